@@ -21,6 +21,5 @@ void ShutdownBaseLibrary()
 {
 	PingService::getInstance().stop();
 	p_libsys_shutdown();
-	TypeInfo::NATIVE_TYPES.clear();
-	TypeInfo::TYPES.clear();
+	TypeInfo::clear();
 }
\ No newline at end of file
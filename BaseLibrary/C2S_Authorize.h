@@ -3,6 +3,7 @@
 #include "Serializable.h"
 #include "serialization.h"
 #include "binary.h"
+#include "fields.h"
 #include "TrackablePacket.h"
 using namespace Serialization;
 using namespace Binary;
@@ -14,8 +15,10 @@ class C2S_Authorize : public TrackablePacket {
 protected:
 	std::string _token;
 public:
+	static constexpr Type TYPE = Type::_C2S_Authorize;
+
 	Type getType() const override {
-		return Type::_C2S_Authorize;
+		return TYPE;
 	}
 
 	C2S_Authorize() = default;
@@ -44,16 +47,27 @@ public:
 		_token = std::move(token);
 	}
 
-	std::ostream& serialize(std::ostream& destination) const override {
+	static auto fields() {
+		return std::make_tuple(
+			Fields::field<Fields::String>(&C2S_Authorize::_token));
+	}
+
+	using TrackablePacket::serialize;
+	using TrackablePacket::deserialize;
+	using TrackablePacket::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& destination) const override {
 		TrackablePacket::serialize(destination);
-		write_string(destination, _token);
-		return destination;
+		return Fields::write_fields(destination, *this, fields());
 	}
 
-	std::istream& deserialize(std::istream& source) override {
+	BinaryReader& deserialize(BinaryReader& source) override {
 		TrackablePacket::deserialize(source);
-		_token = read_string(source);
-		return source;
+		return Fields::read_fields(source, *this, fields());
+	}
+
+	size_t serializedSize(SizeContext& context) const override {
+		return TrackablePacket::serializedSize(context) + Fields::fields_size(context, *this, fields());
 	}
 
 
@@ -1,6 +1,7 @@
 #pragma once
 #include "Serializable.h"
 #include "binary.h"
+#include "fields.h"
 #include "Shift.h"
 
 #include <utility>
@@ -15,8 +16,10 @@ class C2S_DeleteShift : public TrackablePacket {
 protected:
 	identity_t _shiftId;
 public:
+	static constexpr Type TYPE = Type::_C2S_DeleteShift;
+
 	Type getType() const override {
-		return Type::_C2S_DeleteShift;
+		return TYPE;
 	}
 
 	/**
@@ -46,16 +49,27 @@ public:
 		_shiftId = shiftId;
 	}
 
-	std::ostream& serialize(std::ostream& destination) const override {
+	static auto fields() {
+		return std::make_tuple(
+			Fields::field<Fields::Id>(&C2S_DeleteShift::_shiftId));
+	}
+
+	using TrackablePacket::serialize;
+	using TrackablePacket::deserialize;
+	using TrackablePacket::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& destination) const override {
 		TrackablePacket::serialize(destination);
-		write_primitive(destination, _shiftId);
-		return destination;
+		return Fields::write_fields(destination, *this, fields());
 	}
 
-	std::istream& deserialize(std::istream& source) override {
+	BinaryReader& deserialize(BinaryReader& source) override {
 		TrackablePacket::deserialize(source);
-		read_primitive(source, &_shiftId);
-		return source;
+		return Fields::read_fields(source, *this, fields());
+	}
+
+	size_t serializedSize(SizeContext& context) const override {
+		return TrackablePacket::serializedSize(context) + Fields::fields_size(context, *this, fields());
 	}
 
 
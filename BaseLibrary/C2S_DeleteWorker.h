@@ -1,6 +1,7 @@
 #pragma once
 #include "Serializable.h"
 #include "binary.h"
+#include "fields.h"
 #include "Shift.h"
 #include "TrackablePacket.h"
 using namespace Serialization;
@@ -13,8 +14,10 @@ class C2S_DeleteWorker : public TrackablePacket {
 protected:
 	identity_t _workerId;
 public:
+	static constexpr Type TYPE = Type::_C2S_DeleteWorker;
+
 	Type getType() const override {
-		return Type::_C2S_DeleteWorker;
+		return TYPE;
 	}
 
 	/**
@@ -44,16 +47,27 @@ public:
 		_workerId = workerId;
 	}
 
-	std::ostream& serialize(std::ostream& destination) const override {
+	static auto fields() {
+		return std::make_tuple(
+			Fields::field<Fields::Id>(&C2S_DeleteWorker::_workerId));
+	}
+
+	using TrackablePacket::serialize;
+	using TrackablePacket::deserialize;
+	using TrackablePacket::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& destination) const override {
 		TrackablePacket::serialize(destination);
-		write_primitive(destination, _workerId);
-		return destination;
+		return Fields::write_fields(destination, *this, fields());
 	}
 
-	std::istream& deserialize(std::istream& source) override {
+	BinaryReader& deserialize(BinaryReader& source) override {
 		TrackablePacket::deserialize(source);
-		read_primitive(source, &_workerId);
-		return source;
+		return Fields::read_fields(source, *this, fields());
+	}
+
+	size_t serializedSize(SizeContext& context) const override {
+		return TrackablePacket::serializedSize(context) + Fields::fields_size(context, *this, fields());
 	}
 
 
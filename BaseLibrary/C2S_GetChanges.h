@@ -0,0 +1,85 @@
+#pragma once
+#include <utility>
+
+
+#include "Serializable.h"
+#include "binary.h"
+#include "fields.h"
+#include "TrackablePacket.h"
+using namespace Serialization;
+using namespace Binary;
+/**
+ * Client-to-server request for the changes made since the last version the client has seen,
+ * sent after reconnecting instead of listing everything again
+ * 
+ */
+class C2S_GetChanges : public TrackablePacket {
+protected:
+	uint64_t _logId = 0;
+	uint64_t _version = 0;
+public:
+	static constexpr Type TYPE = Type::_C2S_GetChanges;
+
+	Type getType() const override {
+		return TYPE;
+	}
+
+	C2S_GetChanges() = default;
+	/**
+	 * Construct a new request for the missed changes
+	 * 
+	 * @param logId id of the change log the version comes from, 0 if the client has not seen any
+	 * @param version last version seen by the client
+	 */
+	C2S_GetChanges(uint64_t logId, uint64_t version) : _logId(logId), _version(version) {}
+	/**
+	 * Gets the id of the change log the version comes from
+	 * 
+	 * @return uint64_t 
+	 */
+	uint64_t getLogId() const {
+		return _logId;
+	}
+	/**
+	 * Gets the last version seen by the client
+	 * 
+	 * @return uint64_t 
+	 */
+	uint64_t getVersion() const {
+		return _version;
+	}
+
+	static auto fields() {
+		return std::make_tuple(
+			Fields::field<Fields::Uint<uint64_t>>(&C2S_GetChanges::_logId),
+			Fields::field<Fields::Uint<uint64_t>>(&C2S_GetChanges::_version));
+	}
+
+	using TrackablePacket::serialize;
+	using TrackablePacket::deserialize;
+	using TrackablePacket::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& destination) const override {
+		TrackablePacket::serialize(destination);
+		return Fields::write_fields(destination, *this, fields());
+	}
+
+	BinaryReader& deserialize(BinaryReader& source) override {
+		TrackablePacket::deserialize(source);
+		return Fields::read_fields(source, *this, fields());
+	}
+
+	size_t serializedSize(SizeContext& context) const override {
+		return TrackablePacket::serializedSize(context) + Fields::fields_size(context, *this, fields());
+	}
+
+
+	friend bool operator==(const C2S_GetChanges& lhs, const C2S_GetChanges& rhs) {
+		return std::tie(static_cast<const TrackablePacket&>(lhs), lhs._logId, lhs._version) == std::tie(
+			static_cast<const TrackablePacket&>(rhs), rhs._logId, rhs._version);
+	}
+
+	friend bool operator!=(const C2S_GetChanges& lhs, const C2S_GetChanges& rhs) {
+		return !(lhs == rhs);
+	}
+};
@@ -4,6 +4,7 @@
 
 #include "Serializable.h"
 #include "binary.h"
+#include "fields.h"
 #include "TrackablePacket.h"
 using namespace Serialization;
 using namespace Binary;
@@ -15,8 +16,10 @@ class C2S_GetShiftsByDay : public TrackablePacket {
 protected:
 	Date _date;
 public:
+	static constexpr Type TYPE = Type::_C2S_GetShiftsByDay;
+
 	Type getType() const override {
-		return Type::_C2S_GetShiftsByDay;
+		return TYPE;
 	}
 
 	C2S_GetShiftsByDay() : C2S_GetShiftsByDay(Date()) {}
@@ -54,18 +57,27 @@ public:
 	}
 
 
-	std::ostream& serialize(std::ostream& destination) const override {
+	static auto fields() {
+		return std::make_tuple(
+			Fields::field<Fields::Object<Date>>(&C2S_GetShiftsByDay::_date));
+	}
+
+	using TrackablePacket::serialize;
+	using TrackablePacket::deserialize;
+	using TrackablePacket::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& destination) const override {
 		TrackablePacket::serialize(destination);
-		_date.serialize(destination);
-		return destination;
+		return Fields::write_fields(destination, *this, fields());
 	}
 
-	std::istream& deserialize(std::istream& source) override {
+	BinaryReader& deserialize(BinaryReader& source) override {
 		TrackablePacket::deserialize(source);
-		auto date = new_instance<Date>(source);
-		date->deserialize(source);
-		_date = *date;
-		return source;
+		return Fields::read_fields(source, *this, fields());
+	}
+
+	size_t serializedSize(SizeContext& context) const override {
+		return TrackablePacket::serializedSize(context) + Fields::fields_size(context, *this, fields());
 	}
 
 
@@ -0,0 +1,97 @@
+#pragma once
+#include <utility>
+
+
+#include "Serializable.h"
+#include "binary.h"
+#include "fields.h"
+#include "Date.h"
+#include "TrackablePacket.h"
+using namespace Serialization;
+using namespace Binary;
+/**
+ * Client-to-server request to list the Shift objects assigned to a ShiftWorker in a given range of days
+ * 
+ */
+class C2S_GetShiftsByWorker : public TrackablePacket {
+protected:
+	identity_t _workerId{};
+	Date _from;
+	Date _to;
+public:
+	static constexpr Type TYPE = Type::_C2S_GetShiftsByWorker;
+
+	Type getType() const override {
+		return TYPE;
+	}
+
+	C2S_GetShiftsByWorker() = default;
+	/**
+	 * Construct a new request to list the schedule of a worker
+	 * 
+	 * @param workerId id of the ShiftWorker
+	 * @param from first day of the range
+	 * @param to last day of the range (inclusive)
+	 */
+	C2S_GetShiftsByWorker(identity_t workerId, Date from, Date to)
+		: _workerId(workerId), _from(std::move(from)), _to(std::move(to)) {}
+	/**
+	 * Gets the id of the ShiftWorker
+	 * 
+	 * @return identity_t 
+	 */
+	identity_t getWorkerId() const {
+		return _workerId;
+	}
+	/**
+	 * Gets the first day of the range
+	 * 
+	 * @return const Date& 
+	 */
+	const Date& getFrom() const {
+		return _from;
+	}
+	/**
+	 * Gets the last day of the range (inclusive)
+	 * 
+	 * @return const Date& 
+	 */
+	const Date& getTo() const {
+		return _to;
+	}
+
+	static auto fields() {
+		return std::make_tuple(
+			Fields::field<Fields::Id>(&C2S_GetShiftsByWorker::_workerId),
+			Fields::field<Fields::Object<Date>>(&C2S_GetShiftsByWorker::_from),
+			Fields::field<Fields::Object<Date>>(&C2S_GetShiftsByWorker::_to));
+	}
+
+	using TrackablePacket::serialize;
+	using TrackablePacket::deserialize;
+	using TrackablePacket::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& destination) const override {
+		TrackablePacket::serialize(destination);
+		return Fields::write_fields(destination, *this, fields());
+	}
+
+	BinaryReader& deserialize(BinaryReader& source) override {
+		TrackablePacket::deserialize(source);
+		return Fields::read_fields(source, *this, fields());
+	}
+
+	size_t serializedSize(SizeContext& context) const override {
+		return TrackablePacket::serializedSize(context) + Fields::fields_size(context, *this, fields());
+	}
+
+
+	friend bool operator==(const C2S_GetShiftsByWorker& lhs, const C2S_GetShiftsByWorker& rhs) {
+		return std::tie(static_cast<const TrackablePacket&>(lhs), lhs._workerId, lhs._from, lhs._to) == std::tie(
+			static_cast<const TrackablePacket&>(rhs), rhs._workerId, rhs._from, rhs._to);
+	}
+
+	friend bool operator!=(const C2S_GetShiftsByWorker& lhs, const C2S_GetShiftsByWorker& rhs) {
+		return !(lhs == rhs);
+	}
+};
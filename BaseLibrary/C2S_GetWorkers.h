@@ -11,8 +11,10 @@ using namespace Binary;
 class C2S_GetWorkers : public TrackablePacket {
 protected:
 public:
+	static constexpr Type TYPE = Type::_C2S_GetWorkers;
+
 	Type getType() const override {
-		return Type::_C2S_GetWorkers;
+		return TYPE;
 	}
 
 	C2S_GetWorkers() = default;
@@ -1,6 +1,7 @@
 #pragma once
 #include "Serializable.h"
 #include "binary.h"
+#include "fields.h"
 #include "Shift.h"
 
 #include <utility>
@@ -16,8 +17,10 @@ protected:
 	Shift _shift;
 	bool _modifyExisting;
 public:
+	static constexpr Type TYPE = Type::_C2S_InsertShift;
+
 	Type getType() const override {
-		return Type::_C2S_InsertShift;
+		return TYPE;
 	}
 
 	/**
@@ -74,20 +77,28 @@ public:
 		_modifyExisting = modifyExisting;
 	}
 
-	std::ostream& serialize(std::ostream& destination) const override {
+	static auto fields() {
+		return std::make_tuple(
+			Fields::field<Fields::Object<Shift>>(&C2S_InsertShift::_shift),
+			Fields::field<Fields::Bool>(&C2S_InsertShift::_modifyExisting));
+	}
+
+	using TrackablePacket::serialize;
+	using TrackablePacket::deserialize;
+	using TrackablePacket::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& destination) const override {
 		TrackablePacket::serialize(destination);
-		_shift.serialize(destination);
-		write_primitive(destination, _modifyExisting);
-		return destination;
+		return Fields::write_fields(destination, *this, fields());
 	}
 
-	std::istream& deserialize(std::istream& source) override {
+	BinaryReader& deserialize(BinaryReader& source) override {
 		TrackablePacket::deserialize(source);
-		auto instance = new_instance<Shift>(source);
-		instance->deserialize(source);
-		_shift = *instance;
-		read_primitive(source, &_modifyExisting);
-		return source;
+		return Fields::read_fields(source, *this, fields());
+	}
+
+	size_t serializedSize(SizeContext& context) const override {
+		return TrackablePacket::serializedSize(context) + Fields::fields_size(context, *this, fields());
 	}
 
 
@@ -1,6 +1,7 @@
 #pragma once
 #include "Serializable.h"
 #include "binary.h"
+#include "fields.h"
 #include "Shift.h"
 
 #include <utility>
@@ -18,8 +19,10 @@ protected:
 	ShiftWorker _worker;
 	bool _modifyExisting;
 public:
+	static constexpr Type TYPE = Type::_C2S_InsertWorker;
+
 	Type getType() const override {
-		return Type::_C2S_InsertWorker;
+		return TYPE;
 	}
 
 	/**
@@ -76,20 +79,28 @@ public:
 		_modifyExisting = modifyExisting;
 	}
 
-	std::ostream& serialize(std::ostream& destination) const override {
+	static auto fields() {
+		return std::make_tuple(
+			Fields::field<Fields::Object<ShiftWorker>>(&C2S_InsertWorker::_worker),
+			Fields::field<Fields::Bool>(&C2S_InsertWorker::_modifyExisting));
+	}
+
+	using TrackablePacket::serialize;
+	using TrackablePacket::deserialize;
+	using TrackablePacket::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& destination) const override {
 		TrackablePacket::serialize(destination);
-		_worker.serialize(destination);
-		write_primitive(destination, _modifyExisting);
-		return destination;
+		return Fields::write_fields(destination, *this, fields());
 	}
 
-	std::istream& deserialize(std::istream& source) override {
+	BinaryReader& deserialize(BinaryReader& source) override {
 		TrackablePacket::deserialize(source);
-		auto instance = new_instance<ShiftWorker>(source);
-		instance->deserialize(source);
-		_worker = *instance;
-		read_primitive(source, &_modifyExisting);
-		return source;
+		return Fields::read_fields(source, *this, fields());
+	}
+
+	size_t serializedSize(SizeContext& context) const override {
+		return TrackablePacket::serializedSize(context) + Fields::fields_size(context, *this, fields());
 	}
 
 
@@ -0,0 +1,86 @@
+#pragma once
+#include <utility>
+
+
+#include "Serializable.h"
+#include "binary.h"
+#include "fields.h"
+#include "Date.h"
+#include "TrackablePacket.h"
+using namespace Serialization;
+using namespace Binary;
+/**
+ * Client-to-server request to receive the changes of Shift objects only for the given range of days.
+ * Replaces the previous range of the client; clients that never subscribe receive the changes of all days.
+ * 
+ */
+class C2S_SubscribeDays : public TrackablePacket {
+protected:
+	Date _from;
+	Date _to;
+public:
+	static constexpr Type TYPE = Type::_C2S_SubscribeDays;
+
+	Type getType() const override {
+		return TYPE;
+	}
+
+	C2S_SubscribeDays() = default;
+	/**
+	 * Construct a new request to subscribe to a range of days
+	 * 
+	 * @param from first day of the range
+	 * @param to last day of the range (inclusive)
+	 */
+	C2S_SubscribeDays(Date from, Date to) : _from(std::move(from)), _to(std::move(to)) {}
+	/**
+	 * Gets the first day of the range
+	 * 
+	 * @return const Date& 
+	 */
+	const Date& getFrom() const {
+		return _from;
+	}
+	/**
+	 * Gets the last day of the range (inclusive)
+	 * 
+	 * @return const Date& 
+	 */
+	const Date& getTo() const {
+		return _to;
+	}
+
+	static auto fields() {
+		return std::make_tuple(
+			Fields::field<Fields::Object<Date>>(&C2S_SubscribeDays::_from),
+			Fields::field<Fields::Object<Date>>(&C2S_SubscribeDays::_to));
+	}
+
+	using TrackablePacket::serialize;
+	using TrackablePacket::deserialize;
+	using TrackablePacket::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& destination) const override {
+		TrackablePacket::serialize(destination);
+		return Fields::write_fields(destination, *this, fields());
+	}
+
+	BinaryReader& deserialize(BinaryReader& source) override {
+		TrackablePacket::deserialize(source);
+		return Fields::read_fields(source, *this, fields());
+	}
+
+	size_t serializedSize(SizeContext& context) const override {
+		return TrackablePacket::serializedSize(context) + Fields::fields_size(context, *this, fields());
+	}
+
+
+	friend bool operator==(const C2S_SubscribeDays& lhs, const C2S_SubscribeDays& rhs) {
+		return std::tie(static_cast<const TrackablePacket&>(lhs), lhs._from, lhs._to) == std::tie(
+			static_cast<const TrackablePacket&>(rhs), rhs._from, rhs._to);
+	}
+
+	friend bool operator!=(const C2S_SubscribeDays& lhs, const C2S_SubscribeDays& rhs) {
+		return !(lhs == rhs);
+	}
+};
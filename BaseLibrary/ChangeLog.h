@@ -0,0 +1,162 @@
+#pragma once
+#include <chrono>
+#include <deque>
+#include <random>
+
+#include "Date.h"
+#include "Shift.h"
+#include "ShiftWorker.h"
+#include "SyncBatch.h"
+
+/**
+ * Bounded log of the latest changes of the database. Every change gets the next version, so a client
+ * that presents the last version it has seen can be sent only the changes it missed.
+ * The log is kept in memory only; its random id tells a restarted server apart, whose versions start over.
+ */
+class ChangeLog {
+protected:
+	enum class Kind {
+		ChangeShift,
+		RemoveShift,
+		ChangeWorker,
+		RemoveWorker
+	};
+	/**
+	 * Single change of the database
+	 */
+	struct Entry {
+		uint64_t version;
+		Kind kind;
+		bool inserted;
+		identity_t id;
+		Date day;
+		Shift shift;
+		ShiftWorker worker;
+
+		/**
+		 * Construct a new entry, the version is set once it is appended
+		 * 
+		 * @param kind kind of the change
+		 * @param inserted whether the object did not exist before
+		 * @param id id of the object
+		 */
+		Entry(Kind kind, bool inserted, identity_t id) : version(0), kind(kind), inserted(inserted), id(id) {}
+	};
+
+	uint64_t _id;
+	uint64_t _version = 0;
+	size_t _capacity;
+	std::deque<Entry> _entries;
+
+	void append(Entry entry) {
+		entry.version = ++_version;
+		_entries.push_back(std::move(entry));
+		while (_entries.size() > _capacity)
+			_entries.pop_front();
+	}
+
+public:
+	/**
+	 * Construct a new, empty change log
+	 * 
+	 * @param capacity max number of changes kept
+	 */
+	ChangeLog(size_t capacity) : _capacity(capacity) {
+		std::random_device device;
+		std::mt19937_64 random((static_cast<uint64_t>(device()) << 32) ^ device() ^
+			static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()));
+		do {
+			_id = random();
+		} while (_id == 0);
+	}
+	/**
+	 * @return uint64_t id of this log, never 0
+	 */
+	uint64_t getId() const {
+		return _id;
+	}
+	/**
+	 * @return uint64_t version of the latest change
+	 */
+	uint64_t getVersion() const {
+		return _version;
+	}
+	/**
+	 * @return size_t number of changes kept
+	 */
+	size_t size() const {
+		return _entries.size();
+	}
+	/**
+	 * Logs an inserted or modified Shift
+	 * 
+	 * @param shift new state of the object
+	 * @param inserted whether the object did not exist before
+	 */
+	void changeShift(const Shift& shift, bool inserted) {
+		Entry entry(Kind::ChangeShift, inserted, shift.getId());
+		entry.shift = shift;
+		append(std::move(entry));
+	}
+	/**
+	 * Logs a removed Shift
+	 * 
+	 * @param shiftId id of the object
+	 * @param day day the object was in
+	 */
+	void removeShift(identity_t shiftId, const Date& day) {
+		Entry entry(Kind::RemoveShift, false, shiftId);
+		entry.day = day;
+		append(std::move(entry));
+	}
+	/**
+	 * Logs an inserted or modified ShiftWorker
+	 * 
+	 * @param worker new state of the object
+	 * @param inserted whether the object did not exist before
+	 */
+	void changeWorker(const ShiftWorker& worker, bool inserted) {
+		Entry entry(Kind::ChangeWorker, inserted, worker.getId());
+		entry.worker = worker;
+		append(std::move(entry));
+	}
+	/**
+	 * Logs a removed ShiftWorker
+	 * 
+	 * @param workerId id of the object
+	 */
+	void removeWorker(identity_t workerId) {
+		append(Entry(Kind::RemoveWorker, false, workerId));
+	}
+	/**
+	 * Merges the changes made after a version into a batch
+	 * 
+	 * @param since last version seen by the client
+	 * @param batch receives the changes
+	 * @return whether the log still has all the changes made after the version
+	 */
+	bool replay(uint64_t since, SyncBatch& batch) const {
+		if (since > _version)
+			return false;
+		const auto first = _entries.empty() ? _version + 1 : _entries.front().version;
+		if (since + 1 < first)
+			return false;
+		for (auto it = _entries.begin() + static_cast<std::ptrdiff_t>(since + 1 - first); it != _entries.end(); ++it) {
+			switch (it->kind) {
+			case Kind::ChangeShift:
+				batch.changeShift(it->shift, it->inserted);
+				break;
+			case Kind::RemoveShift:
+				batch.removeShift(it->id, it->day);
+				break;
+			case Kind::ChangeWorker:
+				batch.changeWorker(it->worker, it->inserted);
+				break;
+			case Kind::RemoveWorker:
+				batch.removeWorker(it->id);
+				break;
+			}
+		}
+		return true;
+	}
+};
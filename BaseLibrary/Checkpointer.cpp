@@ -0,0 +1,161 @@
+#include "Checkpointer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "files.h"
+
+namespace {
+	/**
+	 * Prefix of snapshots saved as a single compact stream, followed by the first segment of the write-ahead log
+	 * they do not hold
+	 */
+	const char SNAPSHOT_MAGIC[4] = { 'R', 'M', 'C', '2' };
+	/**
+	 * Prefix of compact snapshots saved before the write-ahead log was split into segments.
+	 * Files without any prefix are older fixed-format dumps
+	 */
+	const char LEGACY_MAGIC[4] = { 'R', 'M', 'C', '1' };
+}
+
+Checkpointer::~Checkpointer() {
+	stop();
+}
+
+std::string Checkpointer::imagePath(const std::string& path, uint64_t generation) {
+	return path + "." + std::to_string(generation % 2);
+}
+
+bool Checkpointer::load(uint64_t& segment) {
+	std::shared_ptr<const SnapshotImage> latest;
+	bool corrupt = false;
+	for (uint64_t generation = 0; generation < 2; generation++) {
+		std::shared_ptr<const SnapshotImage> image;
+		// an image damaged on the disk is skipped, the other one is a complete older checkpoint
+		try {
+			image = SnapshotImage::open(imagePath(_path, generation));
+		}
+		catch (std::exception&) {
+			corrupt = true;
+			continue;
+		}
+		if (image && (!latest || image->getGeneration() > latest->getGeneration()))
+			latest = std::move(image);
+	}
+	if (latest) {
+		_generation = latest->getGeneration();
+		segment = latest->getLogSegment();
+		_manager.mapImage(std::move(latest));
+		return true;
+	}
+
+	std::ifstream file(_path, std::ios::binary);
+	if (!file.good()) {
+		// starting empty would drop the saved data for good once the next checkpoint compacts the log
+		if (corrupt)
+			throw std::runtime_error("No valid snapshot image");
+		return false;
+	}
+	char magic[sizeof(SNAPSHOT_MAGIC)] = {};
+	file.read(magic, sizeof(magic));
+	segment = 0;
+	auto format = WireFormat::Compact;
+	if (file.good() && std::memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0) {
+		file.read(reinterpret_cast<char*>(&segment), sizeof(segment));
+	}
+	else if (!file.good() || std::memcmp(magic, LEGACY_MAGIC, sizeof(magic)) != 0) {
+		format = WireFormat::Fixed;
+		file.clear();
+		file.seekg(0);
+	}
+	_manager.deserialize(file, format);
+	return true;
+}
+
+void Checkpointer::checkpoint() {
+	std::lock_guard<std::mutex> checkpointGuard(_checkpointLock);
+	const auto start = std::chrono::steady_clock::now();
+	const auto image = _manager.captureSnapshot(_log);
+	const auto pause = std::chrono::duration_cast<std::chrono::microseconds>(image->getPause());
+
+	const auto generation = _generation + 1;
+	const auto data = SnapshotImage::build(*image, generation);
+	// the previous image stays in place until the new one is on the disk
+	const auto path = imagePath(_path, generation);
+	const auto temporary = path + ".tmp";
+	auto* file = openFile(temporary, "wb");
+	std::shared_ptr<const SnapshotImage> mapped;
+	if (file) {
+		bool saved = std::fwrite(data.data(), 1, data.size(), file) == data.size() && syncFile(file);
+		std::fclose(file);
+		// the new name has to be on the disk before the older snapshot and the segments it replaces are removed
+		saved = saved && replaceFile(temporary, path) && syncDirectory(path);
+		if (!saved)
+			std::remove(temporary.c_str());
+		else
+			mapped = SnapshotImage::open(path);
+	}
+	if (!mapped) {
+		std::lock_guard<std::mutex> guard(_lock);
+		_stats.failures++;
+		throw std::runtime_error("Could not save the snapshot");
+	}
+	// the older image is unmapped once the readers holding it are done, and replaced by the next snapshot
+	_manager.rebaseImage(std::move(mapped));
+	_generation = generation;
+	// a snapshot saved as a single stream is older than the images
+	std::remove(_path.c_str());
+	if (_log)
+		_log->compact(image->getLogSegment());
+
+	std::lock_guard<std::mutex> guard(_lock);
+	_stats.snapshots++;
+	_stats.lastPause = pause;
+	_stats.maxPause = std::max(_stats.maxPause, pause);
+	_stats.lastDuration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+	_stats.lastSize = data.size();
+}
+
+void Checkpointer::start(std::chrono::milliseconds interval) {
+	std::lock_guard<std::mutex> guard(_lock);
+	if (_thread.joinable())
+		throw std::logic_error("Already started");
+	_stopping = false;
+	_thread = std::thread([this, interval] {
+		worker(interval);
+	});
+}
+
+void Checkpointer::stop() {
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+		if (!_thread.joinable())
+			return;
+		_stopping = true;
+	}
+	_signal.notify_all();
+	_thread.join();
+}
+
+Checkpointer::Stats Checkpointer::getStats() {
+	std::lock_guard<std::mutex> guard(_lock);
+	return _stats;
+}
+
+void Checkpointer::worker(std::chrono::milliseconds interval) {
+	std::unique_lock<std::mutex> guard(_lock);
+	while (!_signal.wait_for(guard, interval, [this] {
+		return _stopping;
+	})) {
+		guard.unlock();
+		try {
+			checkpoint();
+		}
+		// counted in the statistics, the next snapshot is tried after the interval
+		catch (std::exception&) { }
+		guard.lock();
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "RestaurantManager.h"
+#include "SnapshotImage.h"
+#include "WriteAheadLog.h"
+
+/**
+ * Saves snapshots of a RestaurantManager in the background while it keeps serving requests.
+ * Every snapshot is an image taken under short pauses of the writers, laid out as a SnapshotImage without any lock,
+ * and written to a temporary file that atomically replaces the older of two image files once it is on the disk.
+ * The manager then serves its days from the new image, and the segments of the write-ahead log it holds are removed.
+ */
+class Checkpointer {
+public:
+	/**
+	 * Counters of the saved snapshots
+	 */
+	struct Stats {
+		uint64_t snapshots = 0;
+		uint64_t failures = 0;
+		/* longest time the writers were stopped for while taking the image */
+		std::chrono::microseconds lastPause{0};
+		std::chrono::microseconds maxPause{0};
+		/* time to take and save the whole snapshot */
+		std::chrono::milliseconds lastDuration{0};
+		size_t lastSize = 0;
+	};
+
+protected:
+	RestaurantManager& _manager;
+	std::string _path;
+	WriteAheadLog* _log;
+	/* generation of the last saved or loaded image */
+	uint64_t _generation = 0;
+	/* only one snapshot is saved at a time */
+	std::mutex _checkpointLock;
+	/* guards the statistics and the background task */
+	std::mutex _lock;
+	std::condition_variable _signal;
+	bool _stopping = false;
+	std::thread _thread;
+	Stats _stats;
+
+	/**
+	 * Background task that saves a snapshot once per interval
+	 *
+	 * @param interval time between the snapshots
+	 */
+	void worker(std::chrono::milliseconds interval);
+
+public:
+	/**
+	 * Construct a new Checkpointer
+	 *
+	 * @param manager saved manager
+	 * @param path path of the snapshot file
+	 * @param log write-ahead log of the manager, if any
+	 */
+	Checkpointer(RestaurantManager& manager, std::string path, WriteAheadLog* log = nullptr)
+		: _manager(manager), _path(std::move(path)), _log(log) { }
+	~Checkpointer();
+
+	Checkpointer(const Checkpointer& other) = delete;
+	Checkpointer& operator=(const Checkpointer& other) = delete;
+
+	/**
+	 * Gets the path of the file of an image, consecutive generations alternate between two files
+	 * so that the one being served from is never replaced
+	 *
+	 * @param path path of the snapshot
+	 * @param generation generation of the image
+	 * @return std::string
+	 */
+	static std::string imagePath(const std::string& path, uint64_t generation);
+	/**
+	 * Loads the manager from the last saved snapshot, if there is one. An image is mapped and served from,
+	 * whatever its size, older snapshots saved as a single stream at the path itself are read in full.
+	 * A damaged image is skipped for the other one, the load fails if no valid image is left
+	 *
+	 * @param segment receives the first segment of the write-ahead log not held by the snapshot
+	 * @return whether a snapshot was found
+	 */
+	bool load(uint64_t& segment);
+	/**
+	 * Saves a snapshot of the manager and removes the segments of the log it holds
+	 */
+	void checkpoint();
+	/**
+	 * Starts saving a snapshot periodically
+	 *
+	 * @param interval time between the snapshots
+	 */
+	void start(std::chrono::milliseconds interval);
+	/**
+	 * Stops saving the snapshots, waiting for the one being saved
+	 */
+	void stop();
+	/**
+	 * @return Stats counters of the saved snapshots
+	 */
+	Stats getStats();
+};
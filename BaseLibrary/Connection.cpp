@@ -1,10 +1,30 @@
 #include "Connection.h"
+#include "Reactor.h"
 #include "net_constants.h"
 #include "serialization.h"
 #include "binary.h"
+#include <algorithm>
 #include <future>
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <cerrno>
+#endif
 using namespace Binary;
 
+namespace {
+	/**
+	 * Limits of everything decoded from a peer
+	 */
+	const DecodeLimits NETWORK_LIMITS = { MAX_STRING_LENGTH, MAX_COLLECTION_SIZE, MAX_JOB_NAMES };
+	/**
+	 * Max number of frames gathered into a single send
+	 */
+	const size_t SEND_BATCH_FRAMES = 64;
+}
+
 int Connection::connect(const std::string& host, int port) {
 	PSocketAddress* addr;
 	PSocket* socket;
@@ -33,6 +53,17 @@ int Connection::connect(const std::string& host, int port) {
 int Connection::connect(PSocket* socket) {
 	if (socket != _socket && isAlive())
 		ConnectionBase::close();
+	// a writing thread detached by the previous connection has to be gone before the state is reset
+	while (_writeThreadActive)
+		std::this_thread::yield();
+	{
+		std::lock_guard<std::mutex> guard(_writeLock);
+		_writeStopping = false;
+		_writeRequested = false;
+	}
+	_sendClosed = false;
+	_sendFailed = false;
+	_receiveBuffer.clear();
 	_socket = socket;
 	if (isAlive()) {
 		p_socket_set_keepalive(_socket, true);
@@ -49,78 +80,300 @@ void Connection::closeError(const std::exception& exception) {
 	}
 }
 
-bool Connection::receiveFromSocket(size_t length) {
-	auto& buf = _receiveStream.buffer();
-	buf.setLength(length, true);
-	buf.pubseekpos(0);
-	auto* data = (pchar*)buf.data();
+bool Connection::receiveFromSocket(size_t required) {
+	const auto available = _receiveBuffer.reserve(required, (std::max)(required, static_cast<size_t>(BUFFER_SIZE)));
+	PError* error = nullptr;
+	// as many bytes as the socket has, so that a burst of frames takes a single call
+	const auto lastRead = p_socket_receive(_socket, reinterpret_cast<pchar*>(_receiveBuffer.writable()), available, &error);
+	_receiveCalls++;
+	if (lastRead <= 0) {
+		const char* msg = p_error_get_message(error);
+		if (!msg)
+			msg = "Connection broken (receive failed)";
+		auto exception = std::runtime_error(msg);
+		closeError(exception);
+		throw exception;
+	}
+	_receiveBuffer.commit(static_cast<size_t>(lastRead));
+	return true;
+}
 
-	pssize lastRead = 0;
-	while (length > 0) {
-		PError* error = nullptr;
-		lastRead = p_socket_receive(_socket, data, length, &error);
-		if (lastRead <= 0) {
-			const char* msg = p_error_get_message(error);
-			if (!msg)
-				msg = "Connection broken (receive failed)";
-			auto exception = std::runtime_error(msg);
-			closeError(exception);
-			throw exception;
-		}
-		data += lastRead;
-		length -= lastRead;
+bool Connection::bufferedFrame(content_len_t& length, WireFormat& format, size_t& frameSize) {
+	frameSize = sizeof(content_len_t);
+	if (_receiveBuffer.size() < frameSize)
+		return false;
+	BinaryReader header(_receiveBuffer.data(), sizeof(content_len_t));
+	const auto prefix = read_primitive<content_len_t>(header);
+	length = prefix & ~COMPACT_FRAME_FLAG;
+	format = prefix & COMPACT_FRAME_FLAG ? WireFormat::Compact : WireFormat::Fixed;
+	if (length > MAX_PACKET_SIZE) {
+		// TODO: handle this by skipping bytes
+		const auto exception = std::runtime_error("Exceeded max packet size");
+		closeError(exception);
+		throw exception;
+	}
+	frameSize += length;
+	return _receiveBuffer.size() >= frameSize;
+}
+
+void Connection::encodeFrame(const Serializable& payload, WireFormat format, std::vector<byte_t>& bytes) {
+	// the exact size is known up front, so oversized packets are rejected before encoding anything
+	const auto size = payload.serializedSize(format);
+	if (size > MAX_PACKET_SIZE) {
+		throw std::runtime_error("Exceeded max packet size");
 	}
+	const auto contentLength = static_cast<content_len_t>(size);
+	bytes.resize(sizeof(content_len_t) + size);
+	BinaryWriter writer(bytes.data(), bytes.size());
+	writer.setFormat(format);
+	const bool compact = format == WireFormat::Compact;
+	write_primitive<content_len_t>(writer, compact ? contentLength | COMPACT_FRAME_FLAG : contentLength);
+	payload.serialize(writer);
+	if (writer.getPosition() != bytes.size())
+		throw std::logic_error("Serialized size mismatch");
+}
 
+OutboundFrame* Connection::encodeFrame(const Serializable& payload) const {
+	auto* frame = new OutboundFrame();
+	try {
+		encodeFrame(payload, getWireFormat(), frame->bytes);
+	}
+	catch (...) {
+		delete frame;
+		throw;
+	}
+	return frame;
+}
+
+SharedFrame Connection::encodeSharedFrame(const Serializable& payload, WireFormat format) {
+	auto bytes = std::make_shared<std::vector<byte_t>>();
+	encodeFrame(payload, format, *bytes);
+	return bytes;
+}
+
+bool Connection::acquireFlush() {
+	if (_flushing.exchange(true, std::memory_order_acquire))
+		return false;
+	_flushOwner = std::this_thread::get_id();
 	return true;
 }
 
-bool Connection::sendBuffer() {
-	auto& buf = _sendStream.buffer();
-	auto* data = reinterpret_cast<pchar*>(buf.data() + static_cast<size_t>(buf.getInPosition()));
-	size_t length = buf.getLength();
+void Connection::releaseFlush() {
+	_flushOwner = std::thread::id();
+	_flushing.store(false, std::memory_order_release);
+}
+
+Connection::FlushResult Connection::flushQueue(bool blocking) {
+	while (true) {
+		if (_sendClosed) {
+			dropFrames();
+			return FlushResult::Drained;
+		}
+		while (_sendBatch.size() < SEND_BATCH_FRAMES) {
+			auto* frame = _sendQueue.pop();
+			if (!frame)
+				break;
+			_sendBatch.push_back(frame);
+		}
+		if (_sendBatch.empty())
+			return FlushResult::Drained;
 
-	pssize lastSent = 0;
-	while (length > 0) {
+#ifdef __linux__
+		iovec vectors[SEND_BATCH_FRAMES];
+		size_t count = 0;
+		for (auto* frame : _sendBatch) {
+			vectors[count].iov_base = const_cast<byte_t*>(frame->data() + frame->offset);
+			vectors[count].iov_len = frame->size() - frame->offset;
+			count++;
+		}
+		msghdr message{};
+		message.msg_iov = vectors;
+		message.msg_iovlen = count;
+		const auto lastSent = ::sendmsg(getNativeHandle(), &message, MSG_NOSIGNAL | (blocking ? 0 : MSG_DONTWAIT));
+		if (lastSent < 0 && errno == EINTR)
+			continue;
+		if (lastSent < 0 && !blocking && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return FlushResult::WouldBlock;
+#else
+		// no scatter/gather in plibsys, the frames are sent one by one
+		auto* first = _sendBatch.front();
 		PError* error = nullptr;
-		lastSent = p_socket_send(_socket, data, length, &error);
+		const auto lastSent = p_socket_send(_socket, reinterpret_cast<const pchar*>(first->data() + first->offset),
+		                                    first->size() - first->offset, &error);
+#endif
 		if (lastSent <= 0) {
-			const char* msg = p_error_get_message(error);
-			if (!msg)
-				msg = "Connection broken (send failed)";
-			auto exception = std::runtime_error(msg);
-			closeError(exception);
-			throw exception;
+			const bool closed = _sendClosed;
+			dropFrames();
+			// a connection closed in the meantime is not reported again
+			return closed ? FlushResult::Drained : FlushResult::Failed;
 		}
-		data += lastSent;
-		length -= lastSent;
-	}
 
-	return true;
+		auto sent = static_cast<size_t>(lastSent);
+		while (sent > 0) {
+			auto* frame = _sendBatch.front();
+			const auto left = frame->size() - frame->offset;
+			if (sent < left) {
+				frame->offset += sent;
+				break;
+			}
+			sent -= left;
+			_sendBatch.pop_front();
+			frame->complete(true);
+			delete frame;
+		}
+	}
 }
 
+bool Connection::flush(bool blocking) {
+	// producers that found the flush owned left their frames to this thread, which checks the queue again once released
+	do {
+		if (!acquireFlush())
+			return false;
+		const auto result = flushQueue(blocking);
+		releaseFlush();
+		if (result == FlushResult::Failed) {
+			closeError(std::runtime_error("Connection broken (send failed)"));
+			return false;
+		}
+		if (result == FlushResult::WouldBlock)
+			return true;
+	} while (!_sendQueue.empty());
+	return false;
+}
 
-void Connection::writeSync(const Serializable& payload) {
+void Connection::scheduleFlush() {
+	// the handler thread sends what its handlers queued once they return, see Reactor::handle
+	if (_reactor && std::this_thread::get_id() == _handlerThread.load())
+		return;
+	if (_reactor && _reactorLoop >= 0 && _reactor->requestFlush(this))
+		return;
+	// the reading thread sends what its handlers queued once they return, see readAsync
+	if (!_reactor && _readingAsync && std::this_thread::get_id() == _readThread.get_id())
+		return;
+	if (!_reactor) {
+		// the current owner of the flush checks the queue again once it is done
+		if (!acquireFlush())
+			return;
+		// other producers try to send right away without blocking, the writing thread is only needed for a full socket
+		const auto result = flushQueue(false);
+		releaseFlush();
+		if (result == FlushResult::Drained && _sendQueue.empty())
+			return;
+		// reported by the writing thread, as producers may hold the locks of the observers
+		if (result == FlushResult::Failed)
+			_sendFailed = true;
+	}
+	{
+		std::lock_guard<std::mutex> guard(_writeLock);
+		if (_writeStopping)
+			return;
+		_writeRequested = true;
+		if (!_writeThreadActive) {
+			_writeThreadActive = true;
+			if (_writeThread.joinable())
+				_writeThread.join();
+			_writeThread = std::thread([this] {
+				writeWorker();
+			});
+		}
+	}
+	_writeSignal.notify_one();
+}
 
-	assertConnected();
-	auto& buf = _sendStream.buffer();
-	buf.setLength(MAX_PACKET_SIZE + sizeof(content_len_t), true);
-	buf.pubseekpos(sizeof(content_len_t));
+void Connection::writeWorker() {
+	std::unique_lock<std::mutex> guard(_writeLock);
+	while (true) {
+		_writeSignal.wait(guard, [this] {
+			return _writeRequested || _writeStopping;
+		});
+		if (_writeStopping)
+			break;
+		_writeRequested = false;
+		guard.unlock();
+		if (_sendFailed.exchange(false))
+			closeError(std::runtime_error("Connection broken (send failed)"));
+		else
+			flush(true);
+		guard.lock();
+	}
+	_writeThreadActive = false;
+}
 
-	payload.serialize(_sendStream);
+void Connection::dropFrames() {
+	for (auto* frame : _sendBatch) {
+		frame->complete(false);
+		delete frame;
+	}
+	_sendBatch.clear();
+	while (auto* frame = _sendQueue.pop()) {
+		frame->complete(false);
+		delete frame;
+	}
+}
 
-	const auto toWrite = static_cast<size_t>(buf.getOutPosition());
-	const auto contentLength = static_cast<content_len_t>(toWrite) - sizeof(content_len_t);
-	if (contentLength > MAX_PACKET_SIZE) {
-		throw std::runtime_error("Exceeded max packet size");
+void Connection::dropPendingFrames() {
+	// the owner is this very thread when a completion closes the connection; its flush drops the frames
+	if (_flushOwner == std::this_thread::get_id())
+		return;
+	while (true) {
+		if (acquireFlush()) {
+			dropFrames();
+			releaseFlush();
+		}
+		if (_sendQueue.empty())
+			return;
+		std::this_thread::yield();
 	}
-	buf.pubseekpos(0, std::ios_base::in | std::ios_base::out);
-	write_primitive(_sendStream, contentLength);
-	buf.setLength(toWrite, false);
+}
 
-	if (sendBuffer())
-		onPayloadSent(payload, contentLength);
+void Connection::writeAsync(const Serializable& payload, std::function<void(bool)> completion) {
+	assertConnected();
+	auto* frame = encodeFrame(payload);
+	frame->completion = std::move(completion);
+	queueFrame(payload, frame);
+}
 
+void Connection::writeAsync(const Serializable& payload, const SharedFrame& frame, std::function<void(bool)> completion) {
+	if (!frame) {
+		writeAsync(payload, std::move(completion));
+		return;
+	}
+	assertConnected();
+	auto* outbound = new OutboundFrame();
+	outbound->shared = frame;
+	outbound->completion = std::move(completion);
+	queueFrame(payload, outbound);
+}
 
+void Connection::queueFrame(const Serializable& payload, OutboundFrame* frame) {
+	const auto contentLength = frame->size() - sizeof(content_len_t);
+	_sendQueue.push(frame);
+	// observers see the payload while it still exists, which is before it is sent
+	onPayloadSent(payload, contentLength);
+	if (_sendClosed)
+		dropPendingFrames();
+	else
+		scheduleFlush();
+}
+
+void Connection::writeSync(const Serializable& payload) {
+	assertConnected();
+	auto* frame = encodeFrame(payload);
+	auto promise = std::make_shared<std::promise<bool>>();
+	auto sent = promise->get_future();
+	frame->completion = [promise](bool result) {
+		promise->set_value(result);
+	};
+	const auto contentLength = frame->size() - sizeof(content_len_t);
+	_sendQueue.push(frame);
+	if (_sendClosed)
+		dropPendingFrames();
+	else
+		flush(true);
+	// otherwise the current owner of the flush sends the frame
+	if (!sent.get())
+		throw std::runtime_error("Connection broken (send failed)");
+	onPayloadSent(payload, contentLength);
 }
 
 std::shared_ptr<Serializable> Connection::readSync() {
@@ -132,43 +385,99 @@ std::shared_ptr<Serializable> Connection::readSync() {
 
 std::shared_ptr<Serializable> Connection::readSyncInternal() {
 	assertConnected();
-	if (receiveFromSocket(sizeof(content_len_t))) {
-		content_len_t length;
-		read_primitive(_receiveStream, &length);
-		if (length > MAX_PACKET_SIZE) {
-			// TODO: handle this by skipping bytes
-			const auto exception = std::runtime_error("Exceeded max packet size");
-			closeError(exception);
-			throw exception;
-		}
-		// discard 'big' buffer if the required length fits in standard capacity
-		auto& buf = _receiveStream.buffer();
-		if (buf.getCapacity() > MAX_BUFFER_SIZE && length < MAX_BUFFER_SIZE)
-			buf.dispose();
+	content_len_t length;
+	WireFormat format;
+	size_t frameSize;
+	// frames received along with an earlier one are decoded without touching the socket
+	while (!bufferedFrame(length, format, frameSize))
+		receiveFromSocket(frameSize);
+	auto obj = decodeFrame(length, format);
+	// discard 'big' buffer once drained, standard capacity fits the usual frames
+	_receiveBuffer.shrink(MAX_BUFFER_SIZE);
+	return obj;
+}
 
-		if (receiveFromSocket(length)) {
-			try {
-				auto obj = new_instance(_receiveStream);
-				obj->deserialize(_receiveStream);
-				onPayloadReceived(*obj, length);
-				return obj;
-			}
-			catch (std::runtime_error& ex) {
-				std::cerr << ex.what() << std::endl;
-				// invalid object found.. ignore it
-			}
-		}
+std::shared_ptr<Serializable> Connection::decodeFrame(content_len_t length, WireFormat format) {
+	auto obj = decodePayload(length, format);
+	if (obj && !deliverPayload(*obj, length))
+		return std::shared_ptr<Serializable>(nullptr);
+	return obj;
+}
+
+std::shared_ptr<Serializable> Connection::decodePayload(content_len_t length, WireFormat format) {
+	const auto* data = _receiveBuffer.data() + sizeof(content_len_t);
+	// consumed before the handlers run, as they may read themselves; the bytes stay in place until the next receive
+	_receiveBuffer.consume(sizeof(content_len_t) + length);
+	// empty frames carry no payload
+	if (length == 0)
+		return std::shared_ptr<Serializable>(nullptr);
+	try {
+		return decode_payload(data, length, format, NETWORK_LIMITS);
+	}
+	catch (std::runtime_error& ex) {
+		std::cerr << ex.what() << std::endl;
+		// invalid object found.. ignore it
 	}
 	return std::shared_ptr<Serializable>(nullptr);
 }
 
+bool Connection::deliverPayload(const Serializable& payload, size_t size) {
+	try {
+		onPayloadReceived(payload, size);
+		return true;
+	}
+	catch (std::runtime_error& ex) {
+		std::cerr << ex.what() << std::endl;
+	}
+	return false;
+}
+
+bool Connection::receiveAvailable() {
+#ifdef __linux__
+	content_len_t length;
+	WireFormat format;
+	size_t frameSize;
+	while (isAlive()) {
+		// every complete frame is decoded before the socket is read again
+		if (bufferedFrame(length, format, frameSize)) {
+			auto obj = decodePayload(length, format);
+			if (obj)
+				_reactor->dispatch(this, std::move(obj), length);
+			continue;
+		}
+		const auto available = _receiveBuffer.reserve(frameSize, (std::max)(frameSize, static_cast<size_t>(BUFFER_SIZE)));
+		const auto lastRead = ::recv(getNativeHandle(), _receiveBuffer.writable(), available, MSG_DONTWAIT);
+		_receiveCalls++;
+		if (lastRead < 0 && errno == EINTR)
+			continue;
+		if (lastRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			// idle connections of an event loop hold no receive memory
+			_receiveBuffer.shrink();
+			return true;
+		}
+		if (lastRead <= 0) {
+			closeError(std::runtime_error("Connection broken (receive failed)"));
+			return false;
+		}
+		_lastReceived = std::chrono::steady_clock::now();
+		_receiveBuffer.commit(static_cast<size_t>(lastRead));
+	}
+	return false;
+#else
+	throw std::logic_error("Event-loop reading is not supported on this platform");
+#endif
+}
+
 bool Connection::readAsync() {
 	std::lock_guard<std::recursive_mutex> lock(_readLock);
 
 	_readingAsync = true;
 	try {
-		while (isAlive() && _readingAsync)
+		while (isAlive() && _readingAsync) {
 			auto _ = readSyncInternal();
+			if (!_sendQueue.empty())
+				flush(true);
+		}
 	}
 	catch (...) {
 		// C++ has no real 'finally' support
@@ -178,6 +487,23 @@ bool Connection::readAsync() {
 }
 
 bool Connection::setReadingAsync(bool readAsync) {
+	if (_reactor) {
+		if (!_readingAsync && readAsync) {
+			_lastReceived = std::chrono::steady_clock::now();
+			_readingAsync = true;
+			try {
+				_reactor->attach(this);
+			}
+			catch (...) {
+				_readingAsync = false;
+				throw;
+			}
+		}
+		else if (_readingAsync && !readAsync) {
+			_reactor->detach(this);
+		}
+		return readAsync;
+	}
 	if (!_readingAsync && readAsync) {
 		_readThread = std::thread([this] {
 			this->readAsync();
@@ -191,14 +517,34 @@ bool Connection::setReadingAsync(bool readAsync) {
 	return readAsync;
 }
 
+void Connection::setReactor(Reactor* reactor) {
+	if (_readingAsync)
+		throw std::logic_error("Cannot change the reading mode while reading");
+	_reactor = reactor;
+}
+
+int Connection::getNativeHandle() const {
+	return _socket ? p_socket_get_fd(_socket) : -1;
+}
+
 void Connection::cleanup() {
 	ConnectionBase::cleanup();
-	_sendStream.dispose();
-	_receiveStream.dispose();
-	if (!p_socket_is_closed(_socket))
-		p_socket_close(_socket, nullptr);
-	p_socket_free(_socket);
-	_socket = nullptr;
+	// stop the event loop from using the socket before it is released
+	if (_reactor)
+		_reactor->detach(this);
+	// the socket is shut down, so a blocked send of the writing thread fails right away
+	_sendClosed = true;
+	{
+		std::lock_guard<std::mutex> guard(_writeLock);
+		_writeStopping = true;
+	}
+	_writeSignal.notify_all();
+	if (_writeThread.get_id() != std::this_thread::get_id() && _writeThread.joinable())
+		_writeThread.join();
+	else if (_writeThread.joinable())
+		_writeThread.detach();
+	dropPendingFrames();
+	// the socket is shut down, so the reading thread has to finish before its buffers are released
 	setReadingAsync(false);
 	if (_readThread.get_id() != std::this_thread::get_id() && _readThread.joinable()) {
 		_readThread.join();
@@ -208,9 +554,27 @@ void Connection::cleanup() {
 				_readThread.detach();
 		}catch(...) {}
 	}
+	// the receive buffer is kept until the connection is reused or deleted, an event loop may still be decoding from it.
+	// the socket is shut down already, a loop still holding the connection frees it once it lets go of it
+	if (_reactor && _reactor->freeOnRelease(this))
+		return;
+	freeSocket();
+}
 
+void Connection::freeSocket() {
+	if (!p_socket_is_closed(_socket))
+		p_socket_close(_socket, nullptr);
+	p_socket_free(_socket);
+	_socket = nullptr;
 }
 
 Connection::~Connection() {
 	Connection::cleanup();
+	// a writing thread that closed the connection itself is detached, and has to leave before the members go
+	while (_writeThreadActive)
+		std::this_thread::yield();
+	// so does an event loop still holding the connection, once no handler thread runs for it
+	while (_reactorLoop >= 0)
+		std::this_thread::yield();
+	std::lock_guard<std::mutex> guard(_writeLock);
 }
@@ -3,8 +3,15 @@
 #include "plibsys.h"
 #include "types.h"
 #include "buffers.h"
+#include "ReceiveBuffer.h"
+#include "SendQueue.h"
 #include <thread>
 #include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+
+class Reactor;
 
 
 /**
@@ -12,29 +19,177 @@
  * 
  */
 class Connection : public ConnectionBase {
+	friend class Reactor;
 protected:
-	memory_stream _sendStream, _receiveStream;
+	/* Received bytes, decoded frame by frame by the reading thread or the event loop */
+	ReceiveBuffer _receiveBuffer;
+	std::atomic<size_t> _receiveCalls{0};
 	std::recursive_mutex _readLock;
 	std::thread _readThread;
 
+	/* Outbound state, the queue and batch are only flushed by the thread owning `_flushing` */
+	SendQueue _sendQueue;
+	std::deque<OutboundFrame*> _sendBatch;
+	std::atomic<bool> _flushing{false};
+	std::atomic<std::thread::id> _flushOwner;
+	std::atomic<bool> _sendClosed{false};
+	std::atomic<bool> _sendFailed{false};
+	std::atomic<bool> _flushRequested{false};
+	bool _reactorWritable = false;
+	std::thread _writeThread;
+	std::atomic<bool> _writeThreadActive{false};
+	std::mutex _writeLock;
+	std::condition_variable _writeSignal;
+	bool _writeRequested = false;
+	bool _writeStopping = false;
+
+	/* Event-loop reading state */
+	Reactor* _reactor = nullptr;
+	std::atomic<int> _reactorLoop{-1};
+	int _reactorFd = -1;
+	/* set once the connection is closed while its loop may still be reading, the loop then frees the socket */
+	bool _freeOnRelease = false;
+	std::chrono::steady_clock::time_point _lastReceived;
+	/* Frames decoded by the event loop, handled in order by a single handler thread at a time */
+	std::mutex _dispatchLock;
+	std::deque<std::pair<std::shared_ptr<Serializable>, size_t>> _dispatchQueue;
+	bool _dispatching = false;
+	std::atomic<std::thread::id> _handlerThread;
+
 	void cleanup() override;
 	void closeError(const std::exception& exception) override;
 	/**
-	 * Helper method to read length bytes from input into the buffer
+	 * Closes and frees the socket
+	 */
+	void freeSocket();
+	/**
+	 * Helper method to read as many bytes as the socket has into the receive buffer, waiting for at least one
 	 * 
-	 * @param length number of bytes to be read
+	 * @param required number of bytes the buffer has to be able to hold, the rest of the next frame included
 	 * @return true success
 	 * @return false failure
 	 */
-	bool receiveFromSocket(size_t length);
+	bool receiveFromSocket(size_t required);
 	/**
-	 * Helper method to push bytes stored in the send buffer
+	 * Looks for a complete frame at the start of the receive buffer, closing the connection if its length is invalid
 	 * 
-	 * @return true success
-	 * @return false failure
+	 * @param length content length of the frame, if its prefix is received
+	 * @param format encoding of the frame, if its prefix is received
+	 * @param frameSize number of bytes the whole frame takes, or of its prefix if that is not received yet
+	 * @return true the whole frame is received
+	 * @return false more bytes are needed
+	 */
+	bool bufferedFrame(content_len_t& length, WireFormat& format, size_t& frameSize);
+	/**
+	 * Outcome of a flush of the send queue
+	 */
+	enum class FlushResult {
+		/** every queued frame was sent */
+		Drained,
+		/** the socket cannot take more bytes without blocking */
+		WouldBlock,
+		/** the socket failed, all queued frames were dropped */
+		Failed,
+	};
+	/**
+	 * Encodes the payload into a frame of its own, in the wire format of this connection
+	 * 
+	 * @param payload payload object
+	 * @return OutboundFrame* new frame, owned by the caller
+	 */
+	OutboundFrame* encodeFrame(const Serializable& payload) const;
+	/**
+	 * Encodes the payload and its length prefix
+	 * 
+	 * @param payload payload object
+	 * @param format wire format
+	 * @param bytes output buffer, resized to the frame
+	 */
+	static void encodeFrame(const Serializable& payload, WireFormat format, std::vector<byte_t>& bytes);
+	/**
+	 * Queues an encoded frame and hands it to the I/O thread
+	 * 
+	 * @param payload encoded payload, passed to the observers
+	 * @param frame new frame, owned by the queue from now on
+	 */
+	void queueFrame(const Serializable& payload, OutboundFrame* frame);
+	/**
+	 * Sends the queued frames, gathering several of them into a single system call.
+	 * Has to be called by the owner of the flush.
+	 * 
+	 * @param blocking whether to wait for the socket, or to stop as soon as it would block
+	 * @return FlushResult outcome
+	 */
+	FlushResult flushQueue(bool blocking);
+	/**
+	 * Takes the ownership of the flush of the send queue, if no other thread has it
+	 * 
+	 * @return whether the calling thread is now the owner
+	 */
+	bool acquireFlush();
+	/**
+	 * Releases the ownership of the flush of the send queue
+	 */
+	virtual void releaseFlush();
+	/**
+	 * Flushes the send queue unless another thread is already doing so, closing the connection on failure
+	 * 
+	 * @param blocking whether to wait for the socket
+	 * @return true frames are left waiting for the socket to become writable
+	 * @return false the queue was drained, or is flushed by another thread
+	 */
+	bool flush(bool blocking);
+	/**
+	 * Hands the flush of the send queue to the I/O thread: the event loop of the connection,
+	 * or, after a non-blocking attempt by the calling thread, a writing thread started on demand
+	 */
+	void scheduleFlush();
+	/**
+	 * Background task that flushes the send queue when signalled, if no event loop does it
+	 */
+	void writeWorker();
+	/**
+	 * Drops the frames of the batch and of the queue, completing them as not sent.
+	 * Has to be called by the owner of the flush.
+	 */
+	void dropFrames();
+	/**
+	 * Drops all queued frames once the connection is closed, waiting for the current flush to finish
 	 */
-	bool sendBuffer();
+	void dropPendingFrames();
 	bool readAsync() override;
+	/**
+	 * Decodes the packet at the start of the receive buffer, consumes it and dispatches it to the observers
+	 * 
+	 * @param length content length of the packet
+	 * @param format encoding of the packet, taken from its length prefix
+	 * @return std::shared_ptr<Serializable> payload received, or nullptr if it could not be decoded
+	 */
+	std::shared_ptr<Serializable> decodeFrame(content_len_t length, WireFormat format);
+	/**
+	 * Decodes the packet at the start of the receive buffer and consumes it, without notifying the observers
+	 * 
+	 * @param length content length of the packet
+	 * @param format encoding of the packet, taken from its length prefix
+	 * @return std::shared_ptr<Serializable> payload received, or nullptr if it could not be decoded
+	 */
+	std::shared_ptr<Serializable> decodePayload(content_len_t length, WireFormat format);
+	/**
+	 * Dispatches a received payload to the observers
+	 * 
+	 * @param payload decoded payload
+	 * @param size encoded size of the payload
+	 * @return whether the observers handled it without error
+	 */
+	bool deliverPayload(const Serializable& payload, size_t size);
+	/**
+	 * Reads all bytes available in the socket without blocking and decodes every complete packet.
+	 * Used by the Reactor, which calls it when the socket becomes readable, and hands the packets to its handler threads.
+	 * 
+	 * @return true the connection is still alive
+	 * @return false the connection was closed
+	 */
+	bool receiveAvailable();
 	/**
 	 * Internal function to read a single packet from the sream
 	 * 
@@ -48,6 +203,27 @@ public:
 	}
 
 	bool setReadingAsync(bool readAsync) override;
+	/**
+	 * Makes the background reading use the given event loop instead of a dedicated thread.
+	 * Has to be set before reading is started.
+	 * 
+	 * @param reactor running event loop, or nullptr to use a reading thread
+	 */
+	void setReactor(Reactor* reactor);
+	/**
+	 * Gets the event loop that reads this connection
+	 * 
+	 * @return Reactor* event loop, or nullptr if a reading thread is used
+	 */
+	Reactor* getReactor() const {
+		return _reactor;
+	}
+	/**
+	 * Gets the native handle (file descriptor) of the underlying socket
+	 * 
+	 * @return int native handle
+	 */
+	int getNativeHandle() const;
 	/**
 	 * Construct a new Connection object
 	 * 
@@ -57,7 +233,40 @@ public:
 	virtual ~Connection();
 	int connect(const std::string& host, int port) override;
 	int connect(PSocket* socket) override;
+	using ConnectionBase::writeAsync;
+	/**
+	 * Sends the payload and waits until the socket takes it. Frames queued earlier are sent first,
+	 * by the calling thread itself if no I/O thread is flushing the queue.
+	 * 
+	 * @param payload payload object
+	 */
 	void writeSync(const Serializable& payload) override;
+	void writeAsync(const Serializable& payload, std::function<void(bool)> completion) override;
+	void writeAsync(const Serializable& payload, const SharedFrame& frame, std::function<void(bool)> completion) override;
+	/**
+	 * Encodes a payload once, to be queued to any number of connections using the same wire format
+	 * 
+	 * @param payload payload object
+	 * @param format wire format of the receiving connections
+	 * @return SharedFrame immutable frame
+	 */
+	static SharedFrame encodeSharedFrame(const Serializable& payload, WireFormat format);
+	/**
+	 * Gets the number of frames not yet taken by the thread flushing the queue
+	 * 
+	 * @return size_t number of queued frames
+	 */
+	size_t getQueuedFrames() const {
+		return _sendQueue.size();
+	}
+	/**
+	 * Gets the number of receive calls made on the socket, each of which may take several frames
+	 * 
+	 * @return size_t number of receive calls
+	 */
+	size_t getReceiveCalls() const {
+		return _receiveCalls;
+	}
 	std::shared_ptr<Serializable> readSync() override;
 
 };
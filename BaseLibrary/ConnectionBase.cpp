@@ -15,7 +15,8 @@ void ConnectionBase::unsubscribe(ConnectionObserver* observer) {
 }
 
 void ConnectionBase::onConnected() {
-	writeSync(Ping());
+	_peerCompactEncoding = false;
+	writeSync(Ping(_compactEncoding ? Ping::CAPABILITY_COMPACT : 0));
 	for (const auto& obs : _observers)
 		if (isAlive())
 			obs->onConnected(this);
@@ -33,6 +34,9 @@ void ConnectionBase::onPayloadSent(const Serializable& payload, size_t size) {
 }
 
 void ConnectionBase::onPayloadReceived(const Serializable& payload, size_t size) {
+	// periodic pings carry no capabilities, so the format is never downgraded
+	if (payload.getType() == Type::_Ping && static_cast<const Ping&>(payload).getCapabilities() & Ping::CAPABILITY_COMPACT)
+		_peerCompactEncoding = true;
 	for (auto* obs : _observers)
 		obs->onPayloadReceived(this, payload, size);
 }
@@ -41,6 +45,9 @@ ConnectionBase::ConnectionBase(bool subscribeToPing) {
 	_id = -1;
 	_lastRequestId = 0;
 	_socket = nullptr;
+	_readingAsync = false;
+	_compactEncoding = true;
+	_peerCompactEncoding = false;
 	if (subscribeToPing)
 		PingService::getInstance().subscribe(this);
 }
@@ -68,7 +75,8 @@ void ConnectionBase::assertConnected() const {
 }
 
 ConnectionObserver::~ConnectionObserver() {
-	_handlers.clear();
+	for (auto& handlers : _handlers)
+		handlers.clear();
 }
 
 int ConnectionBase::newRequestId() {
@@ -78,6 +86,15 @@ int ConnectionBase::newRequestId() {
 }
 
 
+std::future<bool> ConnectionBase::writeAsync(const Serializable& payload) {
+	auto promise = std::make_shared<std::promise<bool>>();
+	auto future = promise->get_future();
+	writeAsync(payload, [promise](bool sent) {
+		promise->set_value(sent);
+	});
+	return future;
+}
+
 int ConnectionBase::writeRequestSync(TrackablePacket& payload) {
 	int id = newRequestId();
 	payload.setRequestId(id);
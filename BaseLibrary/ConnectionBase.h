@@ -1,11 +1,14 @@
 #include "DataBag.h"
 #include "Serializable.h"
 #include "plibsys.h"
+#include <array>
 #include <functional>
+#include <future>
 #include <set>
 #include <atomic>
 #include <list>
 #include <mutex>
+#include "SendQueue.h"
 #include "TrackablePacket.h"
 using namespace std::placeholders;
 #pragma once
@@ -18,7 +21,10 @@ class ConnectionBase;
  */
 class ConnectionObserver {
 protected:
-	std::map<Type, std::list<std::function<void(ConnectionBase*, const Serializable&, size_t)>>> _handlers;
+	/**
+	 * Payload handlers, indexed by the Type tag of the payload
+	 */
+	std::array<std::list<std::function<void(ConnectionBase*, const Serializable&, size_t)>>, TYPE_COUNT> _handlers;
 public:
 	virtual ~ConnectionObserver();
 	/**
@@ -29,8 +35,9 @@ public:
 	 */
 	template <typename T>
 	void addHandler(std::function<void(ConnectionBase*, const T&, size_t)> callback) {
-		_handlers[get_type<T>()].push_back([callback](ConnectionBase* con, const Serializable& data, size_t size) {
-			callback(con, dynamic_cast<const T&>(data), size);
+		// handlers are looked up by the exact type of the payload, so the cast is always valid
+		_handlers[static_cast<uint8_t>(get_type<T>())].push_back([callback](ConnectionBase* con, const Serializable& data, size_t size) {
+			callback(con, static_cast<const T&>(data), size);
 		});
 	}
 	/**
@@ -52,7 +59,7 @@ public:
 	 */
 	template <typename T>
 	void removeHandlers() {
-		_handlers[get_type<T>()].clear();
+		_handlers[static_cast<uint8_t>(get_type<T>())].clear();
 	}
 	/**
 	 * Event handler for connection established
@@ -83,11 +90,8 @@ public:
 	 * @param size size (in bytes) of received payload
 	 */
 	virtual void onPayloadReceived(ConnectionBase* connection, const Serializable& payload, size_t size) {
-		auto it = _handlers.find(payload.getType());
-		if (it != _handlers.end()) {
-			for (const auto& callback : it->second) {
-				callback(connection, payload, size);
-			}
+		for (const auto& callback : _handlers[static_cast<uint8_t>(payload.getType())]) {
+			callback(connection, payload, size);
 		}
 	}
 };
@@ -104,6 +108,8 @@ protected:
 	DataBag _data;
 	std::list<ConnectionObserver*> _observers;
 	std::atomic<bool> _readingAsync;
+	std::atomic<bool> _compactEncoding;
+	std::atomic<bool> _peerCompactEncoding;
 	int _id;
 	int _lastRequestId;
 	/**
@@ -204,6 +210,31 @@ public:
 	 * @return whether the background receive task is now running
 	 */
 	virtual bool setReadingAsync(bool readAsync) = 0;
+	/**
+	 * 
+	 * @return Whether the compact wire format is enabled for this endpoint
+	 */
+	virtual bool isCompactEncoding() const {
+		return _compactEncoding;
+	}
+	/**
+	 * Controls whether the compact wire format is advertised to, and used with capable peers.
+	 * Has to be set before connecting, as the capabilities are sent once per connection.
+	 * 
+	 * @param compact 
+	 */
+	virtual void setCompactEncoding(bool compact) {
+		_compactEncoding = compact;
+	}
+	/**
+	 * Gets the format used for outgoing packets. Packets are sent in the fixed format
+	 * until the peer advertises support for the compact one.
+	 * 
+	 * @return WireFormat format of outgoing packets
+	 */
+	virtual WireFormat getWireFormat() const {
+		return _compactEncoding && _peerCompactEncoding ? WireFormat::Compact : WireFormat::Fixed;
+	}
 	/**
 	 * Construct a new ConnectionBase object
 	 * 
@@ -249,6 +280,32 @@ public:
 	 * @param payload payload object
 	 */
 	virtual void writeSync(const Serializable& payload) = 0;
+	/**
+	 * Queues the given payload to be sent by the I/O thread of this connection, without waiting for the socket.
+	 * The payload is encoded before returning, so it may be modified or destroyed right away.
+	 * 
+	 * @param payload payload object
+	 * @param completion called from the I/O thread with whether the payload was sent, may be empty
+	 */
+	virtual void writeAsync(const Serializable& payload, std::function<void(bool)> completion) = 0;
+	/**
+	 * Queues a payload encoded beforehand, sharing its bytes with other connections instead of encoding it again.
+	 * By default the frame is ignored and the payload is encoded by writeAsync.
+	 * 
+	 * @param payload payload object, passed to the observers
+	 * @param frame payload encoded in the wire format of this connection (see getWireFormat), or nullptr
+	 * @param completion called from the I/O thread with whether the payload was sent, may be empty
+	 */
+	virtual void writeAsync(const Serializable& payload, const SharedFrame& frame, std::function<void(bool)> completion) {
+		writeAsync(payload, std::move(completion));
+	}
+	/**
+	 * Queues the given payload to be sent by the I/O thread of this connection, without waiting for the socket
+	 * 
+	 * @param payload payload object
+	 * @return std::future<bool> whether the payload was sent
+	 */
+	virtual std::future<bool> writeAsync(const Serializable& payload);
 	/**
 	 * Synchronously writes the given request into the network stream
 	 * 
@@ -19,8 +19,10 @@ protected:
 
 
 public:
+	static constexpr Type TYPE = Type::_Date;
+
 	Type getType() const override {
-		return Type::_Date;
+		return TYPE;
 	}
 	/**
 	 * Construct a new Date object with default date (1st January 1970)
@@ -97,22 +99,47 @@ public:
 		_day = day;
 	}
 
-	std::ostream& serialize(std::ostream& destination) const override {
+	using Serializable::serialize;
+	using Serializable::deserialize;
+	using Serializable::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& destination) const override {
 		Serializable::serialize(destination);
+		if (destination.getFormat() == WireFormat::Compact) {
+			// day in bits 0-4, month in bits 5-8, year above: 3 bytes for any current date
+			write_varint(destination, static_cast<uint64_t>(_year) << 9 | _month << 5 | _day);
+			return destination;
+		}
 		write_primitive(destination, _year);
 		write_primitive(destination, _month);
 		write_primitive(destination, _day);
 		return destination;
 	}
 
-	std::istream& deserialize(std::istream& source) override {
+	BinaryReader& deserialize(BinaryReader& source) override {
 		Serializable::deserialize(source);
+		if (source.getFormat() == WireFormat::Compact) {
+			const auto packed = read_varint(source);
+			if (packed >> 9 > std::numeric_limits<uint32_t>::max())
+				throw std::runtime_error("Invalid date");
+			setYear(static_cast<uint32_t>(packed >> 9));
+			setMonth(static_cast<int>(packed >> 5 & 0xf));
+			setDay(static_cast<int>(packed & 0x1f));
+			return source;
+		}
 		setYear(read_primitive<uint32_t>(source));
 		setMonth(read_primitive<uint8_t>(source));
 		setDay(read_primitive<uint8_t>(source));
 		return source;
 	}
 
+	size_t serializedSize(SizeContext& context) const override {
+		const auto base = Serializable::serializedSize(context);
+		if (context.getFormat() == WireFormat::Compact)
+			return base + varint_size(static_cast<uint64_t>(_year) << 9 | _month << 5 | _day);
+		return base + sizeof(_year) + sizeof(_month) + sizeof(_day);
+	}
+
 
 	friend bool operator==(const Date& lhs, const Date& rhs)
 	{
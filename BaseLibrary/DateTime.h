@@ -19,8 +19,10 @@ protected:
 	uint8_t _second{};
 
 public:
+	static constexpr Type TYPE = Type::_DateTime;
+
 	Type getType() const override {
-		return Type::_DateTime;
+		return TYPE;
 	}
 	/**
 	 * Construct a new DateTime object with default date (00:00 1st January 1970)
@@ -124,22 +126,47 @@ public:
 	}
 
 
-	std::ostream& serialize(std::ostream& destination) const override {
+	using Date::serialize;
+	using Date::deserialize;
+	using Date::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& destination) const override {
 		Date::serialize(destination);
+		if (destination.getFormat() == WireFormat::Compact) {
+			// hour in bits 0-4, minute in bits 5-10, second above: 1 byte for a full hour
+			write_varint(destination, _second << 11 | _minute << 5 | _hour);
+			return destination;
+		}
 		write_primitive(destination, _hour);
 		write_primitive(destination, _minute);
 		write_primitive(destination, _second);
 		return destination;
 	}
 
-	std::istream& deserialize(std::istream& source) override {
+	BinaryReader& deserialize(BinaryReader& source) override {
 		Date::deserialize(source);
+		if (source.getFormat() == WireFormat::Compact) {
+			const auto packed = read_varint(source);
+			if (packed >> 17)
+				throw std::runtime_error("Invalid time");
+			setHour(static_cast<int>(packed & 0x1f));
+			setMinute(static_cast<int>(packed >> 5 & 0x3f));
+			setSecond(static_cast<int>(packed >> 11));
+			return source;
+		}
 		setHour(read_primitive<uint8_t>(source));
 		setMinute(read_primitive<uint8_t>(source));
 		setSecond(read_primitive<uint8_t>(source));
 		return source;
 	}
 
+	size_t serializedSize(SizeContext& context) const override {
+		const auto base = Date::serializedSize(context);
+		if (context.getFormat() == WireFormat::Compact)
+			return base + varint_size(_second << 11 | _minute << 5 | _hour);
+		return base + sizeof(_hour) + sizeof(_minute) + sizeof(_second);
+	}
+
 
 	friend bool operator==(const DateTime& lhs, const DateTime& rhs)
 	{
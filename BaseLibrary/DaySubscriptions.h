@@ -0,0 +1,117 @@
+#pragma once
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "Date.h"
+
+/**
+ * Index of the ranges of days the clients are interested in, used to find the clients that have to
+ * be told about the change of a day. Clients are interested in every day until they subscribe to a range.
+ * Ranges are kept ordered by their first day, so a lookup only visits the ranges starting before the changed day.
+ */
+class DaySubscriptions {
+protected:
+	/* client id -> subscribed range (first, last day) */
+	std::map<int, std::pair<Date, Date>> _ranges;
+	/* first day -> client id -> last day */
+	std::map<Date, std::map<int, Date>> _byStart;
+	/* clients interested in every day */
+	std::set<int> _allDays;
+
+	void eraseRange(int client) {
+		auto it = _ranges.find(client);
+		if (it == _ranges.end())
+			return;
+		auto start = _byStart.find(it->second.first);
+		if (start != _byStart.end()) {
+			start->second.erase(client);
+			if (start->second.empty())
+				_byStart.erase(start);
+		}
+		_ranges.erase(it);
+	}
+
+public:
+	/**
+	 * Adds a client interested in every day
+	 * 
+	 * @param client client id
+	 */
+	void add(int client) {
+		eraseRange(client);
+		_allDays.insert(client);
+	}
+	/**
+	 * Sets the range of days of a client, replacing the previous one
+	 * 
+	 * @param client client id
+	 * @param from first day of the range
+	 * @param to last day of the range (inclusive)
+	 */
+	void subscribe(int client, const Date& from, const Date& to) {
+		eraseRange(client);
+		_allDays.erase(client);
+		_ranges[client] = std::make_pair(from, to);
+		_byStart[from][client] = to;
+	}
+	/**
+	 * Removes a client
+	 * 
+	 * @param client client id
+	 */
+	void remove(int client) {
+		eraseRange(client);
+		_allDays.erase(client);
+	}
+	/**
+	 * 
+	 * @param client client id
+	 * @return whether the client is interested only in a range of days
+	 */
+	bool isSubscribed(int client) const {
+		return _ranges.find(client) != _ranges.end();
+	}
+	/**
+	 * 
+	 * @param client client id
+	 * @param day changed day
+	 * @return whether the client is interested in the day
+	 */
+	bool isInterested(int client, const Date& day) const {
+		auto it = _ranges.find(client);
+		return it == _ranges.end() || (it->second.first <= day && day <= it->second.second);
+	}
+	/**
+	 * Appends the clients interested in a day
+	 * 
+	 * @param day changed day
+	 * @param clients receives the client ids, each one once
+	 */
+	void collect(const Date& day, std::vector<int>& clients) const {
+		clients.insert(clients.end(), _allDays.begin(), _allDays.end());
+		for (auto it = _byStart.begin(); it != _byStart.end() && it->first <= day; ++it) {
+			for (const auto& kv : it->second) {
+				if (day <= kv.second)
+					clients.push_back(kv.first);
+			}
+		}
+	}
+	/**
+	 * Appends all clients
+	 * 
+	 * @param clients receives the client ids, each one once
+	 */
+	void collect(std::vector<int>& clients) const {
+		clients.insert(clients.end(), _allDays.begin(), _allDays.end());
+		for (const auto& kv : _ranges)
+			clients.push_back(kv.first);
+	}
+	/**
+	 * @return size_t number of clients
+	 */
+	size_t size() const {
+		return _ranges.size() + _allDays.size();
+	}
+};
@@ -0,0 +1,44 @@
+#include "JobCatalog.h"
+#include <limits>
+#include <stdexcept>
+
+JobCatalog JobCatalog::_instance;
+
+JobCatalog::JobCatalog() {
+	intern(std::string());
+}
+
+job_id_t JobCatalog::intern(const std::string& name) {
+	return intern(name, std::numeric_limits<size_t>::max());
+}
+
+job_id_t JobCatalog::intern(const std::string& name, size_t maxNames) {
+	std::lock_guard<std::recursive_mutex> guard(_lock);
+	const auto it = _ids.find(name);
+	if (it != _ids.end())
+		return it->second;
+	if (_names.size() >= maxNames)
+		throw std::runtime_error("Too many job names");
+	const auto id = static_cast<job_id_t>(_names.size());
+	// deque keeps the references returned by getName valid
+	_names.push_back(name);
+	_ids.emplace(name, id);
+	return id;
+}
+
+const std::string& JobCatalog::getName(job_id_t id) {
+	std::lock_guard<std::recursive_mutex> guard(_lock);
+	if (id >= _names.size())
+		throw std::invalid_argument("Unknown job id");
+	return _names[id];
+}
+
+bool JobCatalog::contains(job_id_t id) {
+	std::lock_guard<std::recursive_mutex> guard(_lock);
+	return id < _names.size();
+}
+
+size_t JobCatalog::size() {
+	std::lock_guard<std::recursive_mutex> guard(_lock);
+	return _names.size();
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "types.h"
+
+/**
+ * Singleton table of interned job names.
+ * Every distinct name is stored once and referred to by a small id, so that shifts
+ * can be compared by integers. Ids are local to the process and are never released,
+ * so names received from peers are only added up to a limit; id 0 is always the empty name.
+ * 
+ */
+class JobCatalog {
+protected:
+	std::recursive_mutex _lock;
+	std::deque<std::string> _names;
+	std::unordered_map<std::string, job_id_t> _ids;
+	static JobCatalog _instance;
+
+public:
+	/**
+	 * Construct a new catalog containing only the empty name
+	 */
+	JobCatalog();
+	/**
+	 * Gets the id of the given name, adding it to the catalog if needed
+	 * 
+	 * @param name UTF-8 job name
+	 * @return job_id_t id of the name
+	 */
+	job_id_t intern(const std::string& name);
+	/**
+	 * Gets the id of the given name, adding it to the catalog only if it holds fewer names than the limit
+	 * 
+	 * @param name UTF-8 job name
+	 * @param maxNames max number of names in the catalog
+	 * @return job_id_t id of the name
+	 */
+	job_id_t intern(const std::string& name, size_t maxNames);
+	/**
+	 * Gets the name with the given id
+	 * 
+	 * @param id id returned by intern
+	 * @return const std::string& UTF-8 job name, valid for the lifetime of the catalog
+	 */
+	const std::string& getName(job_id_t id);
+	/**
+	 * Checks whether the id was returned by intern
+	 * 
+	 * @param id job id
+	 */
+	bool contains(job_id_t id);
+	/**
+	 * Gets the number of interned names
+	 */
+	size_t size();
+	/**
+	 * Gets the instance of this object
+	 * 
+	 * @return JobCatalog& 
+	 */
+	static JobCatalog& getInstance() {
+		return _instance;
+	}
+};
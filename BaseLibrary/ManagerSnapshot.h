@@ -0,0 +1,165 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Date.h"
+#include "fields.h"
+#include "Serializable.h"
+#include "serialization.h"
+#include "Shift.h"
+#include "ShiftWorker.h"
+#include "UserPermissions.h"
+using namespace Serialization;
+using namespace Binary;
+
+/**
+ * Point-in-time image of a RestaurantManager. It shares the published snapshots of the days and of the workers,
+ * which never change, so it is taken without copying a single shift and can be written on a background thread
+ * while the manager keeps changing. Written in the same format as the manager itself.
+ */
+class ManagerSnapshot : public Serializable {
+public:
+	typedef std::vector<Shift> DayShifts;
+	typedef std::map<identity_t, ShiftWorker> Workers;
+	typedef std::vector<std::pair<Date, std::shared_ptr<const DayShifts>>> Days;
+
+protected:
+	/* non-empty days, ordered by day */
+	Days _days;
+	size_t _size = 0;
+	std::shared_ptr<const Workers> _workers;
+	std::map<std::string, UserPermissions> _accessTokens;
+	uint64_t _logSegment;
+	std::chrono::nanoseconds _pause;
+
+public:
+	static constexpr Type TYPE = Type::_RestaurantManager;
+
+	Type getType() const override {
+		return TYPE;
+	}
+
+	/**
+	 * Construct a new image
+	 *
+	 * @param days published shifts of the days, in any order
+	 * @param workers published workers
+	 * @param accessTokens access tokens
+	 * @param logSegment first segment of the write-ahead log not held by the image
+	 * @param pause longest time the writers were stopped for while the image was taken
+	 */
+	ManagerSnapshot(Days days, std::shared_ptr<const Workers> workers,
+	                std::map<std::string, UserPermissions> accessTokens, uint64_t logSegment,
+	                std::chrono::nanoseconds pause)
+		: _days(std::move(days)), _workers(std::move(workers)), _accessTokens(std::move(accessTokens)),
+		  _logSegment(logSegment), _pause(pause) {
+		std::sort(_days.begin(), _days.end(), [](const Days::value_type& lhs, const Days::value_type& rhs) {
+			return lhs.first < rhs.first;
+		});
+		for (const auto& day : _days)
+			_size += day.second->size();
+	}
+	/**
+	 * @return uint64_t first segment of the write-ahead log not held by the image
+	 */
+	uint64_t getLogSegment() const {
+		return _logSegment;
+	}
+	/**
+	 * @return std::chrono::nanoseconds longest time the writers were stopped for while the image was taken
+	 */
+	std::chrono::nanoseconds getPause() const {
+		return _pause;
+	}
+	/**
+	 * @return const Days& non-empty days, ordered by day
+	 */
+	const Days& getDays() const {
+		return _days;
+	}
+	/**
+	 * @return const Workers& workers
+	 */
+	const Workers& getWorkers() const {
+		return *_workers;
+	}
+	/**
+	 * @return const std::map<std::string, UserPermissions>& access tokens
+	 */
+	const std::map<std::string, UserPermissions>& getAccessTokens() const {
+		return _accessTokens;
+	}
+	/**
+	 * @return size_t number of shifts
+	 */
+	size_t size() const {
+		return _size;
+	}
+
+	using Serializable::serialize;
+	using Serializable::deserialize;
+	using Serializable::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& dst) const override {
+		Serializable::serialize(dst);
+		// the shifts are read back in any order, so they are written day by day without sorting them by id
+		write_length(dst, _size);
+		for (const auto& day : _days) {
+			for (const auto& shift : *day.second) {
+				write_id(dst, shift.getId());
+				shift.serialize(dst);
+			}
+		}
+		write_length(dst, _days.size());
+		std::vector<identity_t> ids;
+		for (const auto& day : _days) {
+			day.first.serialize(dst);
+			ids.clear();
+			for (const auto& shift : *day.second)
+				ids.push_back(shift.getId());
+			write_set_primitive(dst, ids);
+		}
+		write_length(dst, _workers->size());
+		for (const auto& kv : *_workers) {
+			write_id(dst, kv.first);
+			kv.second.serialize(dst);
+		}
+		write_length(dst, _accessTokens.size());
+		for (const auto& kv : _accessTokens) {
+			write_string(dst, kv.first);
+			write_primitive(dst, kv.second);
+		}
+		return dst;
+	}
+
+	BinaryReader& deserialize(BinaryReader& /*src*/) override {
+		throw std::logic_error("A snapshot is read back by RestaurantManager::deserialize");
+	}
+
+	size_t serializedSize(SizeContext& context) const override {
+		auto total = Serializable::serializedSize(context);
+		total += Fields::Uint<size_t>::size(context, _size);
+		for (const auto& day : _days) {
+			for (const auto& shift : *day.second)
+				total += Fields::Id::size(context, shift.getId()) + shift.serializedSize(context);
+		}
+		total += Fields::Uint<size_t>::size(context, _days.size());
+		std::vector<identity_t> ids;
+		for (const auto& day : _days) {
+			ids.clear();
+			for (const auto& shift : *day.second)
+				ids.push_back(shift.getId());
+			total += day.first.serializedSize(context) + Fields::IdSet<identity_t>::size(context, ids);
+		}
+		total += Fields::ObjectMap<ShiftWorker>::size(context, *_workers);
+		total += Fields::Uint<size_t>::size(context, _accessTokens.size());
+		for (const auto& kv : _accessTokens)
+			total += Fields::String::size(context, kv.first) + sizeof(kv.second);
+		return total;
+	}
+};
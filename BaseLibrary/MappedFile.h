@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+#include "types.h"
+
+/**
+ * Read-only view of a whole file mapped into memory. The pages are read from the disk as they are touched
+ */
+class MappedFile {
+protected:
+	const byte_t* _data = nullptr;
+	size_t _size = 0;
+	/* handle of the mapping object, on Windows only */
+	void* _mapping = nullptr;
+
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile& other) = delete;
+	MappedFile& operator=(const MappedFile& other) = delete;
+
+	/**
+	 * Maps a file for reading
+	 *
+	 * @param path path of the file
+	 * @return whether the file exists and is not empty
+	 */
+	bool open(const std::string& path);
+	/**
+	 * Unmaps the file, the pointers into it are no longer valid
+	 */
+	void close();
+	/**
+	 * @return const byte_t* first byte of the file, nullptr if not mapped
+	 */
+	const byte_t* data() const {
+		return _data;
+	}
+	/**
+	 * @return size_t size of the file
+	 */
+	size_t size() const {
+		return _size;
+	}
+};
@@ -5,16 +5,76 @@
 using namespace Serialization;
 using namespace Binary;
 /**
- * Basic Ping packet that forces the other endpoint to send a PingReply
+ * Basic Ping packet that forces the other endpoint to send a PingReply.
+ * The ping sent right after connecting also advertises the optional features of the sender.
  * 
  */
 class Ping : public Serializable {
 protected:
+	uint8_t _capabilities = 0;
 public:
+	static constexpr Type TYPE = Type::_Ping;
+	/**
+	 * The sender accepts frames in the WireFormat::Compact encoding
+	 */
+	static constexpr uint8_t CAPABILITY_COMPACT = 1;
+
 	Type getType() const override {
-		return Type::_Ping;
+		return TYPE;
 	}
 
 	Ping() {}
+	/**
+	 * Construct a new Ping advertising the given capabilities
+	 * 
+	 * @param capabilities combination of Ping::CAPABILITY_* flags
+	 */
+	explicit Ping(uint8_t capabilities) : _capabilities(capabilities) {}
+
+	/**
+	 * Gets the capabilities advertised by the sender
+	 * 
+	 * @return uint8_t combination of Ping::CAPABILITY_* flags
+	 */
+	uint8_t getCapabilities() const {
+		return _capabilities;
+	}
+	/**
+	 * Sets the advertised capabilities
+	 * 
+	 * @param capabilities combination of Ping::CAPABILITY_* flags
+	 */
+	void setCapabilities(uint8_t capabilities) {
+		_capabilities = capabilities;
+	}
 
+	using Serializable::serialize;
+	using Serializable::deserialize;
+	using Serializable::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& destination) const override {
+		Serializable::serialize(destination);
+		write_primitive(destination, _capabilities);
+		return destination;
+	}
+
+	BinaryReader& deserialize(BinaryReader& source) override {
+		Serializable::deserialize(source);
+		// older peers send pings without capabilities, their frames end right after the type
+		_capabilities = source.getRemaining() > 0 ? read_primitive<uint8_t>(source) : 0;
+		return source;
+	}
+
+	size_t serializedSize(SizeContext& context) const override {
+		return Serializable::serializedSize(context) + sizeof(_capabilities);
+	}
+
+
+	friend bool operator==(const Ping& lhs, const Ping& rhs) {
+		return lhs._capabilities == rhs._capabilities;
+	}
+
+	friend bool operator!=(const Ping& lhs, const Ping& rhs) {
+		return !(lhs == rhs);
+	}
 };
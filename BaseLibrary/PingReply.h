@@ -11,8 +11,10 @@ using namespace Binary;
 class PingReply : public Serializable {
 protected:
 public:
+	static constexpr Type TYPE = Type::_PingReply;
+
 	Type getType() const override {
-		return Type::_PingReply;
+		return TYPE;
 	}
 
 	PingReply() {}
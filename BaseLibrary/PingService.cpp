@@ -1,5 +1,6 @@
 #include "PingService.h"
 #include "net_constants.h"
+#include <thread>
 
 PingService PingService::_instance;
 
@@ -12,7 +13,7 @@ void PingService::worker() {
 				try {
 					auto* con = *it;
 					if (con->isAlive())
-						con->writeSync(Ping());
+						con->writeAsync(Ping(), nullptr);
 					++it;
 				}
 				catch (...) { }
@@ -0,0 +1,424 @@
+#include "Reactor.h"
+#include "Connection.h"
+#include "net_constants.h"
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Max number of socket events handled in a single wait
+ */
+const int REACTOR_MAX_EVENTS = 256;
+/**
+ * Interval (ms) of idle connection checks
+ */
+const int REACTOR_SWEEP_INTERVAL = 1000 * TIME_SCALE;
+
+bool Reactor::isSupported() {
+#ifdef __linux__
+	return true;
+#else
+	return false;
+#endif
+}
+
+Reactor::Reactor(int threads, int handlerThreads) {
+	if (threads <= 0)
+		throw std::invalid_argument("Invalid number of reactor threads");
+	if (handlerThreads <= 0)
+		throw std::invalid_argument("Invalid number of handler threads");
+	_running = false;
+	_nextLoop = 0;
+	for (int i = 0; i < threads; i++)
+		_loops.push_back(new Loop());
+	_handlers.resize(handlerThreads);
+}
+
+Reactor::~Reactor() {
+	stop();
+	for (auto* loop : _loops)
+		delete loop;
+	_loops.clear();
+}
+
+void Reactor::start() {
+	if (!isSupported())
+		throw std::logic_error("Event-loop mode is not supported on this platform");
+	if (_running)
+		throw std::logic_error("Reactor is already running");
+#ifdef __linux__
+	for (auto* loop : _loops) {
+		loop->pollFd = epoll_create1(EPOLL_CLOEXEC);
+		loop->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (loop->pollFd < 0 || loop->wakeFd < 0)
+			throw std::runtime_error("Could not create the event loop");
+		epoll_event event{};
+		event.events = EPOLLIN;
+		event.data.fd = loop->wakeFd;
+		epoll_ctl(loop->pollFd, EPOLL_CTL_ADD, loop->wakeFd, &event);
+	}
+	_running = true;
+	_handlersStopping = false;
+	for (auto& thread : _handlers) {
+		thread = std::thread([this] {
+			handler();
+		});
+	}
+	for (auto* loop : _loops) {
+		loop->thread = std::thread([this, loop] {
+			worker(loop);
+		});
+	}
+#endif
+}
+
+void Reactor::stop() {
+	if (!_running)
+		return;
+	_running = false;
+#ifdef __linux__
+	for (auto* loop : _loops) {
+		wake(loop);
+		if (loop->thread.joinable())
+			loop->thread.join();
+	}
+	// no frames are dispatched anymore, the handlers finish the ones already queued
+	{
+		std::lock_guard<std::mutex> guard(_handlerLock);
+		_handlersStopping = true;
+	}
+	_handlerSignal.notify_all();
+	for (auto& thread : _handlers) {
+		if (thread.joinable())
+			thread.join();
+	}
+	for (auto* loop : _loops) {
+		// connections still attached are no longer read by anyone
+		{
+			std::lock_guard<std::mutex> guard(loop->lock);
+			for (const auto& kv : loop->connections)
+				loop->detached.push_back(kv.second);
+			loop->connections.clear();
+			loop->flushes.clear();
+		}
+		releaseDetached(loop);
+		close(loop->pollFd);
+		close(loop->wakeFd);
+		loop->pollFd = loop->wakeFd = -1;
+	}
+#endif
+}
+
+void Reactor::attach(Connection* connection) {
+	if (!_running)
+		throw std::logic_error("Reactor is not running");
+#ifdef __linux__
+	const auto index = _nextLoop++ % _loops.size();
+	auto* loop = _loops[index];
+	const int fd = connection->getNativeHandle();
+
+	std::lock_guard<std::mutex> guard(loop->lock);
+	connection->_reactorLoop = static_cast<int>(index);
+	connection->_reactorFd = fd;
+	connection->_reactorWritable = false;
+	connection->_flushRequested = false;
+	loop->connections[fd] = connection;
+
+	epoll_event event{};
+	event.events = EPOLLIN | EPOLLRDHUP;
+	event.data.fd = fd;
+	if (epoll_ctl(loop->pollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+		loop->connections.erase(fd);
+		throw std::runtime_error("Could not register the socket in the event loop");
+	}
+#endif
+}
+
+void Reactor::detach(Connection* connection) {
+	const int index = connection->_reactorLoop;
+	if (index < 0)
+		return;
+#ifdef __linux__
+	auto* loop = _loops[index];
+	{
+		std::lock_guard<std::mutex> guard(loop->lock);
+		const auto it = loop->connections.find(connection->_reactorFd);
+		if (it == loop->connections.end() || it->second != connection)
+			return;
+		loop->connections.erase(it);
+		epoll_ctl(loop->pollFd, EPOLL_CTL_DEL, connection->_reactorFd, nullptr);
+		// released connections may be deleted, so no request may refer to them
+		loop->flushes.erase(std::remove(loop->flushes.begin(), loop->flushes.end(), connection), loop->flushes.end());
+		loop->detached.push_back(connection);
+	}
+	// the loop releases it after its current batch, or stop() does once the loop has been joined
+	wake(loop);
+#endif
+}
+
+bool Reactor::freeOnRelease(Connection* connection) {
+	const int index = connection->_reactorLoop;
+	if (index < 0)
+		return false;
+#ifdef __linux__
+	auto* loop = _loops[index];
+	std::lock_guard<std::mutex> guard(loop->lock);
+	// once taken out of the list by releaseDetached, the loop does not touch the connection anymore
+	if (std::find(loop->detached.begin(), loop->detached.end(), connection) == loop->detached.end())
+		return false;
+	connection->_freeOnRelease = true;
+	return true;
+#else
+	return false;
+#endif
+}
+
+void Reactor::dispatch(Connection* connection, std::shared_ptr<Serializable> payload, size_t size) {
+	{
+		std::lock_guard<std::mutex> guard(connection->_dispatchLock);
+		connection->_dispatchQueue.emplace_back(std::move(payload), size);
+		// the thread already handling the connection takes the frame as well, keeping them in order
+		if (connection->_dispatching)
+			return;
+		connection->_dispatching = true;
+	}
+	{
+		std::lock_guard<std::mutex> guard(_handlerLock);
+		_handlerQueue.push_back(connection);
+	}
+	_handlerSignal.notify_one();
+}
+
+void Reactor::handler() {
+	while (true) {
+		Connection* connection;
+		{
+			std::unique_lock<std::mutex> lock(_handlerLock);
+			_handlerSignal.wait(lock, [this] {
+				return !_handlerQueue.empty() || _handlersStopping;
+			});
+			if (_handlerQueue.empty())
+				return;
+			connection = _handlerQueue.front();
+			_handlerQueue.pop_front();
+		}
+		handle(connection);
+	}
+}
+
+void Reactor::handle(Connection* connection) {
+	Loop* waiting = nullptr;
+	connection->_handlerThread = std::this_thread::get_id();
+	while (true) {
+		std::shared_ptr<Serializable> payload;
+		size_t size;
+		{
+			std::lock_guard<std::mutex> guard(connection->_dispatchLock);
+			if (connection->_dispatchQueue.empty()) {
+				const int index = connection->_reactorLoop;
+				if (index >= 0) {
+					auto* loop = _loops[index];
+					std::lock_guard<std::mutex> loopGuard(loop->lock);
+					if (std::find(loop->detached.begin(), loop->detached.end(), connection) != loop->detached.end())
+						waiting = loop;
+				}
+				connection->_handlerThread = std::thread::id();
+				// the loop may release and delete the connection from now on
+				connection->_dispatching = false;
+				break;
+			}
+			payload = std::move(connection->_dispatchQueue.front().first);
+			size = connection->_dispatchQueue.front().second;
+			connection->_dispatchQueue.pop_front();
+		}
+		// frames of a closed connection are dropped, as the loop stops reading it at that point
+		if (!connection->isAlive())
+			continue;
+		connection->deliverPayload(*payload, size);
+		// replies are sent right away, the loop only takes over once the socket is full
+		try {
+			if (!connection->_sendQueue.empty() && connection->flush(false))
+				requestFlush(connection);
+		}
+		catch (...) {
+			// the connection has already been closed with the error
+		}
+	}
+	// a detached connection is only released once its handlers are done
+	if (waiting)
+		wake(waiting);
+}
+
+bool Reactor::requestFlush(Connection* connection) {
+	const int index = connection->_reactorLoop;
+	if (index < 0 || !_running)
+		return false;
+#ifdef __linux__
+	auto* loop = _loops[index];
+	const bool onLoop = std::this_thread::get_id() == loop->thread.get_id();
+	{
+		std::lock_guard<std::mutex> guard(loop->lock);
+		const auto it = loop->connections.find(connection->_reactorFd);
+		if (it == loop->connections.end() || it->second != connection)
+			return false;
+		if (!onLoop) {
+			// a single pending request covers every frame queued before the loop gets to it
+			if (connection->_flushRequested.exchange(true))
+				return true;
+			loop->flushes.push_back(connection);
+		}
+	}
+	if (!onLoop)
+		wake(loop);
+	// replies of handlers run by the loop itself are sent right away, unless the socket is already full
+	else if (!connection->_reactorWritable)
+		flush(loop, connection);
+	return true;
+#else
+	return false;
+#endif
+}
+
+void Reactor::flush(Loop* loop, Connection* connection) {
+#ifdef __linux__
+	const bool pending = connection->flush(false);
+	if (pending == connection->_reactorWritable)
+		return;
+	std::lock_guard<std::mutex> guard(loop->lock);
+	const auto it = loop->connections.find(connection->_reactorFd);
+	if (it == loop->connections.end() || it->second != connection)
+		return;
+	epoll_event event{};
+	event.events = EPOLLIN | EPOLLRDHUP | (pending ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+	event.data.fd = connection->_reactorFd;
+	if (epoll_ctl(loop->pollFd, EPOLL_CTL_MOD, connection->_reactorFd, &event) == 0)
+		connection->_reactorWritable = pending;
+#endif
+}
+
+void Reactor::flushRequested(Loop* loop) {
+	std::vector<Connection*> requested;
+	{
+		std::lock_guard<std::mutex> guard(loop->lock);
+		requested.swap(loop->flushes);
+	}
+	for (auto* connection : requested) {
+		{
+			// detached connections stay valid until the end of the iteration, but are no longer flushed here
+			std::lock_guard<std::mutex> guard(loop->lock);
+			const auto it = loop->connections.find(connection->_reactorFd);
+			if (it == loop->connections.end() || it->second != connection)
+				continue;
+		}
+		connection->_flushRequested = false;
+		try {
+			flush(loop, connection);
+		}
+		catch (...) {
+			// the connection has already been closed with the error
+		}
+	}
+}
+
+void Reactor::wake(Loop* loop) {
+#ifdef __linux__
+	uint64_t value = 1;
+	// EAGAIN means the counter is full, so the loop is woken already
+	while (write(loop->wakeFd, &value, sizeof(value)) < 0 && errno == EINTR) {}
+#endif
+}
+
+void Reactor::releaseDetached(Loop* loop) {
+	std::vector<Connection*> detached, handled;
+	{
+		std::lock_guard<std::mutex> guard(loop->lock);
+		detached.swap(loop->detached);
+	}
+	// the loop no longer touches these connections, so they can be deleted now, unless a handler still runs for them
+	for (auto* connection : detached) {
+		{
+			std::lock_guard<std::mutex> guard(connection->_dispatchLock);
+			if (connection->_dispatching) {
+				handled.push_back(connection);
+				continue;
+			}
+		}
+		if (connection->_freeOnRelease) {
+			connection->_freeOnRelease = false;
+			connection->freeSocket();
+		}
+		connection->_readingAsync = false;
+		// last, the destructor waits for it
+		connection->_reactorLoop = -1;
+	}
+	if (!handled.empty()) {
+		std::lock_guard<std::mutex> guard(loop->lock);
+		loop->detached.insert(loop->detached.end(), handled.begin(), handled.end());
+	}
+}
+
+void Reactor::closeIdle(Loop* loop) {
+	const auto now = std::chrono::steady_clock::now();
+	const auto timeout = std::chrono::milliseconds(SOCKET_TIMEOUT);
+	std::vector<Connection*> idle;
+	{
+		std::lock_guard<std::mutex> guard(loop->lock);
+		for (const auto& kv : loop->connections) {
+			if (now - kv.second->_lastReceived > timeout)
+				idle.push_back(kv.second);
+		}
+	}
+	for (auto* connection : idle)
+		connection->closeError(std::runtime_error("Connection timed out"));
+}
+
+void Reactor::worker(Loop* loop) {
+#ifdef __linux__
+	epoll_event events[REACTOR_MAX_EVENTS];
+	auto lastSweep = std::chrono::steady_clock::now();
+
+	while (_running) {
+		const int count = epoll_wait(loop->pollFd, events, REACTOR_MAX_EVENTS, REACTOR_SWEEP_INTERVAL);
+		for (int i = 0; i < count; i++) {
+			const int fd = events[i].data.fd;
+			if (fd == loop->wakeFd) {
+				uint64_t value;
+				// resets the counter, EAGAIN means another wake-up did so already
+				while (read(loop->wakeFd, &value, sizeof(value)) < 0 && errno == EINTR) {}
+				continue;
+			}
+			Connection* connection;
+			{
+				std::lock_guard<std::mutex> guard(loop->lock);
+				const auto it = loop->connections.find(fd);
+				if (it == loop->connections.end())
+					continue;
+				connection = it->second;
+			}
+			try {
+				if (events[i].events & EPOLLOUT)
+					flush(loop, connection);
+				if (events[i].events & ~EPOLLOUT)
+					connection->receiveAvailable();
+			}
+			catch (...) {
+				// the connection has already been closed with the error
+			}
+		}
+		flushRequested(loop);
+
+		const auto now = std::chrono::steady_clock::now();
+		if (now - lastSweep >= std::chrono::milliseconds(REACTOR_SWEEP_INTERVAL)) {
+			lastSweep = now;
+			closeIdle(loop);
+		}
+		releaseDetached(loop);
+	}
+#endif
+}
@@ -0,0 +1,166 @@
+#pragma once
+#include "net_constants.h"
+#include "Serializable.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace Serialization;
+
+class Connection;
+
+/**
+ * Pool of event-loop threads that multiplex non-blocking client sockets.
+ * Every attached Connection is pinned to a single loop, which reads the available
+ * bytes and decodes frames as they arrive, instead of blocking a dedicated thread.
+ * The observers of the decoded frames run on a separate pool of handler threads.
+ * Only available on Linux (epoll), see Reactor::isSupported.
+ */
+class Reactor {
+protected:
+	/**
+	 * State of a single event-loop thread
+	 */
+	struct Loop {
+		int pollFd = -1;
+		int wakeFd = -1;
+		std::thread thread;
+		std::mutex lock;
+		std::unordered_map<int, Connection*> connections;
+		std::vector<Connection*> detached;
+		std::vector<Connection*> flushes;
+	};
+
+	std::vector<Loop*> _loops;
+	std::atomic<bool> _running;
+	std::atomic<size_t> _nextLoop;
+	std::vector<std::thread> _handlers;
+	std::mutex _handlerLock;
+	std::condition_variable _handlerSignal;
+	std::deque<Connection*> _handlerQueue;
+	bool _handlersStopping = false;
+
+	/**
+	 * Background task that waits for socket events and dispatches them to connections
+	 *
+	 * @param loop event loop owned by the calling thread
+	 */
+	void worker(Loop* loop);
+	/**
+	 * Background task that runs the observers of the dispatched frames
+	 */
+	void handler();
+	/**
+	 * Runs the observers of every frame queued for a connection
+	 *
+	 * @param connection connection scheduled on the calling handler thread
+	 */
+	void handle(Connection* connection);
+	/**
+	 * Closes the connections that did not receive anything within SOCKET_TIMEOUT
+	 *
+	 * @param loop event loop owned by the calling thread
+	 */
+	void closeIdle(Loop* loop);
+	/**
+	 * Releases connections detached from the loop, allowing them to be deleted, and frees the sockets left to the loop.
+	 * Connections whose frames are still being handled are kept until the next iteration
+	 *
+	 * @param loop event loop owned by the calling thread
+	 */
+	void releaseDetached(Loop* loop);
+	/**
+	 * Interrupts the event wait of the given loop
+	 */
+	void wake(Loop* loop);
+	/**
+	 * Sends the queued frames of a connection without blocking, and waits for the socket
+	 * to become writable if some of them are left
+	 *
+	 * @param loop event loop owned by the calling thread
+	 * @param connection connection attached to the loop
+	 */
+	void flush(Loop* loop, Connection* connection);
+	/**
+	 * Sends the queued frames of the connections that requested it
+	 *
+	 * @param loop event loop owned by the calling thread
+	 */
+	void flushRequested(Loop* loop);
+
+public:
+	/**
+	 * @return whether the event-loop mode is available on this platform
+	 */
+	static bool isSupported();
+	/**
+	 * Construct a new Reactor
+	 *
+	 * @param threads number of event-loop threads
+	 * @param handlerThreads number of threads running the observers of the received frames
+	 */
+	Reactor(int threads, int handlerThreads = REACTOR_HANDLER_THREADS);
+	virtual ~Reactor();
+	/**
+	 * @return whether the event loops are running
+	 */
+	bool isRunning() const {
+		return _running;
+	}
+	/**
+	 * @return number of event-loop threads
+	 */
+	size_t getThreadCount() const {
+		return _loops.size();
+	}
+	/**
+	 * Starts the event-loop and handler threads
+	 */
+	void start();
+	/**
+	 * Stops and joins the event-loop threads, then the handler threads once they ran the frames already received
+	 */
+	void stop();
+	/**
+	 * Starts dispatching socket events of the given connection on one of the loops
+	 *
+	 * @param connection connected client, switched to non-blocking reads
+	 */
+	void attach(Connection* connection);
+	/**
+	 * Stops dispatching socket events of the given connection. The connection stays
+	 * in reading state until its loop finishes the current batch of events.
+	 *
+	 * @param connection attached client
+	 */
+	void detach(Connection* connection);
+	/**
+	 * Leaves the socket of a closed connection to its loop, if the loop has not released the connection yet.
+	 * The loop may still be reading from the socket, and the fd must not be reused by another client meanwhile
+	 *
+	 * @param connection detached client, whose socket is shut down
+	 * @return whether the loop frees the socket, otherwise the caller does
+	 */
+	bool freeOnRelease(Connection* connection);
+	/**
+	 * Queues a frame decoded by the loop for the handler threads. The frames of a connection are
+	 * handled in order, by one thread at a time
+	 *
+	 * @param connection attached client
+	 * @param payload decoded payload
+	 * @param size encoded size of the payload
+	 */
+	void dispatch(Connection* connection, std::shared_ptr<Serializable> payload, size_t size);
+	/**
+	 * Makes the loop of the given connection send its queued frames
+	 *
+	 * @param connection attached client
+	 * @return whether the connection is attached, and its loop will flush it
+	 */
+	bool requestFlush(Connection* connection);
+};
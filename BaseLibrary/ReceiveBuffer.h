@@ -0,0 +1,115 @@
+#pragma once
+#include <cstring>
+#include "types.h"
+
+/**
+ * Buffer of received bytes that are not decoded yet. Bytes are appended behind the write cursor
+ * and consumed from the read cursor, so any number of frames received at once is decoded in place.
+ * Both cursors go back to the start whenever the buffer is drained; a partial frame is only moved
+ * to the start when the rest of it does not fit behind it.
+ */
+class ReceiveBuffer {
+protected:
+	byte_t* _data = nullptr;
+	size_t _capacity = 0;
+	/* first byte not consumed yet */
+	size_t _begin = 0;
+	/* first free byte */
+	size_t _end = 0;
+
+public:
+	ReceiveBuffer() = default;
+	ReceiveBuffer(const ReceiveBuffer&) = delete;
+	ReceiveBuffer& operator=(const ReceiveBuffer&) = delete;
+	~ReceiveBuffer() {
+		delete[] _data;
+	}
+	/**
+	 * @return const byte_t* first byte not consumed yet
+	 */
+	const byte_t* data() const {
+		return _data + _begin;
+	}
+	/**
+	 * @return size_t number of bytes received and not consumed yet
+	 */
+	size_t size() const {
+		return _end - _begin;
+	}
+	/**
+	 * @return size_t number of bytes allocated
+	 */
+	size_t getCapacity() const {
+		return _capacity;
+	}
+	/**
+	 * Makes room for more bytes behind the ones not consumed yet
+	 *
+	 * @param required total number of bytes (consumed ones excluded) the buffer has to be able to hold
+	 * @param capacity capacity allocated when the buffer has to grow, at least `required`
+	 * @return size_t number of bytes that can be written at `writable()`
+	 */
+	size_t reserve(size_t required, size_t capacity) {
+		if (_begin + required <= _capacity)
+			return _capacity - _end;
+		const auto pending = size();
+		if (required <= _capacity) {
+			// the partial frame goes to the start, the only time received bytes are copied
+			std::memmove(_data, _data + _begin, pending);
+		}
+		else {
+			auto* data = new byte_t[capacity < required ? required : capacity];
+			if (pending)
+				std::memcpy(data, _data + _begin, pending);
+			delete[] _data;
+			_data = data;
+			_capacity = capacity < required ? required : capacity;
+		}
+		_begin = 0;
+		_end = pending;
+		return _capacity - _end;
+	}
+	/**
+	 * @return byte_t* first free byte, where received bytes are written
+	 */
+	byte_t* writable() {
+		return _data + _end;
+	}
+	/**
+	 * Appends bytes written at `writable()`
+	 *
+	 * @param length number of bytes written
+	 */
+	void commit(size_t length) {
+		_end += length;
+	}
+	/**
+	 * Consumes decoded bytes, rewinding the buffer once all of them are consumed
+	 *
+	 * @param length number of bytes consumed
+	 */
+	void consume(size_t length) {
+		_begin += length;
+		if (_begin >= _end)
+			_begin = _end = 0;
+	}
+	/**
+	 * Discards all bytes
+	 */
+	void clear() {
+		_begin = _end = 0;
+	}
+	/**
+	 * Releases the memory if no bytes are pending
+	 *
+	 * @param maxCapacity capacity kept allocated, larger buffers are released
+	 */
+	void shrink(size_t maxCapacity = 0) {
+		if (size() || _capacity <= maxCapacity)
+			return;
+		delete[] _data;
+		_data = nullptr;
+		_capacity = 0;
+		_begin = _end = 0;
+	}
+};
@@ -0,0 +1,103 @@
+#pragma once
+#include <utility>
+
+#include "ConnectionBase.h"
+#include "net_constants.h"
+#include "StreamedReply.h"
+
+/**
+ * Sends the results of a request as a sequence of StreamedReply parts of bounded size, each queued
+ * as soon as it is full, so that neither side ever holds all the results in a single packet.
+ * The reply type provides the results through three methods:
+ *  - `static size_t recordSize(SizeContext&, const TRecord&)` - encoded size of a single result
+ *  - `void addRecord(const TRecord&)` - appends a result to the part
+ *  - `void clearRecords()` - removes all results of the part
+ *
+ * @tparam TReply StreamedReply type
+ */
+template <typename TReply>
+class ReplyStream {
+protected:
+	ConnectionBase* _connection;
+	TReply _reply;
+	SizeContext _context;
+	size_t _partSize;
+	size_t _size = 0;
+	size_t _records = 0;
+	size_t _parts = 0;
+
+	/**
+	 * Starts a new part, with the size of the reply without any results
+	 */
+	void reset() {
+		_reply.clearRecords();
+		_context = SizeContext(_connection->getWireFormat());
+		_size = sizeof(content_len_t) + _reply.serializedSize(_context);
+		_records = 0;
+	}
+	/**
+	 * Queues the current part
+	 *
+	 * @param continued whether more parts follow
+	 */
+	void send(bool continued) {
+		_reply.setContinued(continued);
+		_connection->writeAsync(_reply, nullptr);
+		_parts++;
+	}
+
+public:
+	/**
+	 * Construct a new stream of replies
+	 *
+	 * @param connection requesting client
+	 * @param reply reply prototype (request id, queried values), its results are discarded
+	 * @param partSize max encoded size of a part, a single result larger than that is sent in a part of its own
+	 */
+	ReplyStream(ConnectionBase* connection, TReply reply, size_t partSize = STREAM_PART_SIZE)
+		: _connection(connection), _reply(std::move(reply)), _partSize(partSize) {
+		reset();
+	}
+	ReplyStream(const ReplyStream&) = delete;
+	ReplyStream& operator=(const ReplyStream&) = delete;
+	/**
+	 * Gets the reply sent with every part, for the flags that apply to all of them
+	 *
+	 * @return TReply& reply
+	 */
+	TReply& getReply() {
+		return _reply;
+	}
+	/**
+	 * Adds a result, queuing the current part first if the result would not fit in it
+	 *
+	 * @tparam TRecord type of result
+	 * @param record result
+	 */
+	template <typename TRecord>
+	void add(const TRecord& record) {
+		auto size = TReply::recordSize(_context, record);
+		// the element count may take a few more bytes as the part grows
+		if (_records && _size + size + sizeof(uint64_t) > _partSize) {
+			send(true);
+			reset();
+			size = TReply::recordSize(_context, record);
+		}
+		_reply.addRecord(record);
+		_size += size;
+		_records++;
+	}
+	/**
+	 * Queues the last part, which may have no results
+	 */
+	void finish() {
+		send(false);
+		reset();
+	}
+	/**
+	 * @return size_t number of parts queued so far
+	 */
+	size_t getParts() const {
+		return _parts;
+	}
+};
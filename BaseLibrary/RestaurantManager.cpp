@@ -1,8 +1,12 @@
 #include "RestaurantManager.h"
 
+#include <algorithm>
+#include <limits>
+
 #include "C2S_Authorize.h"
 #include "C2S_DeleteShift.h"
 #include "C2S_GetShiftsByDay.h"
+#include "C2S_GetShiftsByWorker.h"
 #include "C2S_GetWorkers.h"
 #include "C2S_InsertShift.h"
 #include "C2S_DeleteWorker.h"
@@ -13,11 +17,15 @@
 #include "S2C_AuthorizeReply.h"
 #include "S2C_DeleteShiftReply.h"
 #include "S2C_DeleteWorkerReply.h"
+#include "S2C_GetShiftsByWorkerReply.h"
 #include "S2C_GetShiftsReply.h"
 #include "S2C_GetWorkersReply.h"
 #include "S2C_InsertShiftReply.h"
 #include "S2C_InsertWorkerReply.h"
+#include "S2C_SubscribeDaysReply.h"
+#include "S2C_GetChangesReply.h"
 #include "S2C_ClientSync.h"
+#include "ReplyStream.h"
 
 
 bool RestaurantManager::verifyPermission(ConnectionBase* connection, UserPermissions required) {
@@ -27,7 +35,7 @@ bool RestaurantManager::verifyPermission(ConnectionBase* connection, UserPermiss
 
 
 void RestaurantManager::handlePing(ConnectionBase* connection, const Ping& payload, size_t size) {
-	connection->writeSync(PingReply());
+	connection->writeAsync(PingReply(), nullptr);
 }
 
 void RestaurantManager::handleAuthorize(ConnectionBase* connection, const C2S_Authorize& payload, size_t size) {
@@ -40,30 +48,23 @@ void RestaurantManager::handleAuthorize(ConnectionBase* connection, const C2S_Au
 		reply.setPermissions(it->second);
 	}
 	connection->getData().put("Permissions", reply.getPermissions());
-	connection->writeSync(reply);
+	connection->writeAsync(reply, nullptr);
 }
 
 void RestaurantManager::handleGetShiftsByDay(ConnectionBase* connection, const C2S_GetShiftsByDay& payload,
                                              size_t size) {
-	S2C_GetShiftsReply reply(payload.getRequestId(), payload.getDate());
+	// large days are sent in parts as the shifts are listed
+	ReplyStream<S2C_GetShiftsReply> stream(connection, S2C_GetShiftsReply(payload.getRequestId(), payload.getDate()));
 	if (!verifyPermission(connection, UserPermissions::View)) {
-		reply.setErrorMsg("Unauthorized");
+		stream.getReply().setErrorMsg("Unauthorized");
 	}
 	else {
-		auto it = _shiftsByDay.find(payload.getDate());
-		if (it != _shiftsByDay.end()) {
-			auto& shifts = reply.getShifts();
-			
-			for (auto id : it->second) {
-				try {
-					shifts.insert(_shifts[id]);
-				}
-				catch (std::exception&) {}
-			}
-		}
+		// every part comes from the same snapshot, even if the day is edited in the meantime
+		const auto shifts = getDaySnapshot(payload.getDate());
+		for (const auto& shift : *shifts)
+			stream.add(shift);
 	}
-	connection->writeSync(reply);
-
+	stream.finish();
 }
 
 void RestaurantManager::handleInsertShift(ConnectionBase* connection, const C2S_InsertShift& payload, size_t size) {
@@ -73,14 +74,16 @@ void RestaurantManager::handleInsertShift(ConnectionBase* connection, const C2S_
 	}
 	else {
 		try {
-			auto& ret = insertShift(payload.getShift(), payload.isModifyExisting());
-			reply.setShift(ret);
+			verifyWriteAheadLog();
+			reply.setShift(insertShift(payload.getShift(), payload.isModifyExisting()));
+			replyDurable(connection, reply);
+			return;
 		}
 		catch (std::exception& ex) {
 			reply.setErrorMsg(ex.what());
 		}
 	}
-	connection->writeSync(reply);
+	connection->writeAsync(reply, nullptr);
 
 }
 
@@ -90,21 +93,31 @@ void RestaurantManager::handleDeleteShift(ConnectionBase* connection, const C2S_
 		reply.setErrorMsg("Unauthorized");
 	}
 	else {
-		reply.setSuccess(deleteShift(payload.getShiftId()));
+		try {
+			verifyWriteAheadLog();
+			reply.setSuccess(deleteShift(payload.getShiftId()));
+			replyDurable(connection, reply);
+			return;
+		}
+		catch (std::exception& ex) {
+			reply.setErrorMsg(ex.what());
+		}
 	}
-	connection->writeSync(reply);
+	connection->writeAsync(reply, nullptr);
 
 }
 
 void RestaurantManager::handleGetWorkers(ConnectionBase* connection, const C2S_GetWorkers& payload, size_t size) {
-	S2C_GetWorkersReply reply(payload.getRequestId());
+	ReplyStream<S2C_GetWorkersReply> stream(connection, S2C_GetWorkersReply(payload.getRequestId()));
 	if (!verifyPermission(connection, UserPermissions::View)) {
-		reply.setErrorMsg("Unauthorized");
+		stream.getReply().setErrorMsg("Unauthorized");
 	}
 	else {
-		reply.setWorkers(_workers);
+		const auto workers = getWorkersSnapshot();
+		for (const auto& kv : *workers)
+			stream.add(kv.second);
 	}
-	connection->writeSync(reply);
+	stream.finish();
 }
 
 void RestaurantManager::handleInsertWorker(ConnectionBase* connection, const C2S_InsertWorker& payload, size_t size) {
@@ -114,14 +127,16 @@ void RestaurantManager::handleInsertWorker(ConnectionBase* connection, const C2S
 	}
 	else {
 		try {
-			auto& ret = insertWorker(payload.getWorker(), payload.isModifyExisting());
-			reply.setWorker(ret);
+			verifyWriteAheadLog();
+			reply.setWorker(insertWorker(payload.getWorker(), payload.isModifyExisting()));
+			replyDurable(connection, reply);
+			return;
 		}
 		catch (std::exception& ex) {
 			reply.setErrorMsg(ex.what());
 		}
 	}
-	connection->writeSync(reply);
+	connection->writeAsync(reply, nullptr);
 }
 
 void RestaurantManager::handleDeleteWorker(ConnectionBase* connection, const C2S_DeleteWorker& payload, size_t size) {
@@ -130,167 +145,698 @@ void RestaurantManager::handleDeleteWorker(ConnectionBase* connection, const C2S
 		reply.setErrorMsg("Unauthorized");
 	}
 	else {
-		reply.setSuccess(deleteWorker(payload.getWorkerId()));
+		try {
+			verifyWriteAheadLog();
+			reply.setSuccess(deleteWorker(payload.getWorkerId()));
+			replyDurable(connection, reply);
+			return;
+		}
+		catch (std::exception& ex) {
+			reply.setErrorMsg(ex.what());
+		}
 	}
-	connection->writeSync(reply);
+	connection->writeAsync(reply, nullptr);
 }
 
-bool RestaurantManager::verifyShift(const Shift& shift) {
-	std::lock_guard<std::recursive_mutex> guard(_lock);
+void RestaurantManager::handleSubscribeDays(ConnectionBase* connection, const C2S_SubscribeDays& payload,
+                                            size_t size) {
+	S2C_SubscribeDaysReply reply(payload.getRequestId(), payload.getFrom(), payload.getTo());
+	if (!verifyPermission(connection, UserPermissions::View)) {
+		reply.setErrorMsg("Unauthorized");
+	}
+	else if (payload.getTo() < payload.getFrom()) {
+		reply.setErrorMsg("Invalid range of days");
+	}
+	else {
+		std::lock_guard<std::recursive_mutex> guard(_lock);
+		_subscriptions.subscribe(connection->getId(), payload.getFrom(), payload.getTo());
+	}
+	connection->writeAsync(reply, nullptr);
+}
 
+void RestaurantManager::handleGetChanges(ConnectionBase* connection, const C2S_GetChanges& payload, size_t size) {
+	std::unique_lock<std::recursive_mutex> guard(_lock);
+	S2C_GetChangesReply reply(payload.getRequestId(), _changeLog.getId(), _changeLog.getVersion());
+	SyncBatch missed;
+	if (!verifyPermission(connection, UserPermissions::View)) {
+		reply.setErrorMsg("Unauthorized");
+	}
+	else if (payload.getLogId() == _changeLog.getId() && _changeLog.replay(payload.getVersion(), missed)) {
+		const auto client = connection->getId();
+		missed.fill(reply.getChanges(), [this, client](const Date& day) {
+			return _subscriptions.isInterested(client, day);
+		});
+		// listing everything again is about as cheap as a delta that does not fit a part
+		reply.setComplete(reply.serializedSize(connection->getWireFormat()) <= STREAM_PART_SIZE);
+		if (!reply.isComplete())
+			reply = S2C_GetChangesReply(payload.getRequestId(), _changeLog.getId(), _changeLog.getVersion());
+	}
+	guard.unlock();
+	connection->writeAsync(reply, nullptr);
+}
 
-	const auto start = shift.getStartTime();
-	const auto end = shift.getEndTime();
+void RestaurantManager::handleGetShiftsByWorker(ConnectionBase* connection, const C2S_GetShiftsByWorker& payload,
+                                                size_t size) {
+	ReplyStream<S2C_GetShiftsByWorkerReply> stream(connection, S2C_GetShiftsByWorkerReply(
+		payload.getRequestId(), payload.getWorkerId(), payload.getFrom(), payload.getTo()));
+	if (!verifyPermission(connection, UserPermissions::View)) {
+		stream.getReply().setErrorMsg("Unauthorized");
+	}
+	else if (payload.getTo() < payload.getFrom()) {
+		stream.getReply().setErrorMsg("Invalid range of days");
+	}
+	else {
+		for (const auto& shift : getShiftsByWorker(payload.getWorkerId(), payload.getFrom(), payload.getTo()))
+			stream.add(shift);
+	}
+	stream.finish();
+}
 
-	auto it = _shiftsByDay.find(start);
+RestaurantManager::~RestaurantManager() {
+	{
+		std::lock_guard<std::recursive_mutex> guard(_lock);
+		_syncStopping = true;
+	}
+	_syncSignal.notify_all();
+	if (_syncThread.joinable())
+		_syncThread.join();
+}
 
-	if (it != _shiftsByDay.end()) {
-		//check collisions
-		for (const auto oShiftId : it->second) {
-			if (oShiftId == shift.getId())
-				continue;
-			const auto oShift = _shifts[oShiftId];
-			if (oShift.getJobName() != shift.getJobName())
-				continue;
-			const auto oStart = oShift.getStartTime();
-			const auto oEnd = oShift.getEndTime();
-			if (!((start < oStart && end <= oStart) || (start >= oEnd)))
-				return false;
-		}
+void RestaurantManager::setSyncWindow(std::chrono::milliseconds window) {
+	std::lock_guard<std::recursive_mutex> guard(_lock);
+	_syncWindow = window;
+	if (window.count() <= 0)
+		flushSync();
+}
+
+void RestaurantManager::flushSync() {
+	std::lock_guard<std::recursive_mutex> guard(_lock);
+	_syncScheduled = false;
+	if (_server) {
+		_syncBatch.build(_subscriptions, _changeLog.getVersion(), [this](std::shared_ptr<const S2C_ClientSync> sync, std::vector<int> clients) {
+			_server->writeTo(std::move(sync), std::move(clients));
+		});
 	}
-	return true;
+	_syncBatch.clear();
 }
 
+void RestaurantManager::setWriteAheadLog(WriteAheadLog* log) {
+	std::lock_guard<std::recursive_mutex> guard(_lock);
+	_writeAheadLog = log;
+}
 
-Shift& RestaurantManager::insertShift(Shift shift, bool modify) {
-	Shift* ref = nullptr;
-	{
-		std::lock_guard<std::recursive_mutex> guard(_lock);
+void RestaurantManager::verifyWriteAheadLog() {
+	std::lock_guard<std::recursive_mutex> guard(_lock);
+	if (_writeAheadLog && _writeAheadLog->hasFailed())
+		throw std::runtime_error("Changes cannot be saved");
+}
 
-		auto id = shift.getId();
+size_t RestaurantManager::replayWriteAheadLog(const std::string& path, uint64_t first, uint64_t& next) {
+	size_t applied = 0;
+	WriteAheadLog::replay(path, first, [this, &applied](const WriteAheadLog::Record& record) {
+		// the log only holds changes that were made, one that fails comes from segments older than the snapshot
+		try {
+			applyRecord(record);
+			applied++;
+		}
+		catch (std::invalid_argument&) { }
+	}, next);
+	return applied;
+}
 
-		if (!modify) {
-			shift.setId(0);
+void RestaurantManager::applyRecord(const WriteAheadLog::Record& record) {
+	Date day;
+	ShiftTable::slot_t slot;
+	switch (record.kind) {
+	case WriteAheadLog::Kind::ChangeShift:
+		// a modified shift is logged as removed from its old day first, so it is usually inserted again
+		if (findShift(record.id, day, slot))
+			insertShift(record.shift, true);
+		else
+			addShift(record.shift, true);
+		break;
+	case WriteAheadLog::Kind::RemoveShift:
+		deleteShift(record.id);
+		break;
+	case WriteAheadLog::Kind::ChangeWorker: {
+		const auto workers = getWorkersSnapshot();
+		if (workers->find(record.id) != workers->end()) {
+			insertWorker(record.worker, true);
+			break;
 		}
+		WriteLock guard(_workersLock);
+		auto copy = std::make_shared<WorkerSnapshot>(*_workers);
+		(*copy)[record.id] = record.worker;
+		std::atomic_store(&_workers, std::shared_ptr<const WorkerSnapshot>(std::move(copy)));
+		recordChange([&record](auto& changes) {
+			changes.changeWorker(record.worker, true);
+		});
+		break;
+	}
+	case WriteAheadLog::Kind::RemoveWorker:
+		deleteWorker(record.id);
+		break;
+	}
+}
 
+void RestaurantManager::scheduleSync() {
+	if (_syncWindow.count() <= 0 || _syncBatch.size() >= SYNC_BATCH_SIZE) {
+		flushSync();
+		return;
+	}
+	if (_syncScheduled)
+		return;
+	// the window starts with its first change, so a stream of edits is sent at least once per window
+	_syncScheduled = true;
+	_syncDeadline = std::chrono::steady_clock::now() + _syncWindow;
+	if (!_syncThread.joinable()) {
+		_syncThread = std::thread([this] {
+			syncWorker();
+		});
+	}
+	_syncSignal.notify_all();
+}
 
-		if (!verifyShift(shift)) {
-			throw std::invalid_argument("Shift collides with existing ones");
+void RestaurantManager::syncWorker() {
+	std::unique_lock<std::recursive_mutex> guard(_lock);
+	while (!_syncStopping) {
+		if (!_syncScheduled) {
+			_syncSignal.wait(guard);
+			continue;
 		}
+		if (_syncSignal.wait_until(guard, _syncDeadline) == std::cv_status::timeout && _syncScheduled)
+			flushSync();
+	}
+}
 
-		if (modify) {
-			if (!deleteShift(id)) {
-				throw std::invalid_argument("Shift to be edited was not found");
-			}
+bool RestaurantManager::findShift(identity_t shiftId, Date& day, ShiftTable::slot_t& slot) const {
+	// a day is located before it is published, so the index is read after checking if the day is loaded
+	Date imageDay;
+	bool unloaded = false;
+	const auto image = std::atomic_load(&_image);
+	if (image && image->findShift(shiftId, imageDay)) {
+		const auto days = std::atomic_load(&_shards[shardIndex(imageDay)].published);
+		unloaded = days->find(imageDay) == days->end();
+	}
+	std::lock_guard<std::mutex> guard(_shiftDaysLock);
+	if (shiftId < _shiftSlots.size() && _shiftSlots[shiftId].day) {
+		day = ShiftTable::unpackDay(_shiftSlots[shiftId].day);
+		slot = _shiftSlots[shiftId].slot;
+		return true;
+	}
+	if (!unloaded)
+		return false;
+	day = imageDay;
+	slot = std::numeric_limits<ShiftTable::slot_t>::max();
+	return true;
+}
+
+void RestaurantManager::loadDay(ShiftShard& shard, const Date& day) {
+	const auto image = std::atomic_load(&_image);
+	if (!image || shard.published->find(day) != shard.published->end())
+		return;
+	const auto shifts = image->getDay(day);
+	if (shifts.empty())
+		return;
+	{
+		std::lock_guard<std::mutex> days(_shiftDaysLock);
+		for (const auto& shift : shifts) {
+			locateShift(shift.getId(), day, shard.table.insert(shift));
+			indexWorkerShift(shift.getWorkerId(), day, shift.getId());
 		}
-		else {
-			shift.setId(id = newIdentityId(_shifts));
+	}
+	for (const auto& shift : shifts)
+		shard.intervals.add(shift);
+	publishDays(shard, { day });
+}
+
+void RestaurantManager::locateShift(identity_t shiftId, const Date& day, ShiftTable::slot_t slot) {
+	if (shiftId >= _shiftSlots.size())
+		_shiftSlots.resize(shiftId + 1, ShiftLocation{ 0, 0 });
+	_shiftSlots[shiftId] = ShiftLocation{ ShiftTable::packDay(day), slot };
+}
+
+bool RestaurantManager::verifyShift(const ShiftShard& shard, const Shift& shift) {
+	return !shard.intervals.collides(shift);
+}
+
+bool RestaurantManager::verifyShift(const Shift& shift) {
+	auto& shard = shardOf(shift.getStartTime());
+	const auto image = std::atomic_load(&_image);
+	if (image) {
+		// the shifts of the day are checked once loaded
+		WriteLock guard(shard.lock);
+		loadDay(shard, shift.getStartTime());
+		return verifyShift(shard, shift);
+	}
+	ReadLock guard(shard.lock);
+	return verifyShift(shard, shift);
+}
+
+std::map<identity_t, Shift> RestaurantManager::getShifts() const {
+	std::map<identity_t, Shift> shifts;
+	for (const auto& shard : _shards) {
+		ReadLock guard(shard.lock);
+		for (const auto& kv : shard.table.getDays()) {
+			for (auto slot : kv.second)
+				shifts.emplace(shard.table.getId(slot), shard.table.get(slot));
 		}
-		ref = &(_shifts[id] = shift);
-		_shiftsByDay[shift.getStartTime()].insert(id);
 	}
-	if (_server) {
-		S2C_ClientSync sync;
-		sync.getChangedShifts().insert(shift);
-		_server->writeToAll(sync);
+	const auto image = std::atomic_load(&_image);
+	if (image) {
+		for (const auto& day : image->getDays()) {
+			const auto days = std::atomic_load(&_shards[shardIndex(day)].published);
+			if (days->find(day) != days->end())
+				continue;
+			for (const auto& shift : image->getDay(day))
+				shifts.emplace(shift.getId(), shift);
+		}
 	}
+	return shifts;
+}
 
-	
-	return *ref;
+std::vector<Shift> RestaurantManager::getShiftsByDay(const Date& day) const {
+	return *getDaySnapshot(day);
 }
 
-bool RestaurantManager::deleteShift(identity_t shiftId) {
+std::shared_ptr<const RestaurantManager::DayShifts> RestaurantManager::getDaySnapshot(const Date& day) const {
+	static const auto empty = std::make_shared<const DayShifts>();
+	const auto days = std::atomic_load(&_shards[shardIndex(day)].published);
+	auto it = days->find(day);
+	if (it != days->end())
+		return std::atomic_load(&it->second->shifts);
+	// not changed since the image was taken, decoded straight from the mapping
+	const auto image = std::atomic_load(&_image);
+	if (!image)
+		return empty;
+	return std::make_shared<const DayShifts>(image->getDay(day));
+}
+
+void RestaurantManager::indexWorkerShift(identity_t workerId, const Date& day, identity_t shiftId) {
+	if (workerId)
+		_workerShifts[workerId].insert(std::make_pair(day, shiftId));
+}
+
+void RestaurantManager::unindexWorkerShift(identity_t workerId, const Date& day, identity_t shiftId) {
+	auto it = _workerShifts.find(workerId);
+	if (it == _workerShifts.end())
+		return;
+	it->second.erase(std::make_pair(day, shiftId));
+	if (it->second.empty())
+		_workerShifts.erase(it);
+}
+
+std::vector<Shift> RestaurantManager::getShiftsByWorker(identity_t workerId, const Date& from, const Date& to) const {
+	std::vector<std::pair<Date, identity_t>> assigned;
 	{
-		std::lock_guard<std::recursive_mutex> guard(_lock);
+		std::lock_guard<std::mutex> guard(_shiftDaysLock);
+		auto it = _workerShifts.find(workerId);
+		if (it != _workerShifts.end()) {
+			auto first = it->second.lower_bound(std::make_pair(from, identity_t(0)));
+			for (; first != it->second.end() && !(to < first->first); ++first)
+				assigned.push_back(*first);
+		}
+	}
+	const auto image = std::atomic_load(&_image);
+	if (image) {
+		// shifts of the days not loaded yet, those of the loaded days are checked against their snapshots below
+		const auto& imageShifts = image->getWorkerShifts(workerId);
+		auto first = std::lower_bound(imageShifts.begin(), imageShifts.end(), std::make_pair(from, identity_t(0)));
+		for (; first != imageShifts.end() && !(to < first->first); ++first)
+			assigned.push_back(*first);
+		std::sort(assigned.begin(), assigned.end());
+		assigned.erase(std::unique(assigned.begin(), assigned.end()), assigned.end());
+	}
+	// the shifts are read from the snapshots of their days, which list them ordered by id
+	std::vector<Shift> shifts;
+	shifts.reserve(assigned.size());
+	for (const auto& entry : assigned) {
+		const auto day = getDaySnapshot(entry.first);
+		auto it = std::lower_bound(day->begin(), day->end(), entry.second, [](const Shift& shift, identity_t id) {
+			return shift.getId() < id;
+		});
+		// edited since the index was read
+		if (it != day->end() && it->getId() == entry.second && it->getWorkerId() == workerId)
+			shifts.push_back(*it);
+	}
+	return shifts;
+}
 
-		auto it = _shifts.find(shiftId);
-		if (it == _shifts.end())
-			return false;
-		_shiftsByDay[it->second.getStartTime()].erase(shiftId);
-		_shifts.erase(shiftId);
+void RestaurantManager::publishDays(ShiftShard& shard, const std::vector<Date>& days) {
+	std::shared_ptr<DaySnapshots> added;
+	for (const auto& day : days) {
+		const auto& slots = shard.table.getDay(day);
+		auto shifts = std::make_shared<DayShifts>();
+		shifts->reserve(slots.size());
+		for (auto slot : slots)
+			shifts->push_back(shard.table.get(slot));
+		auto it = shard.published->find(day);
+		if (it != shard.published->end()) {
+			// only the first replacement keeps the shifts the image is taken of
+			if (shard.preserved)
+				shard.preserved->emplace(day, it->second->shifts);
+			std::atomic_store(&it->second->shifts, std::shared_ptr<const DayShifts>(std::move(shifts)));
+			continue;
+		}
+		// a new day is published with a new map, the other days keep sharing their snapshots
+		if (!added)
+			added = std::make_shared<DaySnapshots>(*shard.published);
+		auto snapshot = std::make_shared<DaySnapshot>();
+		snapshot->shifts = std::move(shifts);
+		(*added)[day] = std::move(snapshot);
 	}
-	if (_server) {
-		S2C_ClientSync sync;
-		sync.getRemovedShifts().insert(shiftId);
-		_server->writeToAll(sync);
+	if (added)
+		std::atomic_store(&shard.published, std::shared_ptr<const DaySnapshots>(std::move(added)));
+}
+
+void RestaurantManager::publishAll(ShiftShard& shard) {
+	auto published = std::make_shared<DaySnapshots>();
+	for (const auto& kv : shard.table.getDays()) {
+		auto shifts = std::make_shared<DayShifts>();
+		shifts->reserve(kv.second.size());
+		for (auto slot : kv.second)
+			shifts->push_back(shard.table.get(slot));
+		auto snapshot = std::make_shared<DaySnapshot>();
+		snapshot->shifts = std::move(shifts);
+		published->emplace_hint(published->end(), kv.first, std::move(snapshot));
 	}
-	return true;
+	std::atomic_store(&shard.published, std::shared_ptr<const DaySnapshots>(std::move(published)));
 }
 
-bool RestaurantManager::deleteWorker(identity_t workerId) {
+Shift RestaurantManager::addShift(Shift shift, bool keepId) {
+	const Date day = shift.getStartTime();
+	auto& shard = shardOf(day);
+	WriteLock guard(shard.lock);
+	loadDay(shard, day);
+	if (!keepId)
+		shift.setId(0);
+	if (!verifyShift(shard, shift)) {
+		throw std::invalid_argument("Shift collides with existing ones");
+	}
 	{
-		std::lock_guard<std::recursive_mutex> guard(_lock);
+		std::lock_guard<std::mutex> days(_shiftDaysLock);
+		if (keepId)
+			_lastShiftId = std::max(_lastShiftId, shift.getId());
+		else
+			shift.setId(++_lastShiftId);
+		locateShift(shift.getId(), day, shard.table.insert(shift));
+		indexWorkerShift(shift.getWorkerId(), day, shift.getId());
+	}
+	shard.intervals.add(shift);
+	publishDays(shard, { day });
+	recordChange([&shift](auto& changes) {
+		changes.changeShift(shift, true);
+	});
+	return shift;
+}
+
+Shift RestaurantManager::insertShift(Shift shift, bool modify) {
+	if (!modify)
+		return addShift(std::move(shift), false);
 
-		const auto it = _workers.find(workerId);
-		if (it == _workers.end())
+	const Date day = shift.getStartTime();
+	const auto target = shardIndex(day);
+
+	const auto id = shift.getId();
+	while (true) {
+		Date oldDay;
+		ShiftTable::slot_t slot;
+		if (!findShift(id, oldDay, slot)) {
+			throw std::invalid_argument("Shift to be edited was not found");
+		}
+		const auto source = shardIndex(oldDay);
+		// every writer locks the partitions in the same order
+		WriteLock first(_shards[std::min(source, target)].lock);
+		WriteLock second;
+		if (source != target)
+			second = WriteLock(_shards[std::max(source, target)].lock);
+		auto& from = _shards[source];
+		auto& to = _shards[target];
+		loadDay(from, oldDay);
+		loadDay(to, day);
+		// moved to another day in the meantime, or just loaded
+		if (!from.table.holds(slot, id))
+			continue;
+		if (!verifyShift(to, shift)) {
+			throw std::invalid_argument("Shift collides with existing ones");
+		}
+		const auto old = from.table.get(slot);
+		from.intervals.remove(old);
+		from.table.erase(slot);
+		{
+			std::lock_guard<std::mutex> days(_shiftDaysLock);
+			locateShift(id, day, to.table.insert(shift));
+			unindexWorkerShift(old.getWorkerId(), oldDay, id);
+			indexWorkerShift(shift.getWorkerId(), day, id);
+		}
+		to.intervals.add(shift);
+		if (source != target) {
+			publishDays(from, { oldDay });
+			publishDays(to, { day });
+		}
+		else {
+			publishDays(to, { oldDay, day });
+		}
+		// sent as a removal from the old day followed by the new state
+		recordChange([&shift, &oldDay, id](auto& changes) {
+			changes.removeShift(id, oldDay);
+			changes.changeShift(shift, false);
+		});
+		return shift;
+	}
+}
+
+bool RestaurantManager::deleteShift(identity_t shiftId) {
+	while (true) {
+		Date day;
+		ShiftTable::slot_t slot;
+		if (!findShift(shiftId, day, slot))
 			return false;
+		auto& shard = shardOf(day);
+		WriteLock guard(shard.lock);
+		loadDay(shard, day);
+		// moved to another day in the meantime, or just loaded
+		if (!shard.table.holds(slot, shiftId))
+			continue;
+		const auto old = shard.table.get(slot);
+		{
+			std::lock_guard<std::mutex> days(_shiftDaysLock);
+			_shiftSlots[shiftId] = ShiftLocation{ 0, 0 };
+			unindexWorkerShift(old.getWorkerId(), day, shiftId);
+		}
+		shard.intervals.remove(old);
+		shard.table.erase(slot);
+		publishDays(shard, { day });
+		recordChange([shiftId, &day](auto& changes) {
+			changes.removeShift(shiftId, day);
+		});
+		return true;
+	}
+}
 
-		for (auto& kv : _shifts) {
-			auto& shift = kv.second;
-			if (shift.getWorkerId() == workerId)
-				shift.setWorkerId(0);
+bool RestaurantManager::deleteWorker(identity_t workerId) {
+	WriteLock guard(_workersLock);
+
+	if (_workers->find(workerId) == _workers->end())
+		return false;
+
+	// the days of the image with shifts of the worker are loaded first, so the index below lists them
+	const auto image = std::atomic_load(&_image);
+	if (image) {
+		for (const auto& entry : image->getWorkerShifts(workerId)) {
+			auto& shard = shardOf(entry.first);
+			WriteLock shardGuard(shard.lock);
+			loadDay(shard, entry.first);
 		}
-		_workers.erase(workerId);
 	}
-	if (_server) {
-		S2C_ClientSync sync;
-		sync.getRemovedWorkers().insert(workerId);
-		_server->writeToAll(sync);
+	// only the shifts of the worker are visited, partition by partition
+	while (true) {
+		std::map<size_t, std::vector<std::pair<Date, identity_t>>> byShard;
+		{
+			std::lock_guard<std::mutex> days(_shiftDaysLock);
+			auto it = _workerShifts.find(workerId);
+			if (it == _workerShifts.end())
+				break;
+			for (const auto& entry : it->second)
+				byShard[shardIndex(entry.first)].push_back(entry);
+		}
+		for (const auto& kv : byShard) {
+			auto& shard = _shards[kv.first];
+			WriteLock shardGuard(shard.lock);
+			std::vector<Date> changed;
+			std::lock_guard<std::mutex> days(_shiftDaysLock);
+			for (const auto& entry : kv.second) {
+				const auto id = entry.second;
+				// moved or reassigned in the meantime, the index is read again
+				if (id >= _shiftSlots.size() || _shiftSlots[id].day != ShiftTable::packDay(entry.first))
+					continue;
+				const auto slot = _shiftSlots[id].slot;
+				if (!shard.table.holds(slot, id) || shard.table.getWorkerId(slot) != workerId)
+					continue;
+				unindexWorkerShift(workerId, entry.first, id);
+				shard.table.setWorkerId(slot, 0);
+				if (changed.empty() || !(changed.back() == entry.first))
+					changed.push_back(entry.first);
+			}
+			if (!changed.empty())
+				publishDays(shard, changed);
+		}
 	}
+	auto workers = std::make_shared<WorkerSnapshot>(*_workers);
+	workers->erase(workerId);
+	std::atomic_store(&_workers, std::shared_ptr<const WorkerSnapshot>(std::move(workers)));
+	recordChange([workerId](auto& changes) {
+		changes.removeWorker(workerId);
+	});
 	return true;
 }
 
-std::ostream& RestaurantManager::serialize(std::ostream& dst) const {
-	Serializable::serialize(dst);
-	write_primitive<size_t>(dst, _shifts.size());
-	for (const auto& kv : _shifts) {
-		write_primitive(dst, kv.first);
-		kv.second.serialize(dst);
+ShiftWorker RestaurantManager::insertWorker(ShiftWorker worker, bool modify) {
+	WriteLock guard(_workersLock);
+
+	identity_t id = worker.getId();
+
+	if (modify) {
+		if (_workers->find(id) == _workers->end()) {
+			throw std::invalid_argument("Worker to be edited was not found");
+		}
 	}
-	write_primitive<size_t>(dst, _shiftsByDay.size());
-	for (const auto& kv : _shiftsByDay) {
-		kv.first.serialize(dst);
-		write_set_primitive(dst, kv.second);
+	else {
+		worker.setId(id = newIdentityId(*_workers));
+	}
+	auto workers = std::make_shared<WorkerSnapshot>(*_workers);
+	(*workers)[id] = worker;
+	std::atomic_store(&_workers, std::shared_ptr<const WorkerSnapshot>(std::move(workers)));
+	recordChange([&worker, modify](auto& changes) {
+		changes.changeWorker(worker, !modify);
+	});
+	return worker;
+}
+
+std::shared_ptr<const ManagerSnapshot> RestaurantManager::captureSnapshot(WriteAheadLog* log) const {
+	std::lock_guard<std::mutex> captureGuard(_captureLock);
+	auto& shards = const_cast<ShiftShard (&)[SHIFT_SHARDS]>(_shards);
+	std::shared_ptr<const DaySnapshots> captured[SHIFT_SHARDS];
+	PreservedDays preserved[SHIFT_SHARDS];
+	std::shared_ptr<const WorkerSnapshot> workers;
+	std::shared_ptr<const SnapshotImage> image;
+	uint64_t segment = 0;
+	auto start = std::chrono::steady_clock::now();
+	{
+		// every change is recorded with the locks of its objects held, so none is half done at this point
+		ReadLock workersGuard(_workersLock);
+		std::vector<WriteLock> guards;
+		for (size_t i = 0; i < SHIFT_SHARDS; i++) {
+			guards.emplace_back(shards[i].lock);
+			captured[i] = shards[i].published;
+			shards[i].preserved = &preserved[i];
+		}
+		workers = _workers;
+		image = std::atomic_load(&_image);
+		if (log)
+			segment = log->rotate();
 	}
-	write_primitive<size_t>(dst, _workers.size());
-	for (const auto& kv : _workers) {
-		write_primitive(dst, kv.first);
-		kv.second.serialize(dst);
+	auto pause = std::chrono::steady_clock::now() - start;
+
+	// the days are listed one partition at a time, stopping only the writers of that partition
+	ManagerSnapshot::Days days;
+	for (size_t i = 0; i < SHIFT_SHARDS; i++) {
+		start = std::chrono::steady_clock::now();
+		WriteLock guard(shards[i].lock);
+		for (const auto& kv : *captured[i]) {
+			auto it = preserved[i].find(kv.first);
+			const auto& shifts = it != preserved[i].end() ? it->second : kv.second->shifts;
+			if (!shifts->empty())
+				days.emplace_back(kv.first, shifts);
+		}
+		shards[i].preserved = nullptr;
+		guard.unlock();
+		pause = std::max(pause, std::chrono::steady_clock::now() - start);
 	}
-	write_primitive<size_t>(dst, _accessTokens.size());
-	for (const auto& kv : _accessTokens) {
-		write_string(dst, kv.first);
-		write_primitive(dst, kv.second);
+	// the days not loaded at that point are the same as in the image, which never changes
+	if (image) {
+		for (const auto& day : image->getDays()) {
+			const auto& loaded = *captured[shardIndex(day)];
+			if (loaded.find(day) == loaded.end())
+				days.emplace_back(day, std::make_shared<const DayShifts>(image->getDay(day)));
+		}
 	}
-	return dst;
+	return std::make_shared<const ManagerSnapshot>(std::move(days), std::move(workers), _accessTokens, segment,
+	                                               std::chrono::duration_cast<std::chrono::nanoseconds>(pause));
 }
 
-std::istream& RestaurantManager::deserialize(std::istream& src) {
+void RestaurantManager::mapImage(std::shared_ptr<const SnapshotImage> image) {
+	WriteLock workersGuard(_workersLock);
+	std::vector<WriteLock> guards;
+	for (auto& shard : _shards) {
+		guards.emplace_back(shard.lock);
+		shard.table.clear();
+		shard.intervals.clear();
+		std::atomic_store(&shard.published, std::make_shared<const DaySnapshots>());
+	}
+	std::lock_guard<std::mutex> daysGuard(_shiftDaysLock);
+	_shiftSlots.clear();
+	_workerShifts.clear();
+	_lastShiftId = image->getLastShiftId();
+	std::atomic_store(&_workers, std::make_shared<const WorkerSnapshot>(image->getWorkers()));
+	_accessTokens = image->getAccessTokens();
+	std::atomic_store(&_image, std::move(image));
+}
+
+void RestaurantManager::rebaseImage(std::shared_ptr<const SnapshotImage> image) {
+	// a day still served from the image was never changed, so it holds the same shifts in the newer one
+	std::atomic_store(&_image, std::move(image));
+}
+
+BinaryWriter& RestaurantManager::serialize(BinaryWriter& dst) const {
+	return captureSnapshot()->serialize(dst);
+}
+
+BinaryReader& RestaurantManager::deserialize(BinaryReader& src) {
+	WriteLock workersGuard(_workersLock);
+	std::vector<WriteLock> guards;
+	for (auto& shard : _shards) {
+		guards.emplace_back(shard.lock);
+		shard.table.clear();
+		shard.intervals.clear();
+	}
+	std::lock_guard<std::mutex> daysGuard(_shiftDaysLock);
 	Serializable::deserialize(src);
-	_shifts.clear();
-	_shiftsByDay.clear();
-	_workers.clear();
+	std::atomic_store(&_image, std::shared_ptr<const SnapshotImage>());
+	_shiftSlots.clear();
+	_workerShifts.clear();
+	_lastShiftId = 0;
+	auto workers = std::make_shared<WorkerSnapshot>();
 	_accessTokens.clear();
-	auto count = read_primitive<size_t>(src);
+	auto count = read_count(src);
 	for (size_t i = 0; i < count; i++) {
-		auto id = read_primitive<identity_t>(src);
+		auto id = read_id(src);
 		auto shift = get_instance<Shift>(src);
-		_shifts[id] = shift;
+		shift.setId(id);
+		const Date day = shift.getStartTime();
+		auto& shard = shardOf(day);
+		locateShift(id, day, shard.table.insert(shift));
+		shard.intervals.add(shift);
+		indexWorkerShift(shift.getWorkerId(), day, id);
+		_lastShiftId = std::max(_lastShiftId, id);
 	}
-	count = read_primitive<size_t>(src);
+	// the index of days is rebuilt from the shifts above
+	count = read_count(src);
 	for (size_t i = 0; i < count; i++) {
-		auto date = get_instance<Date>(src);
+		get_instance<Date>(src);
 		std::set<identity_t> set;
 		read_set_primitive(src, set);
-		_shiftsByDay[date] = set;
 	}
-	count = read_primitive<size_t>(src);
+	for (auto& shard : _shards)
+		publishAll(shard);
+	count = read_count(src);
 	for (size_t i = 0; i < count; i++) {
-		auto id = read_primitive<identity_t>(src);
+		auto id = read_id(src);
 		auto worker = get_instance<ShiftWorker>(src);
-		_workers[id] = worker;
+		(*workers)[id] = worker;
 	}
-	count = read_primitive<size_t>(src);
+	std::atomic_store(&_workers, std::shared_ptr<const WorkerSnapshot>(std::move(workers)));
+	count = read_count(src);
 	for (size_t i = 0; i < count; i++) {
 		auto token = read_string(src);
 		_accessTokens[token] = read_primitive<UserPermissions>(src);
@@ -299,28 +845,6 @@ std::istream& RestaurantManager::deserialize(std::istream& src) {
 }
 
 
-ShiftWorker& RestaurantManager::insertWorker(ShiftWorker worker, bool modify) {
-	ShiftWorker* ref = nullptr;
-	{
-		std::lock_guard<std::recursive_mutex> guard(_lock);
-
-		identity_t id = worker.getId();
-
-
-		if (modify) {
-			if (_workers.find(id) == _workers.end()) {
-				throw std::invalid_argument("Worker to be edited was not found");
-			}
-		}
-		else {
-			worker.setId(id = newIdentityId(_workers));
-		}
-		ref = &(_workers[id] = worker);
-	}
-	if (_server) {
-		S2C_ClientSync sync;
-		sync.getChangedWorkers().insert(worker);
-		_server->writeToAll(sync);
-	}
-	return *ref;
+size_t RestaurantManager::serializedSize(SizeContext& context) const {
+	return captureSnapshot()->serializedSize(context);
 }
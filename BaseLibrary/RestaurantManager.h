@@ -1,22 +1,41 @@
 #pragma once
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <set>
+#include <shared_mutex>
+#include <thread>
 
 
 #include "C2S_Authorize.h"
 #include "C2S_DeleteShift.h"
 #include "C2S_GetShiftsByDay.h"
+#include "C2S_GetShiftsByWorker.h"
 #include "C2S_GetWorkers.h"
 #include "C2S_InsertShift.h"
 #include "C2S_InsertWorker.h"
 #include "C2S_DeleteWorker.h"
+#include "C2S_SubscribeDays.h"
+#include "C2S_GetChanges.h"
+#include "ChangeLog.h"
+#include "DaySubscriptions.h"
+#include "ManagerSnapshot.h"
+#include "net_constants.h"
 #include "Ping.h"
 #include "PingReply.h"
 #include "Serializable.h"
+#include "S2C_ClientSync.h"
 #include "Server.h"
 #include "Shift.h"
+#include "ShiftIntervals.h"
+#include "ShiftTable.h"
 #include "ShiftWorker.h"
+#include "SnapshotImage.h"
+#include "SyncBatch.h"
 #include "TransactionReply.h"
 #include "UserPermissions.h"
+#include "WriteAheadLog.h"
 using namespace Serialization;
 
 /**
@@ -24,26 +43,265 @@ using namespace Serialization;
  * 
  */
 class RestaurantManager : Serializable, public ServerObserver {
+public:
+	/**
+	 * Number of partitions of the shifts, each one with its own lock
+	 */
+	static constexpr size_t SHIFT_SHARDS = 16;
+	/**
+	 * Immutable list of the shifts of a day, as published to the readers
+	 */
+	typedef std::vector<Shift> DayShifts;
+	/**
+	 * Immutable copy of the workers, as published to the readers
+	 */
+	typedef std::map<identity_t, ShiftWorker> WorkerSnapshot;
 protected:
+	/**
+	 * Published shifts of a single day, swapped atomically on every change of the day
+	 */
+	struct DaySnapshot {
+		std::shared_ptr<const DayShifts> shifts;
+	};
+	/* the map is only copied when a day is added, the days themselves are shared between the copies */
+	typedef std::map<Date, std::shared_ptr<DaySnapshot>> DaySnapshots;
+	/* day -> its shifts as they were when an image of the manager was taken */
+	typedef std::map<Date, std::shared_ptr<const DayShifts>> PreservedDays;
+	/**
+	 * Shifts of the days mapped to a single partition, along with the lock guarding them.
+	 * Writers hold the lock and publish a new snapshot of the days they changed, readers never take it.
+	 * Days of the mapped image are loaded into the partition when first changed, until then they are read from the image
+	 */
+	struct ShiftShard {
+		mutable std::shared_timed_mutex lock;
+		ShiftTable table;
+		ShiftIntervals intervals;
+		/* swapped atomically, an old snapshot stays valid for as long as a reader holds it */
+		std::shared_ptr<const DaySnapshots> published = std::make_shared<const DaySnapshots>();
+		/* while an image is taken, receives the snapshots of the days before they are first replaced */
+		PreservedDays* preserved = nullptr;
+	};
+	/**
+	 * Place of a shift: its day, packed by ShiftTable::packDay (0 if there is no such shift), and its slot in the partition of the day
+	 */
+	struct ShiftLocation {
+		uint32_t day;
+		ShiftTable::slot_t slot;
+	};
+	typedef std::shared_lock<std::shared_timed_mutex> ReadLock;
+	typedef std::unique_lock<std::shared_timed_mutex> WriteLock;
+
 	Server* _server;
-	
-	std::recursive_mutex _lock;
-	std::map<identity_t, Shift> _shifts;
-	std::map<Date, std::set<identity_t>> _shiftsByDay;
-	std::map<identity_t, ShiftWorker> _workers;
+
+	ShiftShard _shards[SHIFT_SHARDS];
+	/* place of every shift, indexed by its id since the ids are given out in order */
+	std::vector<ShiftLocation> _shiftSlots;
+	/* worker id -> (day, shift id) of the shifts assigned to the worker, ordered by day */
+	std::map<identity_t, std::set<std::pair<Date, identity_t>>> _workerShifts;
+	identity_t _lastShiftId = 0;
+	/* guards the indexes above, taken after the locks of the partitions */
+	mutable std::mutex _shiftDaysLock;
+	/* copied on write and swapped atomically, the lock only orders the writers */
+	std::shared_ptr<const WorkerSnapshot> _workers = std::make_shared<const WorkerSnapshot>();
+	mutable std::shared_timed_mutex _workersLock;
+	/* set up before the server is started, read-only afterwards */
 	std::map<std::string, UserPermissions> _accessTokens;
+	/* guards the subscriptions, the change log and the changes not sent yet */
+	std::recursive_mutex _lock;
+	/* days viewed by the connected clients, only they are told about the changes of shifts */
+	DaySubscriptions _subscriptions;
+	/* latest changes, for the clients that reconnect */
+	ChangeLog _changeLog{CHANGE_LOG_SIZE};
+	/* changes not sent to the clients yet */
+	SyncBatch _syncBatch;
+	std::chrono::milliseconds _syncWindow{SYNC_WINDOW};
+	std::chrono::steady_clock::time_point _syncDeadline;
+	bool _syncScheduled = false;
+	bool _syncStopping = false;
+	std::condition_variable_any _syncSignal;
+	std::thread _syncThread;
+	/* durable log of the changes, if any */
+	WriteAheadLog* _writeAheadLog = nullptr;
+	/* only one image is taken at a time, taken before any other lock */
+	mutable std::mutex _captureLock;
+	/* mapped snapshot holding the days not published yet, swapped atomically */
+	std::shared_ptr<const SnapshotImage> _image;
+
+	void onConnected(ConnectionBase* connection) override {
+		std::lock_guard<std::recursive_mutex> guard(_lock);
+		_subscriptions.add(connection->getId());
+	}
 
-	void onPayloadReceived(ConnectionBase* connection, const Serializable& payload, size_t size) override {
+	void onDisconnected(ConnectionBase* connection, std::exception exception) override {
+		std::lock_guard<std::recursive_mutex> guard(_lock);
+		_subscriptions.remove(connection->getId());
+	}
+	/**
+	 * Schedules the changes added to the batch to be sent at the end of the sync window,
+	 * or sends them right away if the window is disabled or the batch is full.
+	 * Must be called with the lock held
+	 */
+	virtual void scheduleSync();
+	/**
+	 * Background task that sends the collected changes at the end of every sync window
+	 */
+	virtual void syncWorker();
+	/**
+	 * Records a change in the change log, the write-ahead log and in the changes to be sent to the clients.
+	 * Must be called with the lock of the changed objects held, so that the versions follow their order
+	 * 
+	 * @param record adds the change to a ChangeLog, a WriteAheadLog or a SyncBatch, which have the same interface
+	 */
+	template <typename TRecord>
+	void recordChange(const TRecord& record) {
 		std::lock_guard<std::recursive_mutex> guard(_lock);
-		// synchronize payload handlers
-		ServerObserver::onPayloadReceived(connection, payload, size);
+		record(_changeLog);
+		if (_writeAheadLog)
+			record(*_writeAheadLog);
+		if (_server) {
+			record(_syncBatch);
+			scheduleSync();
+		}
+	}
+	/**
+	 * Refuses a change before it is made once the write-ahead log cannot save changes anymore.
+	 * A change is published as soon as it is made, so it is never reported as failed afterwards
+	 */
+	void verifyWriteAheadLog();
+	/**
+	 * Sends the reply of a change once the changes recorded so far are in the write-ahead log.
+	 * The handler does not wait for the disk: the background thread of the log queues the reply, through the server
+	 * by the id of the client when there is one, so that a client gone in the meantime is skipped
+	 * 
+	 * @param connection client that made the change
+	 * @param reply reply of the change
+	 */
+	template <typename TReply>
+	void replyDurable(ConnectionBase* connection, const TReply& reply) {
+		WriteAheadLog* log;
+		Server* server;
+		{
+			std::lock_guard<std::recursive_mutex> guard(_lock);
+			log = _writeAheadLog;
+			server = _server;
+		}
+		if (!log) {
+			connection->writeAsync(reply, nullptr);
+			return;
+		}
+		// concurrent changes wait for the same batch, which is synced once
+		auto pending = std::make_shared<const TReply>(reply);
+		const auto client = connection->getId();
+		// a change in a batch that could not be saved is published all the same, the log refuses the next ones
+		log->commitAsync([connection, server, client, pending](bool) {
+			if (server)
+				server->writeTo(pending, std::vector<int>{client});
+			else
+				connection->writeAsync(*pending, nullptr);
+		});
+	}
+	/**
+	 * Gets the partition of the shifts of a day
+	 * 
+	 * @param day day of the shifts
+	 * @return ShiftShard& 
+	 */
+	ShiftShard& shardOf(const Date& day) {
+		return _shards[shardIndex(day)];
 	}
+	/**
+	 * Gets the index of the partition of the shifts of a day, consecutive days go to different partitions
+	 * 
+	 * @param day day of the shifts
+	 * @return size_t 
+	 */
+	static size_t shardIndex(const Date& day) {
+		return (day.getYear() * 372u + day.getMonth() * 31u + day.getDay()) % SHIFT_SHARDS;
+	}
+	/**
+	 * Looks up the place of a shift
+	 * 
+	 * @param shiftId id of the Shift
+	 * @param day receives the day
+	 * @param slot receives the slot in the partition of the day, which holds no shift if the day is not loaded yet
+	 * @return whether the shift exists
+	 */
+	bool findShift(identity_t shiftId, Date& day, ShiftTable::slot_t& slot) const;
+	/**
+	 * Loads the shifts of a day from the mapped image, unless the day is already published.
+	 * Must be called with the partition of the day locked for writing, before the day is read or changed
+	 * 
+	 * @param shard partition of the day
+	 * @param day loaded day
+	 */
+	void loadDay(ShiftShard& shard, const Date& day);
+	/**
+	 * Sets the place of a shift, with the lock of the indexes held
+	 * 
+	 * @param shiftId id of the Shift
+	 * @param day day of the shift
+	 * @param slot slot in the partition of the day
+	 */
+	void locateShift(identity_t shiftId, const Date& day, ShiftTable::slot_t slot);
+	/**
+	 * Adds a Shift to the schedule of its worker, with the lock of the indexes held
+	 * 
+	 * @param workerId id of the assigned ShiftWorker, nothing is added if 0
+	 * @param day day of the shift
+	 * @param shiftId id of the Shift
+	 */
+	void indexWorkerShift(identity_t workerId, const Date& day, identity_t shiftId);
+	/**
+	 * Removes a Shift from the schedule of its worker, with the lock of the indexes held
+	 * 
+	 * @param workerId id of the assigned ShiftWorker
+	 * @param day day of the shift
+	 * @param shiftId id of the Shift
+	 */
+	void unindexWorkerShift(identity_t workerId, const Date& day, identity_t shiftId);
+	/**
+	 * Checks if the Shift does not collide with others of its partition, which must be locked
+	 * 
+	 * @param shard partition of the day of the shift
+	 * @param shift object to be queried
+	 * @return whether the shift can be inserted
+	 */
+	static bool verifyShift(const ShiftShard& shard, const Shift& shift);
+	/**
+	 * Inserts a new Shift
+	 * 
+	 * @param shift object to be inserted
+	 * @param keepId whether to keep the id of the shift instead of giving out a new one
+	 * @return Shift inserted object
+	 */
+	Shift addShift(Shift shift, bool keepId);
+	/**
+	 * Applies a change read back from the write-ahead log
+	 * 
+	 * @param record logged change
+	 */
+	void applyRecord(const WriteAheadLog::Record& record);
+	/**
+	 * Publishes the current shifts of the given days of a partition, which must be locked for writing
+	 * 
+	 * @param shard partition of the days
+	 * @param days changed days
+	 */
+	static void publishDays(ShiftShard& shard, const std::vector<Date>& days);
+	/**
+	 * Publishes the current shifts of every day of a partition, which must be locked for writing
+	 * 
+	 * @param shard partition of the days
+	 */
+	static void publishAll(ShiftShard& shard);
 
 
 
 public:
+	static constexpr Type TYPE = Type::_RestaurantManager;
+
 	Type getType() const override {
-		return Type::_RestaurantManager;
+		return TYPE;
 	}
 
 
@@ -58,8 +316,13 @@ public:
 		addHandler(&RestaurantManager::handleInsertShift);
 		addHandler(&RestaurantManager::handleInsertWorker);
 		addHandler(&RestaurantManager::handleDeleteWorker);
+		addHandler(&RestaurantManager::handleSubscribeDays);
+		addHandler(&RestaurantManager::handleGetChanges);
+		addHandler(&RestaurantManager::handleGetShiftsByWorker);
 	}
 
+	~RestaurantManager() override;
+
 	void handlePing(ConnectionBase* connection, const Ping& payload, size_t size);
 	void handleAuthorize(ConnectionBase* connection, const C2S_Authorize& payload, size_t size);
 	void handleGetShiftsByDay(ConnectionBase* connection, const C2S_GetShiftsByDay& payload, size_t size);
@@ -68,6 +331,9 @@ public:
 	void handleGetWorkers(ConnectionBase* connection, const C2S_GetWorkers& payload, size_t size);
 	void handleInsertWorker(ConnectionBase* connection, const C2S_InsertWorker& payload, size_t size);
 	void handleDeleteWorker(ConnectionBase* connection, const C2S_DeleteWorker& payload, size_t size);
+	void handleSubscribeDays(ConnectionBase* connection, const C2S_SubscribeDays& payload, size_t size);
+	void handleGetChanges(ConnectionBase* connection, const C2S_GetChanges& payload, size_t size);
+	void handleGetShiftsByWorker(ConnectionBase* connection, const C2S_GetShiftsByWorker& payload, size_t size);
 	
 	/**
 	 * Checks the permissions of the connected Connection
@@ -92,45 +358,139 @@ public:
 		return id + 1;
 	}
 	/**
-	 * Gets the Shift objects by reference
+	 * Gets a copy of all Shift objects
 	 * 
-	 * @return std::map<identity_t, Shift>& 
+	 * @return std::map<identity_t, Shift> 
 	 */
-	virtual std::map<identity_t, Shift>& getShifts() {
-		return _shifts;
-	}
+	virtual std::map<identity_t, Shift> getShifts() const;
+	/**
+	 * Gets a copy of the Shift objects of a day
+	 * 
+	 * @param day day of the shifts
+	 * @return std::vector<Shift> 
+	 */
+	virtual std::vector<Shift> getShiftsByDay(const Date& day) const;
+	/**
+	 * Gets the published snapshot of the shifts of a day, without waiting for the writers.
+	 * Later changes are published as a new snapshot, the returned one never changes
+	 * 
+	 * @param day day of the shifts
+	 * @return std::shared_ptr<const DayShifts> shifts ordered by id
+	 */
+	virtual std::shared_ptr<const DayShifts> getDaySnapshot(const Date& day) const;
+	/**
+	 * Gets a copy of the Shift objects assigned to a worker in a range of days
+	 * 
+	 * @param workerId id of the ShiftWorker
+	 * @param from first day of the range
+	 * @param to last day of the range (inclusive)
+	 * @return std::vector<Shift> shifts ordered by day
+	 */
+	virtual std::vector<Shift> getShiftsByWorker(identity_t workerId, const Date& from, const Date& to) const;
 	/**
-	 * Gets the Shift objects by day by reference
+	 * Gets a copy of all ShiftWorker objects
 	 * 
-	 * @return std::map<Date, std::set<identity_t>>& 
+	 * @return std::map<identity_t, ShiftWorker> 
 	 */
-	virtual std::map<Date, std::set<identity_t>>& getShiftsByDay() {
-		return _shiftsByDay;
+	virtual std::map<identity_t, ShiftWorker> getWorkers() const {
+		return *getWorkersSnapshot();
 	}
 	/**
-	 * Gets the ShiftWorker objects by reference
+	 * Gets the published snapshot of the workers, without waiting for the writers.
+	 * Later changes are published as a new snapshot, the returned one never changes
 	 * 
-	 * @return std::map<identity_t, ShiftWorker>& 
+	 * @return std::shared_ptr<const WorkerSnapshot> 
 	 */
-	virtual std::map<identity_t, ShiftWorker>& getWorkers() {
-		return _workers;
+	virtual std::shared_ptr<const WorkerSnapshot> getWorkersSnapshot() const {
+		return std::atomic_load(&_workers);
 	}
 	/**
-	 * Gets the access tokens by reference
+	 * Gets the access tokens by reference, to be set up before the server is started
 	 * 
 	 * @return std::map<std::string, UserPermissions>& 
 	 */
 	virtual std::map<std::string, UserPermissions>& getAccessTokens() {
 		return _accessTokens;
 	}
+	/**
+	 * Gets the days viewed by the connected clients by reference
+	 * 
+	 * @return DaySubscriptions& 
+	 */
+	virtual DaySubscriptions& getSubscriptions() {
+		return _subscriptions;
+	}
+	/**
+	 * Gets the log of the latest changes by reference
+	 * 
+	 * @return ChangeLog& 
+	 */
+	virtual ChangeLog& getChangeLog() {
+		return _changeLog;
+	}
+	/**
+	 * Gets the time changes are collected for before being sent to the clients
+	 * 
+	 * @return std::chrono::milliseconds 
+	 */
+	virtual std::chrono::milliseconds getSyncWindow() const {
+		return _syncWindow;
+	}
+	/**
+	 * Sets the time changes are collected for before being sent to the clients
+	 * 
+	 * @param window collecting time, 0 to send every change at once
+	 */
+	virtual void setSyncWindow(std::chrono::milliseconds window);
+	/**
+	 * Sends the collected changes to the clients without waiting for the end of the sync window
+	 */
+	virtual void flushSync();
+	/**
+	 * Sets the log every change is written to before its reply is sent
+	 * 
+	 * @param log open log, nullptr to stop logging
+	 */
+	virtual void setWriteAheadLog(WriteAheadLog* log);
+	/**
+	 * Applies the changes of a write-ahead log over the current state, before the log is set and opened
+	 * 
+	 * @param path path of the log
+	 * @param first first segment not held by the loaded snapshot
+	 * @param next receives the number of the segment to open the log with
+	 * @return size_t number of changes applied
+	 */
+	virtual size_t replayWriteAheadLog(const std::string& path, uint64_t first, uint64_t& next);
+	/**
+	 * Takes a consistent image of the database. The writers are stopped only to mark the point of the image,
+	 * then every partition is collected on its own, with the days changed in the meantime taken as they were.
+	 * The image is serialized without any lock, while the changes go on
+	 * 
+	 * @param log write-ahead log to start a new segment of at the same point, if any
+	 * @return std::shared_ptr<const ManagerSnapshot> 
+	 */
+	virtual std::shared_ptr<const ManagerSnapshot> captureSnapshot(WriteAheadLog* log = nullptr) const;
+	/**
+	 * Replaces the whole database with a mapped image. Only the workers and the access tokens are read,
+	 * the days are served from the image and loaded when changed
+	 * 
+	 * @param image opened image
+	 */
+	virtual void mapImage(std::shared_ptr<const SnapshotImage> image);
+	/**
+	 * Serves the days not loaded yet from a newer image, so the older one can be unmapped
+	 * 
+	 * @param image image of a snapshot taken from this manager after the current image was mapped
+	 */
+	virtual void rebaseImage(std::shared_ptr<const SnapshotImage> image);
 	/**
 	 * Insert a Shift into the database
 	 * 
 	 * @param shift object to be inserted
 	 * @param modify whether to modify an existing record
-	 * @return Shift& reference to the inserted object
+	 * @return Shift inserted object
 	 */
-	virtual Shift& insertShift(Shift shift, bool modify = false);
+	virtual Shift insertShift(Shift shift, bool modify = false);
 	/**
 	 * Deletes a Shift from the database
 	 * 
@@ -150,9 +510,9 @@ public:
 	 * 
 	 * @param worker object to be inserted
 	 * @param modify whether to modify an existing record
-	 * @return ShiftWorker& reference to the inserted object
+	 * @return ShiftWorker inserted object
 	 */
-	virtual ShiftWorker& insertWorker(ShiftWorker worker, bool modify = false);
+	virtual ShiftWorker insertWorker(ShiftWorker worker, bool modify = false);
 	/**
 	 * Deletes a ShiftWorker from the database
 	 * 
@@ -161,7 +521,13 @@ public:
 	 */
 	virtual bool deleteWorker(identity_t workerId);
 
-	std::ostream& serialize(std::ostream& dst) const override;
+	using Serializable::serialize;
+	using Serializable::deserialize;
+	using Serializable::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& dst) const override;
+
+	BinaryReader& deserialize(BinaryReader& src) override;
 
-	std::istream& deserialize(std::istream& src) override;
+	size_t serializedSize(SizeContext& context) const override;
 };
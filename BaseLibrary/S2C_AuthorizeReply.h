@@ -2,6 +2,7 @@
 #include "Serializable.h"
 #include "serialization.h"
 #include "binary.h"
+#include "fields.h"
 #include "TrackablePacket.h"
 #include "TransactionReply.h"
 #include "UserPermissions.h"
@@ -16,8 +17,10 @@ class S2C_AuthorizeReply : public TransactionReply {
 protected:
 	UserPermissions _permissions;
 public:
+	static constexpr Type TYPE = Type::_S2C_AuthorizeReply;
+
 	Type getType() const override {
-		return Type::_S2C_AuthorizeReply;
+		return TYPE;
 	}
 
 	S2C_AuthorizeReply() : S2C_AuthorizeReply(0) {}
@@ -56,16 +59,27 @@ public:
 		_permissions = permissions;
 	}
 
-	std::ostream& serialize(std::ostream& destination) const override {
+	static auto fields() {
+		return std::make_tuple(
+			Fields::field<Fields::Primitive<UserPermissions>>(&S2C_AuthorizeReply::_permissions));
+	}
+
+	using TransactionReply::serialize;
+	using TransactionReply::deserialize;
+	using TransactionReply::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& destination) const override {
 		TransactionReply::serialize(destination);
-		write_primitive(destination, _permissions);
-		return destination;
+		return Fields::write_fields(destination, *this, fields());
 	}
 
-	std::istream& deserialize(std::istream& source) override {
+	BinaryReader& deserialize(BinaryReader& source) override {
 		TransactionReply::deserialize(source);
-		read_primitive(source, &_permissions);
-		return source;
+		return Fields::read_fields(source, *this, fields());
+	}
+
+	size_t serializedSize(SizeContext& context) const override {
+		return TransactionReply::serializedSize(context) + Fields::fields_size(context, *this, fields());
 	}
 
 
@@ -6,11 +6,14 @@
 #include "Serializable.h"
 #include "serialization.h"
 #include "binary.h"
+#include "fields.h"
 #include "Shift.h"
 #include "ShiftWorker.h"
 #include "TransactionReply.h"
 /**
- * Server-to-client broadcast packet that updates the client state
+ * Server-to-client broadcast packet that updates the client state.
+ * Clients apply the removed workers and shifts first, then the changed ones. A changed object replaces
+ * the one with the same id wherever the client had it, so an id is never both removed and changed in one packet.
  * 
  */
 class S2C_ClientSync : public Serializable {
@@ -19,10 +22,25 @@ protected:
 	std::set<identity_t> _removedShifts;
 	std::set<ShiftWorker> _changedWorkers;
 	std::set<Shift> _changedShifts;
+	uint64_t _version = 0;
 public:
+	static constexpr Type TYPE = Type::_S2C_ClientSync;
+
 	Type getType() const override {
-		return Type::_S2C_ClientSync;
+		return TYPE;
 	}
+	/**
+	 * Gets the version of the database the changes bring the client to
+	 * 
+	 * @return uint64_t 
+	 */
+	uint64_t getVersion() const { return _version; }
+	/**
+	 * Sets the version of the database the changes bring the client to
+	 * 
+	 * @param version 
+	 */
+	void setVersion(uint64_t version) { _version = version; }
 	/**
 	 * Gets the removed worker ids
 	 * 
@@ -72,30 +90,39 @@ public:
 	 */
 	std::set<Shift>& getChangedShifts() { return _changedShifts; }
 
-	std::ostream& serialize(std::ostream& dst) const override {
-		Serializable::serialize(dst);
-		write_set_primitive<identity_t>(dst, _removedWorkers);
-		write_set_primitive<identity_t>(dst, _removedShifts);
-		write_set_typed<Shift>(dst, _changedShifts);
-		write_set_typed<ShiftWorker>(dst, _changedWorkers);
-		return dst;
+	static auto fields() {
+		return std::make_tuple(
+			Fields::field<Fields::IdSet<identity_t>>(&S2C_ClientSync::_removedWorkers),
+			Fields::field<Fields::IdSet<identity_t>>(&S2C_ClientSync::_removedShifts),
+			Fields::field<Fields::ObjectSet<Shift>>(&S2C_ClientSync::_changedShifts),
+			Fields::field<Fields::ObjectSet<ShiftWorker>>(&S2C_ClientSync::_changedWorkers),
+			Fields::field<Fields::Uint<uint64_t>>(&S2C_ClientSync::_version));
+	}
+
+	using Serializable::serialize;
+	using Serializable::deserialize;
+	using Serializable::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& destination) const override {
+		Serializable::serialize(destination);
+		return Fields::write_fields(destination, *this, fields());
+	}
+
+	BinaryReader& deserialize(BinaryReader& source) override {
+		Serializable::deserialize(source);
+		return Fields::read_fields(source, *this, fields());
 	}
 
-	std::istream& deserialize(std::istream& src) override {
-		Serializable::deserialize(src);
-		read_set_primitive<identity_t>(src, _removedWorkers);
-		read_set_primitive<identity_t>(src, _removedShifts);
-		read_set(src, _changedShifts, get_type_deserializer<Shift>());
-		read_set(src, _changedWorkers, get_type_deserializer<ShiftWorker>());
-		return src;
+	size_t serializedSize(SizeContext& context) const override {
+		return Serializable::serializedSize(context) + Fields::fields_size(context, *this, fields());
 	}
 
 
 	friend bool operator==(const S2C_ClientSync& lhs, const S2C_ClientSync& rhs) {
 		return std::tie(static_cast<const Serializable&>(lhs), lhs._removedWorkers, lhs._removedShifts,
-		                lhs._changedWorkers, lhs._changedShifts) == std::tie(
+		                lhs._changedWorkers, lhs._changedShifts, lhs._version) == std::tie(
 			static_cast<const Serializable&>(rhs), rhs._removedWorkers, rhs._removedShifts, rhs._changedWorkers,
-			rhs._changedShifts);
+			rhs._changedShifts, rhs._version);
 	}
 
 	friend bool operator!=(const S2C_ClientSync& lhs, const S2C_ClientSync& rhs) {
@@ -1,6 +1,7 @@
 #pragma once
 #include "Serializable.h"
 #include "binary.h"
+#include "fields.h"
 #include "TransactionReply.h"
 
 using namespace Serialization;
@@ -13,8 +14,10 @@ class S2C_DeleteWorkerReply : public TransactionReply {
 protected:
 	identity_t _id = 0;
 public:
+	static constexpr Type TYPE = Type::_S2C_DeleteWorkerReply;
+
 	Type getType() const override {
-		return Type::_S2C_DeleteWorkerReply;
+		return TYPE;
 	}
 	/**
 	 * Gets the ShiftWorker id
@@ -47,16 +50,27 @@ public:
 
 
 	
-	std::ostream& serialize(std::ostream& destination) const override {
+	static auto fields() {
+		return std::make_tuple(
+			Fields::field<Fields::Id>(&S2C_DeleteWorkerReply::_id));
+	}
+
+	using TransactionReply::serialize;
+	using TransactionReply::deserialize;
+	using TransactionReply::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& destination) const override {
 		TransactionReply::serialize(destination);
-		write_primitive(destination, _id);
-		return destination;
+		return Fields::write_fields(destination, *this, fields());
 	}
 
-	std::istream& deserialize(std::istream& source) override {
+	BinaryReader& deserialize(BinaryReader& source) override {
 		TransactionReply::deserialize(source);
-		read_primitive(source, &_id);
-		return source;
+		return Fields::read_fields(source, *this, fields());
+	}
+
+	size_t serializedSize(SizeContext& context) const override {
+		return TransactionReply::serializedSize(context) + Fields::fields_size(context, *this, fields());
 	}
 
 
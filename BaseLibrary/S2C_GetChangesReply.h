@@ -0,0 +1,115 @@
+#pragma once
+#include <utility>
+
+
+#include "Serializable.h"
+#include "binary.h"
+#include "fields.h"
+#include "S2C_ClientSync.h"
+#include "TransactionReply.h"
+
+using namespace Serialization;
+using namespace Binary;
+/**
+ * Server-to-client response to the request for missed changes. If the changes are not complete,
+ * because the change log does not reach back to the version of the client, the client has to list everything again.
+ * 
+ */
+class S2C_GetChangesReply : public TransactionReply {
+protected:
+	uint64_t _logId = 0;
+	bool _complete = false;
+	S2C_ClientSync _changes;
+public:
+	static constexpr Type TYPE = Type::_S2C_GetChangesReply;
+
+	Type getType() const override {
+		return TYPE;
+	}
+
+	S2C_GetChangesReply() = default;
+	/**
+	 * Construct a new response to the request for missed changes
+	 * 
+	 * @param requestId request id
+	 * @param logId id of the change log of the server
+	 * @param version current version of the database
+	 */
+	S2C_GetChangesReply(int requestId, uint64_t logId, uint64_t version) : TransactionReply(requestId), _logId(logId) {
+		_changes.setVersion(version);
+	}
+	/**
+	 * Gets the id of the change log of the server
+	 * 
+	 * @return uint64_t 
+	 */
+	uint64_t getLogId() const {
+		return _logId;
+	}
+	/**
+	 * 
+	 * @return Whether the changes bring the client up to date
+	 */
+	bool isComplete() const {
+		return _complete;
+	}
+	/**
+	 * Sets whether the changes bring the client up to date
+	 * 
+	 * @param complete 
+	 */
+	void setComplete(bool complete) {
+		_complete = complete;
+	}
+	/**
+	 * Gets the missed changes, along with the current version of the database
+	 * 
+	 * @return const S2C_ClientSync& 
+	 */
+	const S2C_ClientSync& getChanges() const {
+		return _changes;
+	}
+	/**
+	 * Gets the missed changes by reference
+	 * 
+	 * @return S2C_ClientSync& 
+	 */
+	S2C_ClientSync& getChanges() {
+		return _changes;
+	}
+
+	static auto fields() {
+		return std::make_tuple(
+			Fields::field<Fields::Uint<uint64_t>>(&S2C_GetChangesReply::_logId),
+			Fields::field<Fields::Bool>(&S2C_GetChangesReply::_complete),
+			Fields::field<Fields::Object<S2C_ClientSync>>(&S2C_GetChangesReply::_changes));
+	}
+
+	using TransactionReply::serialize;
+	using TransactionReply::deserialize;
+	using TransactionReply::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& destination) const override {
+		TransactionReply::serialize(destination);
+		return Fields::write_fields(destination, *this, fields());
+	}
+
+	BinaryReader& deserialize(BinaryReader& source) override {
+		TransactionReply::deserialize(source);
+		return Fields::read_fields(source, *this, fields());
+	}
+
+	size_t serializedSize(SizeContext& context) const override {
+		return TransactionReply::serializedSize(context) + Fields::fields_size(context, *this, fields());
+	}
+
+
+	friend bool operator==(const S2C_GetChangesReply& lhs, const S2C_GetChangesReply& rhs) {
+		return std::tie(static_cast<const TransactionReply&>(lhs), lhs._logId, lhs._complete, lhs._changes) == std::tie(
+			static_cast<const TransactionReply&>(rhs), rhs._logId, rhs._complete, rhs._changes);
+	}
+
+	friend bool operator!=(const S2C_GetChangesReply& lhs, const S2C_GetChangesReply& rhs) {
+		return !(lhs == rhs);
+	}
+};
@@ -0,0 +1,145 @@
+#pragma once
+#include <set>
+#include <utility>
+
+
+#include "Serializable.h"
+#include "serialization.h"
+#include "binary.h"
+#include "fields.h"
+#include "Date.h"
+#include "Shift.h"
+#include "StreamedReply.h"
+using namespace Serialization;
+using namespace Binary;
+/**
+ * Server-to-client response that lists the Shift objects assigned to a ShiftWorker in a range of days,
+ * in one or more parts
+ * 
+ */
+class S2C_GetShiftsByWorkerReply : public StreamedReply {
+protected:
+	identity_t _workerId{};
+	Date _from;
+	Date _to;
+	std::set<Shift> _shifts;
+public:
+	static constexpr Type TYPE = Type::_S2C_GetShiftsByWorkerReply;
+
+	Type getType() const override {
+		return TYPE;
+	}
+
+	S2C_GetShiftsByWorkerReply() : S2C_GetShiftsByWorkerReply(0, 0, Date(), Date()) {}
+	/**
+	 * Construct a new response that lists the schedule of a worker
+	 * 
+	 * @param requestId request id
+	 * @param workerId id of the ShiftWorker
+	 * @param from first day of the range
+	 * @param to last day of the range (inclusive)
+	 */
+	S2C_GetShiftsByWorkerReply(int requestId, identity_t workerId, Date from, Date to)
+		: StreamedReply(requestId), _workerId(workerId), _from(std::move(from)), _to(std::move(to)) {}
+	/**
+	 * Gets the id of the ShiftWorker
+	 * 
+	 * @return identity_t 
+	 */
+	identity_t getWorkerId() const {
+		return _workerId;
+	}
+	/**
+	 * Gets the first day of the range
+	 * 
+	 * @return const Date& 
+	 */
+	const Date& getFrom() const {
+		return _from;
+	}
+	/**
+	 * Gets the last day of the range (inclusive)
+	 * 
+	 * @return const Date& 
+	 */
+	const Date& getTo() const {
+		return _to;
+	}
+	/**
+	 * Gets the Shifts of the worker by const reference
+	 * 
+	 * @return const std::set<Shift>& 
+	 */
+	const std::set<Shift>& getShifts() const {
+		return _shifts;
+	}
+	/**
+	 * Gets the Shifts of the worker by reference
+	 * 
+	 * @return std::set<Shift>& 
+	 */
+	std::set<Shift>& getShifts() {
+		return _shifts;
+	}
+
+	/**
+	 * Encoded size of a Shift in the reply, used by ReplyStream
+	 * 
+	 * @param context state of the message
+	 * @param shift listed Shift
+	 * @return size_t size in bytes
+	 */
+	static size_t recordSize(SizeContext& context, const Shift& shift) {
+		return shift.serializedSize(context);
+	}
+	/**
+	 * Adds a Shift to the reply, used by ReplyStream
+	 * 
+	 * @param shift listed Shift
+	 */
+	void addRecord(const Shift& shift) {
+		_shifts.insert(shift);
+	}
+	/**
+	 * Removes all Shifts from the reply, used by ReplyStream
+	 */
+	void clearRecords() {
+		_shifts.clear();
+	}
+
+	static auto fields() {
+		return std::make_tuple(
+			Fields::field<Fields::Id>(&S2C_GetShiftsByWorkerReply::_workerId),
+			Fields::field<Fields::Object<Date>>(&S2C_GetShiftsByWorkerReply::_from),
+			Fields::field<Fields::Object<Date>>(&S2C_GetShiftsByWorkerReply::_to),
+			Fields::field<Fields::ObjectSet<Shift>>(&S2C_GetShiftsByWorkerReply::_shifts));
+	}
+
+	using StreamedReply::serialize;
+	using StreamedReply::deserialize;
+	using StreamedReply::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& destination) const override {
+		StreamedReply::serialize(destination);
+		return Fields::write_fields(destination, *this, fields());
+	}
+
+	BinaryReader& deserialize(BinaryReader& source) override {
+		StreamedReply::deserialize(source);
+		return Fields::read_fields(source, *this, fields());
+	}
+
+	size_t serializedSize(SizeContext& context) const override {
+		return StreamedReply::serializedSize(context) + Fields::fields_size(context, *this, fields());
+	}
+
+
+	friend bool operator==(const S2C_GetShiftsByWorkerReply& lhs, const S2C_GetShiftsByWorkerReply& rhs) {
+		return std::tie(static_cast<const StreamedReply&>(lhs), lhs._workerId, lhs._from, lhs._to, lhs._shifts) ==
+			std::tie(static_cast<const StreamedReply&>(rhs), rhs._workerId, rhs._from, rhs._to, rhs._shifts);
+	}
+
+	friend bool operator!=(const S2C_GetShiftsByWorkerReply& lhs, const S2C_GetShiftsByWorkerReply& rhs) {
+		return !(lhs == rhs);
+	}
+};
@@ -6,23 +6,37 @@
 #include "Serializable.h"
 #include "serialization.h"
 #include "binary.h"
+#include "fields.h"
 #include "Shift.h"
-#include "TransactionReply.h"
+#include "ShiftView.h"
+#include "StreamedReply.h"
 
 
 using namespace Serialization;
 using namespace Binary;
 /**
- * Server-to-client response that lists all Shift objects in the given day
+ * Server-to-client response that lists all Shift objects in the given day, in one or more parts
  * 
  */
-class S2C_GetShiftsReply : public TransactionReply {
+class S2C_GetShiftsReply : public StreamedReply {
 protected:
-	std::set<Shift> _shifts;
+	mutable std::set<Shift> _shifts;
 	Date _date;
+	/* Received shifts are kept encoded until the Shift objects are requested */
+	ShiftListView _shiftsView;
+	mutable bool _shiftsPending = false;
+
+	void materializeShifts() const {
+		if (_shiftsPending) {
+			_shifts = _shiftsView.toSet();
+			_shiftsPending = false;
+		}
+	}
 public:
+	static constexpr Type TYPE = Type::_S2C_GetShiftsReply;
+
 	Type getType() const override {
-		return Type::_S2C_GetShiftsReply;
+		return TYPE;
 	}
 
 	S2C_GetShiftsReply() : S2C_GetShiftsReply(0, Date()) {}
@@ -32,13 +46,14 @@ public:
 	 * @param requestId request id
 	 * @param date queried day
 	 */
-	S2C_GetShiftsReply(int requestId, Date date) : TransactionReply(requestId), _date(date) {}
+	S2C_GetShiftsReply(int requestId, Date date) : StreamedReply(requestId), _date(date) {}
 	/**
 	 * Gets the Shifts in the queried day
 	 * 
 	 * @return std::set<Shift> 
 	 */
 	std::set<Shift> getShifts() const {
+		materializeShifts();
 		return _shifts;
 	}
 	/**
@@ -47,14 +62,30 @@ public:
 	 * @return std::set<Shift>& 
 	 */
 	std::set<Shift>& getShifts() {
+		materializeShifts();
+		// the set may be modified through the reference
+		_shiftsView = ShiftListView();
 		return _shifts;
 	}
+	/**
+	 * Gets a view over the received Shifts, decoding their fields on demand.
+	 * Empty unless this reply was deserialized and its shifts were not accessed by reference since.
+	 * 
+	 * @return const ShiftListView& 
+	 */
+	const ShiftListView& getShiftsView() const {
+		return _shiftsView;
+	}
 	/**
 	 * Sets the Shifts
 	 * 
 	 * @param shifts 
 	 */
-	void setShifts(const std::set<Shift>& shifts) { _shifts = shifts; }
+	void setShifts(const std::set<Shift>& shifts) {
+		_shifts = shifts;
+		_shiftsView = ShiftListView();
+		_shiftsPending = false;
+	}
 	/**
 	 * Gets the queried date
 	 * 
@@ -74,26 +105,70 @@ public:
 		return _date;
 	}
 
-	std::ostream& serialize(std::ostream& destination) const override {
-		TransactionReply::serialize(destination);
-		_date.serialize(destination);
-		write_set_typed(destination, _shifts);
-		return destination;
+	/**
+	 * Encoded size of a Shift in the reply, used by ReplyStream
+	 * 
+	 * @param context state of the message
+	 * @param shift listed Shift
+	 * @return size_t size in bytes
+	 */
+	static size_t recordSize(SizeContext& context, const Shift& shift) {
+		return shift.serializedSize(context);
+	}
+	/**
+	 * Adds a Shift to the reply, used by ReplyStream
+	 * 
+	 * @param shift listed Shift
+	 */
+	void addRecord(const Shift& shift) {
+		getShifts().insert(shift);
+	}
+	/**
+	 * Removes all Shifts from the reply, used by ReplyStream
+	 */
+	void clearRecords() {
+		_shifts.clear();
+		_shiftsView = ShiftListView();
+		_shiftsPending = false;
+	}
+
+	static auto fields() {
+		return std::make_tuple(
+			Fields::field<Fields::Object<Date>>(&S2C_GetShiftsReply::_date),
+			Fields::field<Fields::ObjectSet<Shift>>(&S2C_GetShiftsReply::_shifts));
+	}
+
+	using StreamedReply::serialize;
+	using StreamedReply::deserialize;
+	using StreamedReply::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& destination) const override {
+		StreamedReply::serialize(destination);
+		materializeShifts();
+		return Fields::write_fields(destination, *this, fields());
 	}
 
-	std::istream& deserialize(std::istream& source) override {
-		TransactionReply::deserialize(source);
-		auto date = new_instance<Date>(source);
-		date->deserialize(source);
-		_date = *date;
-		read_set(source, _shifts, get_type_deserializer<Shift>());
+	BinaryReader& deserialize(BinaryReader& source) override {
+		StreamedReply::deserialize(source);
+		Fields::Object<Date>::read(source, _date);
+		// same wire layout as fields(), but the shifts are only scanned
+		_shiftsView = ShiftListView(source);
+		_shifts.clear();
+		_shiftsPending = true;
 		return source;
 	}
 
+	size_t serializedSize(SizeContext& context) const override {
+		materializeShifts();
+		return StreamedReply::serializedSize(context) + Fields::fields_size(context, *this, fields());
+	}
+
 
 	friend bool operator==(const S2C_GetShiftsReply& lhs, const S2C_GetShiftsReply& rhs) {
-		return std::tie(static_cast<const TransactionReply&>(lhs), lhs._shifts, lhs._date) == std::tie(
-			static_cast<const TransactionReply&>(rhs), rhs._shifts, rhs._date);
+		lhs.materializeShifts();
+		rhs.materializeShifts();
+		return std::tie(static_cast<const StreamedReply&>(lhs), lhs._shifts, lhs._date) == std::tie(
+			static_cast<const StreamedReply&>(rhs), rhs._shifts, rhs._date);
 	}
 
 	friend bool operator!=(const S2C_GetShiftsReply& lhs, const S2C_GetShiftsReply& rhs) {
@@ -1,24 +1,28 @@
 #pragma once
+#include <map>
 #include <utility>
 
 
 #include "Serializable.h"
 #include "serialization.h"
 #include "binary.h"
+#include "fields.h"
 #include "ShiftWorker.h"
-#include "TransactionReply.h"
+#include "StreamedReply.h"
 using namespace Serialization;
 using namespace Binary;
 /**
- * Server-to-client response that lists all ShiftWorker objects in the database
+ * Server-to-client response that lists all ShiftWorker objects in the database, in one or more parts
  * 
  */
-class S2C_GetWorkersReply : public TransactionReply {
+class S2C_GetWorkersReply : public StreamedReply {
 protected:
 	std::map<identity_t, ShiftWorker> _workers;
 public:
+	static constexpr Type TYPE = Type::_S2C_GetWorkersReply;
+
 	Type getType() const override {
-		return Type::_S2C_GetWorkersReply;
+		return TYPE;
 	}
 
 	S2C_GetWorkersReply() : S2C_GetWorkersReply(0) {}
@@ -28,7 +32,7 @@ public:
 	 * @param requestId request id
 	 */
 	S2C_GetWorkersReply(int requestId)
-		: TransactionReply(requestId) {}
+		: StreamedReply(requestId) {}
 	/**
 	 * Gets a copy of all ShiftWorkers
 	 * 
@@ -54,33 +58,58 @@ public:
 		_workers = std::move(workers);
 	}
 
-	std::ostream& serialize(std::ostream& destination) const override {
-		TransactionReply::serialize(destination);
-		write_primitive<size_t>(destination, _workers.size());
-		for (const auto& kv : _workers) {
-			write_primitive(destination, kv.first);
-			kv.second.serialize(destination);
-		}
-		return destination;
+	/**
+	 * Encoded size of a ShiftWorker in the reply, used by ReplyStream
+	 * 
+	 * @param context state of the message
+	 * @param worker listed ShiftWorker
+	 * @return size_t size in bytes
+	 */
+	static size_t recordSize(SizeContext& context, const ShiftWorker& worker) {
+		return Fields::Id::size(context, worker.getId()) + worker.serializedSize(context);
 	}
-
-	std::istream& deserialize(std::istream& source) override {
-		TransactionReply::deserialize(source);
+	/**
+	 * Adds a ShiftWorker to the reply, used by ReplyStream
+	 * 
+	 * @param worker listed ShiftWorker
+	 */
+	void addRecord(const ShiftWorker& worker) {
+		_workers[worker.getId()] = worker;
+	}
+	/**
+	 * Removes all ShiftWorkers from the reply, used by ReplyStream
+	 */
+	void clearRecords() {
 		_workers.clear();
-		size_t count;
-		read_primitive(source, &count);
-		for (size_t i = 0; i < count; i++) {
-			identity_t id;
-			read_primitive(source, &id);
-			_workers[id] = get_instance<ShiftWorker>(source);
-		}
-		return source;
+	}
+
+	static auto fields() {
+		return std::make_tuple(
+			Fields::field<Fields::ObjectMap<ShiftWorker>>(&S2C_GetWorkersReply::_workers));
+	}
+
+	using StreamedReply::serialize;
+	using StreamedReply::deserialize;
+	using StreamedReply::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& destination) const override {
+		StreamedReply::serialize(destination);
+		return Fields::write_fields(destination, *this, fields());
+	}
+
+	BinaryReader& deserialize(BinaryReader& source) override {
+		StreamedReply::deserialize(source);
+		return Fields::read_fields(source, *this, fields());
+	}
+
+	size_t serializedSize(SizeContext& context) const override {
+		return StreamedReply::serializedSize(context) + Fields::fields_size(context, *this, fields());
 	}
 
 
 	friend bool operator==(const S2C_GetWorkersReply& lhs, const S2C_GetWorkersReply& rhs) {
-		return std::tie(static_cast<const TransactionReply&>(lhs), lhs._workers) == std::tie(
-			static_cast<const TransactionReply&>(rhs), rhs._workers);
+		return std::tie(static_cast<const StreamedReply&>(lhs), lhs._workers) == std::tie(
+			static_cast<const StreamedReply&>(rhs), rhs._workers);
 	}
 
 	friend bool operator!=(const S2C_GetWorkersReply& lhs, const S2C_GetWorkersReply& rhs) {
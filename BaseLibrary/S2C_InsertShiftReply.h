@@ -1,6 +1,7 @@
 #pragma once
 #include "Serializable.h"
 #include "binary.h"
+#include "fields.h"
 #include "TransactionReply.h"
 
 
@@ -14,8 +15,10 @@ class S2C_InsertShiftReply : public TransactionReply {
 protected:
 	Shift _shift;
 public:
+	static constexpr Type TYPE = Type::_S2C_InsertShiftReply;
+
 	Type getType() const override {
-		return Type::_S2C_InsertShiftReply;
+		return TYPE;
 	}
 
 	/**
@@ -56,18 +59,27 @@ public:
 	S2C_InsertShiftReply(int requestId, const Shift& shift)
 		: TransactionReply(requestId), _shift(shift) {}
 
-	std::ostream& serialize(std::ostream& destination) const override
-	{
+	static auto fields() {
+		return std::make_tuple(
+			Fields::field<Fields::Object<Shift>>(&S2C_InsertShiftReply::_shift));
+	}
+
+	using TransactionReply::serialize;
+	using TransactionReply::deserialize;
+	using TransactionReply::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& destination) const override {
 		TransactionReply::serialize(destination);
-		_shift.serialize(destination);
-		return destination;
+		return Fields::write_fields(destination, *this, fields());
 	}
 
-	std::istream& deserialize(std::istream& source) override
-	{
+	BinaryReader& deserialize(BinaryReader& source) override {
 		TransactionReply::deserialize(source);
-		_shift = get_instance<Shift>(source);
-		return source;
+		return Fields::read_fields(source, *this, fields());
+	}
+
+	size_t serializedSize(SizeContext& context) const override {
+		return TransactionReply::serializedSize(context) + Fields::fields_size(context, *this, fields());
 	}
 
 
@@ -5,6 +5,7 @@
 
 #include "Serializable.h"
 #include "binary.h"
+#include "fields.h"
 #include "TransactionReply.h"
 
 
@@ -18,8 +19,10 @@ class S2C_InsertWorkerReply : public TransactionReply {
 protected:
 	ShiftWorker _worker;
 public:
+	static constexpr Type TYPE = Type::_S2C_InsertWorkerReply;
+
 	Type getType() const override {
-		return Type::_S2C_InsertWorkerReply;
+		return TYPE;
 	}
 
 	/**
@@ -61,20 +64,27 @@ public:
 	S2C_InsertWorkerReply(int requestId, ShiftWorker worker)
 		: TransactionReply(requestId), _worker(std::move(worker)) {}
 
-	std::ostream& serialize(std::ostream& destination) const override
-	{
+	static auto fields() {
+		return std::make_tuple(
+			Fields::field<Fields::Object<ShiftWorker>>(&S2C_InsertWorkerReply::_worker));
+	}
+
+	using TransactionReply::serialize;
+	using TransactionReply::deserialize;
+	using TransactionReply::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& destination) const override {
 		TransactionReply::serialize(destination);
-		_worker.serialize(destination);
-		return destination;
+		return Fields::write_fields(destination, *this, fields());
 	}
 
-	std::istream& deserialize(std::istream& source) override
-	{
+	BinaryReader& deserialize(BinaryReader& source) override {
 		TransactionReply::deserialize(source);
-	
-		_worker = get_instance<ShiftWorker>(source);
-		
-		return source;
+		return Fields::read_fields(source, *this, fields());
+	}
+
+	size_t serializedSize(SizeContext& context) const override {
+		return TransactionReply::serializedSize(context) + Fields::fields_size(context, *this, fields());
 	}
 
 
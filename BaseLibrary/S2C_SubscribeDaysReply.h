@@ -0,0 +1,88 @@
+#pragma once
+#include <utility>
+
+
+#include "Serializable.h"
+#include "binary.h"
+#include "fields.h"
+#include "Date.h"
+#include "TransactionReply.h"
+
+using namespace Serialization;
+using namespace Binary;
+/**
+ * Server-to-client response to subscribing to a range of days
+ * 
+ */
+class S2C_SubscribeDaysReply : public TransactionReply {
+protected:
+	Date _from;
+	Date _to;
+public:
+	static constexpr Type TYPE = Type::_S2C_SubscribeDaysReply;
+
+	Type getType() const override {
+		return TYPE;
+	}
+
+	S2C_SubscribeDaysReply() = default;
+	/**
+	 * Construct a new response to subscribing to a range of days
+	 * 
+	 * @param requestId request id
+	 * @param from first day of the range
+	 * @param to last day of the range (inclusive)
+	 */
+	S2C_SubscribeDaysReply(int requestId, Date from, Date to)
+		: TransactionReply(requestId), _from(std::move(from)), _to(std::move(to)) {}
+	/**
+	 * Gets the first day of the range
+	 * 
+	 * @return const Date& 
+	 */
+	const Date& getFrom() const {
+		return _from;
+	}
+	/**
+	 * Gets the last day of the range (inclusive)
+	 * 
+	 * @return const Date& 
+	 */
+	const Date& getTo() const {
+		return _to;
+	}
+
+	static auto fields() {
+		return std::make_tuple(
+			Fields::field<Fields::Object<Date>>(&S2C_SubscribeDaysReply::_from),
+			Fields::field<Fields::Object<Date>>(&S2C_SubscribeDaysReply::_to));
+	}
+
+	using TransactionReply::serialize;
+	using TransactionReply::deserialize;
+	using TransactionReply::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& destination) const override {
+		TransactionReply::serialize(destination);
+		return Fields::write_fields(destination, *this, fields());
+	}
+
+	BinaryReader& deserialize(BinaryReader& source) override {
+		TransactionReply::deserialize(source);
+		return Fields::read_fields(source, *this, fields());
+	}
+
+	size_t serializedSize(SizeContext& context) const override {
+		return TransactionReply::serializedSize(context) + Fields::fields_size(context, *this, fields());
+	}
+
+
+	friend bool operator==(const S2C_SubscribeDaysReply& lhs, const S2C_SubscribeDaysReply& rhs) {
+		return std::tie(static_cast<const TransactionReply&>(lhs), lhs._from, lhs._to) == std::tie(
+			static_cast<const TransactionReply&>(rhs), rhs._from, rhs._to);
+	}
+
+	friend bool operator!=(const S2C_SubscribeDaysReply& lhs, const S2C_SubscribeDaysReply& rhs) {
+		return !(lhs == rhs);
+	}
+};
@@ -0,0 +1,133 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "types.h"
+
+/**
+ * Immutable encoded frame (length prefix and payload) shared by the send queues of several connections
+ */
+typedef std::shared_ptr<const std::vector<byte_t>> SharedFrame;
+
+/**
+ * Encoded frame (length prefix and payload) waiting to be sent, in a buffer of its own or in a shared one
+ */
+struct OutboundFrame {
+	std::atomic<OutboundFrame*> next{ nullptr };
+	std::vector<byte_t> bytes;
+	/* used instead of `bytes` if set */
+	SharedFrame shared;
+	/**
+	 * Number of bytes already taken by the socket
+	 */
+	size_t offset = 0;
+	/**
+	 * Called once the frame is sent (true) or dropped with the connection (false), may be empty
+	 */
+	std::function<void(bool)> completion;
+
+	/**
+	 * @return const byte_t* first byte of the frame
+	 */
+	const byte_t* data() const {
+		return shared ? shared->data() : bytes.data();
+	}
+	/**
+	 * @return size_t number of bytes of the frame
+	 */
+	size_t size() const {
+		return shared ? shared->size() : bytes.size();
+	}
+	/**
+	 * Reports the outcome of the frame to its sender
+	 *
+	 * @param sent whether all bytes were sent
+	 */
+	void complete(bool sent) {
+		if (completion)
+			completion(sent);
+	}
+};
+
+/**
+ * Lock-free multi-producer single-consumer queue of outbound frames (intrusive, after D. Vyukov).
+ * Any thread may push, only the thread owning the flush of the connection may pop.
+ * Frames are popped in the order in which their pushes completed.
+ */
+class SendQueue {
+protected:
+	OutboundFrame _stub;
+	/* most recently pushed frame */
+	std::atomic<OutboundFrame*> _head;
+	/* next frame to be popped, consumer only */
+	OutboundFrame* _tail;
+	std::atomic<size_t> _size{ 0 };
+
+	void link(OutboundFrame* frame) {
+		frame->next.store(nullptr, std::memory_order_relaxed);
+		auto* previous = _head.exchange(frame, std::memory_order_acq_rel);
+		previous->next.store(frame, std::memory_order_release);
+	}
+
+public:
+	SendQueue() : _head(&_stub), _tail(&_stub) { }
+	SendQueue(const SendQueue&) = delete;
+	SendQueue& operator=(const SendQueue&) = delete;
+	/**
+	 * Deletes the frames left in the queue without completing them; the owner fails them first
+	 */
+	~SendQueue() {
+		while (auto* frame = pop())
+			delete frame;
+	}
+	/**
+	 * Appends a frame, taking its ownership. Safe to call from any thread.
+	 *
+	 * @param frame encoded frame
+	 */
+	void push(OutboundFrame* frame) {
+		// counted before it becomes visible, so that a non-empty queue is never reported empty
+		_size.fetch_add(1);
+		link(frame);
+	}
+	/**
+	 * Removes the oldest frame. May return nullptr while a push is still in progress.
+	 *
+	 * @return OutboundFrame* frame owned by the caller, or nullptr if there is none
+	 */
+	OutboundFrame* pop() {
+		auto* tail = _tail;
+		auto* next = tail->next.load(std::memory_order_acquire);
+		if (tail == &_stub) {
+			if (!next)
+				return nullptr;
+			_tail = tail = next;
+			next = next->next.load(std::memory_order_acquire);
+		}
+		if (!next) {
+			if (tail != _head.load(std::memory_order_acquire))
+				return nullptr;
+			// the last frame can only be taken once the stub is queued behind it
+			link(&_stub);
+			next = tail->next.load(std::memory_order_acquire);
+			if (!next)
+				return nullptr;
+		}
+		_tail = next;
+		_size.fetch_sub(1);
+		return tail;
+	}
+	/**
+	 * @return whether no frame is queued or being pushed
+	 */
+	bool empty() const {
+		return _size.load() == 0;
+	}
+	/**
+	 * @return number of frames queued or being pushed
+	 */
+	size_t size() const {
+		return _size.load();
+	}
+};
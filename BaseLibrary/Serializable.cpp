@@ -1,7 +1,42 @@
 #include <iostream>
+#include <iterator>
+#include <vector>
 #include "Serializable.h"
 
 namespace Serialization {
+	std::ostream& Serializable::serialize(std::ostream& destination, WireFormat format) const {
+		BinaryWriter writer(serializedSize(format));
+		writer.setFormat(format);
+		serialize(writer);
+		if (!destination.good())
+			throw std::runtime_error("invalid destination stream");
+		destination.write(reinterpret_cast<const char*>(writer.data()), writer.getPosition());
+		return destination;
+	}
+
+	std::istream& Serializable::deserialize(std::istream& source, WireFormat format) {
+		if (!source.good())
+			throw std::runtime_error("invalid source stream");
+		auto* memory = dynamic_cast<memory_buf*>(source.rdbuf());
+		if (memory) {
+			const auto position = static_cast<size_t>(memory->getInPosition());
+			BinaryReader reader(memory->data() + position, memory->getLength() - position);
+			reader.setFormat(format);
+			deserialize(reader);
+			memory->pubseekoff(reader.getPosition(), std::ios_base::cur, std::ios_base::in);
+			return source;
+		}
+		const auto start = source.tellg();
+		std::vector<char> bytes((std::istreambuf_iterator<char>(source)), std::istreambuf_iterator<char>());
+		BinaryReader reader(reinterpret_cast<const byte_t*>(bytes.data()), bytes.size());
+		reader.setFormat(format);
+		deserialize(reader);
+		source.clear();
+		if (start != std::streampos(-1))
+			source.seekg(start + static_cast<std::streamoff>(reader.getPosition()));
+		return source;
+	}
+
 	std::ostream& operator<<(std::ostream& dst, const Serializable& obj) {
 		return obj.serialize(dst);
 	}
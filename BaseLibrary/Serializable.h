@@ -39,7 +39,18 @@ namespace Serialization {
 		_C2S_DeleteWorker,
 		_S2C_DeleteWorkerReply,
 		_S2C_ClientSync,
+		_StreamedReply,
+		_C2S_SubscribeDays,
+		_S2C_SubscribeDaysReply,
+		_C2S_GetChanges,
+		_S2C_GetChangesReply,
+		_C2S_GetShiftsByWorker,
+		_S2C_GetShiftsByWorkerReply,
 	};
+	/**
+	 * Number of distinct Type tags
+	 */
+	const size_t TYPE_COUNT = 256;
 	/**
 	 * Base-class for all serializable objects
 	 * 
@@ -47,6 +58,12 @@ namespace Serialization {
 	class Serializable {
 
 	public:
+		/**
+		 * Type tag of this class, known at compile time.
+		 * Every serializable class has to redefine it and return it from getType().
+		 */
+		static constexpr Type TYPE = Type::Unknown;
+
 		virtual ~Serializable() = default;
 		/**
 	     * @return Type of this serializable object
@@ -55,29 +72,64 @@ namespace Serialization {
 
 
 		/**
-		 * Serializes this object into a binary output stream
-		 * @param destination binary output stream
-		 * @return output stream
+		 * Serializes this object into a binary buffer
+		 * @param destination binary writer
+		 * @return binary writer
 		 */
-		virtual std::ostream& serialize(std::ostream& destination) const {
+		virtual BinaryWriter& serialize(BinaryWriter& destination) const {
 			write_primitive(destination, this->getType());
 			return destination;
 		}
 
 		/**
-		 * Deserializes this object from a binary input stream
-		 * @param source binary input stream
-		 * @return input stream
+		 * Deserializes this object from a binary buffer
+		 * @param source binary reader
+		 * @return binary reader
 		 */
-		virtual std::istream& deserialize(std::istream& source) {
+		virtual BinaryReader& deserialize(BinaryReader& source) {
 			auto type = static_cast<uint8_t>(this->getType());
-			char targetType;
-			read_primitive(source, &targetType);
+			auto targetType = read_primitive<uint8_t>(source);
 			if (targetType != type)
 				throw std::runtime_error(
 					"incompatible object type #" + std::to_string(type) + " <- #" + std::to_string(targetType));
 			return source;
 		}
+		/**
+		 * Computes the exact number of bytes written by serialize, without encoding anything
+		 * @param context format and state of the message being measured
+		 * @return size_t serialized size
+		 */
+		virtual size_t serializedSize(SizeContext& context) const {
+			return sizeof(Type);
+		}
+		/**
+		 * Computes the exact number of bytes written by serialize into a new message
+		 * @param format wire format of the message
+		 * @return size_t serialized size
+		 */
+		size_t serializedSize(WireFormat format = WireFormat::Fixed) const {
+			SizeContext context(format);
+			return serializedSize(context);
+		}
+
+		/**
+		 * Serializes this object into a binary output stream.
+		 * Encodes the object into a contiguous buffer first, then writes it to the stream at once.
+		 * @param destination binary output stream
+		 * @param format encoding of lengths, ids, dates and text
+		 * @return output stream
+		 */
+		std::ostream& serialize(std::ostream& destination, WireFormat format = WireFormat::Fixed) const;
+
+		/**
+		 * Deserializes this object from a binary input stream.
+		 * Decodes in place if the stream uses a memory_buf, otherwise reads the remaining
+		 * bytes into a buffer and moves the stream back behind the decoded object.
+		 * @param source binary input stream
+		 * @param format encoding of lengths, ids, dates and text
+		 * @return input stream
+		 */
+		std::istream& deserialize(std::istream& source, WireFormat format = WireFormat::Fixed);
 
 
 		friend bool operator==(const Serializable& lhs, const Serializable& rhs) {
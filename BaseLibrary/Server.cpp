@@ -7,14 +7,19 @@ bool Server::shouldAcceptSocket(PSocket* socket) {
 
 
 void Server::prepareClient(PSocket* socket) {
-	auto client = static_cast<ConnectionBase*>(new Connection(false));
+	auto* connection = new Connection(false);
+	connection->setReactor(_reactor);
+	auto client = static_cast<ConnectionBase*>(connection);
 	client->subscribe(this);
 	client->connect(socket);
 	if (!client->isAlive()) {
 		client->close();
 		return;
 	}
-	_clients[client->getId()] = client;
+	{
+		std::lock_guard<std::recursive_mutex> lock(_clientsLock);
+		_clients[client->getId()] = client;
+	}
 	client->setReadingAsync(true);
 }
 
@@ -26,6 +31,14 @@ void Server::listenWorker() {
 			continue;
 
 		if (shouldAcceptSocket(client)) {
+			// the event loops do not block, so the client can be set up right away
+			if (_reactor) {
+				try {
+					prepareClient(client);
+				}
+				catch (...) {}
+				continue;
+			}
 			std::thread thr([this, client]() 
 			{
 				prepareClient(client);
@@ -45,9 +58,17 @@ void Server::onDisconnected(ConnectionBase* connection, std::exception exception
 	for (auto obs : _observers) {
 		obs->onDisconnected(connection, exception);
 	}
-	int id = connection->getId();
-	_clients.erase(id);
-	this->deleteConnectionAsync(connection);
+	bool removed;
+	{
+		std::lock_guard<std::recursive_mutex> lock(_clientsLock);
+		const auto it = _clients.find(connection->getId());
+		removed = it != _clients.end() && it->second == connection;
+		if (removed)
+			_clients.erase(it);
+	}
+	// only the one who removed the client may delete it
+	if (removed)
+		this->deleteConnectionAsync(connection);
 }
 
 void Server::onPayloadSent(ConnectionBase* connection, const Serializable& payload, size_t size) {
@@ -89,6 +110,8 @@ void Server::start(const std::string& host, int port) {
 		throw std::runtime_error("Could not start listening on the given port");
 		
 	}
+	if (_reactor && !_reactor->isRunning())
+		_reactor->start();
 	_running = true;
 	_listenSocket = sock;
 	_listenThread = std::thread([this] {
@@ -104,20 +127,109 @@ void Server::stop() {
 
 	p_socket_close(_listenSocket, nullptr);
 	_listenThread.detach();
-	auto clientsCopy = std::map<int, ConnectionBase*>(_clients);
+	// the event loops let go of the clients first, so their sockets are closed right away
+	if (_reactor)
+		_reactor->stop();
+	std::map<int, ConnectionBase*> clientsCopy;
+	{
+		std::lock_guard<std::recursive_mutex> lock(_clientsLock);
+		clientsCopy.swap(_clients);
+	}
 	for (auto client : clientsCopy) {
 		try {
 			client.second->close();
 		}
 		catch (...) {}
+		deleteConnectionAsync(client.second);
+	}
+}
+
+void Server::writeToAll(std::shared_ptr<const Serializable> msg) {
+	if (!msg)
+		return;
+	pushBroadcast(Broadcast{std::move(msg), {}, true});
+}
+
+void Server::writeTo(std::shared_ptr<const Serializable> msg, std::vector<int> clientIds) {
+	if (!msg || clientIds.empty())
+		return;
+	pushBroadcast(Broadcast{std::move(msg), std::move(clientIds), false});
+}
+
+void Server::pushBroadcast(Broadcast broadcast) {
+	{
+		std::lock_guard<std::mutex> guard(_broadcastLock);
+		if (_broadcastStopping)
+			return;
+		_broadcasts.push_back(std::move(broadcast));
+		if (!_broadcastThread.joinable()) {
+			_broadcastThread = std::thread([this] {
+				broadcastWorker();
+			});
+		}
 	}
-	_clients.clear();
+	_broadcastSignal.notify_one();
+}
+
+void Server::flushBroadcasts() {
+	std::unique_lock<std::mutex> guard(_broadcastLock);
+	_broadcastDone.wait(guard, [this] {
+		return (_broadcasts.empty() && _broadcastsInProgress == 0) || !_broadcastThread.joinable();
+	});
 }
 
-void Server::writeToAll(const Serializable& msg) {
-	for(const auto& con : _clients) {
+void Server::broadcastWorker() {
+	std::unique_lock<std::mutex> guard(_broadcastLock);
+	while (true) {
+		_broadcastSignal.wait(guard, [this] {
+			return !_broadcasts.empty() || _broadcastStopping;
+		});
+		if (_broadcastStopping)
+			break;
+		std::deque<Broadcast> broadcasts;
+		broadcasts.swap(_broadcasts);
+		_broadcastsInProgress = broadcasts.size();
+		guard.unlock();
+		for (const auto& broadcast : broadcasts) {
+			try {
+				fanOut(broadcast);
+			}
+			catch (...) {}
+		}
+		guard.lock();
+		_broadcastsInProgress = 0;
+		_broadcastDone.notify_all();
+	}
+	_broadcastDone.notify_all();
+}
+
+void Server::fanOut(const Broadcast& broadcast) {
+	const auto& msg = *broadcast.msg;
+	// at most one encoding per wire format, shared by the send queues of all clients using it
+	SharedFrame frames[2];
+	std::lock_guard<std::recursive_mutex> lock(_clientsLock);
+	// clients closed by a failed write leave the map, but are not deleted while the lock is held
+	std::vector<ConnectionBase*> clients;
+	if (broadcast.toAll) {
+		clients.reserve(_clients.size());
+		for (const auto& con : _clients)
+			clients.push_back(con.second);
+	}
+	else {
+		clients.reserve(broadcast.targets.size());
+		for (auto id : broadcast.targets) {
+			auto it = _clients.find(id);
+			if (it != _clients.end())
+				clients.push_back(it->second);
+		}
+	}
+	for (auto* client : clients) {
+		const auto format = client->getWireFormat();
+		auto& frame = frames[format == WireFormat::Compact ? 1 : 0];
+		if (!frame)
+			frame = Connection::encodeSharedFrame(msg, format);
 		try {
-			con.second->writeSync(msg);
+			client->writeAsync(msg, frame, nullptr);
 		}catch(...){}
 	}
 }
@@ -128,13 +240,26 @@ void Server::join() {
 	_listenThread.join();
 }
 
-Server::Server() {
+Server::Server(int reactorThreads) {
+	_running = false;
 	_listenSocket = nullptr;
+	_reactor = nullptr;
+	if (reactorThreads > 0 && Reactor::isSupported())
+		_reactor = new Reactor(reactorThreads);
 }
 
 Server::~Server() {
 	stop();
+	{
+		std::lock_guard<std::mutex> guard(_broadcastLock);
+		_broadcastStopping = true;
+		_broadcasts.clear();
+	}
+	_broadcastSignal.notify_all();
+	if (_broadcastThread.joinable())
+		_broadcastThread.join();
 	_observers.clear();
+	delete _reactor;
 }
 
 void Server::subscribe(ServerObserver* observer) {
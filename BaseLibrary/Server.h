@@ -1,8 +1,11 @@
 #pragma once
 #include "Connection.h"
+#include "Reactor.h"
 #include <future>
 #include <set>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
 
 class Server;
 /**
@@ -42,10 +45,30 @@ protected:
 
 	std::set<ServerObserver*> _observers;
 	std::map<int, ConnectionBase*> _clients;
+	mutable std::recursive_mutex _clientsLock;
 	std::set<ConnectionBase*> _graveyard;
 	std::atomic<bool> _running;
 	std::thread _listenThread;
 	PSocket* _listenSocket;
+	Reactor* _reactor;
+
+	/**
+	 * Packet waiting to be queued to the clients by the broadcasting thread
+	 */
+	struct Broadcast {
+		std::shared_ptr<const Serializable> msg;
+		/* receiving client ids, ignored if the packet goes to all clients */
+		std::vector<int> targets;
+		bool toAll;
+	};
+	/* Broadcasts waiting to be queued to the clients by the broadcasting thread */
+	std::deque<Broadcast> _broadcasts;
+	std::mutex _broadcastLock;
+	std::condition_variable _broadcastSignal;
+	std::condition_variable _broadcastDone;
+	std::thread _broadcastThread;
+	size_t _broadcastsInProgress = 0;
+	bool _broadcastStopping = false;
 	/**
 	 * Predicate that should decide whether to accept the socket connection
 	 * 
@@ -64,6 +87,23 @@ protected:
 	 * 
 	 */
 	virtual void listenWorker();
+	/**
+	 * Background task that queues the broadcasts to all clients, in order
+	 * 
+	 */
+	virtual void broadcastWorker();
+	/**
+	 * Queues a single broadcast to its connected clients, encoding it once per wire format in use
+	 * 
+	 * @param broadcast payload and its receivers
+	 */
+	virtual void fanOut(const Broadcast& broadcast);
+	/**
+	 * Hands a broadcast to the broadcasting thread, starting it if needed
+	 * 
+	 * @param broadcast payload and its receivers
+	 */
+	virtual void pushBroadcast(Broadcast broadcast);
 
 	/**
 	 * Schedules a connection object to be deleted
@@ -84,6 +124,7 @@ public:
 	 * @return std::map<int, ConnectionBase*> set of all clients
 	 */
 	virtual std::map<int, ConnectionBase*> clients() const {
+		std::lock_guard<std::recursive_mutex> lock(_clientsLock);
 		return _clients;
 	}
 	/**
@@ -94,9 +135,24 @@ public:
 		return _running;
 	};
 
-	Server();
+	/**
+	 * Construct a new Server
+	 * 
+	 * @param reactorThreads number of event-loop threads used to read all clients,
+	 * or 0 to read every client in a dedicated thread. The event-loop mode is used
+	 * only if supported by the platform (see Reactor::isSupported)
+	 */
+	Server(int reactorThreads = 0);
 	
 	virtual ~Server();
+	/**
+	 * Gets the event loops reading the clients
+	 * 
+	 * @return Reactor* event loops, or nullptr if every client is read in a dedicated thread
+	 */
+	virtual Reactor* getReactor() const {
+		return _reactor;
+	}
 	/**
 	 * Starts listening for incoming connections on the specified endpoint
 	 * 
@@ -111,11 +167,26 @@ public:
 	virtual void stop();
 
 	/**
-	 * Sends a packet to all connected clients
+	 * Queues a packet to all connected clients, without waiting for any of them.
+	 * The packet is encoded and handed to the clients by a background thread, so it must not be modified anymore.
 	 * 
 	 * @param msg payload
 	 */
-	virtual void writeToAll(const Serializable& msg);
+	virtual void writeToAll(std::shared_ptr<const Serializable> msg);
+	/**
+	 * Queues a packet to some of the connected clients, without waiting for any of them.
+	 * Ids of clients that are not connected anymore are ignored. Packets passed to writeTo and writeToAll
+	 * are queued to the clients in the order of the calls.
+	 * 
+	 * @param msg payload
+	 * @param clientIds ids of the receiving clients
+	 */
+	virtual void writeTo(std::shared_ptr<const Serializable> msg, std::vector<int> clientIds);
+	/**
+	 * Waits until every packet passed to writeToAll and writeTo so far is queued to the clients
+	 * 
+	 */
+	virtual void flushBroadcasts();
 	/**
 	 * Joins the listener thread
 	 * 
@@ -2,7 +2,9 @@
 #include "Serializable.h"
 #include "serialization.h"
 #include "binary.h"
+#include "fields.h"
 #include "DateTime.h"
+#include "JobCatalog.h"
 #include "types.h"
 #include <stdexcept>
 #include <utility>
@@ -20,15 +22,33 @@ protected:
 	DateTime _startTime;
 	uint8_t _workHours{};
 	identity_t _workerId{};
-	std::wstring _jobName;
+	job_id_t _jobId{}; // interned in JobCatalog
 
 
 public:
+	static constexpr Type TYPE = Type::_Shift;
+
 	Type getType() const override {
-		return Type::_Shift;
+		return TYPE;
 	}
 
-	Shift() : Shift(DateTime(), 1, L"") { }
+	Shift() : Shift(DateTime(), 1, std::string()) { }
+	/**
+	 * Construct a new Shift object
+	 * 
+	 * @param startTime starting time
+	 * @param workHours duration
+	 * @param jobName name of the job, UTF-8
+	 * @param workerId id of the worker
+	 * @param id id of the shift
+	 */
+	Shift(DateTime startTime, int workHours, std::string jobName, identity_t workerId = 0, identity_t id = 0) {
+		_id = id;
+		setStartTime(std::move(startTime));
+		setWorkHours(workHours);
+		setWorkerId(workerId);
+		_jobId = JobCatalog::getInstance().intern(jobName);
+	}
 	/**
 	 * Construct a new Shift object
 	 * 
@@ -38,12 +58,23 @@ public:
 	 * @param workerId id of the worker
 	 * @param id id of the shift
 	 */
-	Shift(DateTime startTime, int workHours, std::wstring jobName, identity_t workerId = 0, identity_t id = 0) {
+	Shift(DateTime startTime, int workHours, const std::wstring& jobName, identity_t workerId = 0, identity_t id = 0)
+		: Shift(std::move(startTime), workHours, Utf8::fromWide(jobName), workerId, id) { }
+	/**
+	 * Construct a new Shift object of an interned job
+	 * 
+	 * @param startTime starting time
+	 * @param workHours duration
+	 * @param jobId id returned by JobCatalog::intern
+	 * @param workerId id of the worker
+	 * @param id id of the shift
+	 */
+	Shift(DateTime startTime, int workHours, job_id_t jobId, identity_t workerId, identity_t id) {
 		_id = id;
 		setStartTime(std::move(startTime));
 		setWorkHours(workHours);
 		setWorkerId(workerId);
-		_jobName = std::move(jobName);
+		_jobId = jobId;
 	}
 
 	/* The accessors below shouldn't be virtual, since they need to be ran from the constructor */
@@ -139,36 +170,108 @@ public:
 	 */
 	virtual std::wstring getJobName() const
 	{
-		return _jobName;
+		return Utf8::toWide(getJobNameUtf8());
 	}
 	/**
 	 * Sets the name of this job
 	 * 
 	 * @param jobName 
 	 */
-	virtual void setJobName(std::wstring jobName)
+	virtual void setJobName(const std::wstring& jobName)
+	{
+		setJobNameUtf8(Utf8::fromWide(jobName));
+	}
+	/**
+	 * Gets the name of this job, as stored in the JobCatalog
+	 * 
+	 * @return const std::string& UTF-8 name
+	 */
+	const std::string& getJobNameUtf8() const
+	{
+		return JobCatalog::getInstance().getName(_jobId);
+	}
+	/**
+	 * Sets the name of this job
+	 * 
+	 * @param jobName UTF-8 name
+	 */
+	void setJobNameUtf8(const std::string& jobName)
 	{
-		_jobName = jobName;
+		_jobId = JobCatalog::getInstance().intern(jobName);
+	}
+	/**
+	 * Gets the id of this job in the JobCatalog. Shifts of the same job always have the same id.
+	 * 
+	 * @return job_id_t 
+	 */
+	job_id_t getJobId() const
+	{
+		return _jobId;
+	}
+	/**
+	 * Sets the id of this job
+	 * 
+	 * @param jobId id returned by JobCatalog::intern
+	 */
+	void setJobId(const job_id_t jobId)
+	{
+		if (!JobCatalog::getInstance().contains(jobId))
+			throw std::invalid_argument("Unknown job id");
+		_jobId = jobId;
+	}
+
+	/**
+	 * Codec for job ids: job names are sent as message-local symbols
+	 */
+	struct JobSymbol {
+		static void write(BinaryWriter& destination, const job_id_t& jobId) {
+			write_symbol(destination, jobId, [](job_id_t id) -> const std::string& {
+				return JobCatalog::getInstance().getName(id);
+			});
+		}
+		static void read(BinaryReader& source, job_id_t& jobId) {
+			// names are never released, so those of peers are bounded by the limits of the reader
+			const auto maxNames = source.getLimits().maxJobNames;
+			jobId = read_symbol(source, [maxNames](const std::string& name) {
+				return JobCatalog::getInstance().intern(name, maxNames);
+			});
+		}
+		static size_t size(SizeContext& context, const job_id_t& jobId) {
+			if (context.getFormat() != WireFormat::Compact)
+				return Fields::Text::size(context, JobCatalog::getInstance().getName(jobId));
+			uint32_t index;
+			if (context.internSymbol(jobId, &index))
+				return varint_size(index);
+			return varint_size(0) + Fields::String::size(context, JobCatalog::getInstance().getName(jobId));
+		}
+	};
+
+	static auto fields() {
+		return std::make_tuple(
+			Fields::field<Fields::Id>(&Shift::_id),
+			Fields::field<Fields::Object<DateTime>>(&Shift::_startTime),
+			// decoded after the start time, which bounds the duration
+			Fields::field<Fields::Primitive<uint8_t>>(&Shift::_workHours, &Shift::setWorkHours),
+			Fields::field<Fields::Id>(&Shift::_workerId),
+			Fields::field<JobSymbol>(&Shift::_jobId));
 	}
 
-	std::ostream& serialize(std::ostream& destination) const override {
+	using Serializable::serialize;
+	using Serializable::deserialize;
+	using Serializable::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& destination) const override {
 		Serializable::serialize(destination);
-		write_primitive(destination, _id);
-		_startTime.serialize(destination);
-		write_primitive(destination, _workHours);
-		write_primitive(destination, _workerId);
-		write_wstring(destination, _jobName);
-		return destination;
+		return Fields::write_fields(destination, *this, fields());
 	}
 
-	std::istream& deserialize(std::istream& source) override {
+	BinaryReader& deserialize(BinaryReader& source) override {
 		Serializable::deserialize(source);
-		read_primitive(source, &_id);
-		_startTime.deserialize(source);
-		setWorkHours(read_primitive<uint8_t>(source));
-		read_primitive(source, &_workerId);
-		_jobName = read_wstring(source);
-		return source;
+		return Fields::read_fields(source, *this, fields());
+	}
+
+	size_t serializedSize(SizeContext& context) const override {
+		return Serializable::serializedSize(context) + Fields::fields_size(context, *this, fields());
 	}
 
 
@@ -178,7 +281,7 @@ public:
 			&& lhs.getStartTime() == rhs.getStartTime()
 			&& lhs._workHours == rhs._workHours
 			&& lhs._workerId == rhs._workerId
-			&& lhs._jobName == rhs._jobName;
+			&& lhs._jobId == rhs._jobId;
 	}
 
 	friend bool operator!=(const Shift& lhs, const Shift& rhs)
@@ -189,8 +292,8 @@ public:
 
 	friend bool operator<(const Shift& lhs, const Shift& rhs)
 	{
-		return std::tie(lhs._startTime, lhs._workHours, lhs._jobName, lhs._workerId, lhs._id) < std::tie(
-			rhs._startTime, rhs._workHours, rhs._jobName, rhs._workerId, rhs._id);
+		return std::tie(lhs._startTime, lhs._workHours, lhs._jobId, lhs._workerId, lhs._id) < std::tie(
+			rhs._startTime, rhs._workHours, rhs._jobId, rhs._workerId, rhs._id);
 	}
 
 	friend bool operator<=(const Shift& lhs, const Shift& rhs)
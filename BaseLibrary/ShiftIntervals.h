@@ -0,0 +1,101 @@
+#pragma once
+#include <iterator>
+#include <map>
+#include <utility>
+
+#include "Date.h"
+#include "DateTime.h"
+#include "Shift.h"
+#include "types.h"
+
+/**
+ * Index of the working time taken by the shifts of every job on every day, used to check new shifts for collisions.
+ * Shifts of the same job on a day never overlap, so they are kept ordered by their start
+ * and a new shift can only collide with its two neighbours.
+ */
+class ShiftIntervals {
+protected:
+	/**
+	 * Time taken by a single shift
+	 */
+	struct Interval {
+		identity_t id;
+		DateTime end;
+	};
+	typedef std::map<DateTime, Interval> Intervals;
+	/* (day, job) -> start -> shift id, end */
+	std::map<std::pair<Date, job_id_t>, Intervals> _intervals;
+	size_t _size = 0;
+
+public:
+	/**
+	 * Adds the time taken by a shift, which must not collide with the others
+	 *
+	 * @param shift added Shift
+	 */
+	void add(const Shift& shift) {
+		auto& intervals = _intervals[std::make_pair(Date(shift.getStartTime()), shift.getJobId())];
+		if (intervals.insert(std::make_pair(shift.getStartTime(), Interval{ shift.getId(), shift.getEndTime() })).second)
+			_size++;
+	}
+	/**
+	 * Removes the time taken by a shift, as it was when added
+	 *
+	 * @param shift removed Shift
+	 */
+	void remove(const Shift& shift) {
+		auto key = _intervals.find(std::make_pair(Date(shift.getStartTime()), shift.getJobId()));
+		if (key == _intervals.end())
+			return;
+		auto it = key->second.find(shift.getStartTime());
+		if (it == key->second.end() || it->second.id != shift.getId())
+			return;
+		key->second.erase(it);
+		_size--;
+		if (key->second.empty())
+			_intervals.erase(key);
+	}
+	/**
+	 * Checks if a shift overlaps another one of the same job on its day, ignoring the shift itself
+	 *
+	 * @param shift checked Shift
+	 * @return whether the shift collides with another one
+	 */
+	bool collides(const Shift& shift) const {
+		auto key = _intervals.find(std::make_pair(Date(shift.getStartTime()), shift.getJobId()));
+		if (key == _intervals.end())
+			return false;
+		const auto& intervals = key->second;
+		const auto& start = shift.getStartTime();
+		const auto end = shift.getEndTime();
+		// the first shift starting at the same time or later must start after this one ends
+		auto next = intervals.lower_bound(start);
+		if (next != intervals.end() && next->second.id == shift.getId())
+			++next;
+		if (next != intervals.end() && next->first < end)
+			return true;
+		// the last shift starting earlier must end before this one starts
+		auto prev = intervals.lower_bound(start);
+		while (prev != intervals.begin()) {
+			--prev;
+			if (prev->second.id == shift.getId())
+				continue;
+			return start < prev->second.end;
+		}
+		return false;
+	}
+	/**
+	 * Removes every shift
+	 */
+	void clear() {
+		_intervals.clear();
+		_size = 0;
+	}
+	/**
+	 *
+	 * @return size_t number of indexed shifts
+	 */
+	size_t size() const {
+		return _size;
+	}
+};
@@ -0,0 +1,217 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "Date.h"
+#include "DateTime.h"
+#include "Shift.h"
+#include "types.h"
+
+/**
+ * Dense storage of Shift records. Every field is kept in its own contiguous column indexed by slot,
+ * so walking the shifts touches no tree nodes and no vtables. Slots of removed shifts are reused,
+ * and every day lists the slots of its shifts ordered by id.
+ */
+class ShiftTable {
+public:
+	typedef uint32_t slot_t;
+	typedef std::vector<slot_t> Slots;
+
+protected:
+	/* id of every slot, 0 if the slot is free */
+	std::vector<identity_t> _ids;
+	/* start time, packed by packTime */
+	std::vector<uint64_t> _starts;
+	std::vector<uint8_t> _workHours;
+	std::vector<identity_t> _workerIds;
+	std::vector<job_id_t> _jobIds;
+	std::vector<slot_t> _free;
+	std::map<Date, Slots> _days;
+
+	Slots& slotsOf(const Date& day) {
+		return _days[day];
+	}
+
+public:
+	/**
+	 * Packs a time into an integer that keeps the order of the times
+	 *
+	 * @param time packed time
+	 * @return uint64_t
+	 */
+	static uint64_t packTime(const DateTime& time) {
+		return static_cast<uint64_t>(time.getYear()) << 26 | static_cast<uint64_t>(time.getMonth()) << 22 |
+			static_cast<uint64_t>(time.getDay()) << 17 | static_cast<uint64_t>(time.getHour()) << 12 |
+			static_cast<uint64_t>(time.getMinute()) << 6 | time.getSecond();
+	}
+	/**
+	 * Unpacks a time packed by packTime
+	 *
+	 * @param packed packed time
+	 * @return DateTime
+	 */
+	static DateTime unpackTime(uint64_t packed) {
+		return DateTime(static_cast<int>(packed >> 26), packed >> 22 & 0xf, packed >> 17 & 0x1f, packed >> 12 & 0x1f,
+		                packed >> 6 & 0x3f, packed & 0x3f);
+	}
+	/**
+	 * Packs a day into an integer that keeps the order of the days, 0 is never a valid day
+	 *
+	 * @param day packed day
+	 * @return uint32_t
+	 */
+	static uint32_t packDay(const Date& day) {
+		return day.getYear() << 9 | day.getMonth() << 5 | day.getDay();
+	}
+	/**
+	 * Unpacks a day packed by packDay
+	 *
+	 * @param packed packed day
+	 * @return Date
+	 */
+	static Date unpackDay(uint32_t packed) {
+		return Date(packed >> 9, packed >> 5 & 0xf, packed & 0x1f);
+	}
+
+	/**
+	 * Stores a Shift, which must have an id
+	 *
+	 * @param shift stored Shift
+	 * @return slot_t slot of the shift
+	 */
+	slot_t insert(const Shift& shift) {
+		slot_t slot;
+		if (!_free.empty()) {
+			slot = _free.back();
+			_free.pop_back();
+		}
+		else {
+			slot = static_cast<slot_t>(_ids.size());
+			_ids.push_back(0);
+			_starts.push_back(0);
+			_workHours.push_back(0);
+			_workerIds.push_back(0);
+			_jobIds.push_back(0);
+		}
+		_ids[slot] = shift.getId();
+		_starts[slot] = packTime(shift.getStartTime());
+		_workHours[slot] = shift.getWorkHours();
+		_workerIds[slot] = shift.getWorkerId();
+		_jobIds[slot] = shift.getJobId();
+		// new shifts have the highest id, so they usually go to the end of their day
+		auto& slots = slotsOf(shift.getStartTime());
+		auto it = std::upper_bound(slots.begin(), slots.end(), shift.getId(), [this](identity_t id, slot_t other) {
+			return id < _ids[other];
+		});
+		slots.insert(it, slot);
+		return slot;
+	}
+	/**
+	 * Removes the Shift of a slot
+	 *
+	 * @param slot slot of the shift
+	 */
+	void erase(slot_t slot) {
+		const auto day = getDay(slot);
+		auto it = _days.find(day);
+		if (it != _days.end()) {
+			auto& slots = it->second;
+			slots.erase(std::remove(slots.begin(), slots.end(), slot), slots.end());
+			if (slots.empty())
+				_days.erase(it);
+		}
+		_ids[slot] = 0;
+		_free.push_back(slot);
+	}
+	/**
+	 *
+	 * @param slot slot of the shift
+	 * @param id id of the shift
+	 * @return whether the slot holds the shift with the given id
+	 */
+	bool holds(slot_t slot, identity_t id) const {
+		return slot < _ids.size() && id && _ids[slot] == id;
+	}
+	/**
+	 * Gets a copy of the Shift of a slot
+	 *
+	 * @param slot slot of the shift
+	 * @return Shift
+	 */
+	Shift get(slot_t slot) const {
+		return Shift(unpackTime(_starts[slot]), _workHours[slot], _jobIds[slot], _workerIds[slot], _ids[slot]);
+	}
+	/**
+	 *
+	 * @param slot slot of the shift
+	 * @return identity_t id of the shift
+	 */
+	identity_t getId(slot_t slot) const {
+		return _ids[slot];
+	}
+	/**
+	 *
+	 * @param slot slot of the shift
+	 * @return Date day of the shift
+	 */
+	Date getDay(slot_t slot) const {
+		return unpackDay(static_cast<uint32_t>(_starts[slot] >> 17));
+	}
+	/**
+	 *
+	 * @param slot slot of the shift
+	 * @return identity_t id of the assigned worker
+	 */
+	identity_t getWorkerId(slot_t slot) const {
+		return _workerIds[slot];
+	}
+	/**
+	 * Assigns the shift of a slot to another worker
+	 *
+	 * @param slot slot of the shift
+	 * @param workerId id of the worker
+	 */
+	void setWorkerId(slot_t slot, identity_t workerId) {
+		_workerIds[slot] = workerId;
+	}
+	/**
+	 * Gets the slots of the shifts of a day
+	 *
+	 * @param day day of the shifts
+	 * @return const Slots& slots ordered by the id of their shifts
+	 */
+	const Slots& getDay(const Date& day) const {
+		static const Slots empty;
+		auto it = _days.find(day);
+		return it != _days.end() ? it->second : empty;
+	}
+	/**
+	 * Gets the slots of the shifts of every day
+	 *
+	 * @return const std::map<Date, Slots>&
+	 */
+	const std::map<Date, Slots>& getDays() const {
+		return _days;
+	}
+	/**
+	 * Removes every shift
+	 */
+	void clear() {
+		_ids.clear();
+		_starts.clear();
+		_workHours.clear();
+		_workerIds.clear();
+		_jobIds.clear();
+		_free.clear();
+		_days.clear();
+	}
+	/**
+	 *
+	 * @return size_t number of stored shifts
+	 */
+	size_t size() const {
+		return _ids.size() - _free.size();
+	}
+};
@@ -0,0 +1,279 @@
+#pragma once
+#include <iterator>
+#include <set>
+#include <vector>
+#include "binary.h"
+#include "buffers.h"
+#include "DateTime.h"
+#include "JobCatalog.h"
+#include "Shift.h"
+#include "types.h"
+
+using namespace Serialization;
+using namespace Binary;
+
+class ShiftListView;
+
+/**
+ * Read-only view of a single encoded Shift, decoding its fields on demand.
+ * Only valid while the ShiftListView it was taken from is alive.
+ */
+class ShiftView {
+	friend class ShiftListView;
+protected:
+	const byte_t* _data;
+	size_t _length;
+	WireFormat _format;
+	job_id_t _jobId;
+
+	/* The fields are decoded in the order of Shift::fields() */
+	BinaryReader open() const {
+		BinaryReader reader(_data, _length);
+		reader.setFormat(_format);
+		// the type tag was checked when the list was scanned
+		reader.advance(sizeof(Type));
+		return reader;
+	}
+
+	ShiftView(const byte_t* data, size_t length, WireFormat format, job_id_t jobId)
+		: _data(data), _length(length), _format(format), _jobId(jobId) { }
+
+public:
+	/**
+	 * Marks job ids that are only resolved when requested, in the fixed format
+	 */
+	static constexpr job_id_t UNRESOLVED_JOB = ~static_cast<job_id_t>(0);
+
+	/**
+	 * Gets the id of the Shift
+	 *
+	 * @return identity_t
+	 */
+	identity_t getId() const {
+		auto reader = open();
+		return read_id(reader);
+	}
+	/**
+	 * Gets the start time of the Shift
+	 *
+	 * @return DateTime
+	 */
+	DateTime getStartTime() const {
+		auto reader = open();
+		read_id(reader);
+		DateTime startTime;
+		startTime.deserialize(reader);
+		return startTime;
+	}
+	/**
+	 * Gets the duration (in hours), not yet validated against the start time
+	 *
+	 * @return uint8_t hours
+	 */
+	uint8_t getWorkHours() const {
+		auto reader = open();
+		read_id(reader);
+		DateTime().deserialize(reader);
+		return read_primitive<uint8_t>(reader);
+	}
+	/**
+	 * Gets the associated worker id
+	 *
+	 * @return identity_t
+	 */
+	identity_t getWorkerId() const {
+		auto reader = open();
+		read_id(reader);
+		DateTime().deserialize(reader);
+		reader.advance(sizeof(uint8_t));
+		return read_id(reader);
+	}
+	/**
+	 * Gets the id of the job in the JobCatalog
+	 *
+	 * @return job_id_t
+	 */
+	job_id_t getJobId() const {
+		if (_jobId != UNRESOLVED_JOB)
+			return _jobId;
+		auto reader = open();
+		read_id(reader);
+		DateTime().deserialize(reader);
+		reader.advance(sizeof(uint8_t));
+		read_id(reader);
+		return JobCatalog::getInstance().intern(read_text(reader));
+	}
+	/**
+	 * Decodes all fields into a new Shift, validating them as Shift::deserialize does
+	 *
+	 * @return Shift
+	 */
+	Shift toShift() const {
+		auto reader = open();
+		Shift shift;
+		shift.setId(read_id(reader));
+		DateTime startTime;
+		startTime.deserialize(reader);
+		shift.setStartTime(startTime);
+		shift.setWorkHours(read_primitive<uint8_t>(reader));
+		shift.setWorkerId(read_id(reader));
+		shift.setJobId(getJobId());
+		return shift;
+	}
+
+	friend bool operator==(const ShiftView& lhs, const Shift& rhs) {
+		auto reader = lhs.open();
+		if (read_id(reader) != rhs.getId())
+			return false;
+		DateTime startTime;
+		startTime.deserialize(reader);
+		return startTime == rhs.getStartTime()
+			&& read_primitive<uint8_t>(reader) == rhs.getWorkHours()
+			&& read_id(reader) == rhs.getWorkerId()
+			&& lhs.getJobId() == rhs.getJobId();
+	}
+
+	friend bool operator!=(const ShiftView& lhs, const Shift& rhs) {
+		return !(lhs == rhs);
+	}
+};
+
+/**
+ * Read-only list of encoded Shifts, as written by Fields::ObjectSet<Shift>.
+ * Keeps a single copy of the encoded bytes and decodes each Shift on demand,
+ * so receivers that only need a few fields never build the Shift objects.
+ */
+class ShiftListView {
+protected:
+	/**
+	 * Position of a Shift in the encoded bytes
+	 */
+	struct Entry {
+		uint32_t offset;
+		uint32_t length;
+		job_id_t jobId;
+	};
+	std::vector<byte_t> _data;
+	std::vector<Entry> _entries;
+	WireFormat _format = WireFormat::Fixed;
+
+public:
+	/**
+	 * Read-only iterator over the views of the list
+	 */
+	class const_iterator {
+		const ShiftListView* _list;
+		size_t _index;
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = ShiftView;
+		using difference_type = std::ptrdiff_t;
+		using pointer = void;
+		using reference = ShiftView;
+
+		const_iterator(const ShiftListView* list, size_t index) : _list(list), _index(index) { }
+
+		ShiftView operator*() const {
+			return (*_list)[_index];
+		}
+		const_iterator& operator++() {
+			_index++;
+			return *this;
+		}
+		const_iterator operator++(int) {
+			auto copy = *this;
+			_index++;
+			return copy;
+		}
+		friend bool operator==(const const_iterator& lhs, const const_iterator& rhs) {
+			return lhs._list == rhs._list && lhs._index == rhs._index;
+		}
+		friend bool operator!=(const const_iterator& lhs, const const_iterator& rhs) {
+			return !(lhs == rhs);
+		}
+	};
+
+	ShiftListView() = default;
+	/**
+	 * Scans an encoded set of Shifts, leaving the source right behind it.
+	 * Only the framing is checked here; the field values are validated when decoded.
+	 *
+	 * @param source source buffer, positioned at the length of the set
+	 */
+	explicit ShiftListView(BinaryReader& source) {
+		_format = source.getFormat();
+		// every shift takes at least its type tag
+		const auto count = read_count(source);
+		const auto start = source.getPosition();
+		_entries.reserve(count);
+		DateTime startTime;
+		for (size_t i = 0; i < count; i++) {
+			const auto offset = source.getPosition();
+			if (static_cast<Type>(source.peek()) != Shift::TYPE)
+				throw std::runtime_error("incompatible object type #" + std::to_string(source.peek()));
+			source.advance(sizeof(Type));
+			read_id(source);
+			startTime.deserialize(source);
+			source.advance(sizeof(uint8_t));
+			read_id(source);
+			auto jobId = ShiftView::UNRESOLVED_JOB;
+			if (_format == WireFormat::Compact) {
+				// later shifts may refer to names defined here, so symbols are resolved while scanning
+				jobId = read_symbol(source, [](const std::string& name) {
+					return JobCatalog::getInstance().intern(name);
+				});
+			}
+			else {
+				source.advance(read_string_length(source, sizeof(wchar_t)) * sizeof(wchar_t));
+			}
+			_entries.push_back({
+				static_cast<uint32_t>(offset - start), static_cast<uint32_t>(source.getPosition() - offset), jobId
+			});
+		}
+		const auto* begin = source.data() + start;
+		_data.assign(begin, begin + (source.getPosition() - start));
+	}
+	/**
+	 * Gets the number of Shifts in the list
+	 *
+	 * @return size_t
+	 */
+	size_t size() const {
+		return _entries.size();
+	}
+	/**
+	 * @return whether the list has no Shifts
+	 */
+	bool empty() const {
+		return _entries.empty();
+	}
+	/**
+	 * Gets the view of the Shift at the given index, in wire (ascending) order
+	 *
+	 * @param index 0-indexed position
+	 * @return ShiftView
+	 */
+	ShiftView operator[](size_t index) const {
+		const auto& entry = _entries[index];
+		return ShiftView(_data.data() + entry.offset, entry.length, _format, entry.jobId);
+	}
+
+	const_iterator begin() const {
+		return const_iterator(this, 0);
+	}
+
+	const_iterator end() const {
+		return const_iterator(this, _entries.size());
+	}
+	/**
+	 * Decodes all Shifts of the list
+	 *
+	 * @return std::set<Shift>
+	 */
+	std::set<Shift> toSet() const {
+		std::set<Shift> shifts;
+		for (const auto& view : *this)
+			shifts.insert(shifts.end(), view.toShift());
+		return shifts;
+	}
+};
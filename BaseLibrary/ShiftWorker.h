@@ -2,6 +2,7 @@
 #include "Serializable.h"
 #include "serialization.h"
 #include "binary.h"
+#include "fields.h"
 #include "types.h"
 #include <stdexcept>
 #include <utility>
@@ -15,9 +16,10 @@ using namespace Binary;
 class ShiftWorker : public Serializable {
 protected:
 	identity_t _id;
-	std::wstring _firstName;
-	std::wstring _lastName;
-	std::wstring _title;
+	/* Names are stored as UTF-8 */
+	std::string _firstName;
+	std::string _lastName;
+	std::string _title;
 
 
 public:
@@ -43,7 +45,7 @@ public:
 	 * @return std::wstring 
 	 */
 	virtual std::wstring getFirstName() const {
-		return _firstName;
+		return Utf8::toWide(_firstName);
 	}
 	/**
 	 * Sets the first name
@@ -51,7 +53,7 @@ public:
 	 * @param firstName 
 	 */
 	virtual void setFirstName(const std::wstring& firstName) {
-		_firstName = firstName;
+		_firstName = Utf8::fromWide(firstName);
 	}
 	/**
 	 * Gets the last name
@@ -59,7 +61,7 @@ public:
 	 * @return std::wstring 
 	 */
 	virtual std::wstring getLastName() const {
-		return _lastName;
+		return Utf8::toWide(_lastName);
 	}
 	/**
 	 * Sets the last name
@@ -67,7 +69,7 @@ public:
 	 * @param lastName 
 	 */
 	virtual void setLastName(const std::wstring& lastName) {
-		_lastName = lastName;
+		_lastName = Utf8::fromWide(lastName);
 	}
 	/**
 	 * Gets the title of this worker
@@ -75,7 +77,7 @@ public:
 	 * @return std::wstring 
 	 */
 	virtual std::wstring getTitle() const {
-		return _title;
+		return Utf8::toWide(_title);
 	}
 	/**
 	 * Sets the title of this worker
@@ -83,11 +85,37 @@ public:
 	 * @param title 
 	 */
 	virtual void setTitle(const std::wstring& title) {
-		_title = title;
+		_title = Utf8::fromWide(title);
+	}
+	/**
+	 * Gets the first name, as stored
+	 * 
+	 * @return const std::string& UTF-8 name
+	 */
+	const std::string& getFirstNameUtf8() const {
+		return _firstName;
+	}
+	/**
+	 * Gets the last name, as stored
+	 * 
+	 * @return const std::string& UTF-8 name
+	 */
+	const std::string& getLastNameUtf8() const {
+		return _lastName;
 	}
+	/**
+	 * Gets the title of this worker, as stored
+	 * 
+	 * @return const std::string& UTF-8 title
+	 */
+	const std::string& getTitleUtf8() const {
+		return _title;
+	}
+
+	static constexpr Type TYPE = Type::_ShiftWorker;
 
 	Type getType() const override {
-		return Type::_ShiftWorker;
+		return TYPE;
 	}
 	/**
 	 * Returns a string representation of this object
@@ -96,34 +124,46 @@ public:
 	 */
 	virtual std::wstring toString() const
 	{
-		return L"[" + std::to_wstring(_id) + L"] " + getFirstName() + L" " + getLastName() + L" (" + getTitle() + L")";
+		return Utf8::toWide("[" + std::to_string(_id) + "] " + _firstName + " " + _lastName + " (" + _title + ")");
 	}
 
-	ShiftWorker() : ShiftWorker(L"", L"", L"") {}
+	ShiftWorker() : ShiftWorker(std::string(), std::string(), std::string()) {}
 
-	ShiftWorker(std::wstring firstName, std::wstring lastName,
-	            std::wstring title, identity_t id = 0)
+	ShiftWorker(std::string firstName, std::string lastName,
+	            std::string title, identity_t id = 0)
 		: _id(id),
 		  _firstName(std::move(firstName)),
 		  _lastName(std::move(lastName)),
 		  _title(std::move(title)) { }
 
-	std::ostream& serialize(std::ostream& destination) const override {
+	ShiftWorker(const std::wstring& firstName, const std::wstring& lastName,
+	            const std::wstring& title, identity_t id = 0)
+		: ShiftWorker(Utf8::fromWide(firstName), Utf8::fromWide(lastName), Utf8::fromWide(title), id) { }
+
+	static auto fields() {
+		return std::make_tuple(
+			Fields::field<Fields::Id>(&ShiftWorker::_id),
+			Fields::field<Fields::Text>(&ShiftWorker::_firstName),
+			Fields::field<Fields::Text>(&ShiftWorker::_lastName),
+			Fields::field<Fields::Text>(&ShiftWorker::_title));
+	}
+
+	using Serializable::serialize;
+	using Serializable::deserialize;
+	using Serializable::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& destination) const override {
 		Serializable::serialize(destination);
-		write_primitive(destination, _id);
-		write_wstring(destination, _firstName);
-		write_wstring(destination, _lastName);
-		write_wstring(destination, _title);
-		return destination;
+		return Fields::write_fields(destination, *this, fields());
 	}
 
-	std::istream& deserialize(std::istream& source) override {
+	BinaryReader& deserialize(BinaryReader& source) override {
 		Serializable::deserialize(source);
-		read_primitive(source, &_id);
-		_firstName = read_wstring(source);
-		_lastName = read_wstring(source);
-		_title = read_wstring(source);
-		return source;
+		return Fields::read_fields(source, *this, fields());
+	}
+
+	size_t serializedSize(SizeContext& context) const override {
+		return Serializable::serializedSize(context) + Fields::fields_size(context, *this, fields());
 	}
 
 
@@ -0,0 +1,224 @@
+#include "SnapshotImage.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "JobCatalog.h"
+#include "ShiftTable.h"
+
+namespace {
+	/**
+	 * Prefix of every image file
+	 */
+	const char IMAGE_MAGIC[4] = { 'R', 'M', 'I', 'M' };
+
+	static_assert(sizeof(SnapshotImage::ShiftRecord) == 32, "Shift records are laid out in 32 bytes");
+	static_assert(sizeof(SnapshotImage::DayRecord) == 16, "Day records are laid out in 16 bytes");
+	static_assert(sizeof(SnapshotImage::IdRecord) == 16, "Id records are laid out in 16 bytes");
+	static_assert(sizeof(SnapshotImage::WorkerRecord) == 32, "Worker records are laid out in 32 bytes");
+	static_assert(sizeof(SnapshotImage::TokenRecord) == 16, "Token records are laid out in 16 bytes");
+
+	/**
+	 * Rounds an offset up to the alignment of the sections
+	 */
+	size_t align(size_t offset) {
+		return (offset + alignof(uint64_t) - 1) / alignof(uint64_t) * alignof(uint64_t);
+	}
+
+	/**
+	 * Gets the day of a shift record
+	 */
+	Date dayOf(const SnapshotImage::ShiftRecord& record) {
+		return ShiftTable::unpackDay(static_cast<uint32_t>(record.start >> 17));
+	}
+}
+
+std::shared_ptr<const SnapshotImage> SnapshotImage::open(const std::string& path) {
+	auto image = std::make_shared<SnapshotImage>();
+	if (!image->_file.open(path))
+		return nullptr;
+	if (image->_file.size() < sizeof(Header))
+		throw std::runtime_error("Invalid snapshot image");
+	const auto* header = reinterpret_cast<const Header*>(image->_file.data());
+	if (std::memcmp(header->magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0)
+		throw std::runtime_error("Invalid snapshot image");
+	if (header->version != VERSION)
+		throw std::runtime_error("Unsupported version of the snapshot image");
+	if (header->size != image->_file.size())
+		throw std::runtime_error("Snapshot image was not written completely");
+	image->_header = header;
+	image->_shifts = image->section<ShiftRecord>(header->shifts, header->shiftCount);
+	image->_days = image->section<DayRecord>(header->days, header->dayCount);
+	image->_ids = image->section<IdRecord>(header->ids, header->shiftCount);
+	image->section<WorkerRecord>(header->workers, header->workerCount);
+	image->section<TokenRecord>(header->tokens, header->tokenCount);
+	image->section<char>(header->heap, header->heapSize);
+	// the shifts refer to the jobs by index, only the few jobs are read up front
+	const auto* jobs = image->section<StringRecord>(header->jobs, header->jobCount);
+	image->_jobIds.reserve(static_cast<size_t>(header->jobCount));
+	for (size_t i = 0; i < header->jobCount; i++)
+		image->_jobIds.push_back(JobCatalog::getInstance().intern(image->readString(jobs[i])));
+	return image;
+}
+
+std::vector<byte_t> SnapshotImage::build(const ManagerSnapshot& snapshot, uint64_t generation) {
+	Header header{};
+	std::memcpy(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+	header.version = VERSION;
+	header.generation = generation;
+	header.logSegment = snapshot.getLogSegment();
+	header.shiftCount = snapshot.size();
+	header.dayCount = snapshot.getDays().size();
+	header.shifts = align(sizeof(Header));
+	header.days = align(header.shifts + header.shiftCount * sizeof(ShiftRecord));
+	header.ids = align(header.days + header.dayCount * sizeof(DayRecord));
+	// the large sections are written in place, the small ones are appended after them
+	std::vector<byte_t> data(static_cast<size_t>(align(header.ids + header.shiftCount * sizeof(IdRecord))));
+	auto* shifts = reinterpret_cast<ShiftRecord*>(data.data() + header.shifts);
+	auto* days = reinterpret_cast<DayRecord*>(data.data() + header.days);
+	auto* ids = reinterpret_cast<IdRecord*>(data.data() + header.ids);
+
+	std::string heap;
+	const auto addString = [&heap](const std::string& text) {
+		const StringRecord record{ static_cast<uint32_t>(heap.size()), static_cast<uint32_t>(text.size()) };
+		heap += text;
+		return record;
+	};
+	std::vector<StringRecord> jobs;
+	std::map<job_id_t, uint32_t> jobIndexes;
+	uint64_t index = 0;
+	for (const auto& day : snapshot.getDays()) {
+		*days++ = DayRecord{ ShiftTable::packDay(day.first), static_cast<uint32_t>(day.second->size()), index };
+		for (const auto& shift : *day.second) {
+			auto job = jobIndexes.find(shift.getJobId());
+			if (job == jobIndexes.end()) {
+				job = jobIndexes.emplace(shift.getJobId(), static_cast<uint32_t>(jobs.size())).first;
+				jobs.push_back(addString(shift.getJobNameUtf8()));
+			}
+			auto& record = shifts[index];
+			record.id = shift.getId();
+			record.workerId = shift.getWorkerId();
+			record.start = ShiftTable::packTime(shift.getStartTime());
+			record.job = job->second;
+			record.workHours = shift.getWorkHours();
+			ids[index] = IdRecord{ shift.getId(), index };
+			header.lastShiftId = std::max(header.lastShiftId, shift.getId());
+			index++;
+		}
+	}
+	std::sort(ids, ids + header.shiftCount, [](const IdRecord& lhs, const IdRecord& rhs) {
+		return lhs.id < rhs.id;
+	});
+
+	std::vector<WorkerRecord> workers;
+	for (const auto& kv : snapshot.getWorkers()) {
+		workers.push_back(WorkerRecord{ kv.first, addString(kv.second.getFirstNameUtf8()),
+		                                addString(kv.second.getLastNameUtf8()), addString(kv.second.getTitleUtf8()) });
+	}
+	std::vector<TokenRecord> tokens;
+	for (const auto& kv : snapshot.getAccessTokens())
+		tokens.push_back(TokenRecord{ addString(kv.first), static_cast<uint32_t>(kv.second), 0 });
+
+	const auto append = [&data](const void* records, size_t size) {
+		data.resize(align(data.size()));
+		const auto offset = data.size();
+		data.insert(data.end(), static_cast<const byte_t*>(records), static_cast<const byte_t*>(records) + size);
+		return offset;
+	};
+	header.jobs = append(jobs.data(), jobs.size() * sizeof(StringRecord));
+	header.jobCount = jobs.size();
+	header.workers = append(workers.data(), workers.size() * sizeof(WorkerRecord));
+	header.workerCount = workers.size();
+	header.tokens = append(tokens.data(), tokens.size() * sizeof(TokenRecord));
+	header.tokenCount = tokens.size();
+	header.heap = append(heap.data(), heap.size());
+	header.heapSize = heap.size();
+	header.size = data.size();
+	std::memcpy(data.data(), &header, sizeof(header));
+	return data;
+}
+
+std::string SnapshotImage::readString(const StringRecord& record) const {
+	if (record.offset > _header->heapSize || record.length > _header->heapSize - record.offset)
+		throw std::runtime_error("Invalid snapshot image");
+	return std::string(reinterpret_cast<const char*>(_file.data() + _header->heap + record.offset), record.length);
+}
+
+const SnapshotImage::DayRecord* SnapshotImage::findDay(const Date& day) const {
+	const auto packed = ShiftTable::packDay(day);
+	const auto* end = _days + _header->dayCount;
+	const auto* it = std::lower_bound(_days, end, packed, [](const DayRecord& record, uint32_t value) {
+		return record.day < value;
+	});
+	return it != end && it->day == packed ? it : nullptr;
+}
+
+SnapshotImage::DayShifts SnapshotImage::readDay(const DayRecord& record) const {
+	if (record.first > _header->shiftCount || record.count > _header->shiftCount - record.first)
+		throw std::runtime_error("Invalid snapshot image");
+	DayShifts shifts;
+	shifts.reserve(record.count);
+	for (const auto* shift = _shifts + record.first; shift != _shifts + record.first + record.count; ++shift) {
+		if (shift->job >= _jobIds.size())
+			throw std::runtime_error("Invalid snapshot image");
+		shifts.emplace_back(ShiftTable::unpackTime(shift->start), shift->workHours, _jobIds[shift->job],
+		                    shift->workerId, shift->id);
+	}
+	return shifts;
+}
+
+std::vector<Date> SnapshotImage::getDays() const {
+	std::vector<Date> days;
+	days.reserve(static_cast<size_t>(_header->dayCount));
+	for (size_t i = 0; i < _header->dayCount; i++)
+		days.push_back(ShiftTable::unpackDay(_days[i].day));
+	return days;
+}
+
+SnapshotImage::DayShifts SnapshotImage::getDay(const Date& day) const {
+	const auto* record = findDay(day);
+	return record ? readDay(*record) : DayShifts();
+}
+
+bool SnapshotImage::findShift(identity_t shiftId, Date& day) const {
+	const auto* end = _ids + _header->shiftCount;
+	const auto* it = std::lower_bound(_ids, end, shiftId, [](const IdRecord& record, identity_t id) {
+		return record.id < id;
+	});
+	if (it == end || it->id != shiftId || it->shift >= _header->shiftCount)
+		return false;
+	day = dayOf(_shifts[it->shift]);
+	return true;
+}
+
+const std::vector<std::pair<Date, identity_t>>& SnapshotImage::getWorkerShifts(identity_t workerId) const {
+	static const std::vector<std::pair<Date, identity_t>> empty;
+	std::call_once(_workerIndexOnce, [this] {
+		// the shifts are ordered by day, so every list comes out ordered as well
+		for (size_t i = 0; i < _header->shiftCount; i++) {
+			if (_shifts[i].workerId)
+				_workerIndex[_shifts[i].workerId].emplace_back(dayOf(_shifts[i]), _shifts[i].id);
+		}
+	});
+	auto it = _workerIndex.find(workerId);
+	return it != _workerIndex.end() ? it->second : empty;
+}
+
+std::map<identity_t, ShiftWorker> SnapshotImage::getWorkers() const {
+	std::map<identity_t, ShiftWorker> workers;
+	const auto* records = section<WorkerRecord>(_header->workers, _header->workerCount);
+	for (size_t i = 0; i < _header->workerCount; i++) {
+		const auto& record = records[i];
+		workers.emplace_hint(workers.end(), record.id, ShiftWorker(readString(record.firstName),
+		                     readString(record.lastName), readString(record.title), record.id));
+	}
+	return workers;
+}
+
+std::map<std::string, UserPermissions> SnapshotImage::getAccessTokens() const {
+	std::map<std::string, UserPermissions> tokens;
+	const auto* records = section<TokenRecord>(_header->tokens, _header->tokenCount);
+	for (size_t i = 0; i < _header->tokenCount; i++)
+		tokens[readString(records[i].token)] = static_cast<UserPermissions>(records[i].permissions);
+	return tokens;
+}
@@ -0,0 +1,219 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Date.h"
+#include "ManagerSnapshot.h"
+#include "MappedFile.h"
+#include "Shift.h"
+#include "ShiftWorker.h"
+#include "types.h"
+#include "UserPermissions.h"
+
+/**
+ * Snapshot of a RestaurantManager laid out to be served straight from a memory mapping.
+ * Every section starts at a multiple of 8 bytes and holds fixed-size records, so opening an image only checks
+ * its header, whatever the number of shifts. The shifts are ordered by day and then by id, with a table of the
+ * days pointing into them and a table of the ids sorted for lookups. Text lives in a heap of UTF-8 strings.
+ * Numbers are stored in the byte order of the machine, images are not meant to be moved between platforms.
+ */
+class SnapshotImage {
+public:
+	/**
+	 * Version of the layout, bumped on every incompatible change
+	 */
+	static constexpr uint32_t VERSION = 1;
+	typedef std::vector<Shift> DayShifts;
+
+	/**
+	 * String in the heap
+	 */
+	struct StringRecord {
+		uint32_t offset;
+		uint32_t length;
+	};
+	struct Header {
+		char magic[4];
+		uint32_t version;
+		/* size of the whole file, a shorter one was not written completely */
+		uint64_t size;
+		/* checkpoint that wrote the image, the newest image is loaded */
+		uint64_t generation;
+		/* first segment of the write-ahead log not held by the image */
+		uint64_t logSegment;
+		uint64_t lastShiftId;
+		/* offsets of the sections from the start of the file, and their number of records */
+		uint64_t shifts, shiftCount;
+		uint64_t days, dayCount;
+		uint64_t ids;
+		uint64_t jobs, jobCount;
+		uint64_t workers, workerCount;
+		uint64_t tokens, tokenCount;
+		uint64_t heap, heapSize;
+	};
+	struct ShiftRecord {
+		uint64_t id;
+		uint64_t workerId;
+		/* packed by ShiftTable::packTime */
+		uint64_t start;
+		/* index in the table of jobs */
+		uint32_t job;
+		uint8_t workHours;
+		uint8_t reserved[3];
+	};
+	struct DayRecord {
+		/* packed by ShiftTable::packDay */
+		uint32_t day;
+		uint32_t count;
+		/* index of the first shift of the day */
+		uint64_t first;
+	};
+	struct IdRecord {
+		uint64_t id;
+		/* index of the shift */
+		uint64_t shift;
+	};
+	struct WorkerRecord {
+		uint64_t id;
+		StringRecord firstName, lastName, title;
+	};
+	struct TokenRecord {
+		StringRecord token;
+		uint32_t permissions;
+		uint32_t reserved;
+	};
+
+protected:
+	MappedFile _file;
+	const Header* _header = nullptr;
+	const ShiftRecord* _shifts = nullptr;
+	const DayRecord* _days = nullptr;
+	const IdRecord* _ids = nullptr;
+	/* ids of the jobs of the image in the JobCatalog of this process */
+	std::vector<job_id_t> _jobIds;
+	mutable std::once_flag _workerIndexOnce;
+	/* worker id -> (day, shift id) of the shifts assigned to the worker, ordered by day, built on first use */
+	mutable std::map<identity_t, std::vector<std::pair<Date, identity_t>>> _workerIndex;
+
+	/**
+	 * Gets a string of the heap
+	 *
+	 * @param record place of the string
+	 * @return std::string
+	 */
+	std::string readString(const StringRecord& record) const;
+	/**
+	 * Gets the records of a section, after checking that they are inside the file
+	 *
+	 * @tparam T type of the records
+	 * @param offset offset of the section
+	 * @param count number of records
+	 * @return const T* first record
+	 */
+	template <typename T>
+	const T* section(uint64_t offset, uint64_t count) const {
+		if (offset % alignof(uint64_t) != 0 || offset > _file.size() || count > (_file.size() - offset) / sizeof(T))
+			throw std::runtime_error("Invalid snapshot image");
+		return reinterpret_cast<const T*>(_file.data() + offset);
+	}
+	/**
+	 * Finds the record of a day
+	 *
+	 * @param day searched day
+	 * @return const DayRecord* nullptr if the image has no shifts on that day
+	 */
+	const DayRecord* findDay(const Date& day) const;
+	/**
+	 * Decodes the shifts of a day
+	 *
+	 * @param record record of the day
+	 * @return DayShifts shifts ordered by id
+	 */
+	DayShifts readDay(const DayRecord& record) const;
+
+public:
+	SnapshotImage() = default;
+	SnapshotImage(const SnapshotImage& other) = delete;
+	SnapshotImage& operator=(const SnapshotImage& other) = delete;
+
+	/**
+	 * Maps an image file
+	 *
+	 * @param path path of the image
+	 * @return std::shared_ptr<const SnapshotImage> nullptr if there is no such file
+	 */
+	static std::shared_ptr<const SnapshotImage> open(const std::string& path);
+	/**
+	 * Lays out a snapshot as an image
+	 *
+	 * @param snapshot saved snapshot
+	 * @param generation checkpoint that writes the image
+	 * @return std::vector<byte_t> contents of the image file
+	 */
+	static std::vector<byte_t> build(const ManagerSnapshot& snapshot, uint64_t generation);
+
+	/**
+	 * @return uint64_t checkpoint that wrote the image
+	 */
+	uint64_t getGeneration() const {
+		return _header->generation;
+	}
+	/**
+	 * @return uint64_t first segment of the write-ahead log not held by the image
+	 */
+	uint64_t getLogSegment() const {
+		return _header->logSegment;
+	}
+	/**
+	 * @return identity_t highest id of the shifts of the image
+	 */
+	identity_t getLastShiftId() const {
+		return _header->lastShiftId;
+	}
+	/**
+	 * @return size_t number of shifts
+	 */
+	size_t size() const {
+		return static_cast<size_t>(_header->shiftCount);
+	}
+	/**
+	 * @return std::vector<Date> days with shifts, in order
+	 */
+	std::vector<Date> getDays() const;
+	/**
+	 * Decodes the shifts of a day straight from the mapping
+	 *
+	 * @param day day of the shifts
+	 * @return DayShifts shifts ordered by id
+	 */
+	DayShifts getDay(const Date& day) const;
+	/**
+	 * Looks up the day of a shift in the table of ids
+	 *
+	 * @param shiftId id of the Shift
+	 * @param day receives the day
+	 * @return whether the image holds the shift
+	 */
+	bool findShift(identity_t shiftId, Date& day) const;
+	/**
+	 * Gets the shifts assigned to a worker. The index is built from all the shifts on the first call
+	 *
+	 * @param workerId id of the ShiftWorker
+	 * @return const std::vector<std::pair<Date, identity_t>>& (day, shift id) ordered by day
+	 */
+	const std::vector<std::pair<Date, identity_t>>& getWorkerShifts(identity_t workerId) const;
+	/**
+	 * @return std::map<identity_t, ShiftWorker> workers
+	 */
+	std::map<identity_t, ShiftWorker> getWorkers() const;
+	/**
+	 * @return std::map<std::string, UserPermissions> access tokens
+	 */
+	std::map<std::string, UserPermissions> getAccessTokens() const;
+};
@@ -0,0 +1,78 @@
+#pragma once
+#include <utility>
+
+
+#include "Serializable.h"
+#include "serialization.h"
+#include "binary.h"
+#include "fields.h"
+#include "TransactionReply.h"
+using namespace Serialization;
+using namespace Binary;
+/**
+ * Base-class for replies that may be sent in several parts, each carrying a share of the results.
+ * All parts of a reply have the same request id; every part but the last one is flagged as continued.
+ *
+ */
+class StreamedReply : public TransactionReply {
+protected:
+	bool _continued = false;
+public:
+	static constexpr Type TYPE = Type::_StreamedReply;
+
+	StreamedReply() : StreamedReply(0) {}
+	/**
+	 * Construct a new successful StreamedReply object
+	 *
+	 * @param requestId request id
+	 */
+	StreamedReply(int requestId) : TransactionReply(requestId) {}
+
+	/**
+	 *
+	 * @return Whether more parts of this reply follow
+	 */
+	bool isContinued() const {
+		return _continued;
+	}
+	/**
+	 * Sets whether more parts of this reply follow
+	 *
+	 * @param continued whether more parts follow
+	 */
+	void setContinued(bool continued) {
+		_continued = continued;
+	}
+
+	static auto fields() {
+		return std::make_tuple(
+			Fields::field<Fields::Bool>(&StreamedReply::_continued));
+	}
+
+	using TransactionReply::serialize;
+	using TransactionReply::deserialize;
+	using TransactionReply::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& destination) const override {
+		TransactionReply::serialize(destination);
+		return Fields::write_fields(destination, *this, fields());
+	}
+
+	BinaryReader& deserialize(BinaryReader& source) override {
+		TransactionReply::deserialize(source);
+		return Fields::read_fields(source, *this, fields());
+	}
+
+	size_t serializedSize(SizeContext& context) const override {
+		return TransactionReply::serializedSize(context) + Fields::fields_size(context, *this, fields());
+	}
+
+	friend bool operator==(const StreamedReply& lhs, const StreamedReply& rhs) {
+		return std::tie(static_cast<const TransactionReply&>(lhs), lhs._continued) == std::tie(
+			static_cast<const TransactionReply&>(rhs), rhs._continued);
+	}
+
+	friend bool operator!=(const StreamedReply& lhs, const StreamedReply& rhs) {
+		return !(lhs == rhs);
+	}
+};
@@ -0,0 +1,230 @@
+#pragma once
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "Date.h"
+#include "DaySubscriptions.h"
+#include "S2C_ClientSync.h"
+#include "Shift.h"
+#include "ShiftWorker.h"
+
+/**
+ * Changes made since the last S2C_ClientSync was sent, merged by object id.
+ * An object inserted and removed before the changes are sent is left out entirely,
+ * and an object changed several times is sent only in its latest state.
+ * A shift moved to another day is removed from the clients viewing only its old day, and changed for the others.
+ */
+class SyncBatch {
+protected:
+	std::map<identity_t, Shift> _changedShifts;
+	/* removed shift id -> days the clients may have it in */
+	std::map<identity_t, std::set<Date>> _removedShifts;
+	/* shifts inserted since the last sync, unknown to all clients */
+	std::set<identity_t> _insertedShifts;
+	std::map<identity_t, ShiftWorker> _changedWorkers;
+	std::set<identity_t> _removedWorkers;
+	std::set<identity_t> _insertedWorkers;
+	/* upper bound of the encoded size of the changes */
+	size_t _size = 0;
+
+	/**
+	 * Adds the removed workers to a packet, leaving out those changed again, as a change replaces the object
+	 * 
+	 * @param sync receiving packet
+	 */
+	void fillRemovedWorkers(S2C_ClientSync& sync) const {
+		for (auto id : _removedWorkers) {
+			if (_changedWorkers.find(id) == _changedWorkers.end())
+				sync.getRemovedWorkers().insert(id);
+		}
+	}
+	/**
+	 * Checks whether a packet gets the change of a shift, which replaces its removal
+	 * 
+	 * @param shiftId id of the Shift
+	 * @param viewed filter of the days of the packet
+	 * @return whether the shift is changed on a day of the packet
+	 */
+	template <typename TViewed>
+	bool sendsChange(identity_t shiftId, const TViewed& viewed) const {
+		auto changed = _changedShifts.find(shiftId);
+		return changed != _changedShifts.end() && viewed(changed->second.getStartTime());
+	}
+
+public:
+	/**
+	 * Adds an inserted or modified Shift
+	 * 
+	 * @param shift new state of the object
+	 * @param inserted whether the object did not exist before
+	 */
+	void changeShift(const Shift& shift, bool inserted) {
+		const auto id = shift.getId();
+		if (inserted && _removedShifts.find(id) == _removedShifts.end())
+			_insertedShifts.insert(id);
+		_changedShifts[id] = shift;
+		_size += shift.serializedSize();
+	}
+	/**
+	 * Adds a removed Shift
+	 * 
+	 * @param shiftId id of the object
+	 * @param day day the object was in
+	 */
+	void removeShift(identity_t shiftId, const Date& day) {
+		_changedShifts.erase(shiftId);
+		// the clients never heard of it
+		if (_insertedShifts.erase(shiftId))
+			return;
+		_removedShifts[shiftId].insert(day);
+		_size += sizeof(identity_t);
+	}
+	/**
+	 * Adds an inserted or modified ShiftWorker
+	 * 
+	 * @param worker new state of the object
+	 * @param inserted whether the object did not exist before
+	 */
+	void changeWorker(const ShiftWorker& worker, bool inserted) {
+		const auto id = worker.getId();
+		if (inserted && _removedWorkers.find(id) == _removedWorkers.end())
+			_insertedWorkers.insert(id);
+		_changedWorkers[id] = worker;
+		_size += worker.serializedSize();
+	}
+	/**
+	 * Adds a removed ShiftWorker
+	 * 
+	 * @param workerId id of the object
+	 */
+	void removeWorker(identity_t workerId) {
+		_changedWorkers.erase(workerId);
+		if (_insertedWorkers.erase(workerId))
+			return;
+		_removedWorkers.insert(workerId);
+		_size += sizeof(identity_t);
+	}
+	/**
+	 * @return whether there are no changes to be sent
+	 */
+	bool empty() const {
+		return _changedShifts.empty() && _removedShifts.empty() && _changedWorkers.empty() && _removedWorkers.empty();
+	}
+	/**
+	 * @return size_t upper bound of the encoded size of the changes
+	 */
+	size_t size() const {
+		return _size;
+	}
+	/**
+	 * Discards all changes
+	 */
+	void clear() {
+		_changedShifts.clear();
+		_removedShifts.clear();
+		_insertedShifts.clear();
+		_changedWorkers.clear();
+		_removedWorkers.clear();
+		_insertedWorkers.clear();
+		_size = 0;
+	}
+	/**
+	 * Adds the changes to a S2C_ClientSync packet
+	 * 
+	 * @param sync receives all changes of workers and the changes of the days accepted by the filter
+	 * @param viewed filter of days
+	 */
+	void fill(S2C_ClientSync& sync, const std::function<bool(const Date&)>& viewed) const {
+		fillRemovedWorkers(sync);
+		for (const auto& kv : _changedWorkers)
+			sync.getChangedWorkers().insert(kv.second);
+		for (const auto& kv : _changedShifts) {
+			if (viewed(kv.second.getStartTime()))
+				sync.getChangedShifts().insert(kv.second);
+		}
+		for (const auto& kv : _removedShifts) {
+			if (sendsChange(kv.first, viewed))
+				continue;
+			for (const auto& day : kv.second) {
+				if (viewed(day)) {
+					sync.getRemovedShifts().insert(kv.first);
+					break;
+				}
+			}
+		}
+	}
+	/**
+	 * Builds the S2C_ClientSync packets of the changes. Every client gets the changes of the days it views
+	 * and all changes of workers; clients interested in the same changes share a single packet.
+	 * 
+	 * @param subscriptions days viewed by the clients
+	 * @param version version of the database the changes bring the clients to
+	 * @param send called with every packet and the ids of its receivers
+	 */
+	void build(const DaySubscriptions& subscriptions, uint64_t version,
+	           const std::function<void(std::shared_ptr<const S2C_ClientSync>, std::vector<int>)>& send) const {
+		if (empty())
+			return;
+		std::map<Date, std::vector<const Shift*>> changedByDay;
+		for (const auto& kv : _changedShifts)
+			changedByDay[kv.second.getStartTime()].push_back(&kv.second);
+		std::map<Date, std::vector<identity_t>> removedByDay;
+		for (const auto& kv : _removedShifts) {
+			for (const auto& day : kv.second)
+				removedByDay[day].push_back(kv.first);
+		}
+		std::set<Date> days;
+		for (const auto& kv : changedByDay)
+			days.insert(kv.first);
+		for (const auto& kv : removedByDay)
+			days.insert(kv.first);
+
+		// client id -> changed days it views
+		std::map<int, std::set<Date>> interests;
+		std::vector<int> clients;
+		for (const auto& day : days) {
+			clients.clear();
+			subscriptions.collect(day, clients);
+			for (auto client : clients)
+				interests[client].insert(day);
+		}
+		if (!_changedWorkers.empty() || !_removedWorkers.empty()) {
+			clients.clear();
+			subscriptions.collect(clients);
+			for (auto client : clients)
+				interests[client];
+		}
+
+		std::map<std::set<Date>, std::vector<int>> groups;
+		for (const auto& kv : interests)
+			groups[kv.second].push_back(kv.first);
+		for (auto& group : groups) {
+			const auto inGroup = [&group](const Date& day) {
+				return group.first.count(day) != 0;
+			};
+			auto sync = std::make_shared<S2C_ClientSync>();
+			sync->setVersion(version);
+			fillRemovedWorkers(*sync);
+			for (const auto& kv : _changedWorkers)
+				sync->getChangedWorkers().insert(kv.second);
+			for (const auto& day : group.first) {
+				auto changed = changedByDay.find(day);
+				if (changed != changedByDay.end()) {
+					for (const auto* shift : changed->second)
+						sync->getChangedShifts().insert(*shift);
+				}
+				auto removed = removedByDay.find(day);
+				if (removed == removedByDay.end())
+					continue;
+				for (auto id : removed->second) {
+					if (!sendsChange(id, inGroup))
+						sync->getRemovedShifts().insert(id);
+				}
+			}
+			send(std::move(sync), std::move(group.second));
+		}
+	}
+};
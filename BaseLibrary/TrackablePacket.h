@@ -3,6 +3,7 @@
 #include "Serializable.h"
 #include "serialization.h"
 #include "binary.h"
+#include "fields.h"
 using namespace Serialization;
 using namespace Binary;
 /**
@@ -13,6 +14,8 @@ class TrackablePacket : public Serializable {
 protected:
 	int _requestId;
 public:
+	static constexpr Type TYPE = Type::_TrackablePacket;
+
 	/**
 	 * Construct a new Trackable Packet
 	 * 
@@ -40,16 +43,27 @@ public:
 		return _requestId;
 	}
 
-	std::ostream& serialize(std::ostream& destination) const override {
+	static auto fields() {
+		return std::make_tuple(
+			Fields::field<Fields::Uint<int>>(&TrackablePacket::_requestId));
+	}
+
+	using Serializable::serialize;
+	using Serializable::deserialize;
+	using Serializable::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& destination) const override {
 		Serializable::serialize(destination);
-		write_primitive(destination, _requestId);
-		return destination;
+		return Fields::write_fields(destination, *this, fields());
 	}
 
-	std::istream& deserialize(std::istream& source) override {
+	BinaryReader& deserialize(BinaryReader& source) override {
 		Serializable::deserialize(source);
-		read_primitive(source, &_requestId);
-		return source;
+		return Fields::read_fields(source, *this, fields());
+	}
+
+	size_t serializedSize(SizeContext& context) const override {
+		return Serializable::serializedSize(context) + Fields::fields_size(context, *this, fields());
 	}
 
 	friend bool operator==(const TrackablePacket& lhs, const TrackablePacket& rhs) {
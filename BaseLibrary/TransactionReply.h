@@ -5,6 +5,7 @@
 #include "Serializable.h"
 #include "serialization.h"
 #include "binary.h"
+#include "fields.h"
 #include "TrackablePacket.h"
 using namespace Serialization;
 using namespace Binary;
@@ -17,6 +18,8 @@ protected:
 	bool _success;
 	std::string _errorMsg;
 public:
+	static constexpr Type TYPE = Type::_TransactionReply;
+
 	TransactionReply() : TransactionReply(0) {}
 	/**
 	 * Construct a new successful TransactionReply object
@@ -76,18 +79,28 @@ public:
 		_errorMsg = msg;
 	}
 
-	std::ostream& serialize(std::ostream& destination) const override {
+	static auto fields() {
+		return std::make_tuple(
+			Fields::field<Fields::Bool>(&TransactionReply::_success),
+			Fields::field<Fields::String>(&TransactionReply::_errorMsg));
+	}
+
+	using TrackablePacket::serialize;
+	using TrackablePacket::deserialize;
+	using TrackablePacket::serializedSize;
+
+	BinaryWriter& serialize(BinaryWriter& destination) const override {
 		TrackablePacket::serialize(destination);
-		write_primitive(destination, _success);
-		write_string(destination, _errorMsg);
-		return destination;
+		return Fields::write_fields(destination, *this, fields());
 	}
 
-	std::istream& deserialize(std::istream& source) override {
+	BinaryReader& deserialize(BinaryReader& source) override {
 		TrackablePacket::deserialize(source);
-		read_primitive(source, &_success);
-		_errorMsg = read_string(source);
-		return source;
+		return Fields::read_fields(source, *this, fields());
+	}
+
+	size_t serializedSize(SizeContext& context) const override {
+		return TrackablePacket::serializedSize(context) + Fields::fields_size(context, *this, fields());
 	}
 
 	friend bool operator==(const TransactionReply& lhs, const TransactionReply& rhs) {
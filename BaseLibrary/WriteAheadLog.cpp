@@ -0,0 +1,383 @@
+#include "WriteAheadLog.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include "binary.h"
+#include "files.h"
+#include "serialization.h"
+
+using namespace Serialization;
+
+namespace {
+	/**
+	 * Prefix of every log file
+	 */
+	const char LOG_MAGIC[4] = { 'R', 'M', 'W', '1' };
+	/**
+	 * Length and checksum in front of every record
+	 */
+	const size_t RECORD_HEADER_SIZE = 2 * sizeof(uint32_t);
+
+	/**
+	 * Creates a new segment file, starting with the magic
+	 */
+	std::FILE* createSegment(const std::string& path) {
+		auto* file = openFile(path, "wb");
+		if (file && std::fwrite(LOG_MAGIC, 1, sizeof(LOG_MAGIC), file) != sizeof(LOG_MAGIC)) {
+			std::fclose(file);
+			return nullptr;
+		}
+		return file;
+	}
+
+	/**
+	 * FNV-1a hash of a record, enough to tell a torn write apart
+	 */
+	uint32_t checksum(const byte_t* data, size_t length) {
+		uint32_t hash = 2166136261u;
+		for (size_t i = 0; i < length; i++) {
+			hash ^= data[i];
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	WriteAheadLog::Record decodeRecord(const byte_t* data, size_t length) {
+		BinaryReader reader(data, length);
+		reader.setFormat(WireFormat::Compact);
+		WriteAheadLog::Record record{};
+		record.kind = static_cast<WriteAheadLog::Kind>(reader.read<uint8_t>());
+		record.inserted = reader.read<uint8_t>() != 0;
+		switch (record.kind) {
+		case WriteAheadLog::Kind::ChangeShift:
+			record.shift = get_instance<Shift>(reader);
+			record.id = record.shift.getId();
+			break;
+		case WriteAheadLog::Kind::RemoveShift:
+			record.id = read_id(reader);
+			record.day = get_instance<Date>(reader);
+			break;
+		case WriteAheadLog::Kind::ChangeWorker:
+			record.worker = get_instance<ShiftWorker>(reader);
+			record.id = record.worker.getId();
+			break;
+		case WriteAheadLog::Kind::RemoveWorker:
+			record.id = read_id(reader);
+			break;
+		default:
+			throw std::runtime_error("Unknown record of the write-ahead log");
+		}
+		return record;
+	}
+
+	/**
+	 * Reads the records of a segment file, up to the first torn or corrupt one
+	 *
+	 * @param path path of the segment file
+	 * @param apply called with every record
+	 * @param count incremented for every record read
+	 * @return whether the segment exists
+	 */
+	bool readSegment(const std::string& path, const std::function<void(const WriteAheadLog::Record&)>& apply,
+	                 size_t& count) {
+		auto* file = openFile(path, "rb");
+		if (!file)
+			return false;
+		std::vector<byte_t> data;
+		byte_t chunk[BUFFER_SIZE];
+		size_t read;
+		while ((read = std::fread(chunk, 1, sizeof(chunk), file)) > 0)
+			data.insert(data.end(), chunk, chunk + read);
+		std::fclose(file);
+		// created right before a crash
+		if (data.size() < sizeof(LOG_MAGIC))
+			return true;
+		if (std::memcmp(data.data(), LOG_MAGIC, sizeof(LOG_MAGIC)) != 0)
+			throw std::runtime_error("Invalid write-ahead log");
+
+		size_t position = sizeof(LOG_MAGIC);
+		while (data.size() - position >= RECORD_HEADER_SIZE) {
+			uint32_t length, sum;
+			std::memcpy(&length, data.data() + position, sizeof(length));
+			std::memcpy(&sum, data.data() + position + sizeof(length), sizeof(sum));
+			const auto* payload = data.data() + position + RECORD_HEADER_SIZE;
+			if (length > data.size() - position - RECORD_HEADER_SIZE || checksum(payload, length) != sum)
+				break;
+			WriteAheadLog::Record record;
+			try {
+				record = decodeRecord(payload, length);
+			}
+			catch (std::exception&) {
+				break;
+			}
+			apply(record);
+			count++;
+			position += RECORD_HEADER_SIZE + length;
+		}
+		return true;
+	}
+}
+
+WriteAheadLog::~WriteAheadLog() {
+	close();
+}
+
+std::string WriteAheadLog::segmentPath(const std::string& path, uint64_t segment) {
+	return path + "." + std::to_string(segment);
+}
+
+void WriteAheadLog::open(const std::string& path, uint64_t segment) {
+	if (_open)
+		throw std::logic_error("Write-ahead log already open");
+	// a torn record ends its segment, so the new records never follow one
+	auto* file = createSegment(segmentPath(path, segment));
+	if (!file || !syncFile(file)) {
+		if (file)
+			std::fclose(file);
+		throw std::runtime_error("Could not open the write-ahead log");
+	}
+	std::lock_guard<std::mutex> guard(_lock);
+	_file = file;
+	_open = true;
+	_path = path;
+	_segment = _fileSegment = segment;
+	_failed = false;
+	_stopping = false;
+	_thread = std::thread([this] {
+		commitWorker();
+	});
+}
+
+void WriteAheadLog::close() {
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+		if (!_open)
+			return;
+		_open = false;
+		_stopping = true;
+	}
+	_appendedSignal.notify_all();
+	_thread.join();
+	// left closed if a new segment could not be created
+	if (_file)
+		std::fclose(_file);
+	_file = nullptr;
+}
+
+uint64_t WriteAheadLog::rotate() {
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+		if (!_open)
+			return _segment;
+		_rotations.push_back(_pending.size());
+		_segment++;
+	}
+	// the old segment is closed right away, even if nothing is appended to the new one
+	_appendedSignal.notify_all();
+	return _segment;
+}
+
+size_t WriteAheadLog::compact(uint64_t segment) {
+	std::string path;
+	{
+		std::unique_lock<std::mutex> guard(_lock);
+		_durableSignal.wait(guard, [this, segment] {
+			return _fileSegment >= segment || _failed || !_open;
+		});
+		if (_fileSegment < segment)
+			return 0;
+		path = _path;
+	}
+	// the segments on the disk are consecutive, every compaction removes the oldest ones
+	size_t removed = 0;
+	while (segment-- > 0 && std::remove(segmentPath(path, segment).c_str()) == 0)
+		removed++;
+	return removed;
+}
+
+void WriteAheadLog::append(const BinaryWriter& record) {
+	const auto length = static_cast<uint32_t>(record.getPosition());
+	const auto sum = checksum(record.data(), length);
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+		if (!_open)
+			return;
+		const auto* header = reinterpret_cast<const byte_t*>(&length);
+		_pending.insert(_pending.end(), header, header + sizeof(length));
+		header = reinterpret_cast<const byte_t*>(&sum);
+		_pending.insert(_pending.end(), header, header + sizeof(sum));
+		_pending.insert(_pending.end(), record.data(), record.data() + length);
+		_appended++;
+	}
+	_appendedSignal.notify_all();
+}
+
+void WriteAheadLog::changeShift(const Shift& shift, bool inserted) {
+	BinaryWriter record;
+	record.setFormat(WireFormat::Compact);
+	record.write(static_cast<uint8_t>(Kind::ChangeShift));
+	record.write(static_cast<uint8_t>(inserted));
+	shift.serialize(record);
+	append(record);
+}
+
+void WriteAheadLog::removeShift(identity_t shiftId, const Date& day) {
+	BinaryWriter record;
+	record.setFormat(WireFormat::Compact);
+	record.write(static_cast<uint8_t>(Kind::RemoveShift));
+	record.write(static_cast<uint8_t>(false));
+	write_id(record, shiftId);
+	day.serialize(record);
+	append(record);
+}
+
+void WriteAheadLog::changeWorker(const ShiftWorker& worker, bool inserted) {
+	BinaryWriter record;
+	record.setFormat(WireFormat::Compact);
+	record.write(static_cast<uint8_t>(Kind::ChangeWorker));
+	record.write(static_cast<uint8_t>(inserted));
+	worker.serialize(record);
+	append(record);
+}
+
+void WriteAheadLog::removeWorker(identity_t workerId) {
+	BinaryWriter record;
+	record.setFormat(WireFormat::Compact);
+	record.write(static_cast<uint8_t>(Kind::RemoveWorker));
+	record.write(static_cast<uint8_t>(false));
+	write_id(record, workerId);
+	append(record);
+}
+
+void WriteAheadLog::commit() {
+	std::unique_lock<std::mutex> guard(_lock);
+	const auto target = _appended;
+	_durableSignal.wait(guard, [this, target] {
+		return _durable >= target || _failed || !_open;
+	});
+	if (_durable < target)
+		throw std::runtime_error("Change could not be saved");
+}
+
+void WriteAheadLog::commitAsync(std::function<void(bool)> completion) {
+	bool durable;
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+		const auto target = _appended;
+		if (_durable < target && !_failed && _open) {
+			_waiters.emplace_back(target, std::move(completion));
+			return;
+		}
+		durable = _durable >= target;
+	}
+	completion(durable);
+}
+
+bool WriteAheadLog::hasFailed() {
+	std::lock_guard<std::mutex> guard(_lock);
+	return _failed;
+}
+
+void WriteAheadLog::takeWaiters(std::vector<std::pair<bool, std::function<void(bool)>>>& ready) {
+	while (!_waiters.empty() && (_waiters.front().first <= _durable || _failed || !_open)) {
+		ready.emplace_back(_waiters.front().first <= _durable, std::move(_waiters.front().second));
+		_waiters.pop_front();
+	}
+}
+
+std::chrono::microseconds WriteAheadLog::getCommitWindow() {
+	std::lock_guard<std::mutex> guard(_lock);
+	return _commitWindow;
+}
+
+void WriteAheadLog::setCommitWindow(std::chrono::microseconds window) {
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+		_commitWindow = window;
+	}
+	_appendedSignal.notify_all();
+}
+
+uint64_t WriteAheadLog::getSyncCount() {
+	std::lock_guard<std::mutex> guard(_lock);
+	return _syncs;
+}
+
+void WriteAheadLog::commitWorker() {
+	std::unique_lock<std::mutex> guard(_lock);
+	std::vector<byte_t> batch;
+	std::vector<size_t> rotations;
+	std::vector<std::pair<bool, std::function<void(bool)>>> ready;
+	while (true) {
+		_appendedSignal.wait(guard, [this] {
+			return _stopping || !_pending.empty() || !_rotations.empty();
+		});
+		if (_pending.empty() && _rotations.empty())
+			break;
+		// the window starts with its first record, the records appended during it join the batch
+		if (_commitWindow.count() > 0 && !_stopping) {
+			const auto deadline = std::chrono::steady_clock::now() + _commitWindow;
+			_appendedSignal.wait_until(guard, deadline, [this] {
+				return _stopping;
+			});
+		}
+		batch.clear();
+		batch.swap(_pending);
+		rotations.clear();
+		rotations.swap(_rotations);
+		const auto last = _appended;
+		const auto failed = _failed;
+		guard.unlock();
+		const bool ok = !failed && writeBatch(batch, rotations);
+		guard.lock();
+		_fileSegment += rotations.size();
+		if (ok)
+			_durable = last;
+		else
+			_failed = true;
+		_syncs++;
+		_durableSignal.notify_all();
+		// the callbacks may queue replies, which is done without holding the lock
+		ready.clear();
+		takeWaiters(ready);
+		if (!ready.empty()) {
+			guard.unlock();
+			for (auto& waiter : ready)
+				waiter.second(waiter.first);
+			guard.lock();
+		}
+	}
+	// the last batch completed every callback of an open log, those left raced with close
+	ready.clear();
+	takeWaiters(ready);
+	guard.unlock();
+	for (auto& waiter : ready)
+		waiter.second(waiter.first);
+}
+
+bool WriteAheadLog::writeBatch(const std::vector<byte_t>& data, const std::vector<size_t>& rotations) {
+	size_t written = 0;
+	auto segment = _fileSegment;
+	for (auto offset : rotations) {
+		// the records of the old segment are made durable before it is closed
+		if (std::fwrite(data.data() + written, 1, offset - written, _file) != offset - written || !syncFile(_file))
+			return false;
+		std::fclose(_file);
+		_file = createSegment(segmentPath(_path, ++segment));
+		if (!_file)
+			return false;
+		written = offset;
+	}
+	return std::fwrite(data.data() + written, 1, data.size() - written, _file) == data.size() - written &&
+		syncFile(_file);
+}
+
+size_t WriteAheadLog::replay(const std::string& path, uint64_t first, const std::function<void(const Record&)>& apply,
+                             uint64_t& next) {
+	size_t count = 0;
+	next = first;
+	while (readSegment(segmentPath(path, next), apply, count))
+		next++;
+	return count;
+}
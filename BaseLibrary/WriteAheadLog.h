@@ -0,0 +1,216 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Date.h"
+#include "net_constants.h"
+#include "Shift.h"
+#include "ShiftWorker.h"
+
+/**
+ * Append-only log of the changes of the database, written before their replies are sent.
+ * Every change is a length-prefixed, checksummed record in the compact format. The records are collected
+ * for a commit window and written by a background thread with a single sync per batch (group commit),
+ * so concurrent changes share one flush to the disk instead of paying for one each.
+ * The log is split into numbered segment files. A snapshot starts a new segment, and the older segments
+ * are removed once it is saved; replaying the segments after it restores the later changes.
+ * A record torn by a crash ends its segment and is dropped.
+ * A batch that cannot be written fails the log for good, the RestaurantManager then refuses the changes before making them.
+ */
+class WriteAheadLog {
+public:
+	enum class Kind : uint8_t {
+		ChangeShift,
+		RemoveShift,
+		ChangeWorker,
+		RemoveWorker
+	};
+	/**
+	 * Single change read back from the log
+	 */
+	struct Record {
+		Kind kind;
+		bool inserted;
+		identity_t id;
+		Date day;
+		Shift shift;
+		ShiftWorker worker;
+	};
+
+protected:
+	/* written by the background thread only */
+	std::FILE* _file = nullptr;
+	std::string _path;
+	/* guards everything below, never held while writing to the file */
+	std::mutex _lock;
+	std::condition_variable _appendedSignal;
+	std::condition_variable _durableSignal;
+	/* encoded records not written yet */
+	std::vector<byte_t> _pending;
+	/* offsets in the pending records where a new segment starts */
+	std::vector<size_t> _rotations;
+	/* segment the records are appended to, and the one the file is open for */
+	uint64_t _segment = 0;
+	uint64_t _fileSegment = 0;
+	/* number of the last appended record and of the last one synced to the disk */
+	uint64_t _appended = 0;
+	uint64_t _durable = 0;
+	uint64_t _syncs = 0;
+	/* callbacks waiting for a record to be durable, by number of the record, in the order of the numbers */
+	std::deque<std::pair<uint64_t, std::function<void(bool)>>> _waiters;
+	bool _open = false;
+	bool _failed = false;
+	bool _stopping = false;
+	std::chrono::microseconds _commitWindow{std::chrono::milliseconds(WAL_COMMIT_WINDOW)};
+	std::thread _thread;
+
+	/**
+	 * Frames an encoded record and queues it for the next commit
+	 *
+	 * @param record encoded record
+	 */
+	void append(const BinaryWriter& record);
+	/**
+	 * Background task that writes and syncs the queued records once per commit window
+	 */
+	void commitWorker();
+	/**
+	 * Takes the callbacks whose record is durable, or will never be. Must be called with the lock held
+	 *
+	 * @param ready receives the callbacks, with whether their record is durable
+	 */
+	void takeWaiters(std::vector<std::pair<bool, std::function<void(bool)>>>& ready);
+	/**
+	 * Writes a batch of records and syncs the file to the disk
+	 *
+	 * @param data framed records
+	 * @param rotations offsets in the records where a new segment starts
+	 * @return whether the batch is durable
+	 */
+	bool writeBatch(const std::vector<byte_t>& data, const std::vector<size_t>& rotations);
+
+public:
+	WriteAheadLog() = default;
+	~WriteAheadLog();
+
+	WriteAheadLog(const WriteAheadLog& other) = delete;
+	WriteAheadLog& operator=(const WriteAheadLog& other) = delete;
+
+	/**
+	 * Opens a log for appending, starting a new segment. The log must be replayed first,
+	 * so that the new segment follows all the existing ones
+	 *
+	 * @param path path of the log, the segments are stored next to it
+	 * @param segment number of the new segment, as returned by replay
+	 */
+	void open(const std::string& path, uint64_t segment);
+	/**
+	 * Commits the appended records and closes the log
+	 */
+	void close();
+	/**
+	 * @return whether the log is open
+	 */
+	bool isOpen() const {
+		return _open;
+	}
+	/**
+	 * Starts a new segment for the records appended after the call, without waiting for the disk.
+	 * Called when a snapshot is taken, so that the snapshot holds every record of the older segments
+	 *
+	 * @return uint64_t number of the new segment
+	 */
+	uint64_t rotate();
+	/**
+	 * Removes the segments before the given one, once a snapshot holding all of their records was saved
+	 *
+	 * @param segment first segment kept, as returned by rotate
+	 * @return size_t number of removed segments
+	 */
+	size_t compact(uint64_t segment);
+	/**
+	 * Appends an inserted or modified Shift
+	 *
+	 * @param shift new state of the object
+	 * @param inserted whether the object did not exist before
+	 */
+	void changeShift(const Shift& shift, bool inserted);
+	/**
+	 * Appends a removed Shift
+	 *
+	 * @param shiftId id of the object
+	 * @param day day the object was in
+	 */
+	void removeShift(identity_t shiftId, const Date& day);
+	/**
+	 * Appends an inserted or modified ShiftWorker
+	 *
+	 * @param worker new state of the object
+	 * @param inserted whether the object did not exist before
+	 */
+	void changeWorker(const ShiftWorker& worker, bool inserted);
+	/**
+	 * Appends a removed ShiftWorker
+	 *
+	 * @param workerId id of the object
+	 */
+	void removeWorker(identity_t workerId);
+	/**
+	 * Waits until every record appended before the call is durable
+	 */
+	void commit();
+	/**
+	 * Calls back once every record appended before the call is durable, without waiting for it.
+	 * The callback runs on the background thread, or right away if there is nothing to wait for
+	 *
+	 * @param completion called with whether the records are durable
+	 */
+	void commitAsync(std::function<void(bool)> completion);
+	/**
+	 * @return whether a batch could not be written, the records appended from then on are never durable
+	 */
+	bool hasFailed();
+	/**
+	 * Gets the time records are collected for before being synced to the disk
+	 *
+	 * @return std::chrono::microseconds
+	 */
+	std::chrono::microseconds getCommitWindow();
+	/**
+	 * Sets the time records are collected for before being synced to the disk
+	 *
+	 * @param window collecting time, 0 to sync whatever was appended while the previous batch was written
+	 */
+	void setCommitWindow(std::chrono::microseconds window);
+	/**
+	 * @return uint64_t number of batches synced to the disk
+	 */
+	uint64_t getSyncCount();
+	/**
+	 * Gets the path of a segment file
+	 *
+	 * @param path path of the log
+	 * @param segment number of the segment
+	 * @return std::string
+	 */
+	static std::string segmentPath(const std::string& path, uint64_t segment);
+	/**
+	 * Reads the records of the consecutive segments of a log, each up to its first torn or corrupt record
+	 *
+	 * @param path path of the log
+	 * @param first first segment not held by the last snapshot
+	 * @param apply called with every record, in the order they were appended
+	 * @param next receives the number of the segment after the last existing one
+	 * @return size_t number of records read
+	 */
+	static size_t replay(const std::string& path, uint64_t first, const std::function<void(const Record&)>& apply,
+	                     uint64_t& next);
+};
@@ -1,7 +1,11 @@
 #pragma once
+#include <algorithm>
 #include <functional>
 #include <iostream>
+#include <limits>
 #include <set>
+#include "buffers.h"
+#include "utf8.h"
 
 namespace Serialization {
 	namespace Binary {
@@ -50,6 +54,30 @@ namespace Serialization {
 			source.read(reinterpret_cast<char*>(&obj), sizeof(T));
 			return obj;
 		}
+		/**
+		 * Reads characters straight into the destination string.
+		 * The string at most doubles with every read, so that a corrupt length fails at the end of the stream
+		 * instead of allocating the whole length up front.
+		 * 
+		 * @tparam TString std::string or std::wstring
+		 * @param source source stream
+		 * @param str destination string
+		 * @param len number of characters
+		 */
+		template <typename TString>
+		static void read_chars(std::istream& source, TString& str, size_t len) {
+			using char_t = typename TString::value_type;
+			const size_t step = 4096 / sizeof(char_t);
+			str.clear();
+			while (str.size() < len) {
+				const auto offset = str.size();
+				const auto count = (std::min)(len - offset, offset + step);
+				str.resize(offset + count);
+				source.read(reinterpret_cast<char*>(&str[offset]), count * sizeof(char_t));
+				if (static_cast<size_t>(source.gcount()) != count * sizeof(char_t))
+					throw std::runtime_error("Unexpected end of stream");
+			}
+		}
 		/**
 		 * Reads a length-prefixed string from the source stream
 		 * 
@@ -59,10 +87,8 @@ namespace Serialization {
 		static std::string read_string(std::istream& source) {
 			size_t len;
 			read_primitive(source, &len);
-			char* buf = new char[len];
-			source.read(buf, len);
-			auto str = std::string(buf, len);
-			delete[] buf;
+			std::string str;
+			read_chars(source, str, len);
 			return str;
 		}
 		/**
@@ -104,10 +130,8 @@ namespace Serialization {
 		static std::wstring read_wstring(std::istream& source) {
 			size_t len;
 			read_primitive(source, &len);
-			wchar_t* buf = new wchar_t[len];
-			source.read((char*)buf, len*sizeof(wchar_t));
-			auto str = std::wstring(buf, len);
-			delete[] buf;
+			std::wstring str;
+			read_chars(source, str, len);
 			return str;
 		}
 		/**
@@ -171,5 +195,397 @@ namespace Serialization {
 		}
 
 
+		/**
+		 * Writes a primitive to the target buffer
+		 * 
+		 * @tparam T primitive type to be written
+		 * @param destination destination buffer
+		 * @param value value to be written
+		 * @return size_t number of bytes written
+		 */
+		template <typename T>
+		static size_t write_primitive(BinaryWriter& destination, T value) {
+			destination.write(value);
+			return sizeof(T);
+		}
+		/**
+		 * Reads a primitive from the source buffer
+		 * 
+		 * @tparam T primitive type to be read
+		 * @param source source buffer
+		 * @param obj pointer to store the read value
+		 * @return size_t number of bytes read
+		 */
+		template <typename T>
+		static size_t read_primitive(BinaryReader& source, T* obj) {
+			source.read(obj, sizeof(T));
+			return sizeof(T);
+		}
+		/**
+		 * Reads a primitive from the source buffer
+		 * 
+		 * @tparam T primitive type to be read
+		 * @param source source buffer
+		 * @return T read value
+		 */
+		template <typename T>
+		static T read_primitive(BinaryReader& source) {
+			return source.read<T>();
+		}
+		/**
+		 * Whether sets of T are written as varint deltas in the given format
+		 * 
+		 * @tparam T set element type
+		 * @param format wire format
+		 */
+		template <typename T>
+		static constexpr bool is_delta_encoded(WireFormat format) {
+			return std::is_integral<T>::value && std::is_unsigned<T>::value && format == WireFormat::Compact;
+		}
+		/**
+		 * Writes an unsigned LEB128 varint: 7 bits per byte, least significant group first
+		 * 
+		 * @param destination destination buffer
+		 * @param value value to be written
+		 * @return size_t number of bytes written
+		 */
+		static size_t write_varint(BinaryWriter& destination, uint64_t value) {
+			byte_t bytes[10];
+			size_t count = 0;
+			while (value >= 0x80) {
+				bytes[count++] = static_cast<byte_t>(value | 0x80);
+				value >>= 7;
+			}
+			bytes[count++] = static_cast<byte_t>(value);
+			destination.write(bytes, count);
+			return count;
+		}
+		/**
+		 * Gets the number of bytes write_varint would write
+		 * 
+		 * @param value value to be written
+		 * @return size_t encoded length, 1 to 10 bytes
+		 */
+		static size_t varint_size(uint64_t value) {
+			size_t count = 1;
+			while (value >= 0x80) {
+				value >>= 7;
+				count++;
+			}
+			return count;
+		}
+		/**
+		 * Reads an unsigned LEB128 varint
+		 * 
+		 * @param source source buffer
+		 * @return uint64_t read value
+		 */
+		static uint64_t read_varint(BinaryReader& source) {
+			uint64_t value = 0;
+			for (int shift = 0; shift < 64; shift += 7) {
+				const auto b = source.read<byte_t>();
+				value |= static_cast<uint64_t>(b & 0x7f) << shift;
+				if (!(b & 0x80)) {
+					// the 10th byte may only carry the top bit
+					if (shift == 63 && b > 1)
+						throw std::runtime_error("Varint overflow");
+					return value;
+				}
+			}
+			throw std::runtime_error("Varint overflow");
+		}
+		/**
+		 * Writes an unsigned integer field: a varint in the compact format, a primitive otherwise
+		 * 
+		 * @tparam T unsigned integral type
+		 * @param destination destination buffer
+		 * @param value value to be written
+		 * @return size_t number of bytes written
+		 */
+		template <typename T>
+		static size_t write_uint(BinaryWriter& destination, T value) {
+			static_assert(std::is_unsigned<T>::value, "only unsigned integers can be varint-encoded");
+			if (destination.getFormat() == WireFormat::Compact)
+				return write_varint(destination, value);
+			return write_primitive(destination, value);
+		}
+		/**
+		 * Reads an unsigned integer field written by write_uint
+		 * 
+		 * @tparam T unsigned integral type
+		 * @param source source buffer
+		 * @return T read value
+		 */
+		template <typename T>
+		static T read_uint(BinaryReader& source) {
+			static_assert(std::is_unsigned<T>::value, "only unsigned integers can be varint-encoded");
+			if (source.getFormat() != WireFormat::Compact)
+				return source.read<T>();
+			const auto value = read_varint(source);
+			if (value > std::numeric_limits<T>::max())
+				throw std::runtime_error("Varint overflow");
+			return static_cast<T>(value);
+		}
+		/**
+		 * Writes a collection or string length
+		 * 
+		 * @param destination destination buffer
+		 * @param len length
+		 * @return size_t number of bytes written
+		 */
+		static size_t write_length(BinaryWriter& destination, size_t len) {
+			return write_uint(destination, len);
+		}
+		/**
+		 * Reads a collection or string length
+		 * 
+		 * @param source source buffer
+		 * @return size_t read length
+		 */
+		static size_t read_length(BinaryReader& source) {
+			return read_uint<size_t>(source);
+		}
+		/**
+		 * Reads the length of a string, rejecting lengths beyond the remaining bytes or the reader's limits
+		 * 
+		 * @param source source buffer
+		 * @param charSize size of a single character, in bytes
+		 * @return size_t number of characters
+		 */
+		static size_t read_string_length(BinaryReader& source, size_t charSize = 1) {
+			const auto len = read_length(source);
+			if (len > source.getRemaining() / charSize)
+				throw std::runtime_error("Unexpected end of buffer");
+			if (len * charSize > source.getLimits().maxStringLength)
+				throw std::runtime_error("String exceeds the decode limit");
+			return len;
+		}
+		/**
+		 * Reads the number of elements of a collection, rejecting counts whose elements cannot fit
+		 * in the remaining bytes or that exceed the reader's limits
+		 * 
+		 * @param source source buffer
+		 * @param minElementSize minimal encoded size of a single element, in bytes
+		 * @return size_t number of elements
+		 */
+		static size_t read_count(BinaryReader& source, size_t minElementSize = 1) {
+			const auto count = read_length(source);
+			if (count > source.getRemaining() / minElementSize)
+				throw std::runtime_error("Unexpected end of buffer");
+			if (count > source.getLimits().maxCollectionSize)
+				throw std::runtime_error("Collection exceeds the decode limit");
+			return count;
+		}
+		/**
+		 * Writes an object id
+		 * 
+		 * @param destination destination buffer
+		 * @param id object id
+		 * @return size_t number of bytes written
+		 */
+		static size_t write_id(BinaryWriter& destination, identity_t id) {
+			return write_uint(destination, id);
+		}
+		/**
+		 * Reads an object id
+		 * 
+		 * @param source source buffer
+		 * @return identity_t read id
+		 */
+		static identity_t read_id(BinaryReader& source) {
+			return read_uint<identity_t>(source);
+		}
+		/**
+		 * Reads a length-prefixed string from the source buffer
+		 * 
+		 * @param source source buffer
+		 * @return std::string read string
+		 */
+		static std::string read_string(BinaryReader& source) {
+			const auto len = read_string_length(source);
+			const auto* data = source.advance(len);
+			return std::string(reinterpret_cast<const char*>(data), len);
+		}
+		/**
+		 * Writes a length-prefixed string to the destination buffer
+		 * 
+		 * @param destination destination buffer
+		 * @param str string to be written
+		 * @return size_t number of bytes written
+		 */
+		static size_t write_string(BinaryWriter& destination, const std::string& str) {
+			size_t len = str.size();
+			const auto prefix = write_length(destination, len);
+			destination.write(str.data(), len);
+			return len + prefix;
+		}
+		/**
+		 * Writes a length-prefixed wide string to the destination buffer
+		 * 
+		 * @param destination destination buffer
+		 * @param str string to be written
+		 * @return size_t number of bytes written
+		 */
+		static size_t write_wstring(BinaryWriter& destination, const std::wstring& str) {
+			size_t len = str.size();
+			write_length(destination, len);
+			destination.write(str.data(), len * sizeof(wchar_t));
+			return len;
+		}
+		/**
+		 * Reads a length-prefixed wide string from the source buffer
+		 * 
+		 * @param source source buffer
+		 * @return std::wstring read string
+		 */
+		static std::wstring read_wstring(BinaryReader& source) {
+			const auto len = read_string_length(source, sizeof(wchar_t));
+			std::wstring str(len, L'\0');
+			source.read(&str[0], len * sizeof(wchar_t));
+			return str;
+		}
+		/**
+		 * Writes a UTF-8 text field: as is in the compact format, as a wide string otherwise
+		 * 
+		 * @param destination destination buffer
+		 * @param str UTF-8 string to be written
+		 * @return size_t number of bytes written
+		 */
+		static size_t write_text(BinaryWriter& destination, const std::string& str) {
+			if (destination.getFormat() == WireFormat::Compact)
+				return write_string(destination, str);
+			const auto start = destination.getPosition();
+			write_wstring(destination, Utf8::toWide(str));
+			return destination.getPosition() - start;
+		}
+		/**
+		 * Reads a text field written by write_text
+		 * 
+		 * @param source source buffer
+		 * @return std::string UTF-8 string
+		 */
+		static std::string read_text(BinaryReader& source) {
+			if (source.getFormat() == WireFormat::Compact)
+				return read_string(source);
+			return Utf8::fromWide(read_wstring(source));
+		}
+		/**
+		 * Writes an interned text value. In the compact format the text is sent only once per message,
+		 * as a 0 followed by the string, later occurrences refer to it by its 1-based index.
+		 * 
+		 * @param destination destination buffer
+		 * @param key process-local id of the interned text
+		 * @param lookup callback returning the UTF-8 text of the key, only called when the text is written
+		 * @return size_t number of bytes written
+		 */
+		static size_t write_symbol(BinaryWriter& destination, uint32_t key,
+		                           const std::function<const std::string&(uint32_t)>& lookup) {
+			if (destination.getFormat() != WireFormat::Compact)
+				return write_text(destination, lookup(key));
+			uint32_t index;
+			if (destination.internSymbol(key, &index))
+				return write_varint(destination, index);
+			return write_varint(destination, 0) + write_string(destination, lookup(key));
+		}
+		/**
+		 * Reads an interned text value written by write_symbol
+		 * 
+		 * @param source source buffer
+		 * @param intern callback mapping the text to its process-local id
+		 * @return uint32_t process-local id of the value
+		 */
+		static uint32_t read_symbol(BinaryReader& source, const std::function<uint32_t(const std::string&)>& intern) {
+			if (source.getFormat() != WireFormat::Compact)
+				return intern(read_text(source));
+			const auto index = read_uint<uint32_t>(source);
+			if (index)
+				return source.getSymbol(index);
+			const auto key = intern(read_string(source));
+			source.addSymbol(key);
+			return key;
+		}
+		/**
+		 * Writes a {@code std::set<T>} of primitives, or any other collection sorted in ascending order, into the destination buffer.
+		 * In the compact format, unsigned integers are written as varint deltas of the sorted values.
+		 * 
+		 * @tparam TSet sorted collection of primitives
+		 * @param destination destination buffer
+		 * @param set collection
+		 */
+		template <typename TSet, typename T = typename TSet::value_type>
+		static void write_set_primitive(BinaryWriter& destination, const TSet& set) {
+			size_t len = set.size();
+			write_length(destination, len);
+			if (is_delta_encoded<T>(destination.getFormat())) {
+				uint64_t previous = 0;
+				for (auto obj : set) {
+					write_varint(destination, static_cast<uint64_t>(obj) - previous);
+					previous = static_cast<uint64_t>(obj);
+				}
+				return;
+			}
+			// reserved after the length, which is shorter than sizeof(size_t) in the compact format
+			destination.reserve(len * sizeof(T));
+			for (auto obj : set) {
+				destination.write(obj);
+			}
+		}
+		/**
+		 * Writes a std::set<T> of Serializable objects into the destination buffer
+		 * 
+		 * @tparam T serializable type
+		 * @param destination destination buffer
+		 * @param set collection
+		 */
+		template <typename T>
+		static void write_set_typed(BinaryWriter& destination, const std::set<T>& set) {
+			write_length(destination, set.size());
+			for (const auto& obj : set) {
+				obj.serialize(destination);
+			}
+		}
+		/**
+		 * Reads a std::set<T> from the source buffer by applying the callback function
+		 * 
+		 * @tparam T element type
+		 * @param source source buffer
+		 * @param set output collection
+		 * @param callback deserializer for T
+		 */
+		template <typename T>
+		static void read_set(BinaryReader& source, std::set<T>& set, std::function<T(BinaryReader&)> callback) {
+			set.clear();
+			const auto len = read_count(source);
+			for (size_t i = 0; i < len; i++) {
+				set.insert(set.end(), callback(source));
+			}
+		}
+		/**
+		 * Reads a std::set<T> of primitives from the source buffer
+		 * 
+		 * @tparam T primitive element type
+		 * @param source source buffer
+		 * @param set output collection
+		 */
+		template <typename T>
+		static void read_set_primitive(BinaryReader& source, std::set<T>& set) {
+			set.clear();
+			const bool delta = is_delta_encoded<T>(source.getFormat());
+			// every element has to be present in the buffer, varints take at least a byte
+			const auto len = read_count(source, delta ? 1 : sizeof(T));
+			uint64_t previous = 0;
+			for (size_t i = 0; i < len; i++) {
+				if (!delta) {
+					set.insert(set.end(), source.read<T>());
+					continue;
+				}
+				const auto value = previous + read_varint(source);
+				if (value < previous || value > std::numeric_limits<T>::max())
+					throw std::runtime_error("Varint overflow");
+				set.insert(set.end(), static_cast<T>(value));
+				previous = value;
+			}
+		}
+
 	}
 };
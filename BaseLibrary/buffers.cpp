@@ -3,7 +3,7 @@
 void memory_buf::updateBuffer() {
 	auto* data = reinterpret_cast<char*>(_data);
 	setg(data, data, data + _length);
-	setp(data, data, data + _length);
+	setp(data, data + _length);
 }
 
 char* memory_buf::calcOffset(char* base, char* now, char* end, std::streamoff off, std::ios_base::seekdir way) {
@@ -42,7 +42,8 @@ std::streampos memory_buf::seekoff(std::streamoff off, std::ios_base::seekdir wa
 		auto* base = pbase();
 		auto* end = epptr();
 		auto* now = calcOffset(base, pptr(), end, off, way);
-		setp(base, now, end);
+		setp(base, end);
+		pbump(static_cast<int>(now - base));
 		lastPos = now - base;
 	}
 	return lastPos;
@@ -72,3 +73,17 @@ void memory_buf::setData(pbyte_t data, size_t length) {
 
 	updateBuffer();
 }
+
+void BinaryWriter::grow(size_t length) {
+	if (!_owned)
+		throw std::runtime_error("Insufficient buffer capacity");
+	auto capacity = _capacity * 2;
+	if (capacity < _position + length)
+		capacity = _position + length;
+	auto* data = new byte_t[capacity];
+	if (_position > 0)
+		std::memcpy(data, _data, _position);
+	delete[] _data;
+	_data = data;
+	_capacity = capacity;
+}
@@ -3,7 +3,12 @@
  */
 
 #pragma once
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
 #include "types.h"
 
 
@@ -148,3 +153,368 @@ public:
 private:
 	memory_buf _buffer;
 };
+
+/**
+ * Binary encoding of lengths, ids and dates
+ */
+enum class WireFormat : uint8_t {
+	/**
+	 * Fixed-width fields, same as their in-memory representation
+	 */
+	Fixed = 0,
+	/**
+	 * LEB128 varints for lengths and ids, bit-packed dates and times
+	 */
+	Compact = 1,
+};
+
+/**
+ * Resource limits applied when decoding untrusted data.
+ * Lengths are always checked against the remaining bytes, the limits bound them further.
+ */
+struct DecodeLimits {
+	/**
+	 * Max encoded length of a single string, in bytes
+	 */
+	size_t maxStringLength = std::numeric_limits<size_t>::max();
+	/**
+	 * Max number of elements of a single collection
+	 */
+	size_t maxCollectionSize = std::numeric_limits<size_t>::max();
+	/**
+	 * Max number of names in the JobCatalog, a new job name decoded once it is reached is rejected
+	 */
+	size_t maxJobNames = std::numeric_limits<size_t>::max();
+};
+
+/**
+ * Writes binary data directly into a contiguous byte buffer.
+ * Uses either an external buffer of fixed capacity, or an internal one that grows on demand.
+ */
+class BinaryWriter {
+private:
+	pbyte_t _data;
+	size_t _capacity;
+	size_t _position;
+	bool _owned;
+	WireFormat _format;
+	std::vector<uint32_t> _symbols;
+	uint32_t _symbolCount = 0;
+
+	/**
+	 * Expands the internal buffer to fit the given number of bytes after the current position
+	 * @param length required number of bytes
+	 */
+	void grow(size_t length);
+
+public:
+	/**
+	 * Construct a writer with an internal buffer that grows on demand
+	 * @param capacity initial capacity
+	 */
+	BinaryWriter(size_t capacity = 256) {
+		_data = new byte_t[capacity];
+		_capacity = capacity;
+		_position = 0;
+		_owned = true;
+		_format = WireFormat::Fixed;
+	}
+	/**
+	 * Construct a writer over an external buffer, without taking ownership
+	 * @param data byte buffer
+	 * @param capacity buffer length
+	 */
+	BinaryWriter(pbyte_t data, size_t capacity) {
+		_data = data;
+		_capacity = capacity;
+		_position = 0;
+		_owned = false;
+		_format = WireFormat::Fixed;
+	}
+
+	~BinaryWriter() {
+		if (_owned)
+			delete[] _data;
+	}
+
+	BinaryWriter(const BinaryWriter& other) = delete;
+	BinaryWriter& operator=(const BinaryWriter& other) = delete;
+
+	/**
+	 * Makes sure that the given number of bytes can be written at the current position
+	 * @param length number of bytes
+	 */
+	void reserve(size_t length) {
+		if (length > _capacity - _position)
+			grow(length);
+	}
+	/**
+	 * Writes raw bytes at the current position
+	 * @param source bytes to be written
+	 * @param length number of bytes
+	 */
+	void write(const void* source, size_t length) {
+		reserve(length);
+		if (length > 0)
+			std::memcpy(_data + _position, source, length);
+		_position += length;
+	}
+	/**
+	 * Writes a primitive at the current position
+	 * @tparam T trivially copyable type
+	 * @param value value to be written
+	 */
+	template <typename T>
+	void write(const T& value) {
+		static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable types can be written");
+		reserve(sizeof(T));
+		std::memcpy(_data + _position, &value, sizeof(T));
+		_position += sizeof(T);
+	}
+	/**
+	 * Gets the current 0-indexed position, which is also the number of bytes written
+	 */
+	size_t getPosition() const {
+		return _position;
+	}
+	/**
+	 * Moves the current position
+	 * @param position 0-indexed position, not greater than the capacity
+	 */
+	void setPosition(size_t position) {
+		if (position > _capacity)
+			throw std::length_error("Invalid position");
+		_position = position;
+	}
+	/**
+	 * Gets the length of the underlying buffer
+	 */
+	size_t getCapacity() const {
+		return _capacity;
+	}
+	/**
+	 * Assigns a message-local index to an interned value, see write_symbol
+	 * @param key process-local id of the value
+	 * @param index output 1-based index of the value in this message
+	 * @return true if the value was already written into this message
+	 */
+	bool internSymbol(uint32_t key, uint32_t* index) {
+		if (key >= _symbols.size())
+			_symbols.resize(key + 1, 0);
+		const bool known = _symbols[key] != 0;
+		if (!known)
+			_symbols[key] = ++_symbolCount;
+		*index = _symbols[key];
+		return known;
+	}
+	/**
+	 * Gets the encoding used for lengths, ids and dates
+	 */
+	WireFormat getFormat() const {
+		return _format;
+	}
+	/**
+	 * Sets the encoding used for lengths, ids and dates
+	 * @param format wire format
+	 */
+	void setFormat(WireFormat format) {
+		_format = format;
+	}
+	/**
+	 * Return a pointer to the underlying byte buffer
+	 */
+	pbyte_t data() const {
+		return _data;
+	}
+};
+
+/**
+ * Reads binary data directly from a contiguous byte buffer, without taking ownership of it
+ */
+class BinaryReader {
+private:
+	const byte_t* _data;
+	size_t _length;
+	size_t _position;
+	WireFormat _format;
+	DecodeLimits _limits;
+	std::vector<uint32_t> _symbols;
+
+public:
+	/**
+	 * Construct a reader over the given bytes
+	 * @param data byte buffer
+	 * @param length buffer length
+	 */
+	BinaryReader(const byte_t* data, size_t length) {
+		_data = data;
+		_length = length;
+		_position = 0;
+		_format = WireFormat::Fixed;
+	}
+	/**
+	 * Makes sure that the given number of bytes can be read at the current position
+	 * @param length number of bytes
+	 */
+	void require(size_t length) const {
+		if (length > _length - _position)
+			throw std::runtime_error("Unexpected end of buffer");
+	}
+	/**
+	 * Skips the given number of bytes
+	 * @param length number of bytes
+	 * @return const byte_t* pointer to the first skipped byte
+	 */
+	const byte_t* advance(size_t length) {
+		require(length);
+		const auto* data = _data + _position;
+		_position += length;
+		return data;
+	}
+	/**
+	 * Copies raw bytes from the current position
+	 * @param destination output buffer
+	 * @param length number of bytes
+	 */
+	void read(void* destination, size_t length) {
+		const auto* data = advance(length);
+		if (length > 0)
+			std::memcpy(destination, data, length);
+	}
+	/**
+	 * Reads a primitive from the current position
+	 * @tparam T trivially copyable type
+	 * @return T read value
+	 */
+	template <typename T>
+	T read() {
+		static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable types can be read");
+		T value;
+		read(&value, sizeof(T));
+		return value;
+	}
+	/**
+	 * Gets the byte at the current position without advancing
+	 */
+	byte_t peek() const {
+		require(1);
+		return _data[_position];
+	}
+	/**
+	 * Gets the current 0-indexed position, which is also the number of bytes read
+	 */
+	size_t getPosition() const {
+		return _position;
+	}
+	/**
+	 * Moves the current position
+	 * @param position 0-indexed position, not greater than the length
+	 */
+	void setPosition(size_t position) {
+		if (position > _length)
+			throw std::length_error("Invalid position");
+		_position = position;
+	}
+	/**
+	 * Gets the length of the underlying buffer
+	 */
+	size_t getLength() const {
+		return _length;
+	}
+	/**
+	 * Gets the number of bytes left to read
+	 */
+	size_t getRemaining() const {
+		return _length - _position;
+	}
+	/**
+	 * Registers the next interned value of this message, see read_symbol
+	 * @param key process-local id of the value
+	 */
+	void addSymbol(uint32_t key) {
+		_symbols.push_back(key);
+	}
+	/**
+	 * Gets an interned value registered earlier in this message
+	 * @param index 1-based index of the value
+	 * @return uint32_t process-local id of the value
+	 */
+	uint32_t getSymbol(uint32_t index) const {
+		if (index == 0 || index > _symbols.size())
+			throw std::runtime_error("Invalid symbol reference");
+		return _symbols[index - 1];
+	}
+	/**
+	 * Gets the encoding used for lengths, ids and dates
+	 */
+	WireFormat getFormat() const {
+		return _format;
+	}
+	/**
+	 * Sets the encoding used for lengths, ids and dates
+	 * @param format wire format
+	 */
+	void setFormat(WireFormat format) {
+		_format = format;
+	}
+	/**
+	 * Gets the limits applied to decoded lengths, unbounded by default
+	 */
+	const DecodeLimits& getLimits() const {
+		return _limits;
+	}
+	/**
+	 * Sets the limits applied to decoded lengths
+	 * @param limits decode limits
+	 */
+	void setLimits(const DecodeLimits& limits) {
+		_limits = limits;
+	}
+	/**
+	 * Return a pointer to the underlying byte buffer
+	 */
+	const byte_t* data() const {
+		return _data;
+	}
+};
+
+/**
+ * State of a serialized size computation, mirroring the state of a BinaryWriter
+ * that would encode the same message
+ */
+class SizeContext {
+private:
+	WireFormat _format;
+	std::vector<uint32_t> _symbols;
+	uint32_t _symbolCount = 0;
+
+public:
+	/**
+	 * Construct a context for a new message
+	 * @param format wire format the message would be written in
+	 */
+	explicit SizeContext(WireFormat format = WireFormat::Fixed) {
+		_format = format;
+	}
+	/**
+	 * Gets the encoding used for lengths, ids and dates
+	 */
+	WireFormat getFormat() const {
+		return _format;
+	}
+	/**
+	 * Assigns a message-local index to an interned value, same as BinaryWriter::internSymbol
+	 * @param key process-local id of the value
+	 * @param index output 1-based index of the value in this message
+	 * @return true if the value was already counted in this message
+	 */
+	bool internSymbol(uint32_t key, uint32_t* index) {
+		if (key >= _symbols.size())
+			_symbols.resize(key + 1, 0);
+		const bool known = _symbols[key] != 0;
+		if (!known)
+			_symbols[key] = ++_symbolCount;
+		*index = _symbols[key];
+		return known;
+	}
+};
@@ -0,0 +1,351 @@
+#pragma once
+#include <initializer_list>
+#include <map>
+#include <set>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "binary.h"
+#include "serialization.h"
+
+namespace Serialization {
+	/**
+	 * Compile-time field descriptors.
+	 * A model lists its fields once, as a tuple returned by a static fields() function, and
+	 * write_fields, read_fields and fields_size walk that list to encode, decode and measure it.
+	 * Every codec is a type with static write, read and size functions for a single value.
+	 */
+	namespace Fields {
+		/**
+		 * Codec for trivially copyable values, written as in memory
+		 *
+		 * @tparam T primitive type
+		 */
+		template <typename T>
+		struct Primitive {
+			static void write(BinaryWriter& destination, const T& value) {
+				write_primitive(destination, value);
+			}
+			static void read(BinaryReader& source, T& value) {
+				value = read_primitive<T>(source);
+			}
+			static size_t size(SizeContext& context, const T& value) {
+				return sizeof(T);
+			}
+		};
+
+		/**
+		 * Codec for flags, written as a single byte. Bytes other than 0 and 1 are rejected,
+		 * as they are not valid bool values.
+		 */
+		struct Bool {
+			static void write(BinaryWriter& destination, const bool& value) {
+				write_primitive(destination, value);
+			}
+			static void read(BinaryReader& source, bool& value) {
+				const auto b = read_primitive<uint8_t>(source);
+				if (b > 1)
+					throw std::runtime_error("Invalid boolean");
+				value = b != 0;
+			}
+			static size_t size(SizeContext& context, const bool& value) {
+				return sizeof(bool);
+			}
+		};
+
+		/**
+		 * Codec for integers written by write_uint: varints in the compact format.
+		 * Signed values are sent as their unsigned counterpart of the same size.
+		 *
+		 * @tparam T integral type
+		 */
+		template <typename T>
+		struct Uint {
+			using unsigned_t = typename std::make_unsigned<T>::type;
+
+			static void write(BinaryWriter& destination, const T& value) {
+				write_uint(destination, static_cast<unsigned_t>(value));
+			}
+			static void read(BinaryReader& source, T& value) {
+				value = static_cast<T>(read_uint<unsigned_t>(source));
+			}
+			static size_t size(SizeContext& context, const T& value) {
+				if (context.getFormat() == WireFormat::Compact)
+					return varint_size(static_cast<unsigned_t>(value));
+				return sizeof(T);
+			}
+		};
+
+		/**
+		 * Codec for object ids
+		 */
+		using Id = Uint<identity_t>;
+
+		/**
+		 * Codec for byte strings written by write_string
+		 */
+		struct String {
+			static void write(BinaryWriter& destination, const std::string& value) {
+				write_string(destination, value);
+			}
+			static void read(BinaryReader& source, std::string& value) {
+				value = read_string(source);
+			}
+			static size_t size(SizeContext& context, const std::string& value) {
+				return Uint<size_t>::size(context, value.size()) + value.size();
+			}
+		};
+
+		/**
+		 * Codec for UTF-8 text written by write_text: wide strings in the fixed format
+		 */
+		struct Text {
+			static void write(BinaryWriter& destination, const std::string& value) {
+				write_text(destination, value);
+			}
+			static void read(BinaryReader& source, std::string& value) {
+				value = read_text(source);
+			}
+			static size_t size(SizeContext& context, const std::string& value) {
+				if (context.getFormat() == WireFormat::Compact)
+					return String::size(context, value);
+				return sizeof(size_t) + Utf8::wideLength(value) * sizeof(wchar_t);
+			}
+		};
+
+		/**
+		 * Codec for nested Serializable objects, including their type tag.
+		 * Objects of a derived type are accepted and sliced, as the field holds a T by value.
+		 *
+		 * @tparam T serializable type
+		 */
+		template <typename T>
+		struct Object {
+			static void write(BinaryWriter& destination, const T& value) {
+				value.serialize(destination);
+			}
+			static void read(BinaryReader& source, T& value) {
+				// the exact type is decoded in place, without allocating a temporary instance
+				if (static_cast<Type>(source.peek()) == T::TYPE) {
+					value.deserialize(source);
+					return;
+				}
+				auto instance = new_instance<T>(source);
+				instance->deserialize(source);
+				value = *instance;
+			}
+			static size_t size(SizeContext& context, const T& value) {
+				return value.serializedSize(context);
+			}
+		};
+
+		/**
+		 * Codec for a std::set of ids, written by write_set_primitive: varint deltas in the compact format
+		 *
+		 * @tparam T unsigned integral type
+		 */
+		template <typename T>
+		struct IdSet {
+			static void write(BinaryWriter& destination, const std::set<T>& value) {
+				write_set_primitive(destination, value);
+			}
+			static void read(BinaryReader& source, std::set<T>& value) {
+				read_set_primitive(source, value);
+			}
+			/* any collection sorted in ascending order has the same size */
+			template <typename TSet>
+			static size_t size(SizeContext& context, const TSet& value) {
+				auto total = Uint<size_t>::size(context, value.size());
+				if (!is_delta_encoded<T>(context.getFormat()))
+					return total + value.size() * sizeof(T);
+				uint64_t previous = 0;
+				for (auto id : value) {
+					total += varint_size(static_cast<uint64_t>(id) - previous);
+					previous = static_cast<uint64_t>(id);
+				}
+				return total;
+			}
+		};
+
+		/**
+		 * Codec for a std::set of nested Serializable objects
+		 *
+		 * @tparam T serializable type
+		 */
+		template <typename T>
+		struct ObjectSet {
+			static void write(BinaryWriter& destination, const std::set<T>& value) {
+				write_length(destination, value.size());
+				for (const auto& obj : value)
+					Object<T>::write(destination, obj);
+			}
+			static void read(BinaryReader& source, std::set<T>& value) {
+				value.clear();
+				// every object takes at least its type tag
+				const auto len = read_count(source);
+				for (size_t i = 0; i < len; i++) {
+					T obj;
+					Object<T>::read(source, obj);
+					value.insert(value.end(), std::move(obj));
+				}
+			}
+			/* any collection sorted in ascending order has the same size */
+			template <typename TSet>
+			static size_t size(SizeContext& context, const TSet& value) {
+				auto total = Uint<size_t>::size(context, value.size());
+				for (const auto& obj : value)
+					total += obj.serializedSize(context);
+				return total;
+			}
+		};
+
+		/**
+		 * Codec for a std::map from ids to nested Serializable objects
+		 *
+		 * @tparam T serializable type
+		 */
+		template <typename T>
+		struct ObjectMap {
+			static void write(BinaryWriter& destination, const std::map<identity_t, T>& value) {
+				write_length(destination, value.size());
+				for (const auto& kv : value) {
+					write_id(destination, kv.first);
+					Object<T>::write(destination, kv.second);
+				}
+			}
+			static void read(BinaryReader& source, std::map<identity_t, T>& value) {
+				value.clear();
+				// every entry takes at least its id and type tag
+				const auto len = read_count(source, 2);
+				for (size_t i = 0; i < len; i++) {
+					const auto id = read_id(source);
+					Object<T>::read(source, value[id]);
+				}
+			}
+			static size_t size(SizeContext& context, const std::map<identity_t, T>& value) {
+				auto total = Uint<size_t>::size(context, value.size());
+				for (const auto& kv : value)
+					total += Id::size(context, kv.first) + kv.second.serializedSize(context);
+				return total;
+			}
+		};
+
+		/**
+		 * Field stored directly in a member
+		 */
+		template <typename TCodec, typename TClass, typename TValue>
+		struct Field {
+			TValue TClass::* member;
+
+			void write(BinaryWriter& destination, const TClass& obj) const {
+				TCodec::write(destination, obj.*member);
+			}
+			void read(BinaryReader& source, TClass& obj) const {
+				TCodec::read(source, obj.*member);
+			}
+			size_t size(SizeContext& context, const TClass& obj) const {
+				return TCodec::size(context, obj.*member);
+			}
+		};
+
+		/**
+		 * Field stored in a member, but assigned through a validating setter when decoded
+		 */
+		template <typename TCodec, typename TClass, typename TValue, typename TSetter>
+		struct ValidatedField {
+			TValue TClass::* member;
+			TSetter setter;
+
+			void write(BinaryWriter& destination, const TClass& obj) const {
+				TCodec::write(destination, obj.*member);
+			}
+			void read(BinaryReader& source, TClass& obj) const {
+				TValue value;
+				TCodec::read(source, value);
+				(obj.*setter)(value);
+			}
+			size_t size(SizeContext& context, const TClass& obj) const {
+				return TCodec::size(context, obj.*member);
+			}
+		};
+
+		/**
+		 * Describes a field encoded with the given codec
+		 *
+		 * @tparam TCodec codec of the field
+		 * @param member pointer to the member holding the value
+		 */
+		template <typename TCodec, typename TClass, typename TValue>
+		constexpr Field<TCodec, TClass, TValue> field(TValue TClass::* member) {
+			return { member };
+		}
+		/**
+		 * Describes a field encoded with the given codec, decoded through a setter
+		 *
+		 * @tparam TCodec codec of the field
+		 * @param member pointer to the member holding the value
+		 * @param setter pointer to the member function validating and assigning the decoded value
+		 */
+		template <typename TCodec, typename TClass, typename TValue, typename TSetter>
+		constexpr ValidatedField<TCodec, TClass, TValue, TSetter> field(TValue TClass::* member, TSetter setter) {
+			return { member, setter };
+		}
+
+		namespace detail {
+			template <typename TClass, typename TTuple, size_t... I>
+			void write_all(BinaryWriter& destination, const TClass& obj, const TTuple& fields, std::index_sequence<I...>) {
+				// braced lists are evaluated in order
+				(void)std::initializer_list<int>{ (std::get<I>(fields).write(destination, obj), 0)... };
+			}
+			template <typename TClass, typename TTuple, size_t... I>
+			void read_all(BinaryReader& source, TClass& obj, const TTuple& fields, std::index_sequence<I...>) {
+				(void)std::initializer_list<int>{ (std::get<I>(fields).read(source, obj), 0)... };
+			}
+			template <typename TClass, typename TTuple, size_t... I>
+			size_t size_all(SizeContext& context, const TClass& obj, const TTuple& fields, std::index_sequence<I...>) {
+				size_t total = 0;
+				(void)std::initializer_list<int>{ (total += std::get<I>(fields).size(context, obj), 0)... };
+				return total;
+			}
+		}
+
+		/**
+		 * Writes all described fields of the object, in order
+		 *
+		 * @param destination destination buffer
+		 * @param obj object
+		 * @param fields tuple of field descriptors
+		 * @return BinaryWriter& destination buffer
+		 */
+		template <typename TClass, typename... TFields>
+		BinaryWriter& write_fields(BinaryWriter& destination, const TClass& obj, const std::tuple<TFields...>& fields) {
+			detail::write_all(destination, obj, fields, std::index_sequence_for<TFields...>());
+			return destination;
+		}
+		/**
+		 * Reads all described fields of the object, in order
+		 *
+		 * @param source source buffer
+		 * @param obj object
+		 * @param fields tuple of field descriptors
+		 * @return BinaryReader& source buffer
+		 */
+		template <typename TClass, typename... TFields>
+		BinaryReader& read_fields(BinaryReader& source, TClass& obj, const std::tuple<TFields...>& fields) {
+			detail::read_all(source, obj, fields, std::index_sequence_for<TFields...>());
+			return source;
+		}
+		/**
+		 * Computes the serialized size of all described fields of the object
+		 *
+		 * @param context format and state of the message being measured
+		 * @param obj object
+		 * @param fields tuple of field descriptors
+		 * @return size_t number of bytes write_fields would write
+		 */
+		template <typename TClass, typename... TFields>
+		size_t fields_size(SizeContext& context, const TClass& obj, const std::tuple<TFields...>& fields) {
+			return detail::size_all(context, obj, fields, std::index_sequence_for<TFields...>());
+		}
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdio>
+#include <string>
+
+#ifdef _WIN32
+#include <io.h>
+#include <share.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Opens a file that only this process writes to
+ *
+ * @param path path of the file
+ * @param mode std::fopen mode
+ * @return std::FILE* nullptr on failure
+ */
+inline std::FILE* openFile(const std::string& path, const char* mode) {
+#ifdef _WIN32
+	return _fsopen(path.c_str(), mode, _SH_DENYWR);
+#else
+	return std::fopen(path.c_str(), mode);
+#endif
+}
+/**
+ * Flushes the buffered writes of a file and waits until they reach the disk
+ *
+ * @param file open file
+ * @return whether the data is durable
+ */
+inline bool syncFile(std::FILE* file) {
+	if (std::fflush(file) != 0)
+		return false;
+#ifdef _WIN32
+	return _commit(_fileno(file)) == 0;
+#else
+	return fsync(fileno(file)) == 0;
+#endif
+}
+/**
+ * Atomically replaces a file with another one, so that readers see either the old or the new contents
+ *
+ * @param source path of the new file, which is moved
+ * @param destination path of the replaced file
+ * @return whether the file was replaced
+ */
+inline bool replaceFile(const std::string& source, const std::string& destination) {
+#ifdef _WIN32
+	return MoveFileExA(source.c_str(), destination.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	return std::rename(source.c_str(), destination.c_str()) == 0;
+#endif
+}
+/**
+ * Waits until the entries of the directory holding a file reach the disk, so that a file created or renamed
+ * in it survives a crash
+ *
+ * @param path path of a file in the directory
+ * @return whether the directory is durable
+ */
+inline bool syncDirectory(const std::string& path) {
+#ifdef _WIN32
+	// directories cannot be synced, replaceFile moves files with MOVEFILE_WRITE_THROUGH instead
+	return true;
+#else
+	const auto separator = path.find_last_of('/');
+	const auto directory = separator == std::string::npos ? std::string(".") : path.substr(0, separator + 1);
+	const int handle = ::open(directory.c_str(), O_RDONLY);
+	if (handle < 0)
+		return false;
+	const bool synced = fsync(handle) == 0;
+	::close(handle);
+	return synced;
+#endif
+}
@@ -2,12 +2,16 @@
 #include "C2S_Authorize.h"
 #include "C2S_DeleteShift.h"
 #include "C2S_DeleteWorker.h"
+#include "C2S_GetChanges.h"
 #include "C2S_GetShiftsByDay.h"
+#include "C2S_GetShiftsByWorker.h"
 #include "C2S_GetWorkers.h"
 #include "C2S_InsertShift.h"
 #include "C2S_InsertWorker.h"
+#include "C2S_SubscribeDays.h"
 #include "Date.h"
 #include "DateTime.h"
+#include "net_constants.h"
 #include "serialization.h"
 
 #include "Ping.h"
@@ -15,14 +19,18 @@
 #include "S2C_AuthorizeReply.h"
 #include "S2C_DeleteShiftReply.h"
 #include "S2C_DeleteWorkerReply.h"
+#include "S2C_GetChangesReply.h"
+#include "S2C_GetShiftsByWorkerReply.h"
 #include "S2C_GetShiftsReply.h"
 #include "S2C_GetWorkersReply.h"
 #include "S2C_InsertShiftReply.h"
 #include "S2C_InsertWorkerReply.h"
+#include "S2C_SubscribeDaysReply.h"
 #include "S2C_ClientSync.h"
 #include "Shift.h"
 #include "ShiftWorker.h"
 #include "TrackablePacket.h"
+#include "StreamedReply.h"
 #include "TransactionReply.h"
 
 namespace Serialization {
@@ -33,6 +41,7 @@ namespace Serialization {
 	inline void register_models() {
 		register_base_type<TrackablePacket>(Type::_TrackablePacket);
 		register_base_type<TransactionReply>(Type::_TransactionReply, Type::_TrackablePacket);
+		register_base_type<StreamedReply>(Type::_StreamedReply, Type::_TransactionReply);
 
 		register_type<Ping>();
 		register_type<PingReply>();
@@ -49,14 +58,29 @@ namespace Serialization {
 		register_derived<C2S_InsertShift>(trackable);
 		register_derived<C2S_InsertWorker>(trackable);
 		register_derived<C2S_DeleteWorker>(trackable);
+		register_derived<C2S_SubscribeDays>(trackable);
+		register_derived<C2S_GetChanges>(trackable);
+		register_derived<C2S_GetShiftsByWorker>(trackable);
 		const auto reply = Type::_TransactionReply;
 		register_derived<S2C_AuthorizeReply>(reply);
 		register_derived<S2C_DeleteShiftReply>(reply);
-		register_derived<S2C_GetShiftsReply>(reply);
-		register_derived<S2C_GetWorkersReply>(reply);
 		register_derived<S2C_InsertShiftReply>(reply);
 		register_derived<S2C_InsertWorkerReply>(reply);
 		register_derived<S2C_DeleteWorkerReply>(reply);
-		
+		register_derived<S2C_SubscribeDaysReply>(reply);
+		register_derived<S2C_GetChangesReply>(reply);
+		const auto streamed = Type::_StreamedReply;
+		register_derived<S2C_GetShiftsReply>(streamed);
+		register_derived<S2C_GetWorkersReply>(streamed);
+		register_derived<S2C_GetShiftsByWorkerReply>(streamed);
+
+		// everything a client may send is small, so oversized frames are dropped before they are decoded
+		const Type requests[] = {
+			Type::_Ping, Type::_PingReply, Type::_C2S_Authorize, Type::_C2S_DeleteShift, Type::_C2S_GetShiftsByDay,
+			Type::_C2S_GetWorkers, Type::_C2S_InsertShift, Type::_C2S_InsertWorker, Type::_C2S_DeleteWorker,
+			Type::_C2S_SubscribeDays, Type::_C2S_GetChanges, Type::_C2S_GetShiftsByWorker
+		};
+		for (auto type : requests)
+			set_max_size(type, MAX_REQUEST_SIZE);
 	}
 };
@@ -1,4 +1,6 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 
 /**
  * Scale to be used for all time-related constants
@@ -20,6 +22,58 @@ const int MAX_BUFFER_SIZE = BUFFER_SIZE * 4;
  * 
  */
 const int MAX_PACKET_SIZE = BUFFER_SIZE * 8;
+/**
+ * Max encoded size of a single part of a streamed reply, so that the parts fit the standard network buffers
+ * 
+ */
+const size_t STREAM_PART_SIZE = MAX_BUFFER_SIZE;
+/**
+ * Max encoded size of a request or ping, larger frames of these types are rejected before decoding
+ * 
+ */
+const int MAX_REQUEST_SIZE = 4096;
+/**
+ * Max encoded length of a string received from a peer
+ * 
+ */
+const size_t MAX_STRING_LENGTH = 4096;
+/**
+ * Max number of elements of a collection received from a peer
+ * 
+ */
+const size_t MAX_COLLECTION_SIZE = 16384;
+/**
+ * Max number of distinct job names in the JobCatalog, new names received from a peer beyond it are rejected
+ * 
+ */
+const size_t MAX_JOB_NAMES = 1024;
+/**
+ * Number of threads running the handlers of the frames decoded by the event loops, so a slow handler
+ * does not hold up the other clients of its loop
+ * 
+ */
+const int REACTOR_HANDLER_THREADS = 8;
+/**
+ * Time the changes of the database are collected for before being sent to the clients in a single S2C_ClientSync
+ * 
+ */
+const int SYNC_WINDOW = 50 * TIME_SCALE;
+/**
+ * Encoded size of the collected changes that sends them before the end of SYNC_WINDOW
+ * 
+ */
+const size_t SYNC_BATCH_SIZE = MAX_BUFFER_SIZE;
+/**
+ * Number of the latest changes of the database kept for the clients that reconnect
+ * 
+ */
+const size_t CHANGE_LOG_SIZE = 4096;
+/**
+ * Time the changes of the database are collected for before being synced to the write-ahead log in a single write.
+ * With 0, the changes made while a batch is being synced still share the next sync
+ * 
+ */
+const int WAL_COMMIT_WINDOW = 0;
 /**
  * Timeout for the socket recv() operation
  * 
@@ -30,3 +84,8 @@ const int SOCKET_TIMEOUT = 10000 * TIME_SCALE;
  * 
  */
 const int CLIENT_PING_INTERVAL = 5000 * TIME_SCALE;
+/**
+ * Bit of the frame length prefix set for packets in the compact wire format
+ * 
+ */
+const uint32_t COMPACT_FRAME_FLAG = 0x80000000u;
@@ -1,9 +1,5 @@
 #include "serialization.h"
 
-#include <map>
-
-
 namespace Serialization {
-	std::map<Type, TypeInfo> TypeInfo::TYPES;
-	std::map<std::type_index, Type> TypeInfo::NATIVE_TYPES;
+	TypeInfo TypeInfo::TYPES[TYPE_COUNT];
 }
@@ -1,8 +1,8 @@
 #pragma once
-#include <map>
+#include <bitset>
 #include <functional>
 #include <memory>
-#include <typeindex>
+#include <typeinfo>
 
 #include "Serializable.h"
 
@@ -13,13 +13,15 @@ namespace Serialization {
 	 */
 	struct TypeInfo {
 	public:
-		static std::map<std::type_index, Type> NATIVE_TYPES;
-		static std::map<Type, TypeInfo> TYPES;
+		/**
+		 * Registered types, indexed by their Type tag
+		 */
+		static TypeInfo TYPES[TYPE_COUNT];
 		bool registered = false;
 		/**
 		 * Function that constructs a serializable type and returns its shared pointer
 		 */
-		std::function<std::shared_ptr<Serializable>()> constructor = nullptr;
+		std::shared_ptr<Serializable> (*constructor)() = nullptr;
 		/**
 		 * Parent-type of this type
 		 */
@@ -28,18 +30,40 @@ namespace Serialization {
 		 * Compiler-generated name for this type
 		 */
 		const char* name = nullptr;
+		/**
+		 * Set of types this type can be assigned to (itself, all of its parents and Type::Unknown)
+		 */
+		std::bitset<TYPE_COUNT> ancestors;
+		/**
+		 * Max encoded size accepted from a peer, 0 if only bounded by the packet size
+		 */
+		size_t maxSize = 0;
+
+		/**
+		 * Gets the information about the given type
+		 * @param type Serializable type
+		 * @return TypeInfo& type information, with `registered` unset if the type is unknown
+		 */
+		static TypeInfo& get(Type type) {
+			return TYPES[static_cast<uint8_t>(type)];
+		}
+		/**
+		 * Unregisters all types
+		 */
+		static void clear() {
+			for (auto& info : TYPES)
+				info = TypeInfo();
+		}
 	};
 
 	/**
-	 * Builds a function that constructs a Serializable object of given type
+	 * Constructs a Serializable object of given type
 	 * @tparam T type that implements Serializable
-	 * @return callable function that returns a shared pointer to newly constructed instance
+	 * @return shared pointer to newly constructed instance
 	 */
 	template <typename T>
-	static std::function<std::shared_ptr<Serializable>()> build_constructor() {
-		return []() {
-			return std::dynamic_pointer_cast<Serializable>(std::make_shared<T>());
-		};
+	static std::shared_ptr<Serializable> construct() {
+		return std::make_shared<T>();
 	}
 
 	/**
@@ -49,42 +73,16 @@ namespace Serialization {
 	 * @return true if rhs can be assigned to lhs, false otherwise
 	 */
 	static bool is_assignable(Type lhs, Type rhs) {
-		if (lhs == rhs) return true;
-		std::map<Type, TypeInfo>::iterator it;
-		while ((it = TypeInfo::TYPES.find(rhs)) != TypeInfo::TYPES.end()) {
-			rhs = it->second.parent;
-			if (lhs == rhs) return true;
-		}
-		return false;
-	}
-
-	/**
-	 * Registers a given type as Serializable
-	 * @tparam T Serializable type
-	 * @param type the enum tag of this type
-	 * @param parent optionally - the parent (base class) of this type
-	 */
-	template <typename T>
-	static void register_type(Type type, Type parent = Type::Unknown) {
-		const auto& it = TypeInfo::TYPES.find(type);
-		if (it != TypeInfo::TYPES.end() && it->second.registered) {
-			throw std::runtime_error("the specified type is already registered");
-		}
-		TypeInfo::TYPES[type] = {true, build_constructor<T>(), parent, typeid(T).name()};
+		return lhs == rhs || TypeInfo::get(rhs).ancestors.test(static_cast<uint8_t>(lhs));
 	}
 
 	/**
-	 * Resolves and registers information about serializable type `T`
+	 * Gets the Type tag of serializable type `T`
 	 * @tparam T Serializable object
 	 */
 	template <typename T>
-	static Type get_type() {
-		auto type = std::type_index(typeid(T));
-		auto it = TypeInfo::NATIVE_TYPES.find(type);
-		if (it == TypeInfo::NATIVE_TYPES.end()) {
-			return (TypeInfo::NATIVE_TYPES[type] = T().getType());
-		}
-		return it->second;
+	static constexpr Type get_type() {
+		return T::TYPE;
 	}
 
 	/**
@@ -92,12 +90,61 @@ namespace Serialization {
 	 * @param type Serializable type
 	 */
 	static std::string get_type_name(Type type) {
-		const auto& it = TypeInfo::TYPES.find(type);
-		if (it != TypeInfo::TYPES.end() && it->second.name)
-			return it->second.name;
+		const auto& info = TypeInfo::get(type);
+		if (info.registered && info.name)
+			return info.name;
 		return "#" + std::to_string(static_cast<int>(type));
 	}
 
+	/**
+	 * Stores the information about a serializable type
+	 * @param type the enum tag of this type
+	 * @param parent the parent (base class) of this type
+	 * @param constructor constructor of this type, or nullptr for base types
+	 * @param name display name of this type
+	 */
+	static void register_info(Type type, Type parent, std::shared_ptr<Serializable> (*constructor)(), const char* name) {
+		auto& info = TypeInfo::get(type);
+		if (info.registered)
+			throw std::runtime_error("the specified type is already registered");
+		const auto& parentInfo = TypeInfo::get(parent);
+		if (parent != Type::Unknown && !parentInfo.registered)
+			throw std::runtime_error("the parent type has to be registered first");
+		info.registered = true;
+		info.constructor = constructor;
+		info.parent = parent;
+		info.name = name;
+		info.ancestors = parentInfo.ancestors;
+		info.ancestors.set(static_cast<uint8_t>(Type::Unknown));
+		info.ancestors.set(static_cast<uint8_t>(parent));
+		info.ancestors.set(static_cast<uint8_t>(type));
+	}
+
+	/**
+	 * Bounds the encoded size of a registered type, see decode_payload
+	 * @param type Serializable type
+	 * @param maxSize max encoded size in bytes, including the type tag
+	 */
+	static void set_max_size(Type type, size_t maxSize) {
+		auto& info = TypeInfo::get(type);
+		if (!info.registered)
+			throw std::runtime_error("unregistered target type " + get_type_name(type));
+		info.maxSize = maxSize;
+	}
+
+	/**
+	 * Registers a given type as Serializable
+	 * @tparam T Serializable type
+	 * @param type the enum tag of this type
+	 * @param parent optionally - the parent (base class) of this type
+	 */
+	template <typename T>
+	static void register_type(Type type, Type parent = Type::Unknown) {
+		if (T().getType() != type)
+			throw std::runtime_error("the type tag does not match the object type");
+		register_info(type, parent, construct<T>, typeid(T).name());
+	}
+
 	template <typename T>
 	static void register_type() {
 		register_type<T>(get_type<T>());
@@ -120,11 +167,7 @@ namespace Serialization {
 	*/
 	template <typename T>
 	static void register_base_type(Type type, Type parent = Type::Unknown) {
-		const auto& it = TypeInfo::TYPES.find(type);
-		if (it != TypeInfo::TYPES.end() && it->second.registered)
-			throw std::runtime_error("the specified type is already registered");
-		TypeInfo::TYPES[type] = {true, nullptr, parent, typeid(T).name()};
-		TypeInfo::NATIVE_TYPES[std::type_index(typeid(T))] = type;
+		register_info(type, parent, nullptr, typeid(T).name());
 	}
 
 
@@ -137,19 +180,21 @@ namespace Serialization {
 	 */
 	template <typename T>
 	static std::shared_ptr<T> new_instance(Type baseType, Type type) {
-		auto& TYPES = TypeInfo::TYPES;
-		if (baseType != Type::Unknown && TYPES.find(baseType) == TYPES.end())
+		if (baseType != Type::Unknown && !TypeInfo::get(baseType).registered)
 			throw std::runtime_error("unregistered base type " + get_type_name(baseType));
-		if (TYPES.find(type) == TYPES.end())
+		const auto& info = TypeInfo::get(type);
+		if (!info.registered)
 			throw std::runtime_error("unregistered target type " + get_type_name(type));
 		if (!is_assignable(baseType, type))
 			throw std::runtime_error(
 				"target type is not derived from given base type " + get_type_name(baseType) + " <- " +
 				get_type_name(type));
-		auto ctor = TYPES[type].constructor;
-		if (ctor == nullptr)
+		if (info.constructor == nullptr)
 			throw std::runtime_error("target type is a base type " + get_type_name(type));
-		auto ptr = ctor();
+		auto ptr = info.constructor();
+		// the ancestry check above already guarantees the cast for T's own tag
+		if (baseType == get_type<T>())
+			return std::static_pointer_cast<T>(ptr);
 		return std::dynamic_pointer_cast<T>(ptr);
 	}
 
@@ -158,15 +203,12 @@ namespace Serialization {
 	 * @param type Serializable type
 	 */
 	static std::shared_ptr<Serializable> new_instance(Type type) {
-		auto& TYPES = TypeInfo::TYPES;
-		if (TYPES.find(type) == TYPES.end())
+		const auto& info = TypeInfo::get(type);
+		if (!info.registered)
 			throw std::runtime_error("unregistered target type " + get_type_name(type));
-		auto ctor = TYPES[type].constructor;
-		if (ctor == nullptr)
+		if (info.constructor == nullptr)
 			throw std::runtime_error("target type is a base type " + get_type_name(type));
-		auto ptr = ctor();
-		return ptr;
-
+		return info.constructor();
 	}
 
 	template <typename T>
@@ -213,6 +255,68 @@ namespace Serialization {
 		return new_instance(type);
 	}
 
+	/**
+	* Creates a new instance of given Serializable type from the buffer identifier, without consuming it
+	* @tparam T the base-class pointer type
+	* @param baseType base type
+	* @param source binary reader
+	* @return shared pointer to an instance of given type
+	*/
+	template <typename T>
+	static std::shared_ptr<T> new_instance(Type baseType, const BinaryReader& source) {
+		return new_instance<T>(baseType, static_cast<Type>(source.peek()));
+	}
+
+	/**
+	 * Creates a new instance of given Serializable type from the buffer identifier, without consuming it
+	 * @tparam T the Serializable class
+	 * @param source binary reader
+	 * @return shared pointer to an instance of given type
+	 */
+	template <typename T>
+	static std::shared_ptr<T> new_instance(const BinaryReader& source) {
+		return new_instance<T>(get_type<T>(), source);
+	}
+
+	/**
+	 * Creates a new instance of given Serializable type from the buffer identifier, without consuming it
+	 * @param source binary reader
+	 * @return shared pointer to an instance of given type
+	 */
+	static std::shared_ptr<Serializable> new_instance(const BinaryReader& source) {
+		return new_instance(static_cast<Type>(source.peek()));
+	}
+
+	/**
+	 * Decodes an object received from an untrusted peer.
+	 * The payload is rejected before construction if it exceeds the max size of its type,
+	 * and every decoded length is checked against the remaining bytes and the given limits.
+	 * Invalid field values rejected by the model setters are reported as std::runtime_error as well.
+	 * @param data payload, starting with the type tag
+	 * @param length payload length
+	 * @param format wire format of the payload
+	 * @param limits limits of decoded strings and collections
+	 * @return shared pointer to the decoded object
+	 */
+	static std::shared_ptr<Serializable> decode_payload(const byte_t* data, size_t length, WireFormat format,
+	                                                    const DecodeLimits& limits) {
+		BinaryReader reader(data, length);
+		reader.setFormat(format);
+		reader.setLimits(limits);
+		const auto type = static_cast<Type>(reader.peek());
+		const auto maxSize = TypeInfo::get(type).maxSize;
+		if (maxSize > 0 && length > maxSize)
+			throw std::runtime_error("payload exceeds the max size of type " + get_type_name(type));
+		auto obj = new_instance(reader);
+		try {
+			obj->deserialize(reader);
+		}
+		catch (std::invalid_argument& ex) {
+			throw std::runtime_error(std::string("Invalid field value: ") + ex.what());
+		}
+		return obj;
+	}
+
 	/**
 	 * Deserializes a new instance of given Serializable type from input stream identifier
 	 * @param src input stream
@@ -224,11 +328,26 @@ namespace Serialization {
 		instance->deserialize(src);
 		return *instance;
 	}
+
 	/**
-	 * Creates a function to read the target type `T` (or a derived one) from the source stream.
+	 * Deserializes a new instance of given Serializable type from the buffer identifier
+	 * @param src binary reader
+	 * @return shared pointer to an instance of given type
 	 */
 	template <typename T>
-	static std::function<T(std::istream&)> get_type_deserializer() {
-		return get_instance<T>;
+	static T get_instance(BinaryReader& src) {
+		auto instance = new_instance<T>(src);
+		instance->deserialize(src);
+		return *instance;
+	}
+	/**
+	 * Creates a function to read the target type `T` (or a derived one) from the source.
+	 * @tparam TSource std::istream or BinaryReader
+	 */
+	template <typename T, typename TSource = BinaryReader>
+	static std::function<T(TSource&)> get_type_deserializer() {
+		return [](TSource& src) {
+			return get_instance<T>(src);
+		};
 	}
 }
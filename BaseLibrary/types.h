@@ -4,3 +4,4 @@ typedef uint8_t byte_t;
 typedef uint8_t* pbyte_t;
 typedef uint32_t content_len_t;
 typedef uint64_t identity_t;
+typedef uint32_t job_id_t;
@@ -0,0 +1,289 @@
+#include "utf8.h"
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define UTF8_SSE2
+#endif
+
+namespace {
+	const char32_t REPLACEMENT_CHARACTER = 0xFFFD;
+	/**
+	 * Marks a malformed sequence, never a valid code point
+	 */
+	const char32_t INVALID_SEQUENCE = 0xFFFFFFFF;
+	const bool WIDE_UTF16 = sizeof(wchar_t) == 2;
+
+	/**
+	 * Widens the leading ASCII bytes
+	 * 
+	 * @return size_t number of converted characters
+	 */
+	size_t widenAscii(const uint8_t* src, size_t length, wchar_t* dst) {
+		size_t i = 0;
+#ifdef UTF8_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		for (; i + 16 <= length; i += 16) {
+			const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			if (_mm_movemask_epi8(bytes))
+				break;
+			const __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+			const __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+			auto* out = reinterpret_cast<__m128i*>(dst + i);
+			if (WIDE_UTF16) {
+				_mm_storeu_si128(out, lo);
+				_mm_storeu_si128(out + 1, hi);
+			}
+			else {
+				_mm_storeu_si128(out, _mm_unpacklo_epi16(lo, zero));
+				_mm_storeu_si128(out + 1, _mm_unpackhi_epi16(lo, zero));
+				_mm_storeu_si128(out + 2, _mm_unpacklo_epi16(hi, zero));
+				_mm_storeu_si128(out + 3, _mm_unpackhi_epi16(hi, zero));
+			}
+		}
+#else
+		for (; i + 8 <= length; i += 8) {
+			uint64_t word;
+			std::memcpy(&word, src + i, sizeof(word));
+			if (word & 0x8080808080808080ULL)
+				break;
+			for (size_t j = 0; j < 8; j++)
+				dst[i + j] = src[i + j];
+		}
+#endif
+		for (; i < length && src[i] < 0x80; i++)
+			dst[i] = src[i];
+		return i;
+	}
+
+	/**
+	 * Narrows the leading ASCII characters
+	 * 
+	 * @return size_t number of converted characters
+	 */
+	size_t narrowAscii(const wchar_t* src, size_t length, uint8_t* dst) {
+		size_t i = 0;
+#ifdef UTF8_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const auto* in = reinterpret_cast<const __m128i*>(src);
+		if (WIDE_UTF16) {
+			const __m128i mask = _mm_set1_epi16(static_cast<short>(0xff80));
+			for (; i + 16 <= length; i += 16, in += 2) {
+				const __m128i a = _mm_loadu_si128(in);
+				const __m128i b = _mm_loadu_si128(in + 1);
+				const __m128i high = _mm_and_si128(_mm_or_si128(a, b), mask);
+				if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, zero)) != 0xffff)
+					break;
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(a, b));
+			}
+		}
+		else {
+			const __m128i mask = _mm_set1_epi32(static_cast<int>(0xffffff80));
+			for (; i + 16 <= length; i += 16, in += 4) {
+				const __m128i a = _mm_loadu_si128(in);
+				const __m128i b = _mm_loadu_si128(in + 1);
+				const __m128i c = _mm_loadu_si128(in + 2);
+				const __m128i d = _mm_loadu_si128(in + 3);
+				const __m128i high = _mm_and_si128(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d)), mask);
+				if (_mm_movemask_epi8(_mm_cmpeq_epi32(high, zero)) != 0xffff)
+					break;
+				// all values are below 0x80, so the saturating packs are exact
+				const __m128i ab = _mm_packs_epi32(a, b);
+				const __m128i cd = _mm_packs_epi32(c, d);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(ab, cd));
+			}
+		}
+#endif
+		for (; i < length && static_cast<uint32_t>(src[i]) < 0x80; i++)
+			dst[i] = static_cast<uint8_t>(src[i]);
+		return i;
+	}
+
+	/**
+	 * Decodes a single multi-byte sequence
+	 * 
+	 * @param codePoint output code point, INVALID_SEQUENCE for malformed sequences
+	 * @return size_t number of consumed bytes
+	 */
+	size_t decodeSequence(const uint8_t* src, size_t length, char32_t* codePoint) {
+		*codePoint = INVALID_SEQUENCE;
+		const uint8_t lead = src[0];
+		size_t count;
+		uint8_t min = 0x80, max = 0xbf;
+		if (lead >= 0xc2 && lead <= 0xdf) {
+			count = 2;
+		}
+		else if (lead >= 0xe0 && lead <= 0xef) {
+			count = 3;
+			// no overlong forms and no surrogates
+			if (lead == 0xe0)
+				min = 0xa0;
+			else if (lead == 0xed)
+				max = 0x9f;
+		}
+		else if (lead >= 0xf0 && lead <= 0xf4) {
+			count = 4;
+			// no overlong forms and nothing above U+10FFFF
+			if (lead == 0xf0)
+				min = 0x90;
+			else if (lead == 0xf4)
+				max = 0x8f;
+		}
+		else {
+			return 1;
+		}
+
+		char32_t value = lead & (0x7f >> count);
+		for (size_t i = 1; i < count; i++) {
+			if (i >= length || src[i] < min || src[i] > max)
+				return i;
+			value = value << 6 | (src[i] & 0x3f);
+			min = 0x80;
+			max = 0xbf;
+		}
+		*codePoint = value;
+		return count;
+	}
+
+	/**
+	 * Reads a single code point from a wide string
+	 * 
+	 * @param codePoint output code point, U+FFFD for unpaired surrogates or invalid values
+	 * @return size_t number of consumed characters
+	 */
+	size_t readWide(const wchar_t* src, size_t length, char32_t* codePoint) {
+		const auto value = static_cast<char32_t>(src[0]) & (WIDE_UTF16 ? 0xffff : 0xffffffff);
+		if (value >= 0xd800 && value <= 0xdbff && WIDE_UTF16 && length > 1) {
+			const auto low = static_cast<char32_t>(src[1]) & 0xffff;
+			if (low >= 0xdc00 && low <= 0xdfff) {
+				*codePoint = 0x10000 + ((value - 0xd800) << 10) + (low - 0xdc00);
+				return 2;
+			}
+		}
+		*codePoint = (value >= 0xd800 && value <= 0xdfff) || value > 0x10ffff ? REPLACEMENT_CHARACTER : value;
+		return 1;
+	}
+
+	/**
+	 * Writes a code point into a wide string
+	 * 
+	 * @return size_t number of written characters
+	 */
+	size_t writeWide(char32_t codePoint, wchar_t* dst) {
+		if (WIDE_UTF16 && codePoint >= 0x10000) {
+			codePoint -= 0x10000;
+			dst[0] = static_cast<wchar_t>(0xd800 + (codePoint >> 10));
+			dst[1] = static_cast<wchar_t>(0xdc00 + (codePoint & 0x3ff));
+			return 2;
+		}
+		dst[0] = static_cast<wchar_t>(codePoint);
+		return 1;
+	}
+
+	/**
+	 * Writes a code point above U+007F as UTF-8
+	 * 
+	 * @return size_t number of written bytes
+	 */
+	size_t writeSequence(char32_t codePoint, uint8_t* dst) {
+		if (codePoint < 0x800) {
+			dst[0] = static_cast<uint8_t>(0xc0 | codePoint >> 6);
+			dst[1] = static_cast<uint8_t>(0x80 | (codePoint & 0x3f));
+			return 2;
+		}
+		if (codePoint < 0x10000) {
+			dst[0] = static_cast<uint8_t>(0xe0 | codePoint >> 12);
+			dst[1] = static_cast<uint8_t>(0x80 | (codePoint >> 6 & 0x3f));
+			dst[2] = static_cast<uint8_t>(0x80 | (codePoint & 0x3f));
+			return 3;
+		}
+		dst[0] = static_cast<uint8_t>(0xf0 | codePoint >> 18);
+		dst[1] = static_cast<uint8_t>(0x80 | (codePoint >> 12 & 0x3f));
+		dst[2] = static_cast<uint8_t>(0x80 | (codePoint >> 6 & 0x3f));
+		dst[3] = static_cast<uint8_t>(0x80 | (codePoint & 0x3f));
+		return 4;
+	}
+}
+
+namespace Utf8 {
+	std::string fromWide(const std::wstring& str) {
+		const auto length = str.size();
+		if (length == 0)
+			return std::string();
+		// a UTF-16 unit takes at most 3 bytes (4 for a pair), a UTF-32 one at most 4
+		std::string result(length * (WIDE_UTF16 ? 3 : 4), '\0');
+		const auto* src = str.data();
+		auto* dst = reinterpret_cast<uint8_t*>(&result[0]);
+		size_t in = 0, out = 0;
+		while (in < length) {
+			const auto ascii = narrowAscii(src + in, length - in, dst + out);
+			in += ascii;
+			out += ascii;
+			if (in >= length)
+				break;
+			char32_t codePoint;
+			in += readWide(src + in, length - in, &codePoint);
+			out += writeSequence(codePoint, dst + out);
+		}
+		result.resize(out);
+		return result;
+	}
+
+	std::wstring toWide(const std::string& str) {
+		const auto length = str.size();
+		if (length == 0)
+			return std::wstring();
+		// every character takes at least as many bytes as wide characters
+		std::wstring result(length, L'\0');
+		const auto* src = reinterpret_cast<const uint8_t*>(str.data());
+		auto* dst = &result[0];
+		size_t in = 0, out = 0;
+		while (in < length) {
+			const auto ascii = widenAscii(src + in, length - in, dst + out);
+			in += ascii;
+			out += ascii;
+			if (in >= length)
+				break;
+			char32_t codePoint;
+			in += decodeSequence(src + in, length - in, &codePoint);
+			out += writeWide(codePoint == INVALID_SEQUENCE ? REPLACEMENT_CHARACTER : codePoint, dst + out);
+		}
+		result.resize(out);
+		return result;
+	}
+
+	size_t wideLength(const std::string& str) {
+		const auto length = str.size();
+		const auto* src = reinterpret_cast<const uint8_t*>(str.data());
+		size_t in = 0, count = 0;
+		while (in < length) {
+			if (src[in] < 0x80) {
+				in++;
+				count++;
+				continue;
+			}
+			char32_t codePoint;
+			in += decodeSequence(src + in, length - in, &codePoint);
+			count += WIDE_UTF16 && codePoint >= 0x10000 && codePoint != INVALID_SEQUENCE ? 2 : 1;
+		}
+		return count;
+	}
+
+	bool isValid(const std::string& str) {
+		const auto length = str.size();
+		const auto* src = reinterpret_cast<const uint8_t*>(str.data());
+		size_t in = 0;
+		while (in < length) {
+			if (src[in] < 0x80) {
+				in++;
+				continue;
+			}
+			char32_t codePoint;
+			in += decodeSequence(src + in, length - in, &codePoint);
+			if (codePoint == INVALID_SEQUENCE)
+				return false;
+		}
+		return true;
+	}
+}
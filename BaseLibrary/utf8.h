@@ -0,0 +1,39 @@
+#pragma once
+#include <string>
+
+/**
+ * Conversions between UTF-8, used for storing and sending text, and the platform wide strings
+ * used by the UI (UTF-16 on Windows, UTF-32 elsewhere).
+ * Runs of ASCII characters are converted 16 at a time with SSE2, when available.
+ * Invalid input is never rejected, every malformed sequence is replaced by U+FFFD.
+ */
+namespace Utf8 {
+	/**
+	 * Converts a wide string into UTF-8
+	 * 
+	 * @param str UTF-16 or UTF-32 string, depending on the size of wchar_t
+	 * @return std::string UTF-8 string
+	 */
+	std::string fromWide(const std::wstring& str);
+	/**
+	 * Converts a UTF-8 string into a wide string
+	 * 
+	 * @param str UTF-8 string
+	 * @return std::wstring UTF-16 or UTF-32 string, depending on the size of wchar_t
+	 */
+	std::wstring toWide(const std::string& str);
+	/**
+	 * Counts the wide characters toWide would produce, without converting
+	 * 
+	 * @param str UTF-8 string
+	 * @return size_t length of the wide string
+	 */
+	size_t wideLength(const std::string& str);
+	/**
+	 * Checks whether the given bytes are well-formed UTF-8
+	 * 
+	 * @param str UTF-8 string
+	 * @return true if no sequence would be replaced by toWide
+	 */
+	bool isValid(const std::string& str);
+}
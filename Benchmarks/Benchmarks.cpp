@@ -0,0 +1,38 @@
+#include <cstring>
+#include "bench.h"
+#include "BaseLibrary.h"
+
+/**
+ * Runs the benchmark suites selected by name (or all of them if none is given).
+ * Usage: Benchmarks [all|serialization|protocol|server|manager|fuzz] [--json results.json]
+ */
+int main(int argc, char** argv) {
+	const char* suite = "all";
+	const char* jsonPath = nullptr;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+			jsonPath = argv[++i];
+		else
+			suite = argv[i];
+	}
+	const bool all = std::strcmp(suite, "all") == 0;
+
+	InitializeBaseLibrary();
+	if (all || std::strcmp(suite, "serialization") == 0)
+		runSerializationBenchmark();
+	if (all || std::strcmp(suite, "protocol") == 0)
+		runProtocolBenchmark();
+	if (all || std::strcmp(suite, "server") == 0)
+		runServerBenchmark();
+	if (all || std::strcmp(suite, "manager") == 0)
+		runManagerBenchmark();
+	if (all || std::strcmp(suite, "fuzz") == 0)
+		runFuzzBenchmark();
+	ShutdownBaseLibrary();
+
+	if (jsonPath && !writeMetricsJson(jsonPath)) {
+		std::fprintf(stderr, "could not write %s\n", jsonPath);
+		return 1;
+	}
+	return 0;
+}
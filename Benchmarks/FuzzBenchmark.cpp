@@ -0,0 +1,122 @@
+#include "bench.h"
+#include "models.h"
+#include "net_constants.h"
+
+namespace {
+	typedef std::vector<byte_t> input_t;
+
+	/**
+	 * Inputs in the layout of Fuzz/DecodeFuzzer.cpp: the wire format, followed by the frame payload
+	 */
+	struct Corpus {
+		std::vector<input_t> inputs;
+		size_t bytes = 0;
+
+		void add(input_t input) {
+			bytes += input.size() - 1;
+			inputs.push_back(std::move(input));
+		}
+	};
+
+	/**
+	 * Minimal linear congruential generator, so that the mutated corpus is the same on every run
+	 */
+	class Lcg {
+		uint32_t _state;
+	public:
+		explicit Lcg(uint32_t seed) : _state(seed) { }
+		uint32_t next(uint32_t bound) {
+			_state = _state * 1664525u + 1013904223u;
+			return (_state >> 8) % bound;
+		}
+	};
+
+	input_t encode(const Serializable& obj, WireFormat format) {
+		BinaryWriter writer(obj.serializedSize(format) + 1);
+		write_primitive(writer, static_cast<byte_t>(format));
+		writer.setFormat(format);
+		obj.serialize(writer);
+		return input_t(writer.data(), writer.data() + writer.getPosition());
+	}
+
+	std::vector<std::shared_ptr<Serializable>> buildSeeds() {
+		const wchar_t* jobs[] = { L"Kucharz", L"Kelner", L"Zmywak", L"Dostawca", L"Kierownik zmiany" };
+		const Shift shift(DateTime(2020, 6, 1, 8, 0, 0), 8, L"Kierownik zmiany", 12, 345);
+		const ShiftWorker worker(L"Ma\u0142gorzata", L"Wi\u015bniewska", L"Kucharz", 12);
+		auto shifts = std::make_shared<S2C_GetShiftsReply>(1, Date(2020, 6, 1));
+		auto workers = std::make_shared<S2C_GetWorkersReply>();
+		auto sync = std::make_shared<S2C_ClientSync>();
+		for (int i = 0; i < 50; i++) {
+			const Shift other(DateTime(2020, 6, 1, i % 16, 0, 0), 1 + i % 7, jobs[i % 5], 1 + i % 40, i + 1);
+			shifts->getShifts().insert(other);
+			workers->getWorkers()[i + 1] = ShiftWorker(L"Jan", L"Kowalski", jobs[i % 5], i + 1);
+			sync->getRemovedShifts().insert(1000 + i * 3);
+			sync->getChangedShifts().insert(other);
+		}
+		return {
+			std::make_shared<Ping>(Ping::CAPABILITY_COMPACT), std::make_shared<PingReply>(),
+			std::make_shared<DateTime>(2020, 6, 1, 8, 30, 0), std::make_shared<Shift>(shift),
+			std::make_shared<ShiftWorker>(worker), std::make_shared<C2S_Authorize>("0123456789abcdef"),
+			std::make_shared<C2S_GetShiftsByDay>(Date(2020, 6, 1)), std::make_shared<C2S_InsertShift>(shift),
+			std::make_shared<C2S_InsertWorker>(worker), std::make_shared<C2S_DeleteShift>(345),
+			std::make_shared<C2S_DeleteWorker>(12), std::make_shared<C2S_GetWorkers>(),
+			std::make_shared<S2C_AuthorizeReply>(1), std::make_shared<S2C_InsertShiftReply>(1, shift),
+			shifts, workers, sync
+		};
+	}
+
+	/**
+	 * Builds the seed inputs in both formats, each followed by its truncations and corrupted copies
+	 */
+	Corpus buildCorpus() {
+		Corpus corpus;
+		Lcg random(0x5eed);
+		for (const auto& seed : buildSeeds()) {
+			for (auto format : { WireFormat::Fixed, WireFormat::Compact }) {
+				const auto input = encode(*seed, format);
+				corpus.add(input);
+				for (size_t i = 1; i <= 16; i++)
+					corpus.add(input_t(input.begin(), input.begin() + 1 + (input.size() - 1) * i / 17));
+				for (int i = 0; i < 64; i++) {
+					auto mutated = input;
+					// the type tag is left intact, so that every mutation reaches its deserialize
+					const auto position = 2 + random.next(static_cast<uint32_t>(mutated.size() - 2 + 1));
+					if (position >= mutated.size())
+						continue;
+					mutated[position] = i % 2 ? 0xff : static_cast<byte_t>(random.next(256));
+					corpus.add(std::move(mutated));
+				}
+			}
+		}
+		return corpus;
+	}
+}
+
+void runFuzzBenchmark() {
+	const auto corpus = buildCorpus();
+	const DecodeLimits limits = { MAX_STRING_LENGTH, MAX_COLLECTION_SIZE };
+	size_t rejected = 0, unexpected = 0;
+	const auto ns = measureNs([&] {
+		rejected = 0;
+		unexpected = 0;
+		for (const auto& input : corpus.inputs) {
+			const auto format = static_cast<WireFormat>(input[0]);
+			try {
+				decode_payload(input.data() + 1, input.size() - 1, format, limits);
+			}
+			catch (std::runtime_error&) {
+				rejected++;
+			}
+			catch (std::exception&) {
+				unexpected++;
+			}
+		}
+	});
+	printMetric("fuzz", "corpus/inputs", static_cast<double>(corpus.inputs.size()), "inputs");
+	printMetric("fuzz", "corpus/size", static_cast<double>(corpus.bytes), "B");
+	printMetric("fuzz", "corpus/rejected", 100.0 * rejected / corpus.inputs.size(), "%");
+	printMetric("fuzz", "decode", ns / corpus.inputs.size(), "ns/input");
+	printMetric("fuzz", "decode_throughput", corpus.bytes / ns * 1e9 / (1 << 20), "MB/s");
+	if (unexpected)
+		std::fprintf(stderr, "fuzz: %zu inputs failed with an exception other than std::runtime_error\n", unexpected);
+}
@@ -0,0 +1,448 @@
+#include "bench.h"
+#include "Checkpointer.h"
+#include "Connection.h"
+#include "RestaurantManager.h"
+#include "WriteAheadLog.h"
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <random>
+#include <thread>
+
+namespace {
+	const int VIEWED_DAYS = 30;
+	const int SHIFTS_PER_DAY = 40;
+	const int WRITE_PERCENT = 5;
+	const double RUN_NS = 3e8;
+	const int READERS = 4;
+	const int BULK_SHIFTS = 2000;
+	const int CROWDED_JOBS = 1000;
+	const int SHIFTS_PER_JOB = 10;
+	const int STORED_SHIFTS = 1000000;
+	const int STORED_PER_DAY = 50;
+	const char* const LOG_PATH = "bench.wal";
+	const char* const SNAPSHOT_PATH = "bench.bin";
+
+	/**
+	 * Encodes the replies like a real connection would, then drops them
+	 */
+	class DiscardingConnection : public ConnectionBase {
+	protected:
+		void closeError(const std::exception& exception) override {}
+		bool readAsync() override {
+			return false;
+		}
+	public:
+		size_t bytes = 0;
+		/* replies of changes are written by the write-ahead log once they are durable */
+		std::atomic<size_t> writes{0};
+
+		DiscardingConnection() : ConnectionBase(false) {
+			getData().put("Permissions", UserPermissions::View | UserPermissions::Insert);
+		}
+		bool isAlive() const override {
+			return true;
+		}
+		bool setReadingAsync(bool readAsync) override {
+			return false;
+		}
+		int connect(const std::string& host, int port) override {
+			return 0;
+		}
+		int connect(PSocket* socket) override {
+			return 0;
+		}
+		void writeSync(const Serializable& payload) override {
+			BinaryWriter writer;
+			payload.serialize(writer);
+			bytes += writer.getPosition();
+		}
+		using ConnectionBase::writeAsync;
+		void writeAsync(const Serializable& payload, std::function<void(bool)> completion) override {
+			writeSync(payload);
+			writes++;
+			if (completion)
+				completion(true);
+		}
+		std::shared_ptr<Serializable> readSync() override {
+			return nullptr;
+		}
+		/**
+		 * Waits for a number of packets in total, as a client waits for the reply of its change
+		 *
+		 * @param count number of packets
+		 */
+		void waitWrites(size_t count) {
+			while (writes < count)
+				std::this_thread::yield();
+		}
+	};
+
+	/**
+	 * Runs the read/write mix from the given number of threads
+	 *
+	 * @param manager manager with the viewed days already filled
+	 * @param threads number of concurrent clients
+	 * @param global lock taken around every request, as when the whole manager was guarded by a single lock
+	 * @return double requests handled per second
+	 */
+	double runMix(RestaurantManager& manager, int threads, std::mutex* global) {
+		std::atomic<bool> stop{false};
+		std::atomic<size_t> total{0};
+		std::vector<std::thread> workers;
+		for (int t = 0; t < threads; t++) {
+			workers.emplace_back([&, t] {
+				DiscardingConnection connection;
+				std::mt19937 random(t);
+				// every writer moves a shift of its own job, so its edits never collide with the others
+				auto own = manager.insertShift(Shift(DateTime(2020, 6, 1, 22, 0, 0), 1, "Writer " + std::to_string(t)));
+				size_t requests = 0;
+				while (!stop) {
+					const Date day(2020, 6, 1 + random() % VIEWED_DAYS);
+					std::unique_lock<std::mutex> guard;
+					if (global)
+						guard = std::unique_lock<std::mutex>(*global);
+					if (static_cast<int>(random() % 100) < WRITE_PERCENT) {
+						own.setStartTime(DateTime(day.getYear(), day.getMonth(), day.getDay(), 22, 0, 0));
+						manager.handleInsertShift(&connection, C2S_InsertShift(own, true), 0);
+					}
+					else {
+						manager.handleGetShiftsByDay(&connection, C2S_GetShiftsByDay(day), 0);
+					}
+					requests++;
+				}
+				manager.deleteShift(own.getId());
+				total += requests;
+			});
+		}
+		Stopwatch watch;
+		std::this_thread::sleep_for(std::chrono::nanoseconds(static_cast<long long>(RUN_NS)));
+		stop = true;
+		for (auto& worker : workers)
+			worker.join();
+		return total / (watch.elapsedNs() / 1e9);
+	}
+
+	/**
+	 * Measures the latency of day listings while another thread imports and then removes a batch of shifts
+	 *
+	 * @param manager manager with the viewed days already filled
+	 * @param global lock taken around every request and edit, as when the whole manager was guarded by a single lock
+	 * @param latencies receives the latency of every listing, in nanoseconds
+	 */
+	void runBulkEdits(RestaurantManager& manager, std::mutex* global, std::vector<double>& latencies) {
+		std::atomic<bool> stop{false};
+		std::vector<std::vector<double>> samples(READERS);
+		std::vector<std::thread> readers;
+		for (int t = 0; t < READERS; t++) {
+			readers.emplace_back([&, t] {
+				DiscardingConnection connection;
+				std::mt19937 random(t);
+				while (!stop) {
+					const Date day(2020, 6, 1 + random() % VIEWED_DAYS);
+					Stopwatch watch;
+					{
+						std::unique_lock<std::mutex> guard;
+						if (global)
+							guard = std::unique_lock<std::mutex>(*global);
+						manager.handleGetShiftsByDay(&connection, C2S_GetShiftsByDay(day), 0);
+					}
+					samples[t].push_back(watch.elapsedNs());
+				}
+			});
+		}
+		std::vector<identity_t> imported;
+		for (int i = 0; i < BULK_SHIFTS; i++) {
+			std::unique_lock<std::mutex> guard;
+			if (global)
+				guard = std::unique_lock<std::mutex>(*global);
+			const Shift shift(DateTime(2020, 6, 1 + i % VIEWED_DAYS, 20, 0, 0), 1, "Import " + std::to_string(i));
+			imported.push_back(manager.insertShift(shift).getId());
+		}
+		for (auto id : imported) {
+			std::unique_lock<std::mutex> guard;
+			if (global)
+				guard = std::unique_lock<std::mutex>(*global);
+			manager.deleteShift(id);
+		}
+		stop = true;
+		for (auto& reader : readers)
+			reader.join();
+		latencies.clear();
+		for (const auto& thread : samples)
+			latencies.insert(latencies.end(), thread.begin(), thread.end());
+	}
+
+	/**
+	 * Checks a shift against every shift of its day, as done before the interval index
+	 *
+	 * @param shifts shifts of the day
+	 * @param shift checked Shift
+	 * @return whether the shift collides with another one
+	 */
+	bool collidesLinear(const std::vector<Shift>& shifts, const Shift& shift) {
+		const auto start = shift.getStartTime();
+		const auto end = shift.getEndTime();
+		for (const auto& other : shifts) {
+			if (other.getId() == shift.getId() || other.getJobId() != shift.getJobId())
+				continue;
+			if (!((start < other.getStartTime() && end <= other.getStartTime()) || (start >= other.getEndTime())))
+				return true;
+		}
+		return false;
+	}
+
+	/**
+	 * Measures collision checks and inserts on a day with thousands of shifts
+	 */
+	void benchmarkCrowdedDay() {
+		RestaurantManager manager(nullptr);
+		for (int job = 0; job < CROWDED_JOBS; job++) {
+			for (int i = 0; i < SHIFTS_PER_JOB; i++)
+				manager.insertShift(Shift(DateTime(2020, 6, 1, 2 * i, 0, 0), 1, "Job " + std::to_string(job)));
+		}
+		const auto day = manager.getDaySnapshot(Date(2020, 6, 1));
+		const auto name = "crowded_day_" + std::to_string(day->size());
+		// fits between the shifts of its job
+		const Shift probe(DateTime(2020, 6, 1, 1, 0, 0), 1, "Job " + std::to_string(CROWDED_JOBS / 2));
+		bool collides = false;
+		printMetric("manager", name + "/verify_linear", measureNs([&] {
+			collides = collidesLinear(*day, probe) || collides;
+		}), "ns");
+		bool valid = true;
+		printMetric("manager", name + "/verify_indexed", measureNs([&] {
+			valid = manager.verifyShift(probe) && valid;
+		}), "ns");
+		if (collides || !valid)
+			std::fprintf(stderr, "%s: the probe collides with another shift\n", name.c_str());
+		// the published snapshot of the day is rebuilt on every change, which dominates the edit
+		printMetric("manager", name + "/insert_delete", measureNs([&] {
+			manager.deleteShift(manager.insertShift(probe).getId());
+		}), "ns");
+		// a worker with a single shift among all the others
+		printMetric("manager", name + "/delete_worker", measureNs([&] {
+			auto worker = manager.insertWorker(ShiftWorker(L"Jan", L"Kowalski", L"Kelner"));
+			auto shift = probe;
+			shift.setWorkerId(worker.getId());
+			const auto id = manager.insertShift(shift).getId();
+			manager.deleteWorker(worker.getId());
+			manager.deleteShift(id);
+		}), "ns");
+	}
+
+	/**
+	 * Edits shifts from the given number of clients, every reply waiting for its change to be durable
+	 *
+	 * @param manager manager logging its changes, if at all
+	 * @param threads number of concurrent clients
+	 * @param committed receives the number of committed edits
+	 * @return double committed edits per second
+	 */
+	double runCommits(RestaurantManager& manager, int threads, size_t& committed) {
+		std::atomic<bool> stop{false};
+		std::atomic<size_t> total{0};
+		std::vector<std::thread> workers;
+		for (int t = 0; t < threads; t++) {
+			workers.emplace_back([&, t] {
+				DiscardingConnection connection;
+				auto own = manager.insertShift(Shift(DateTime(2020, 7, 1, 8, 0, 0), 1, "Committer " + std::to_string(t)));
+				size_t commits = 0;
+				while (!stop) {
+					own.setStartTime(DateTime(2020, 7, 1 + commits % VIEWED_DAYS, 8, 0, 0));
+					manager.handleInsertShift(&connection, C2S_InsertShift(own, true), 0);
+					connection.waitWrites(++commits);
+				}
+				manager.deleteShift(own.getId());
+				total += commits;
+			});
+		}
+		Stopwatch watch;
+		std::this_thread::sleep_for(std::chrono::nanoseconds(static_cast<long long>(RUN_NS)));
+		stop = true;
+		for (auto& worker : workers)
+			worker.join();
+		committed = total;
+		return total / (watch.elapsedNs() / 1e9);
+	}
+
+	/**
+	 * Measures durable edits at different commit windows of the write-ahead log
+	 */
+	void benchmarkWriteAheadLog() {
+		for (int threads : { 1, 4, 16 }) {
+			const auto name = "wal/threads_" + std::to_string(threads);
+			size_t committed;
+			{
+				RestaurantManager manager(nullptr);
+				printMetric("manager", name + "/no_log", runCommits(manager, threads, committed), "commits/s");
+			}
+			for (int window : { 0, 1, 5, 20 }) {
+				RestaurantManager manager(nullptr);
+				WriteAheadLog log;
+				log.open(LOG_PATH, 0);
+				log.setCommitWindow(std::chrono::milliseconds(window));
+				manager.setWriteAheadLog(&log);
+				const auto syncs = log.getSyncCount();
+				const auto rate = runCommits(manager, threads, committed);
+				const auto batches = log.getSyncCount() - syncs;
+				manager.setWriteAheadLog(nullptr);
+				log.close();
+				std::remove(WriteAheadLog::segmentPath(LOG_PATH, 0).c_str());
+				const auto prefix = name + "/window_" + std::to_string(window) + "ms";
+				printMetric("manager", prefix, rate, "commits/s");
+				// every edit moves a shift, which is logged as a removal and a change
+				printMetric("manager", prefix + "/records_per_sync",
+				            batches ? 2.0 * committed / batches : 0, "records");
+			}
+		}
+	}
+
+	/**
+	 * Saves a snapshot while a client keeps editing shifts, measuring the pause of the writers and the edit latency
+	 *
+	 * @param manager manager holding a large history
+	 * @param name prefix of the metrics
+	 */
+	void benchmarkSnapshot(RestaurantManager& manager, const std::string& name) {
+		WriteAheadLog log;
+		log.open(LOG_PATH, 0);
+		manager.setWriteAheadLog(&log);
+		Checkpointer checkpointer(manager, SNAPSHOT_PATH, &log);
+		std::atomic<bool> stop{false};
+		std::vector<double> latencies;
+		std::thread editor([&] {
+			DiscardingConnection connection;
+			auto own = manager.insertShift(Shift(DateTime(2020, 7, 1, 8, 0, 0), 1, "Editor"));
+			for (int i = 0; !stop; i++) {
+				own.setStartTime(DateTime(2020, 7, 1 + i % VIEWED_DAYS, 8, 0, 0));
+				Stopwatch watch;
+				manager.handleInsertShift(&connection, C2S_InsertShift(own, true), 0);
+				connection.waitWrites(latencies.size() + 1);
+				latencies.push_back(watch.elapsedNs());
+			}
+			manager.deleteShift(own.getId());
+		});
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		checkpointer.checkpoint();
+		stop = true;
+		editor.join();
+		const auto stats = checkpointer.getStats();
+		printMetric("manager", name + "/snapshot_pause", static_cast<double>(stats.lastPause.count()), "us");
+		printMetric("manager", name + "/snapshot_save", static_cast<double>(stats.lastDuration.count()), "ms");
+		printMetric("manager", name + "/snapshot_edit_p50", percentile(latencies, 50) / 1000, "us");
+		printMetric("manager", name + "/snapshot_edit_p99", percentile(latencies, 99) / 1000, "us");
+		printMetric("manager", name + "/snapshot_edits", static_cast<double>(latencies.size()), "edits");
+		manager.setWriteAheadLog(nullptr);
+		log.close();
+		std::remove(WriteAheadLog::segmentPath(LOG_PATH, 1).c_str());
+	}
+
+	/**
+	 * Restarts from the image saved by benchmarkSnapshot, measuring the time until the first requests are served
+	 *
+	 * @param name prefix of the metrics
+	 */
+	void benchmarkImage(const std::string& name) {
+		{
+			Stopwatch watch;
+			RestaurantManager restored(nullptr);
+			Checkpointer loader(restored, SNAPSHOT_PATH);
+			uint64_t segment;
+			const bool loaded = loader.load(segment);
+			printMetric("manager", name + "/image_load", watch.elapsedNs() / 1e6, "ms");
+			watch.restart();
+			const auto day = restored.getDaySnapshot(Date(2001, 6, 14));
+			printMetric("manager", name + "/image_first_day", watch.elapsedNs() / 1000, "us");
+			// the edited day is loaded from the image first
+			watch.restart();
+			restored.insertShift(Shift(DateTime(2001, 6, 14, 22, 0, 0), 1, "Job 0"));
+			printMetric("manager", name + "/image_first_edit", watch.elapsedNs() / 1000, "us");
+			// the index of the workers is built from the whole image on the first query
+			watch.restart();
+			const auto shifts = restored.getShiftsByWorker(1, Date(2000, 1, 1), Date(2100, 1, 1));
+			printMetric("manager", name + "/image_worker_schedule", watch.elapsedNs() / 1e6, "ms");
+			watch.restart();
+			restored.getShiftsByWorker(1, Date(2000, 1, 1), Date(2100, 1, 1));
+			printMetric("manager", name + "/image_worker_schedule_again", watch.elapsedNs() / 1e6, "ms");
+			if (!loaded || day->empty() || shifts.empty())
+				std::printf("image benchmark produced nothing\n");
+		}
+		std::remove(Checkpointer::imagePath(SNAPSHOT_PATH, 0).c_str());
+		std::remove(Checkpointer::imagePath(SNAPSHOT_PATH, 1).c_str());
+	}
+
+	/**
+	 * Measures the memory taken by a large history of shifts and the time to walk all of them
+	 */
+	void benchmarkStorage() {
+		const auto name = "storage_" + std::to_string(STORED_SHIFTS / 1000) + "k";
+		const auto before = getResidentMemory();
+		double elapsed;
+		{
+			RestaurantManager manager(nullptr);
+			Stopwatch watch;
+			for (int i = 0; i < STORED_SHIFTS; i++) {
+				// 5 jobs with 10 shifts each per day, 28 days a month
+				const auto day = i / STORED_PER_DAY;
+				const auto slot = i % STORED_PER_DAY;
+				const DateTime start(2000 + day / (12 * 28), 1 + day / 28 % 12, 1 + day % 28, 2 * (slot / 5), 0, 0);
+				manager.insertShift(Shift(start, 1, "Job " + std::to_string(slot % 5), 1 + i % 100));
+			}
+			elapsed = watch.elapsedNs();
+			printMetric("manager", name + "/insert", elapsed / STORED_SHIFTS, "ns/shift");
+			printMetric("manager", name + "/memory", static_cast<double>(getResidentMemory() - before) / STORED_SHIFTS,
+			            "B/shift");
+
+			watch.restart();
+			const auto size = manager.serializedSize();
+			printMetric("manager", name + "/scan_serialized_size", watch.elapsedNs() / 1e6, "ms");
+			watch.restart();
+			BinaryWriter writer;
+			manager.serialize(writer);
+			printMetric("manager", name + "/serialize", watch.elapsedNs() / 1e6, "ms");
+			watch.restart();
+			RestaurantManager restored(nullptr);
+			BinaryReader reader(writer.data(), writer.getPosition());
+			restored.deserialize(reader);
+			printMetric("manager", name + "/deserialize", watch.elapsedNs() / 1e6, "ms");
+			watch.restart();
+			const auto shifts = manager.getShiftsByWorker(1, Date(2000, 1, 1), Date(2100, 1, 1));
+			printMetric("manager", name + "/worker_schedule", watch.elapsedNs() / 1e6, "ms");
+			if (size == 0 || shifts.empty())
+				std::printf("storage benchmark produced nothing\n");
+
+			benchmarkSnapshot(manager, name);
+		}
+		benchmarkImage(name);
+	}
+}
+
+void runManagerBenchmark() {
+	RestaurantManager manager(nullptr);
+	for (int day = 1; day <= VIEWED_DAYS; day++) {
+		for (int i = 0; i < SHIFTS_PER_DAY; i++)
+			manager.insertShift(Shift(DateTime(2020, 6, day, i % 20, 0, 0), 1, "Job " + std::to_string(i / 20)));
+	}
+
+	const auto cores = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+	std::mutex global;
+	for (int threads = 1; threads <= std::max(4, 2 * cores); threads *= 2) {
+		const auto name = "mix_" + std::to_string(100 - WRITE_PERCENT) + "_" + std::to_string(WRITE_PERCENT) +
+			"/threads_" + std::to_string(threads);
+		printMetric("manager", name + "/sharded", runMix(manager, threads, nullptr), "req/s");
+		printMetric("manager", name + "/single_lock", runMix(manager, threads, &global), "req/s");
+	}
+	printMetric("manager", "hardware_threads", cores, "threads");
+
+	std::vector<double> latencies;
+	runBulkEdits(manager, nullptr, latencies);
+	printMetric("manager", "bulk_edits/snapshot_read_p50", percentile(latencies, 50) / 1000, "us");
+	printMetric("manager", "bulk_edits/snapshot_read_p99", percentile(latencies, 99) / 1000, "us");
+	runBulkEdits(manager, &global, latencies);
+	printMetric("manager", "bulk_edits/single_lock_read_p50", percentile(latencies, 50) / 1000, "us");
+	printMetric("manager", "bulk_edits/single_lock_read_p99", percentile(latencies, 99) / 1000, "us");
+
+	benchmarkCrowdedDay();
+	benchmarkWriteAheadLog();
+	benchmarkStorage();
+}
@@ -0,0 +1,217 @@
+#include "bench.h"
+#include "Connection.h"
+#include "models.h"
+#include "net_constants.h"
+#include "Reactor.h"
+#include <atomic>
+#include <thread>
+
+namespace {
+	const std::string HOST = "127.0.0.1";
+	const int PAIR_PORT = 14347;
+	const int BURST_PORT = 14348;
+	/**
+	 * Number of frames pipelined by the burst benchmark
+	 */
+	const size_t BURST_FRAMES = 10000;
+
+	/**
+	 * Connects two sockets over loopback TCP, the portable equivalent of socketpair()
+	 *
+	 * @param port free local port used to set up the pair
+	 * @return std::pair<PSocket*, PSocket*> client and server end, nullptr if the pair could not be set up
+	 */
+	std::pair<PSocket*, PSocket*> openSocketPair(int port) {
+		std::pair<PSocket*, PSocket*> pair{ nullptr, nullptr };
+		auto* addr = p_socket_address_new(HOST.c_str(), port);
+		auto* listener = p_socket_new(P_SOCKET_FAMILY_INET, P_SOCKET_TYPE_STREAM, P_SOCKET_PROTOCOL_TCP, nullptr);
+		if (listener && p_socket_bind(listener, addr, TRUE, nullptr) && p_socket_listen(listener, nullptr)) {
+			pair.first = p_socket_new(P_SOCKET_FAMILY_INET, P_SOCKET_TYPE_STREAM, P_SOCKET_PROTOCOL_TCP, nullptr);
+			if (pair.first && p_socket_connect(pair.first, addr, nullptr))
+				pair.second = p_socket_accept(listener, nullptr);
+		}
+		if (!pair.second && pair.first) {
+			p_socket_free(pair.first);
+			pair.first = nullptr;
+		}
+		if (listener)
+			p_socket_free(listener);
+		p_socket_address_free(addr);
+		return pair;
+	}
+
+	/**
+	 * Measures the construction of an instance from a type tag, as done for every received frame
+	 */
+	void benchmarkDispatch() {
+		const std::pair<Type, std::string> types[] = {
+			{ Type::_Ping, "ping" }, { Type::_Shift, "shift" },
+			{ Type::_S2C_GetShiftsReply, "get_shifts_reply" }, { Type::_S2C_ClientSync, "client_sync" }
+		};
+		for (const auto& type : types) {
+			std::shared_ptr<Serializable> instance;
+			const auto ns = measureNs([&] {
+				instance = new_instance(type.first);
+			});
+			printMetric("protocol", "new_instance/" + type.second, ns, "ns/op");
+		}
+		const byte_t tag[] = { static_cast<byte_t>(Type::_Shift) };
+		std::shared_ptr<Serializable> instance;
+		const auto ns = measureNs([&] {
+			BinaryReader reader(tag, sizeof(tag));
+			instance = new_instance(reader);
+		});
+		printMetric("protocol", "new_instance/from_buffer", ns, "ns/op");
+	}
+
+	/**
+	 * Measures writeSync on one end of the pair followed by readSync on the other end
+	 *
+	 * @param name name of the measured case
+	 * @param payload sent object
+	 * @param compact whether the connections negotiate the compact format
+	 */
+	void benchmarkFrame(const std::string& name, const Serializable& payload, bool compact) {
+		const auto format = compact ? WireFormat::Compact : WireFormat::Fixed;
+		const auto prefix = "frame/" + name + (compact ? "/compact" : "/fixed");
+		const auto size = payload.serializedSize(format);
+		if (size > MAX_PACKET_SIZE) {
+			std::printf("protocol   %-52s skipped, %zu B exceeds the max packet size\n", prefix.c_str(), size);
+			return;
+		}
+		const auto sockets = openSocketPair(PAIR_PORT);
+		if (!sockets.second) {
+			std::fprintf(stderr, "%s: could not open a socket pair\n", prefix.c_str());
+			return;
+		}
+		Connection sender(false), receiver(false);
+		sender.setCompactEncoding(compact);
+		receiver.setCompactEncoding(compact);
+		sender.connect(sockets.first);
+		receiver.connect(sockets.second);
+		// consume the capability pings
+		sender.readSync();
+		receiver.readSync();
+
+		bool received = true;
+		const auto ns = measureNs([&] {
+			sender.writeSync(payload);
+			const auto obj = receiver.readSync();
+			received = received && obj && obj->getType() == payload.getType();
+		}, 5e8);
+		printMetric("protocol", prefix + "/size", static_cast<double>(size + sizeof(content_len_t)), "B");
+		printMetric("protocol", prefix + "/round_trip", ns, "ns/op");
+		printMetric("protocol", prefix + "/throughput", size / ns * 1e9 / (1 << 20), "MB/s");
+		if (!received)
+			std::fprintf(stderr, "%s: received an unexpected payload\n", prefix.c_str());
+		sender.close();
+		receiver.close();
+	}
+
+	/**
+	 * Counts the received payloads, for connections read by an event loop
+	 */
+	class FrameCounter : public ConnectionObserver {
+	public:
+		std::atomic<size_t> received{ 0 };
+
+		void onPayloadReceived(ConnectionBase* connection, const Serializable& payload, size_t size) override {
+			received++;
+		}
+	};
+
+	/**
+	 * Measures the receiving end of a burst of pipelined frames: the receive calls it takes, and the frame rate
+	 *
+	 * @param name name of the measured case
+	 * @param payload sent object, BURST_FRAMES times
+	 * @param reactor event loop reading the receiving end, or nullptr to read it with readSync
+	 */
+	void benchmarkBurst(const std::string& name, const Serializable& payload, Reactor* reactor) {
+		const auto prefix = "burst/" + name + (reactor ? "/reactor" : "/threads");
+		const auto sockets = openSocketPair(BURST_PORT);
+		if (!sockets.second) {
+			std::fprintf(stderr, "%s: could not open a socket pair\n", prefix.c_str());
+			return;
+		}
+		Connection sender(false), receiver(false);
+		FrameCounter counter;
+		sender.connect(sockets.first);
+		receiver.connect(sockets.second);
+		// consume the capability pings
+		sender.readSync();
+		receiver.readSync();
+		if (reactor) {
+			receiver.subscribe(&counter);
+			receiver.setReactor(reactor);
+			receiver.setReadingAsync(true);
+		}
+
+		const auto calls = receiver.getReceiveCalls();
+		Stopwatch watch;
+		std::thread producer([&sender, &payload] {
+			for (size_t i = 0; i < BURST_FRAMES; i++)
+				sender.writeAsync(payload, nullptr);
+		});
+		size_t received = 0;
+		if (reactor) {
+			const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+			while (counter.received < BURST_FRAMES && std::chrono::steady_clock::now() < deadline)
+				std::this_thread::yield();
+			received = counter.received;
+		}
+		else {
+			for (; received < BURST_FRAMES; received++) {
+				const auto obj = receiver.readSync();
+				if (!obj || obj->getType() != payload.getType())
+					break;
+			}
+		}
+		const auto ns = watch.elapsedNs();
+		producer.join();
+		const auto receiveCalls = receiver.getReceiveCalls() - calls;
+
+		printMetric("protocol", prefix + "/receive_calls", static_cast<double>(receiveCalls), "calls");
+		printMetric("protocol", prefix + "/frames_per_call", static_cast<double>(received) / (std::max)(receiveCalls, static_cast<size_t>(1)), "frames");
+		printMetric("protocol", prefix + "/throughput", received / ns * 1e9, "frames/s");
+		if (received != BURST_FRAMES)
+			std::fprintf(stderr, "%s: received %zu of %zu frames\n", prefix.c_str(), received, BURST_FRAMES);
+		if (reactor)
+			receiver.setReadingAsync(false);
+		sender.close();
+		receiver.close();
+		receiver.unsubscribe(&counter);
+	}
+
+	S2C_GetShiftsReply buildShiftsReply(int count) {
+		const wchar_t* jobs[] = { L"Kucharz", L"Kelner", L"Zmywak", L"Dostawca", L"Kierownik zmiany" };
+		S2C_GetShiftsReply reply(1, Date(2020, 6, 1));
+		for (int i = 0; i < count; i++) {
+			DateTime start(2020, 6, 1 + i % 28, i % 16, 0, 0);
+			reply.getShifts().insert(Shift(start, 1 + i % 7, jobs[i % 5], 1 + i % 40, i + 1));
+		}
+		return reply;
+	}
+}
+
+void runProtocolBenchmark() {
+	benchmarkDispatch();
+	const Ping ping;
+	const auto small = buildShiftsReply(10);
+	const auto large = buildShiftsReply(1000);
+	for (auto compact : { false, true }) {
+		benchmarkFrame("ping", ping, compact);
+		benchmarkFrame("get_shifts_reply_10", small, compact);
+		benchmarkFrame("get_shifts_reply_1k", large, compact);
+	}
+	const C2S_GetShiftsByDay request(Date(2020, 6, 1));
+	benchmarkBurst("ping", ping, nullptr);
+	benchmarkBurst("get_shifts_by_day", request, nullptr);
+	if (Reactor::isSupported()) {
+		Reactor reactor(1);
+		reactor.start();
+		benchmarkBurst("ping", ping, &reactor);
+		benchmarkBurst("get_shifts_by_day", request, &reactor);
+		reactor.stop();
+	}
+}
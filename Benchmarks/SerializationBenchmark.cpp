@@ -0,0 +1,196 @@
+#include "bench.h"
+#include "buffers.h"
+#include "models.h"
+#include "net_constants.h"
+#include "utf8.h"
+
+namespace {
+	const int COLLECTION_SIZES[] = { 10, 1000, 10000 };
+	const wchar_t* JOBS[] = { L"Kucharz", L"Kelner", L"Zmywak", L"Dostawca", L"Kierownik zmiany" };
+	const wchar_t* FIRST_NAMES[] = { L"Jan", L"Anna", L"Zofia", L"\u0141ukasz", L"Ma\u0142gorzata" };
+	const wchar_t* LAST_NAMES[] = { L"Kowalski", L"Nowak", L"Wi\u015bniewska", L"W\u00f3jcik", L"Kami\u0144ska" };
+
+	Shift buildShift(int i) {
+		DateTime start(2020, 6, 1 + i % 28, i % 16, 0, 0);
+		return Shift(start, 1 + i % 7, JOBS[i % 5], 1 + i % 40, i + 1);
+	}
+
+	ShiftWorker buildWorker(int i) {
+		return ShiftWorker(FIRST_NAMES[i % 5], LAST_NAMES[i / 5 % 5], JOBS[i % 5], i + 1);
+	}
+
+	/**
+	 * Builds a reply listing the given number of shifts
+	 */
+	S2C_GetShiftsReply buildShiftsReply(int count) {
+		S2C_GetShiftsReply reply(1, Date(2020, 6, 1));
+		for (int i = 0; i < count; i++)
+			reply.getShifts().insert(buildShift(i));
+		return reply;
+	}
+
+	/**
+	 * Builds a reply listing the given number of workers
+	 */
+	S2C_GetWorkersReply buildWorkersReply(int count) {
+		S2C_GetWorkersReply reply;
+		reply.setRequestId(1);
+		for (int i = 0; i < count; i++)
+			reply.getWorkers()[i + 1] = buildWorker(i);
+		return reply;
+	}
+
+	/**
+	 * Builds a broadcast with the given number of changes of each kind
+	 */
+	S2C_ClientSync buildClientSync(int count) {
+		S2C_ClientSync sync;
+		for (int i = 0; i < count; i++) {
+			sync.getRemovedShifts().insert(10000 + i * 3);
+			sync.getRemovedWorkers().insert(500 + i);
+			sync.getChangedShifts().insert(buildShift(i));
+			sync.getChangedWorkers().insert(buildWorker(i));
+		}
+		return sync;
+	}
+
+	std::string formatName(WireFormat format) {
+		return format == WireFormat::Compact ? "compact" : "fixed";
+	}
+
+	/**
+	 * Measures encoding into a reused buffer (as done by Connection::writeSync), sizing and decoding of a model
+	 *
+	 * @param name name of the measured case
+	 * @param obj measured object
+	 * @param format wire format
+	 */
+	template <typename T>
+	void benchmarkModel(const std::string& name, const T& obj, WireFormat format) {
+		const auto prefix = name + "/" + formatName(format);
+		memory_buf buffer;
+		buffer.setLength(obj.serializedSize(format), true);
+		size_t encodedLength = 0;
+		const auto encodeNs = measureNs([&] {
+			BinaryWriter writer(buffer.data(), buffer.getLength());
+			writer.setFormat(format);
+			obj.serialize(writer);
+			encodedLength = writer.getPosition();
+		});
+		printMetric("serialize", prefix + "/size", static_cast<double>(encodedLength), "B");
+		printMetric("serialize", prefix + "/encode", encodeNs, "ns/op");
+		printMetric("serialize", prefix + "/encode_throughput", encodedLength / encodeNs * 1e9 / (1 << 20), "MB/s");
+
+		size_t computedLength = 0;
+		printMetric("serialize", prefix + "/serialized_size", measureNs([&] {
+			computedLength = obj.serializedSize(format);
+		}), "ns/op");
+		if (computedLength != encodedLength)
+			std::fprintf(stderr, "%s: serializedSize does not match the encoded length\n", prefix.c_str());
+
+		bool equal = true;
+		const auto decodeNs = measureNs([&] {
+			BinaryReader reader(buffer.data(), encodedLength);
+			reader.setFormat(format);
+			equal = get_instance<T>(reader) == obj && equal;
+		});
+		printMetric("serialize", prefix + "/decode", decodeNs, "ns/op");
+		printMetric("serialize", prefix + "/decode_throughput", encodedLength / decodeNs * 1e9 / (1 << 20), "MB/s");
+		if (!equal)
+			std::fprintf(stderr, "%s: decoded object does not equal the original\n", prefix.c_str());
+	}
+
+	template <typename T>
+	void benchmarkModel(const std::string& name, const T& obj) {
+		benchmarkModel(name, obj, WireFormat::Fixed);
+		benchmarkModel(name, obj, WireFormat::Compact);
+	}
+
+	/**
+	 * Measures decoding a reply and reading the fields needed by the schedule grid through the lazy view
+	 *
+	 * @param name name of the measured case
+	 * @param reply measured reply
+	 * @param format wire format
+	 */
+	void benchmarkShiftView(const std::string& name, const S2C_GetShiftsReply& reply, WireFormat format) {
+		const auto prefix = name + "/" + formatName(format);
+		BinaryWriter writer(reply.serializedSize(format));
+		writer.setFormat(format);
+		reply.serialize(writer);
+		size_t hours = 0;
+		const auto ns = measureNs([&] {
+			BinaryReader reader(writer.data(), writer.getPosition());
+			reader.setFormat(format);
+			hours = 0;
+			const auto decoded = get_instance<S2C_GetShiftsReply>(reader);
+			for (const auto& view : decoded.getShiftsView())
+				hours += view.getStartTime().getHour() + view.getId() % 2;
+		});
+		printMetric("serialize", prefix + "/decode_view", ns, "ns/op");
+		printMetric("serialize", prefix + "/decode_view_throughput", writer.getPosition() / ns * 1e9 / (1 << 20), "MB/s");
+		if (hours == 0)
+			std::fprintf(stderr, "%s: decoded no shifts\n", prefix.c_str());
+	}
+
+	std::string sizeSuffix(int count) {
+		return count >= 1000 ? std::to_string(count / 1000) + "k" : std::to_string(count);
+	}
+
+	/**
+	 * Measures the conversions done at the UI boundary, on mostly-ASCII text
+	 */
+	void benchmarkTranscoding() {
+		std::wstring text;
+		while (text.size() < 4096)
+			text += L"Kierownik zmiany, kuchnia g\u0142\u00f3wna; ";
+		const auto utf8 = Utf8::fromWide(text);
+		size_t length = 0;
+		const auto fromWideNs = measureNs([&] {
+			length = Utf8::fromWide(text).size();
+		});
+		printMetric("serialize", "utf8/from_wide", fromWideNs, "ns/op");
+		printMetric("serialize", "utf8/from_wide_throughput", utf8.size() / fromWideNs * 1e9 / (1 << 20), "MB/s");
+		if (length != utf8.size())
+			std::fprintf(stderr, "transcoded an unexpected number of characters\n");
+		const auto toWideNs = measureNs([&] {
+			length = Utf8::toWide(utf8).size();
+		});
+		printMetric("serialize", "utf8/to_wide", toWideNs, "ns/op");
+		printMetric("serialize", "utf8/to_wide_throughput", utf8.size() / toWideNs * 1e9 / (1 << 20), "MB/s");
+		if (length != text.size())
+			std::fprintf(stderr, "transcoded an unexpected number of characters\n");
+	}
+}
+
+void runSerializationBenchmark() {
+	printMetric("serialize", "shift/object_size", static_cast<double>(sizeof(Shift)), "B");
+	benchmarkModel("date_time", DateTime(2020, 6, 1, 8, 30, 0));
+	benchmarkModel("shift", buildShift(7));
+	benchmarkModel("shift_worker", buildWorker(3));
+	for (auto count : COLLECTION_SIZES) {
+		const auto reply = buildShiftsReply(count);
+		benchmarkModel("get_shifts_reply_" + sizeSuffix(count), reply);
+		benchmarkShiftView("get_shifts_reply_" + sizeSuffix(count), reply, WireFormat::Fixed);
+		benchmarkShiftView("get_shifts_reply_" + sizeSuffix(count), reply, WireFormat::Compact);
+	}
+	for (auto count : COLLECTION_SIZES)
+		benchmarkModel("get_workers_reply_" + sizeSuffix(count), buildWorkersReply(count));
+	benchmarkModel("client_sync_100", buildClientSync(100));
+
+	// encoding through the std::ostream adapter
+	const auto reply = buildShiftsReply(1000);
+	memory_stream stream;
+	stream.buffer().setLength(MAX_PACKET_SIZE * 4, true);
+	size_t encodedLength = 0;
+	const auto streamNs = measureNs([&] {
+		stream.buffer().pubseekpos(0);
+		reply.serialize(stream);
+		encodedLength = static_cast<size_t>(stream.buffer().getOutPosition());
+	});
+	printMetric("serialize", "get_shifts_reply_1k/fixed/encode_stream", streamNs, "ns/op");
+	printMetric("serialize", "get_shifts_reply_1k/fixed/encode_stream_throughput",
+	            encodedLength / streamNs * 1e9 / (1 << 20), "MB/s");
+
+	benchmarkTranscoding();
+}
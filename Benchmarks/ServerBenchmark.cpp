@@ -0,0 +1,299 @@
+#include "bench.h"
+#include "Connection.h"
+#include "DaySubscriptions.h"
+#include "Server.h"
+#include "C2S_GetShiftsByDay.h"
+#include "Ping.h"
+#include "PingReply.h"
+#include "RestaurantManager.h"
+#include "S2C_GetChangesReply.h"
+#include "S2C_ClientSync.h"
+#include <atomic>
+#include <thread>
+
+namespace {
+	const std::string HOST = "127.0.0.1";
+	const int BASE_PORT = 14337;
+	const int IDLE_CONNECTIONS = 1000;
+	const int ACTIVE_CLIENTS = 16;
+	const int REQUESTS_PER_CLIENT = 2000;
+	const int BROADCASTS = 200;
+	const int VIEWED_DAYS = 30;
+	const int IMPORTED_SHIFTS = 500;
+	const int SLOW_HANDLER_MS = 2;
+
+	/**
+	 * Replies to every Ping with a PingReply
+	 */
+	class PingResponder : public ServerObserver {
+	public:
+		PingResponder() {
+			addHandler(&PingResponder::handlePing);
+		}
+
+		void handlePing(ConnectionBase* connection, const Ping& payload, size_t size) {
+			connection->writeAsync(PingReply(), nullptr);
+		}
+	};
+
+	/**
+	 * Takes SLOW_HANDLER_MS to handle a C2S_GetShiftsByDay, like a request waiting for the database
+	 */
+	class SlowResponder : public ServerObserver {
+	public:
+		SlowResponder() {
+			addHandler(&SlowResponder::handleRequest);
+		}
+
+		void handleRequest(ConnectionBase* connection, const C2S_GetShiftsByDay& payload, size_t size) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(SLOW_HANDLER_MS));
+		}
+	};
+
+	/**
+	 * Counts the S2C_ClientSync frames queued to the clients
+	 */
+	class SyncCounter : public ServerObserver {
+	public:
+		std::atomic<size_t> frames{0};
+
+		void onPayloadSent(ConnectionBase* connection, const Serializable& payload, size_t size) override {
+			if (payload.getType() == Type::_S2C_ClientSync)
+				frames++;
+		}
+	};
+
+	/**
+	 * Opens raw sockets that never send anything
+	 */
+	std::vector<PSocket*> openIdleSockets(int port, int count) {
+		std::vector<PSocket*> sockets;
+		for (int i = 0; i < count; i++) {
+			auto* addr = p_socket_address_new(HOST.c_str(), port);
+			auto* socket = p_socket_new(P_SOCKET_FAMILY_INET, P_SOCKET_TYPE_STREAM, P_SOCKET_PROTOCOL_TCP, nullptr);
+			if (socket && p_socket_connect(socket, addr, nullptr))
+				sockets.push_back(socket);
+			else if (socket)
+				p_socket_free(socket);
+			p_socket_address_free(addr);
+		}
+		return sockets;
+	}
+
+	/**
+	 * Sends Ping requests from a single client and records the round-trip latencies
+	 */
+	void measureRoundTrips(int port, std::vector<double>& latencies) {
+		Connection client(false);
+		client.connect(HOST, port);
+		Stopwatch watch;
+		for (int i = 0; i < REQUESTS_PER_CLIENT && client.isAlive(); i++) {
+			watch.restart();
+			client.writeSync(Ping());
+			std::shared_ptr<Serializable> reply;
+			// skip the server-initiated pings
+			do {
+				reply = client.readSync();
+			} while (reply && reply->getType() != Type::_PingReply);
+			latencies.push_back(watch.elapsedNs());
+		}
+		client.close();
+	}
+
+	/**
+	 * Measures the Ping round trips of ACTIVE_CLIENTS clients at once
+	 *
+	 * @param metric prefix of the reported metrics
+	 * @param port port of the server
+	 */
+	void benchmarkPings(const std::string& metric, int port) {
+		std::vector<std::vector<double>> latencies(ACTIVE_CLIENTS);
+		std::vector<std::thread> clients;
+		Stopwatch total;
+		for (int i = 0; i < ACTIVE_CLIENTS; i++) {
+			clients.emplace_back([port, &latencies, i] {
+				try {
+					measureRoundTrips(port, latencies[i]);
+				}
+				catch (std::exception& ex) {
+					std::fprintf(stderr, "client failed: %s\n", ex.what());
+				}
+			});
+		}
+		for (auto& thread : clients)
+			thread.join();
+		const auto elapsed = total.elapsedNs();
+
+		std::vector<double> all;
+		for (const auto& samples : latencies)
+			all.insert(all.end(), samples.begin(), samples.end());
+		printMetric("server", metric + "_p50", percentile(all, 50) / 1000, "us");
+		printMetric("server", metric + "_p99", percentile(all, 99) / 1000, "us");
+		printMetric("server", metric + "_throughput", all.size() / (elapsed / 1e9), "req/s");
+	}
+
+	/**
+	 * Measures the Ping round trips while another client keeps sending requests with a slow handler
+	 *
+	 * @param name name of the server mode
+	 * @param port port of the server
+	 */
+	void benchmarkSlowNeighbour(const std::string& name, int port) {
+		std::atomic<bool> done{false};
+		std::thread neighbour([port, &done] {
+			try {
+				Connection client(false);
+				client.connect(HOST, port);
+				while (!done && client.isAlive()) {
+					client.writeSync(C2S_GetShiftsByDay(Date(2020, 6, 1)));
+					std::this_thread::sleep_for(std::chrono::milliseconds(SLOW_HANDLER_MS));
+				}
+				client.close();
+			}
+			catch (std::exception& ex) {
+				std::fprintf(stderr, "neighbour failed: %s\n", ex.what());
+			}
+		});
+		benchmarkPings(name + "/ping_slow_neighbour", port);
+		done = true;
+		neighbour.join();
+	}
+
+	/**
+	 * Broadcasts schedule changes to all clients, as done for every edit, and measures the time
+	 * spent by the editing thread and the time until every client has the change queued
+	 */
+	void benchmarkBroadcast(const std::string& name, Server& server) {
+		const auto clients = server.clients().size();
+		std::vector<double> caller;
+		Stopwatch total, watch;
+		for (int i = 0; i < BROADCASTS; i++) {
+			auto sync = std::make_shared<S2C_ClientSync>();
+			sync->getChangedShifts().insert(Shift(DateTime(2020, 6, 1, 8, 0, 0), 8, L"Kelner", 1 + i % 40, i + 1));
+			watch.restart();
+			server.writeToAll(sync);
+			caller.push_back(watch.elapsedNs());
+		}
+		server.flushBroadcasts();
+		const auto elapsed = total.elapsedNs();
+		printMetric("server", name + "/broadcast_caller_p50", percentile(caller, 50) / 1000, "us");
+		printMetric("server", name + "/broadcast_fanout", elapsed / BROADCASTS / 1000, "us/broadcast");
+		printMetric("server", name + "/broadcast_throughput", BROADCASTS * clients / (elapsed / 1e9), "frames/s");
+	}
+
+	/**
+	 * Sends schedule changes only to the clients viewing the changed day, with the clients spread
+	 * over a month, and compares the frames and bytes sent per edit with broadcasting to everyone
+	 */
+	void benchmarkSubscriptions(const std::string& name, Server& server) {
+		DaySubscriptions subscriptions;
+		size_t clients = 0;
+		for (const auto& kv : server.clients()) {
+			const Date day(2020, 6, 1 + static_cast<int>(clients++ % VIEWED_DAYS));
+			subscriptions.subscribe(kv.first, day, day);
+		}
+		size_t frames = 0, bytes = 0;
+		Stopwatch total;
+		for (int i = 0; i < BROADCASTS; i++) {
+			auto sync = std::make_shared<S2C_ClientSync>();
+			const Shift shift(DateTime(2020, 6, 1 + i % VIEWED_DAYS, 8, 0, 0), 8, L"Kelner", 1 + i % 40, i + 1);
+			sync->getChangedShifts().insert(shift);
+			std::vector<int> targets;
+			subscriptions.collect(shift.getStartTime(), targets);
+			frames += targets.size();
+			bytes += targets.size() * (sizeof(content_len_t) + sync->serializedSize(WireFormat::Fixed));
+			server.writeTo(sync, std::move(targets));
+		}
+		server.flushBroadcasts();
+		const auto elapsed = total.elapsedNs();
+		printMetric("server", name + "/sync_frames_per_edit_all", static_cast<double>(clients), "frames");
+		printMetric("server", name + "/sync_frames_per_edit_subscribed", static_cast<double>(frames) / BROADCASTS, "frames");
+		printMetric("server", name + "/sync_bytes_per_edit_subscribed", static_cast<double>(bytes) / BROADCASTS, "B");
+		printMetric("server", name + "/sync_fanout_subscribed", elapsed / BROADCASTS / 1000, "us/edit");
+	}
+
+	/**
+	 * Imports a batch of shifts, as done when copying a week, with every change sent at once
+	 * and with the changes collected over the sync window
+	 */
+	void benchmarkImport(const std::string& name, Server& server, SyncCounter& counter) {
+		const auto clients = server.clients();
+		for (auto window : { std::chrono::milliseconds(0), std::chrono::milliseconds(SYNC_WINDOW) }) {
+			RestaurantManager manager(&server);
+			manager.setSyncWindow(window);
+			for (const auto& kv : clients)
+				manager.getSubscriptions().add(kv.first);
+			counter.frames = 0;
+			Stopwatch total;
+			for (int i = 0; i < IMPORTED_SHIFTS; i++)
+				manager.insertShift(Shift(DateTime(2020, 6, 1 + i % 7, 8, 0, 0), 8, "Job " + std::to_string(i), 0));
+			manager.flushSync();
+			server.flushBroadcasts();
+			const auto elapsed = total.elapsedNs();
+			const auto mode = window.count() ? std::string("/import_coalesced") : std::string("/import_immediate");
+			printMetric("server", name + mode + "_frames_per_client",
+			            clients.empty() ? 0 : static_cast<double>(counter.frames) / clients.size(), "frames");
+			printMetric("server", name + mode + "_time", elapsed / 1e6, "ms");
+			if (!window.count())
+				continue;
+
+			// a client that missed the last 10 changes gets them from the change log instead of listing the week again
+			SyncBatch missed;
+			manager.getChangeLog().replay(manager.getChangeLog().getVersion() - 10, missed);
+			S2C_GetChangesReply delta(1, manager.getChangeLog().getId(), manager.getChangeLog().getVersion());
+			missed.fill(delta.getChanges(), [](const Date&) { return true; });
+			size_t full = 0;
+			for (const auto& kv : manager.getShifts())
+				full += kv.second.serializedSize();
+			printMetric("server", name + "/resync_delta_bytes", static_cast<double>(delta.serializedSize()), "B");
+			printMetric("server", name + "/resync_full_bytes", static_cast<double>(full), "B");
+		}
+	}
+
+	void benchmarkMode(const std::string& name, int reactorThreads, int port) {
+		PingResponder responder;
+		SlowResponder slow;
+		SyncCounter counter;
+		Server server(reactorThreads);
+		server.subscribe(&responder);
+		server.subscribe(&slow);
+		server.subscribe(&counter);
+		server.start(HOST, port);
+
+		// idle connections
+		const auto before = getResidentMemory();
+		auto idle = openIdleSockets(port, IDLE_CONNECTIONS);
+		// wait for the server to set up all the clients
+		for (int i = 0; i < 100 && server.clients().size() < idle.size(); i++)
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		const auto after = getResidentMemory();
+		printMetric("server", name + "/idle_connections", static_cast<double>(idle.size()), "conn");
+		printMetric("server", name + "/memory_per_idle_connection",
+		            idle.empty() ? 0 : static_cast<double>(after - before) / idle.size(), "B/conn");
+
+		// request latency with the idle connections still open
+		benchmarkPings(name + "/ping", port);
+		benchmarkSlowNeighbour(name, port);
+
+		benchmarkBroadcast(name, server);
+		benchmarkSubscriptions(name, server);
+		benchmarkImport(name, server, counter);
+
+		for (auto* socket : idle) {
+			p_socket_close(socket, nullptr);
+			p_socket_free(socket);
+		}
+		server.stop();
+	}
+}
+
+void runServerBenchmark() {
+	benchmarkMode("threads", 0, BASE_PORT);
+	if (Reactor::isSupported()) {
+		const auto cores = std::max(1u, std::thread::hardware_concurrency());
+		benchmarkMode("reactor", static_cast<int>(cores), BASE_PORT + 1);
+	}
+	else {
+		std::printf("server     event-loop mode is not supported on this platform\n");
+	}
+}
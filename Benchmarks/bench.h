@@ -0,0 +1,176 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#include <fstream>
+#endif
+
+/**
+ * Measures the elapsed wall-clock time
+ */
+class Stopwatch {
+protected:
+	std::chrono::steady_clock::time_point _start;
+public:
+	Stopwatch() {
+		restart();
+	}
+	/**
+	 * Resets the measured time
+	 */
+	void restart() {
+		_start = std::chrono::steady_clock::now();
+	}
+	/**
+	 * @return double nanoseconds elapsed since the last restart
+	 */
+	double elapsedNs() const {
+		return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - _start).count();
+	}
+};
+
+/**
+ * Computes a percentile of the given samples
+ * 
+ * @param samples measured values
+ * @param p percentile in range [0, 100]
+ * @return double value of the percentile, or 0 if there are no samples
+ */
+inline double percentile(std::vector<double> samples, double p) {
+	if (samples.empty())
+		return 0;
+	std::sort(samples.begin(), samples.end());
+	auto index = static_cast<size_t>(p / 100.0 * (samples.size() - 1) + 0.5);
+	return samples[std::min(index, samples.size() - 1)];
+}
+
+/**
+ * @return size_t resident memory (in bytes) of the current process
+ */
+inline size_t getResidentMemory() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.WorkingSetSize;
+	return 0;
+#else
+	std::ifstream statm("/proc/self/statm");
+	size_t pages = 0, resident = 0;
+	statm >> pages >> resident;
+	return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+/**
+ * A single benchmark measurement
+ */
+struct Metric {
+	std::string suite;
+	std::string name;
+	double value;
+	std::string unit;
+};
+
+/**
+ * @return std::vector<Metric>& all measurements printed so far
+ */
+inline std::vector<Metric>& recordedMetrics() {
+	static std::vector<Metric> metrics;
+	return metrics;
+}
+
+/**
+ * Prints a single benchmark measurement and records it for the results file
+ * 
+ * @param suite benchmark suite
+ * @param name measured case
+ * @param value measured value
+ * @param unit unit of the value
+ */
+inline void printMetric(const std::string& suite, const std::string& name, double value, const std::string& unit) {
+	std::printf("%-10s %-52s %14.1f %s\n", suite.c_str(), name.c_str(), value, unit.c_str());
+	recordedMetrics().push_back({ suite, name, value, unit });
+}
+
+/**
+ * Writes all recorded measurements as a JSON array of {suite, name, value, unit} objects
+ * 
+ * @param path output file
+ * @return bool whether the file was written
+ */
+inline bool writeMetricsJson(const std::string& path) {
+	auto* file = std::fopen(path.c_str(), "w");
+	if (!file)
+		return false;
+	// names and units are plain ASCII identifiers, no escaping needed
+	std::fprintf(file, "[\n");
+	const auto& metrics = recordedMetrics();
+	for (size_t i = 0; i < metrics.size(); i++) {
+		const auto& metric = metrics[i];
+		std::fprintf(file, "  {\"suite\": \"%s\", \"name\": \"%s\", \"value\": %.3f, \"unit\": \"%s\"}%s\n",
+		             metric.suite.c_str(), metric.name.c_str(), metric.value, metric.unit.c_str(),
+		             i + 1 < metrics.size() ? "," : "");
+	}
+	std::fprintf(file, "]\n");
+	return std::fclose(file) == 0;
+}
+
+/**
+ * Repeats an operation until the minimum duration has passed
+ * 
+ * @param operation measured operation
+ * @param minDurationNs minimum total duration, in nanoseconds
+ * @return double average nanoseconds per call
+ */
+template <typename TOperation>
+double measureNs(TOperation&& operation, double minDurationNs = 2e8) {
+	// warm-up
+	operation();
+	size_t iterations = 0;
+	size_t batch = 1;
+	Stopwatch watch;
+	// the clock is read once per batch, so short operations are not dominated by it
+	while (true) {
+		for (size_t i = 0; i < batch; i++)
+			operation();
+		iterations += batch;
+		const auto elapsed = watch.elapsedNs();
+		if (elapsed >= minDurationNs)
+			return elapsed / iterations;
+		batch *= 2;
+	}
+}
+
+/**
+ * Compares the thread-per-connection and event-loop server modes
+ */
+void runServerBenchmark();
+
+/**
+ * Measures encoding, decoding and sizing of every model, in both wire formats
+ */
+void runSerializationBenchmark();
+
+/**
+ * Measures type dispatch and full Connection frames over a loopback socket pair
+ */
+void runProtocolBenchmark();
+
+/**
+ * Measures decoding of a corpus of valid, truncated and corrupted frames, as received from untrusted peers
+ */
+void runFuzzBenchmark();
+
+/**
+ * Measures a mix of day listings and shift edits handled by the manager from a growing number of threads
+ */
+void runManagerBenchmark();
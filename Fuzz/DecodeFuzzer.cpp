@@ -0,0 +1,60 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include "BaseLibrary.h"
+#include "models.h"
+#include "net_constants.h"
+
+/**
+ * libFuzzer target for everything a peer can send.
+ * The first byte of the input selects the wire format, the rest is a frame payload starting with its type tag,
+ * so every registered Type is reached through new_instance and its deserialize.
+ * Decoding may only fail with std::runtime_error, and a decoded object has to encode to exactly serializedSize bytes.
+ */
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+	static const bool initialized = (InitializeBaseLibrary(), true);
+	(void)initialized;
+	if (size < 2)
+		return 0;
+	const auto format = data[0] & 1 ? WireFormat::Compact : WireFormat::Fixed;
+	const DecodeLimits limits = { MAX_STRING_LENGTH, MAX_COLLECTION_SIZE };
+	std::shared_ptr<Serializable> obj;
+	try {
+		obj = decode_payload(data + 1, size - 1, format, limits);
+	}
+	catch (std::runtime_error&) {
+		return 0;
+	}
+	const auto expected = obj->serializedSize(format);
+	BinaryWriter writer(expected);
+	writer.setFormat(format);
+	obj->serialize(writer);
+	if (writer.getPosition() != expected) {
+		std::fprintf(stderr, "%s: serializedSize does not match the encoded length\n",
+		             get_type_name(obj->getType()).c_str());
+		std::abort();
+	}
+	return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+/**
+ * Replays the given inputs without libFuzzer, e.g. to debug a crash it found.
+ * Usage: Fuzz input...
+ */
+int main(int argc, char** argv) {
+	for (int i = 1; i < argc; i++) {
+		std::ifstream file(argv[i], std::ios::binary);
+		if (!file) {
+			std::fprintf(stderr, "could not read %s\n", argv[i]);
+			return 1;
+		}
+		const std::vector<uint8_t> input((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		LLVMFuzzerTestOneInput(input.data(), input.size());
+	}
+	std::printf("replayed %d inputs\n", argc - 1);
+	return 0;
+}
+#endif
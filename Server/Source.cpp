@@ -1,16 +1,33 @@
 ﻿#include <csignal>
-#include <fstream>
 #include "Connection.h"
 #include "BaseLibrary.h"
 #include "C2S_Authorize.h"
+#include "Checkpointer.h"
 #include "Server.h"
 #include "RestaurantManager.h"
 #include "S2C_ClientSync.h"
+#include "WriteAheadLog.h"
 
 
 const std::string HOST = "127.0.0.1";
 const int PORT = 1337;
+/**
+ * Snapshots are mapped images in two files next to this path, older ones were saved at the path itself
+ */
 const std::string STORAGE_PATH = "store.bin";
+/**
+ * Changes made since the last snapshot in STORAGE_PATH, replayed over it on startup.
+ * Stored in numbered segments next to this path
+ */
+const std::string WAL_PATH = "store.wal";
+/**
+ * Time between the snapshots saved while the server is running
+ */
+const auto SNAPSHOT_INTERVAL = std::chrono::minutes(5);
+/**
+ * Event-loop threads reading all clients where the platform supports them, otherwise every client gets its own thread
+ */
+const int REACTOR_THREADS = 2;
 
 std::map<std::string, UserPermissions> TOKENS = {
 	{"arbuz", UserPermissions::NORMAL_USER},
@@ -59,17 +76,21 @@ public:
 Server* server;
 ConnectionEventHandler* handler;
 RestaurantManager* mgr;
+WriteAheadLog* wal;
+Checkpointer* checkpointer;
+/* first segment of the write-ahead log not held by the loaded snapshot */
+uint64_t walSegment = 0;
 
 /**
- * Loads the RestaurantManager from the specified file
+ * Loads the RestaurantManager from the last snapshot
  */
-bool loadManager(const std::string& path) {
-	std::ifstream f(path);
-	if (!f.good())
-		return false;
+bool loadManager() {
 	std::cout << "Importing manager from storage... ";
 	try {
-		mgr->deserialize(f);
+		if (!checkpointer->load(walSegment)) {
+			std::cout << "none" << std::endl;
+			return false;
+		}
 		std::cout << "OK" << std::endl;
 	} catch(std::exception& ex) {
 		std::cout << ex.what() << std::endl;
@@ -78,16 +99,34 @@ bool loadManager(const std::string& path) {
 	return true;
 }
 /**
- * Saves the RestaurantManager into the specified file
+ * Applies the changes logged since the last snapshot and starts logging the new ones
  */
-void saveManager(const std::string& path) {
-	std::ofstream f(path);
-	if (!f.good())
-		return;
+bool openWriteAheadLog(const std::string& path) {
+	try {
+		uint64_t next;
+		const auto replayed = mgr->replayWriteAheadLog(path, walSegment, next);
+		if (replayed)
+			std::cout << "Replayed " << replayed << " changes from the write-ahead log" << std::endl;
+		wal->open(path, next);
+		mgr->setWriteAheadLog(wal);
+	}
+	catch (std::exception& ex) {
+		std::cout << ex.what() << std::endl;
+		return false;
+	}
+	return true;
+}
+/**
+ * Saves a snapshot of the RestaurantManager and prints how long the writers were paused for
+ */
+void saveManager() {
 	std::cout << "Saving manager instance... ";
 	try {
-		mgr->serialize(f);
-		std::cout << "OK" << std::endl;
+		checkpointer->checkpoint();
+		const auto stats = checkpointer->getStats();
+		std::cout << "OK (" << stats.lastSize << "b in " << stats.lastDuration.count() << "ms, writers paused for "
+			<< stats.lastPause.count() << "us, at most " << stats.maxPause.count() << "us in " << stats.snapshots
+			<< " snapshots)" << std::endl;
 	}
 	catch (std::exception& ex) {
 		std::cout << ex.what() << std::endl;
@@ -98,13 +137,17 @@ void onExit() {
 	static bool exited = false;
 	if (exited) return;
 	exited = true;
-	saveManager(STORAGE_PATH);
 	
 	std::cout << "Stopping the server... ";
 	server->stop();
 	std::cout << "OK" << std::endl;
 
+	checkpointer->stop();
+	saveManager();
 	
+	mgr->setWriteAheadLog(nullptr);
+	delete checkpointer;
+	delete wal;
 	delete mgr;
 	delete server;
 	delete handler;
@@ -131,12 +174,18 @@ int main() {
 	}
 	
 	handler = new ConnectionEventHandler;
-	server = new Server;
+	server = new Server(REACTOR_THREADS);
 	mgr = new RestaurantManager(server);
+	wal = new WriteAheadLog;
+	checkpointer = new Checkpointer(*mgr, STORAGE_PATH, wal);
 	
-	if (!loadManager(STORAGE_PATH)) {
+	if (!loadManager()) {
 		std::cout << "Could not find an existing manager instance" << std::endl;
 	}
+	if (!openWriteAheadLog(WAL_PATH)) {
+		std::cout << "ERROR: Could not open the write-ahead log" << std::endl;
+		return 1;
+	}
 
 	auto& tokens = mgr->getAccessTokens();
 
@@ -154,6 +203,7 @@ int main() {
 		return 0;
 	}
 	std::cout << "Server is listening on " << HOST << ":" << PORT << std::endl;
+	checkpointer->start(SNAPSHOT_INTERVAL);
 	server->join();
 
 
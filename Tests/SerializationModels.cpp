@@ -1,16 +1,38 @@
 ﻿#include "pch.h"
 
 
+#include <algorithm>
+#include <atomic>
 #include <codecvt>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <future>
 #include <locale>
+#include <sstream>
+#include <thread>
+#include <vector>
 
 #include "CppUnitTest.h"
 #include "../BaseLibrary/buffers.h"
+#include "../BaseLibrary/Checkpointer.h"
+#include "../BaseLibrary/Connection.h"
 #include "../BaseLibrary/Date.h"
 #include "../BaseLibrary/DateTime.h"
+#include "../BaseLibrary/DaySubscriptions.h"
 #include "../BaseLibrary/net_constants.h"
+#include "../BaseLibrary/ReceiveBuffer.h"
+#include "../BaseLibrary/ReplyStream.h"
+#include "../BaseLibrary/RestaurantManager.h"
+#include "../BaseLibrary/SendQueue.h"
 #include "../BaseLibrary/serialization.h"
+#include "../BaseLibrary/utf8.h"
 #include "../BaseLibrary/models.h"
+#include "../BaseLibrary/ShiftIntervals.h"
+#include "../BaseLibrary/ShiftTable.h"
+#include "../BaseLibrary/ShiftView.h"
+#include "../BaseLibrary/SyncBatch.h"
+#include "../BaseLibrary/WriteAheadLog.h"
 
 namespace Serialization {
 	class Serializable;
@@ -18,6 +40,99 @@ namespace Serialization {
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 
+namespace Tests
+{
+	/**
+	 * Connection that runs a hook while the flush of its queue is still owned, right before it is released
+	 */
+	class RacingConnection : public Connection {
+	protected:
+		void releaseFlush() override {
+			auto hook = std::move(beforeRelease);
+			beforeRelease = nullptr;
+			if (hook)
+				hook();
+			Connection::releaseFlush();
+		}
+	public:
+		std::function<void()> beforeRelease;
+
+		RacingConnection() : Connection(false) {}
+		/**
+		 * Queues a reply and flushes it from a thread taken for the reading thread, as readAsync does once the handlers return
+		 *
+		 * @param reply payload queued by the handler
+		 */
+		void replyAsReader(const Serializable& reply) {
+			std::promise<void> assigned;
+			auto started = assigned.get_future();
+			_readingAsync = true;
+			_readThread = std::thread([this, &reply, &started] {
+				started.wait();
+				writeAsync(reply, nullptr);
+				flush(true);
+			});
+			assigned.set_value();
+			_readThread.join();
+			_readingAsync = false;
+		}
+	};
+
+	/**
+	 * Write-ahead log that can be made to fail, as when the disk is full
+	 */
+	class FailingLog : public WriteAheadLog {
+	public:
+		void fail() {
+			std::lock_guard<std::mutex> guard(_lock);
+			_failed = true;
+		}
+	};
+
+	/**
+	 * Connection that keeps the packets written to it, encoded, instead of sending them
+	 */
+	class CapturingConnection : public ConnectionBase {
+	protected:
+		void closeError(const std::exception& exception) override {}
+		bool readAsync() override {
+			return false;
+		}
+	public:
+		std::vector<std::vector<byte_t>> packets;
+
+		CapturingConnection() : ConnectionBase(false) {}
+		bool isAlive() const override {
+			return true;
+		}
+		bool setReadingAsync(bool readAsync) override {
+			return false;
+		}
+		int connect(const std::string& host, int port) override {
+			return 0;
+		}
+		int connect(PSocket* socket) override {
+			return 0;
+		}
+		void writeSync(const Serializable& payload) override {
+			std::vector<byte_t> packet(payload.serializedSize(getWireFormat()));
+			BinaryWriter writer(packet.data(), packet.size());
+			writer.setFormat(getWireFormat());
+			payload.serialize(writer);
+			packets.push_back(std::move(packet));
+		}
+		using ConnectionBase::writeAsync;
+		void writeAsync(const Serializable& payload, std::function<void(bool)> completion) override {
+			writeSync(payload);
+			if (completion)
+				completion(true);
+		}
+		std::shared_ptr<Serializable> readSync() override {
+			return nullptr;
+		}
+	};
+}
+
 namespace Tests
 {
 	TEST_CLASS(SerializationModels)
@@ -59,7 +174,11 @@ namespace Tests
 		}
 		std::wstring s2ws(const std::string& str)
 		{
-			return std::wstring(str.begin(), str.end());
+			// Latin-1, so that every byte maps to a valid code point
+			std::wstring result;
+			for (const auto c : str)
+				result += static_cast<wchar_t>(static_cast<unsigned char>(c));
+			return result;
 		}
 
 		std::wstring rand_wstring(int id = -1) {
@@ -97,13 +216,37 @@ namespace Tests
 			std::wstring msg = L"Deserialized object does not equal to the original.";
 			Assert::IsTrue(serializable == other, msg.c_str());
 			Assert::IsFalse(serializable != other, msg.c_str());
+			checkExactSize(serializable, WireFormat::Fixed);
+			checkCompactSerialization(serializable);
+		}
+		template <typename T>
+		void checkCompactSerialization(const T& serializable) {
+			BinaryWriter writer;
+			writer.setFormat(WireFormat::Compact);
+			serializable.serialize(writer);
+			BinaryReader reader(writer.data(), writer.getPosition());
+			reader.setFormat(WireFormat::Compact);
+			T other = Serialization::get_instance<T>(reader);
+			std::wstring msg = L"Compact deserialized object does not equal to the original.";
+			Assert::IsTrue(serializable == other, msg.c_str());
+			Assert::AreEqual(writer.getPosition(), reader.getPosition(), msg.c_str());
+			checkExactSize(serializable, WireFormat::Compact);
+		}
+		template <typename T>
+		void checkExactSize(const T& serializable, WireFormat format) {
+			// encodes into a buffer of exactly the computed size, which cannot grow
+			std::vector<byte_t> buffer(serializable.serializedSize(format));
+			BinaryWriter writer(buffer.data(), buffer.size());
+			writer.setFormat(format);
+			serializable.serialize(writer);
+			Assert::AreEqual(buffer.size(), writer.getPosition(), L"Serialized size does not match the written bytes.");
 		}
 		
 	public:
 		SerializationModels() {
 			srand(195120);
 			stream.buffer().setLength(MAX_PACKET_SIZE, true);
-			if(TypeInfo::TYPES.empty())
+			if(!TypeInfo::get(Type::_Ping).registered)
 				register_models();
 		}
 		TEST_METHOD(SerializeDate)
@@ -237,9 +380,1093 @@ namespace Tests
 			
 		}
 
+		TEST_METHOD(SerializeBinaryBuffers) {
+			S2C_GetShiftsReply reply(5125, Date(2020, 06, 01));
+			for (int i = 0; i < 64; i++)
+				reply.getShifts().insert(rand_shift());
+			// the stream adapter has to produce exactly the same bytes
+			BinaryWriter writer;
+			reply.serialize(writer);
+			stream.buffer().pubseekpos(0);
+			reply.serialize(stream);
+			Assert::AreEqual(writer.getPosition(), static_cast<size_t>(stream.buffer().getOutPosition()));
+			Assert::IsTrue(std::memcmp(writer.data(), stream.buffer().data(), writer.getPosition()) == 0);
+
+			BinaryReader reader(writer.data(), writer.getPosition());
+			auto other = get_instance<S2C_GetShiftsReply>(reader);
+			Assert::IsTrue(reply == other);
+			Assert::AreEqual(writer.getPosition(), reader.getPosition());
+
+			// truncated buffers are rejected instead of being read past the end
+			BinaryReader truncated(writer.data(), writer.getPosition() - 1);
+			Assert::ExpectException<std::runtime_error>([&truncated] {
+				get_instance<S2C_GetShiftsReply>(truncated);
+			});
+			// external buffers are never expanded
+			byte_t small[16];
+			BinaryWriter fixed(small, sizeof(small));
+			Assert::ExpectException<std::runtime_error>([&reply, &fixed] {
+				reply.serialize(fixed);
+			});
+		}
+
+		TEST_METHOD(TypeRegistry) {
+			static_assert(get_type<Shift>() == Type::_Shift, "type tags have to be known at compile time");
+			Assert::IsTrue(is_assignable(Type::_TrackablePacket, Type::_S2C_GetShiftsReply));
+			Assert::IsTrue(is_assignable(Type::_TransactionReply, Type::_S2C_GetShiftsReply));
+			Assert::IsTrue(is_assignable(Type::_Date, Type::_DateTime));
+			Assert::IsTrue(is_assignable(Type::Unknown, Type::_Shift));
+			Assert::IsFalse(is_assignable(Type::_DateTime, Type::_Date));
+			Assert::IsFalse(is_assignable(Type::_TransactionReply, Type::_C2S_Authorize));
+			Assert::IsFalse(is_assignable(Type::_Shift, static_cast<Type>(200)));
+
+			Assert::IsTrue(new_instance(Type::_Shift)->getType() == Type::_Shift);
+			Assert::IsTrue(new_instance<Date>(Type::_Date, Type::_DateTime)->getType() == Type::_DateTime);
+			Assert::ExpectException<std::runtime_error>([] {
+				new_instance(static_cast<Type>(200));
+			});
+			Assert::ExpectException<std::runtime_error>([] {
+				new_instance(Type::_TrackablePacket);
+			});
+			Assert::ExpectException<std::runtime_error>([] {
+				new_instance<TransactionReply>(Type::_TransactionReply, Type::_C2S_Authorize);
+			});
+		}
+
 		TEST_METHOD(SerializePing) {
 			checkSerialization(Ping());
 			checkSerialization(PingReply());
 		}
+
+		TEST_METHOD(SerializeCompact) {
+			// LEB128 boundaries
+			const uint64_t values[] = { 0, 1, 127, 128, 16383, 16384, 0xffffffffULL, ~0ULL };
+			for (const auto value : values) {
+				BinaryWriter writer;
+				write_varint(writer, value);
+				BinaryReader reader(writer.data(), writer.getPosition());
+				Assert::AreEqual(value, read_varint(reader));
+				Assert::AreEqual(writer.getPosition(), reader.getPosition());
+			}
+			// over-long and overflowing varints are rejected
+			const byte_t overflow[] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x02 };
+			Assert::ExpectException<std::runtime_error>([&overflow] {
+				BinaryReader reader(overflow, sizeof(overflow));
+				read_varint(reader);
+			});
+			const byte_t wide[] = { 0x80, 0x80, 0x80, 0x80, 0x10 };
+			Assert::ExpectException<std::runtime_error>([&wide] {
+				BinaryReader reader(wide, sizeof(wide));
+				reader.setFormat(WireFormat::Compact);
+				read_uint<uint32_t>(reader);
+			});
+
+			S2C_GetShiftsReply reply(5125, Date(2020, 06, 01));
+			for (int i = 0; i < 64; i++)
+				reply.getShifts().insert(Shift(DateTime(2020, 06, 01, i % 16, 0, 0), 1, L"Job", 1000 + i, 10 + i % 8));
+			BinaryWriter fixed, compact;
+			compact.setFormat(WireFormat::Compact);
+			reply.serialize(fixed);
+			reply.serialize(compact);
+			Assert::IsTrue(compact.getPosition() * 3 < fixed.getPosition() * 2);
+			checkCompactSerialization(reply);
+
+			// pings of older peers carry no capabilities
+			const byte_t ping[] = { static_cast<byte_t>(Type::_Ping) };
+			BinaryReader reader(ping, sizeof(ping));
+			Assert::AreEqual(static_cast<int>(get_instance<Ping>(reader).getCapabilities()), 0);
+			checkSerialization(Ping(Ping::CAPABILITY_COMPACT));
+		}
+
+		TEST_METHOD(TranscodeUtf8) {
+			const std::wstring samples[] = {
+				L"", L"ASCII", L"zażółć gęślą jaźń", L"Kierownik zmiany, kuchnia główna (od 6:00)",
+				L"\u20ac\u00a3 \U0001F355 pizza \U0001F355", std::wstring(100, L'a') + L"\u0142" + std::wstring(33, L'b')
+			};
+			for (const auto& sample : samples) {
+				const auto utf8 = Utf8::fromWide(sample);
+				Assert::IsTrue(Utf8::isValid(utf8));
+				Assert::IsTrue(Utf8::toWide(utf8) == sample);
+			}
+			Assert::IsTrue(Utf8::fromWide(L"za\u017c\u00f3\u0142\u0107") == "za\xc5\xbc\xc3\xb3\xc5\x82\xc4\x87");
+			Assert::IsTrue(Utf8::fromWide(L"\U0001F355") == "\xf0\x9f\x8d\x95");
+
+			// malformed input is replaced, never rejected
+			const std::string malformed[] = { "\xff", "\xc0\xaf", "\xed\xa0\x80", "\xf4\x90\x80\x80", "\xe2\x82", "\xf0\x9f\x8d" };
+			for (const auto& sample : malformed) {
+				Assert::IsFalse(Utf8::isValid(sample));
+				const auto wide = Utf8::toWide("a" + sample + "b");
+				Assert::IsTrue(wide.front() == L'a' && wide.back() == L'b');
+				Assert::IsTrue(wide.find(L'\ufffd') != std::wstring::npos);
+			}
+
+			// text is sent as UTF-8 in the compact format, and as wide strings otherwise
+			const ShiftWorker worker(L"Przemysław", L"Rozwałka", L"zażółczaćgęśląjaźń", 15159);
+			Assert::IsTrue(worker.getFirstName() == L"Przemysław");
+			Assert::IsTrue(worker.getFirstNameUtf8() == Utf8::fromWide(L"Przemysław"));
+			BinaryWriter fixed, compact;
+			compact.setFormat(WireFormat::Compact);
+			worker.serialize(fixed);
+			worker.serialize(compact);
+			const size_t textLength = worker.getFirstNameUtf8().size() + worker.getLastNameUtf8().size() + worker.getTitleUtf8().size();
+			// type, 2-byte id and three 1-byte lengths
+			Assert::AreEqual(compact.getPosition(), 1 + 2 + 3 + textLength);
+			Assert::IsTrue(fixed.getPosition() >= 1 + 4 * sizeof(size_t) + 36 * sizeof(wchar_t));
+		}
+
+		TEST_METHOD(InternJobNames) {
+			auto& catalog = JobCatalog::getInstance();
+			const auto cook = catalog.intern("Kucharz");
+			Assert::AreEqual(cook, catalog.intern("Kucharz"));
+			Assert::AreNotEqual(cook, catalog.intern("Kelner"));
+			Assert::AreEqual(catalog.intern(""), static_cast<job_id_t>(0));
+			Assert::IsTrue(catalog.getName(cook) == "Kucharz");
+			Assert::ExpectException<std::invalid_argument>([&catalog] {
+				catalog.getName(static_cast<job_id_t>(catalog.size()));
+			});
+
+			Shift shift(DateTime(2020, 06, 01, 10, 0, 0), 2, L"Kucharz", 1, 2);
+			Assert::AreEqual(shift.getJobId(), cook);
+			Assert::IsTrue(shift.getJobName() == L"Kucharz");
+			Assert::IsTrue(shift == Shift(DateTime(2020, 06, 01, 10, 0, 0), 2, "Kucharz", 1, 2));
+
+			// in the compact format every job name is sent once per message
+			S2C_GetShiftsReply reply(5125, Date(2020, 06, 01));
+			for (int i = 0; i < 16; i++)
+				reply.getShifts().insert(Shift(DateTime(2020, 06, 01, i, 0, 0), 1, i % 2 ? L"Kucharz" : L"Kelner", 1, i + 1));
+			BinaryWriter writer;
+			writer.setFormat(WireFormat::Compact);
+			reply.serialize(writer);
+			const std::string encoded(reinterpret_cast<const char*>(writer.data()), writer.getPosition());
+			Assert::AreEqual(encoded.find("Kucharz"), encoded.rfind("Kucharz"));
+			Assert::AreEqual(encoded.find("Kelner"), encoded.rfind("Kelner"));
+			checkCompactSerialization(reply);
+
+			// references to names not sent in the message are rejected
+			BinaryWriter reference;
+			reference.setFormat(WireFormat::Compact);
+			uint32_t index;
+			reference.internSymbol(shift.getJobId(), &index);
+			shift.serialize(reference);
+			Assert::ExpectException<std::runtime_error>([&reference] {
+				BinaryReader reader(reference.data(), reference.getPosition());
+				reader.setFormat(WireFormat::Compact);
+				get_instance<Shift>(reader);
+			});
+		}
+
+		TEST_METHOD(ViewReceivedShifts) {
+			S2C_GetShiftsReply reply(5125, Date(2020, 06, 01));
+			for (int i = 0; i < 64; i++)
+				reply.getShifts().insert(rand_shift());
+			const auto shifts = reply.getShifts();
+			for (auto format : { WireFormat::Fixed, WireFormat::Compact }) {
+				BinaryWriter writer;
+				writer.setFormat(format);
+				reply.serialize(writer);
+				BinaryReader reader(writer.data(), writer.getPosition());
+				reader.setFormat(format);
+				auto other = get_instance<S2C_GetShiftsReply>(reader);
+				Assert::AreEqual(writer.getPosition(), reader.getPosition());
+
+				const auto& view = other.getShiftsView();
+				Assert::AreEqual(view.size(), shifts.size());
+				auto it = shifts.begin();
+				for (const auto& shiftView : view) {
+					Assert::IsTrue(shiftView == *it);
+					Assert::AreEqual(shiftView.getId(), it->getId());
+					Assert::IsTrue(shiftView.getStartTime() == it->getStartTime());
+					Assert::AreEqual(shiftView.getWorkerId(), it->getWorkerId());
+					Assert::AreEqual(shiftView.getJobId(), it->getJobId());
+					Assert::IsTrue(shiftView.toShift() == *it);
+					++it;
+				}
+				Assert::IsTrue(view[0] != *shifts.rbegin());
+
+				// the shifts are built on first access, and the view is dropped once they can be modified
+				Assert::IsTrue(other == reply);
+				other.getShifts().clear();
+				Assert::IsTrue(other.getShiftsView().empty());
+			}
+		}
+
+		TEST_METHOD(DecodeUntrustedPayloads) {
+			// lengths beyond the remaining bytes fail before anything is allocated
+			BinaryWriter forged;
+			forged.setFormat(WireFormat::Compact);
+			write_primitive(forged, Type::_S2C_ClientSync);
+			write_varint(forged, 1ULL << 40);
+			Assert::ExpectException<std::runtime_error>([&forged] {
+				decode_payload(forged.data(), forged.getPosition(), WireFormat::Compact, DecodeLimits());
+			});
+			std::stringstream forgedStream;
+			write_primitive(forgedStream, static_cast<size_t>(1ULL << 40));
+			forgedStream << "token";
+			Assert::ExpectException<std::runtime_error>([&forgedStream] {
+				read_string(forgedStream);
+			});
+
+			S2C_ClientSync sync;
+			for (identity_t id = 1; id <= 100; id++)
+				sync.getRemovedShifts().insert(id);
+			C2S_Authorize authorize("0123456789abcdef");
+			const Serializable* payloads[] = { &sync, &authorize };
+			DecodeLimits limits;
+			limits.maxCollectionSize = 100;
+			limits.maxStringLength = 16;
+			for (auto format : { WireFormat::Fixed, WireFormat::Compact }) {
+				for (const auto* obj : payloads) {
+					BinaryWriter writer;
+					writer.setFormat(format);
+					obj->serialize(writer);
+					Assert::IsTrue(decode_payload(writer.data(), writer.getPosition(), format, limits)->getType() == obj->getType());
+				}
+			}
+			// the limits bound otherwise valid payloads
+			limits.maxCollectionSize = 99;
+			limits.maxStringLength = 15;
+			for (const auto* obj : payloads) {
+				BinaryWriter writer;
+				obj->serialize(writer);
+				Assert::ExpectException<std::runtime_error>([&writer, &limits] {
+					decode_payload(writer.data(), writer.getPosition(), WireFormat::Fixed, limits);
+				});
+			}
+			// job names of peers are only added to the catalog up to a limit, as they are never released
+			BinaryWriter request;
+			request.setFormat(WireFormat::Compact);
+			C2S_InsertShift(Shift(DateTime(2020, 6, 1, 8, 0, 0), 8, u8"Kucharz (limit)"), false).serialize(request);
+			auto& catalog = JobCatalog::getInstance();
+			limits = DecodeLimits();
+			limits.maxJobNames = catalog.size();
+			Assert::IsTrue(decode_payload(request.data(), request.getPosition(), WireFormat::Compact, limits) != nullptr);
+			// the same request with a name the catalog does not hold yet
+			auto* name = std::search(request.data(), request.data() + request.getPosition(), "(limit)", "(limit)" + 7);
+			name[6] = ']';
+			const auto names = catalog.size();
+			Assert::ExpectException<std::runtime_error>([&request, &limits] {
+				decode_payload(request.data(), request.getPosition(), WireFormat::Compact, limits);
+			});
+			Assert::AreEqual(names, catalog.size());
+			limits.maxJobNames = names + 1;
+			Assert::IsTrue(decode_payload(request.data(), request.getPosition(), WireFormat::Compact, limits) != nullptr);
+			Assert::AreEqual(names + 1, catalog.size());
+			// requests are bounded by their type, before being decoded
+			C2S_Authorize large(std::string(MAX_REQUEST_SIZE, 'x'));
+			BinaryWriter writer;
+			large.serialize(writer);
+			Assert::ExpectException<std::runtime_error>([&writer] {
+				decode_payload(writer.data(), writer.getPosition(), WireFormat::Fixed, DecodeLimits());
+			});
+		}
+		TEST_METHOD(QueueOutboundFrames) {
+			const size_t producers = 4, frames = 10000;
+			SendQueue queue;
+			Assert::IsTrue(queue.empty());
+			std::vector<std::thread> threads;
+			for (size_t p = 0; p < producers; p++) {
+				threads.emplace_back([&queue, p, frames] {
+					for (size_t i = 0; i < frames; i++) {
+						auto* frame = new OutboundFrame();
+						frame->bytes = { static_cast<byte_t>(p), static_cast<byte_t>(i), static_cast<byte_t>(i >> 8) };
+						queue.push(frame);
+					}
+				});
+			}
+			// frames of each producer are popped in the order in which it pushed them
+			std::vector<size_t> next(producers, 0);
+			size_t popped = 0;
+			while (popped < producers * frames) {
+				auto* frame = queue.pop();
+				if (!frame)
+					continue;
+				const size_t p = frame->bytes[0];
+				const size_t i = frame->bytes[1] | (frame->bytes[2] << 8);
+				Assert::AreEqual(next[p] & 0xFFFF, i);
+				next[p]++;
+				popped++;
+				delete frame;
+			}
+			for (auto& thread : threads)
+				thread.join();
+			Assert::IsTrue(queue.empty());
+			Assert::IsTrue(queue.pop() == nullptr);
+			// completions report whether the frame was sent
+			int outcome = -1;
+			OutboundFrame frame;
+			frame.completion = [&outcome](bool sent) { outcome = sent ? 1 : 0; };
+			frame.complete(false);
+			Assert::AreEqual(0, outcome);
+		}
+		TEST_METHOD(BufferReceivedFrames) {
+			ReceiveBuffer buffer;
+			Assert::AreEqual(size_t(16), buffer.reserve(4, 16));
+			const byte_t received[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+			std::memcpy(buffer.writable(), received, sizeof(received));
+			buffer.commit(sizeof(received));
+			// decoded bytes are consumed in place
+			buffer.consume(4);
+			Assert::AreEqual(size_t(6), buffer.size());
+			Assert::AreEqual(byte_t(5), buffer.data()[0]);
+			const auto* partial = buffer.data();
+			// the rest of a frame that fits behind it is received in place
+			Assert::AreEqual(size_t(6), buffer.reserve(10, 16));
+			Assert::IsTrue(buffer.data() == partial);
+			// otherwise the partial frame moves to the start
+			Assert::AreEqual(size_t(6), buffer.reserve(12, 16));
+			Assert::AreEqual(byte_t(5), buffer.data()[0]);
+			Assert::AreEqual(size_t(16), buffer.getCapacity());
+			// or the buffer grows
+			Assert::AreEqual(size_t(26), buffer.reserve(32, 16));
+			Assert::AreEqual(byte_t(10), buffer.data()[5]);
+			buffer.consume(6);
+			Assert::AreEqual(size_t(0), buffer.size());
+			Assert::AreEqual(size_t(32), buffer.reserve(32, 16));
+			buffer.shrink(16);
+			Assert::AreEqual(size_t(0), buffer.getCapacity());
+		}
+		TEST_METHOD(StreamLargeReplies) {
+			std::map<identity_t, ShiftWorker> workers;
+			for (identity_t id = 1; id <= 3000; id++)
+				workers[id] = ShiftWorker(std::wstring(20, L'a' + id % 26), L"Kowalski", L"Kelner", id);
+			SizeContext context;
+			const auto whole = S2C_GetWorkersReply(7).serializedSize(WireFormat::Fixed) +
+				Fields::ObjectMap<ShiftWorker>::size(context, workers);
+			Assert::IsTrue(whole > static_cast<size_t>(MAX_PACKET_SIZE));
+
+			CapturingConnection connection;
+			ReplyStream<S2C_GetWorkersReply> stream(&connection, S2C_GetWorkersReply(7));
+			for (const auto& kv : workers)
+				stream.add(kv.second);
+			stream.finish();
+			Assert::AreEqual(connection.packets.size(), stream.getParts());
+			Assert::IsTrue(connection.packets.size() > 1);
+
+			// every part is bounded, and all of them together list every worker once
+			std::map<identity_t, ShiftWorker> received;
+			for (size_t i = 0; i < connection.packets.size(); i++) {
+				const auto& packet = connection.packets[i];
+				Assert::IsTrue(sizeof(content_len_t) + packet.size() <= STREAM_PART_SIZE);
+				auto part = std::dynamic_pointer_cast<S2C_GetWorkersReply>(decode_payload(packet.data(), packet.size(), WireFormat::Fixed, DecodeLimits()));
+				Assert::IsTrue(part != nullptr);
+				Assert::AreEqual(7, part->getRequestId());
+				Assert::IsTrue(part->isSuccess());
+				Assert::AreEqual(i + 1 < connection.packets.size(), part->isContinued());
+				for (const auto& kv : part->getWorkers())
+					Assert::IsTrue(received.insert(kv).second);
+			}
+			Assert::IsTrue(received == workers);
+
+			// results that fit are sent in a single, final part
+			CapturingConnection small;
+			ReplyStream<S2C_GetShiftsReply> shifts(&small, S2C_GetShiftsReply(8, Date(2020, 6, 1)));
+			shifts.getReply().setErrorMsg("Unauthorized");
+			shifts.finish();
+			Assert::AreEqual(size_t(1), small.packets.size());
+			BinaryReader reader(small.packets[0].data(), small.packets[0].size());
+			auto reply = get_instance<S2C_GetShiftsReply>(reader);
+			Assert::IsFalse(reply.isContinued());
+			Assert::IsFalse(reply.isSuccess());
+		}
+		TEST_METHOD(SubscribeToDays) {
+			checkSerialization(C2S_SubscribeDays());
+			checkSerialization(C2S_SubscribeDays(Date(2020, 6, 1), Date(2020, 6, 7)));
+			S2C_SubscribeDaysReply reply(5125, Date(2020, 6, 1), Date(2020, 6, 7));
+			checkSerialization(reply);
+			reply.setErrorMsg("Unauthorized");
+			checkSerialization(reply);
+
+			// clients get the changes of every day until they subscribe to a range
+			DaySubscriptions subscriptions;
+			subscriptions.add(1);
+			subscriptions.add(2);
+			subscriptions.add(3);
+			subscriptions.subscribe(2, Date(2020, 6, 1), Date(2020, 6, 7));
+			subscriptions.subscribe(3, Date(2020, 6, 5), Date(2020, 6, 5));
+			auto collect = [&subscriptions](const Date& day) {
+				std::vector<int> clients;
+				subscriptions.collect(day, clients);
+				return std::set<int>(clients.begin(), clients.end());
+			};
+			Assert::IsTrue(collect(Date(2020, 5, 31)) == std::set<int>{1});
+			Assert::IsTrue(collect(Date(2020, 6, 1)) == std::set<int>({1, 2}));
+			Assert::IsTrue(collect(Date(2020, 6, 5)) == std::set<int>({1, 2, 3}));
+			Assert::IsTrue(collect(Date(2020, 6, 7)) == std::set<int>({1, 2}));
+			// a new range replaces the previous one
+			subscriptions.subscribe(2, Date(2021, 1, 1), Date(2021, 1, 1));
+			Assert::IsTrue(collect(Date(2020, 6, 1)) == std::set<int>{1});
+			Assert::IsTrue(collect(Date(2021, 1, 1)) == std::set<int>({1, 2}));
+			subscriptions.remove(1);
+			subscriptions.remove(2);
+			Assert::IsTrue(collect(Date(2021, 1, 1)).empty());
+			Assert::AreEqual(size_t(1), subscriptions.size());
+
+			// the manager accepts ranges only from clients allowed to view them
+			RestaurantManager manager(nullptr);
+			CapturingConnection connection;
+			manager.handleSubscribeDays(&connection, C2S_SubscribeDays(Date(2020, 6, 1), Date(2020, 6, 2)), 0);
+			connection.getData().put("Permissions", UserPermissions::View);
+			manager.handleSubscribeDays(&connection, C2S_SubscribeDays(Date(2020, 6, 2), Date(2020, 6, 1)), 0);
+			Assert::IsFalse(manager.getSubscriptions().isSubscribed(connection.getId()));
+			manager.handleSubscribeDays(&connection, C2S_SubscribeDays(Date(2020, 6, 1), Date(2020, 6, 2)), 0);
+			Assert::IsTrue(manager.getSubscriptions().isSubscribed(connection.getId()));
+			Assert::AreEqual(size_t(3), connection.packets.size());
+			for (size_t i = 0; i < connection.packets.size(); i++) {
+				BinaryReader reader(connection.packets[i].data(), connection.packets[i].size());
+				auto received = get_instance<S2C_SubscribeDaysReply>(reader);
+				Assert::AreEqual(i == 2, received.isSuccess());
+			}
+		}
+		TEST_METHOD(CoalesceChanges) {
+			SyncBatch batch;
+			Assert::IsTrue(batch.empty());
+			const Shift monday(DateTime(2020, 6, 1, 8, 0, 0), 8, L"Kelner", 1, 1);
+			const Shift tuesday(DateTime(2020, 6, 2, 8, 0, 0), 8, L"Kelner", 2, 2);
+			// inserted and removed before being sent, the shift is never sent at all
+			batch.changeShift(Shift(DateTime(2020, 6, 1, 9, 0, 0), 8, L"Kucharz", 1, 3), true);
+			batch.removeShift(3, Date(2020, 6, 1));
+			Assert::IsTrue(batch.empty());
+			// the latest state of a shift modified twice
+			batch.changeShift(Shift(DateTime(2020, 6, 1, 6, 0, 0), 8, L"Kelner", 1, 1), false);
+			batch.changeShift(monday, false);
+			batch.removeShift(2, Date(2020, 6, 2));
+			batch.changeShift(tuesday, true);
+			batch.changeWorker(ShiftWorker(L"Jan", L"Kowalski", L"Kelner", 4), true);
+			batch.changeWorker(ShiftWorker(L"Anna", L"Nowak", L"Kelner", 5), true);
+			batch.removeWorker(5);
+			// moved from a day to another one
+			const Shift moved(DateTime(2020, 6, 1, 14, 0, 0), 8, L"Kelner", 1, 6);
+			batch.removeShift(6, Date(2020, 6, 5));
+			batch.changeShift(moved, false);
+			Assert::IsFalse(batch.empty());
+
+			DaySubscriptions subscriptions;
+			subscriptions.add(1);
+			subscriptions.add(2);
+			subscriptions.add(3);
+			subscriptions.subscribe(2, Date(2020, 6, 1), Date(2020, 6, 1));
+			subscriptions.subscribe(3, Date(2020, 6, 5), Date(2020, 6, 5));
+			std::map<int, std::shared_ptr<const S2C_ClientSync>> received;
+			size_t packets = 0;
+			batch.build(subscriptions, 7, [&](std::shared_ptr<const S2C_ClientSync> sync, std::vector<int> clients) {
+				packets++;
+				for (auto client : clients)
+					Assert::IsTrue(received.emplace(client, sync).second);
+			});
+			Assert::AreEqual(size_t(3), packets);
+
+			// every change reaches the clients viewing its day in a single packet, workers reach everyone.
+			// a change replaces the removal of the same shift, which only goes to the clients not getting the change
+			const auto& all = *received.at(1);
+			Assert::IsTrue(all.getChangedShifts() == std::set<Shift>({monday, tuesday, moved}));
+			Assert::IsTrue(all.getRemovedShifts().empty());
+			Assert::AreEqual(size_t(1), all.getChangedWorkers().size());
+			Assert::IsTrue(all.getRemovedWorkers().empty());
+			const auto& viewer = *received.at(2);
+			Assert::IsTrue(viewer.getChangedShifts() == std::set<Shift>({monday, moved}));
+			Assert::IsTrue(viewer.getRemovedShifts().empty());
+			const auto& other = *received.at(3);
+			Assert::IsTrue(other.getChangedShifts().empty());
+			Assert::IsTrue(other.getRemovedShifts() == std::set<identity_t>{6});
+			Assert::AreEqual(size_t(1), other.getChangedWorkers().size());
+			S2C_ClientSync filled;
+			batch.fill(filled, [](const Date& day) { return day == Date(2020, 6, 1) || day == Date(2020, 6, 5); });
+			Assert::IsTrue(filled.getChangedShifts() == std::set<Shift>({monday, moved}));
+			Assert::IsTrue(filled.getRemovedShifts().empty());
+
+			batch.clear();
+			Assert::IsTrue(batch.empty());
+			Assert::AreEqual(size_t(0), batch.size());
+		}
+		TEST_METHOD(ResumeFromChangeLog) {
+			checkSerialization(C2S_GetChanges());
+			checkSerialization(C2S_GetChanges(0x123456789abcdefull, 41));
+			S2C_GetChangesReply reply(5125, 0x123456789abcdefull, 41);
+			checkSerialization(reply);
+			reply.setComplete(true);
+			reply.getChanges().getChangedShifts().insert(rand_shift());
+			reply.getChanges().getRemovedWorkers().insert(rand_id());
+			checkSerialization(reply);
+
+			ChangeLog log(4);
+			Assert::AreNotEqual(uint64_t(0), log.getId());
+			const Shift shift(DateTime(2020, 6, 1, 8, 0, 0), 8, L"Kelner", 1, 1);
+			log.changeShift(shift, true);
+			log.changeWorker(ShiftWorker(L"Jan", L"Kowalski", L"Kelner", 2), true);
+			log.removeWorker(2);
+			Assert::AreEqual(uint64_t(3), log.getVersion());
+			// a client that has seen the first change only misses a worker that does not exist anymore
+			SyncBatch missed;
+			Assert::IsTrue(log.replay(1, missed));
+			Assert::IsTrue(missed.empty());
+			Assert::IsTrue(log.replay(3, missed));
+			Assert::IsTrue(missed.empty());
+			Assert::IsTrue(log.replay(0, missed));
+			S2C_ClientSync changes;
+			missed.fill(changes, [](const Date&) { return true; });
+			Assert::IsTrue(changes.getChangedShifts() == std::set<Shift>{shift});
+			Assert::IsTrue(changes.getRemovedWorkers().empty());
+			// versions from the future or older than the log require listing everything again
+			Assert::IsFalse(log.replay(4, missed));
+			log.removeShift(1, Date(2020, 6, 1));
+			log.changeShift(shift, true);
+			Assert::AreEqual(size_t(4), log.size());
+			Assert::IsFalse(log.replay(0, missed));
+			Assert::IsTrue(log.replay(1, missed));
+
+			// the manager replies with the missed changes of the log it keeps
+			RestaurantManager manager(nullptr);
+			CapturingConnection connection;
+			connection.getData().put("Permissions", UserPermissions::View);
+			manager.insertShift(shift);
+			const auto logId = manager.getChangeLog().getId();
+			manager.handleGetChanges(&connection, C2S_GetChanges(logId, 0), 0);
+			manager.handleGetChanges(&connection, C2S_GetChanges(logId + 1, 0), 0);
+			Assert::AreEqual(size_t(2), connection.packets.size());
+			BinaryReader first(connection.packets[0].data(), connection.packets[0].size());
+			auto resumed = get_instance<S2C_GetChangesReply>(first);
+			Assert::IsTrue(resumed.isComplete());
+			Assert::AreEqual(logId, resumed.getLogId());
+			Assert::AreEqual(uint64_t(1), resumed.getChanges().getVersion());
+			Assert::AreEqual(size_t(1), resumed.getChanges().getChangedShifts().size());
+			BinaryReader second(connection.packets[1].data(), connection.packets[1].size());
+			auto restarted = get_instance<S2C_GetChangesReply>(second);
+			Assert::IsFalse(restarted.isComplete());
+			Assert::IsTrue(restarted.getChanges().getChangedShifts().empty());
+		}
+		TEST_METHOD(ShardShiftLocks) {
+			RestaurantManager manager(nullptr);
+			const int threads = 4, days = 8, perThread = 48;
+			std::vector<std::thread> writers;
+			for (int t = 0; t < threads; t++) {
+				writers.emplace_back([&, t] {
+					// every thread edits shifts of its own job, so none of them collide
+					const auto job = "Job " + std::to_string(t);
+					for (int i = 0; i < perThread; i++) {
+						auto shift = manager.insertShift(Shift(DateTime(2020, 6, 1 + i % days, i / days, 0, 0), 1, job));
+						if (i % 4 == 0) {
+							// moved to a day of another partition, then removed
+							shift.setStartTime(DateTime(2020, 7, 1 + i % days, i / days, 0, 0));
+							manager.insertShift(shift, true);
+							Assert::IsTrue(manager.deleteShift(shift.getId()));
+						}
+						else if (i % 4 == 1) {
+							shift.setStartTime(DateTime(2020, 7, 1 + i % days, i / days, 0, 0));
+							manager.insertShift(shift, true);
+						}
+					}
+				});
+			}
+			for (auto& thread : writers)
+				thread.join();
+
+			const auto shifts = manager.getShifts();
+			Assert::AreEqual(size_t(threads * perThread * 3 / 4), shifts.size());
+			// a move is logged as a removal from the old day and the new state of the shift
+			Assert::AreEqual(uint64_t(threads * (perThread + perThread / 4 * 3 + perThread / 4 * 2)),
+				manager.getChangeLog().getVersion());
+			size_t listed = 0;
+			for (int month = 6; month <= 7; month++) {
+				for (int day = 1; day <= days; day++) {
+					for (const auto& shift : manager.getShiftsByDay(Date(2020, month, day))) {
+						Assert::IsTrue(Date(shift.getStartTime()) == Date(2020, month, day));
+						Assert::IsTrue(shifts.at(shift.getId()) == shift);
+						listed++;
+					}
+				}
+			}
+			Assert::AreEqual(shifts.size(), listed);
+
+			// the partitions are stored and restored as a single database
+			BinaryWriter writer;
+			manager.serialize(writer);
+			BinaryReader reader(writer.data(), writer.getPosition());
+			RestaurantManager restored(nullptr);
+			restored.deserialize(reader);
+			Assert::IsTrue(restored.getShifts() == shifts);
+			const auto next = restored.insertShift(Shift(DateTime(2021, 1, 1, 8, 0, 0), 1, "Job 0"));
+			Assert::IsTrue(next.getId() > shifts.rbegin()->first);
+		}
+		TEST_METHOD(ReadPublishedSnapshots) {
+			RestaurantManager manager(nullptr);
+			const Date monday(2020, 6, 1), tuesday(2020, 6, 2);
+			auto shift = manager.insertShift(Shift(DateTime(2020, 6, 1, 8, 0, 0), 8, "Kelner"));
+			auto worker = manager.insertWorker(ShiftWorker(L"Jan", L"Kowalski", L"Kelner"));
+			const auto before = manager.getDaySnapshot(monday);
+			const auto workersBefore = manager.getWorkersSnapshot();
+			Assert::AreEqual(size_t(1), before->size());
+			Assert::IsTrue(manager.getDaySnapshot(tuesday)->empty());
+
+			// the held snapshots stay the same while the database changes
+			manager.insertShift(Shift(DateTime(2020, 6, 1, 16, 0, 0), 4, "Kelner"));
+			shift.setStartTime(DateTime(2020, 6, 2, 8, 0, 0));
+			shift.setWorkerId(worker.getId());
+			manager.insertShift(shift, true);
+			manager.insertWorker(ShiftWorker(L"Anna", L"Nowak", L"Kucharz"));
+			Assert::AreEqual(size_t(1), before->size());
+			Assert::AreEqual(identity_t(0), before->front().getWorkerId());
+			Assert::AreEqual(size_t(1), workersBefore->size());
+
+			const auto after = manager.getDaySnapshot(monday);
+			Assert::AreEqual(size_t(1), after->size());
+			Assert::AreNotEqual(shift.getId(), after->front().getId());
+			Assert::IsTrue(*manager.getDaySnapshot(tuesday) == std::vector<Shift>{shift});
+			Assert::AreEqual(size_t(2), manager.getWorkersSnapshot()->size());
+
+			// removing a worker publishes the shifts it was unassigned from
+			const auto assigned = manager.getDaySnapshot(tuesday);
+			Assert::IsTrue(manager.deleteWorker(worker.getId()));
+			Assert::AreEqual(worker.getId(), assigned->front().getWorkerId());
+			Assert::AreEqual(identity_t(0), manager.getDaySnapshot(tuesday)->front().getWorkerId());
+			Assert::IsTrue(manager.deleteShift(shift.getId()));
+			Assert::IsTrue(manager.getDaySnapshot(tuesday)->empty());
+
+			// a restored database is published as a whole
+			BinaryWriter writer;
+			manager.serialize(writer);
+			BinaryReader reader(writer.data(), writer.getPosition());
+			RestaurantManager restored(nullptr);
+			restored.deserialize(reader);
+			Assert::IsTrue(*restored.getDaySnapshot(monday) == *after);
+			Assert::AreEqual(size_t(1), restored.getWorkersSnapshot()->size());
+		}
+		TEST_METHOD(DetectShiftCollisions) {
+			ShiftIntervals intervals;
+			intervals.add(Shift(DateTime(2020, 6, 1, 8, 0, 0), 4, "Kelner", 0, 1));
+			intervals.add(Shift(DateTime(2020, 6, 1, 14, 0, 0), 2, "Kelner", 0, 2));
+			Assert::AreEqual(size_t(2), intervals.size());
+			// touching shifts do not overlap
+			Assert::IsFalse(intervals.collides(Shift(DateTime(2020, 6, 1, 12, 0, 0), 2, "Kelner")));
+			Assert::IsFalse(intervals.collides(Shift(DateTime(2020, 6, 1, 16, 0, 0), 1, "Kelner")));
+			Assert::IsFalse(intervals.collides(Shift(DateTime(2020, 6, 1, 6, 0, 0), 2, "Kelner")));
+			Assert::IsTrue(intervals.collides(Shift(DateTime(2020, 6, 1, 8, 0, 0), 1, "Kelner")));
+			Assert::IsTrue(intervals.collides(Shift(DateTime(2020, 6, 1, 11, 0, 0), 4, "Kelner")));
+			Assert::IsTrue(intervals.collides(Shift(DateTime(2020, 6, 1, 7, 0, 0), 2, "Kelner")));
+			Assert::IsTrue(intervals.collides(Shift(DateTime(2020, 6, 1, 6, 0, 0), 12, "Kelner")));
+			// other jobs and other days are not checked
+			Assert::IsFalse(intervals.collides(Shift(DateTime(2020, 6, 1, 8, 0, 0), 4, "Kucharz")));
+			Assert::IsFalse(intervals.collides(Shift(DateTime(2020, 6, 2, 8, 0, 0), 4, "Kelner")));
+			// an edited shift does not collide with its old self
+			Assert::IsFalse(intervals.collides(Shift(DateTime(2020, 6, 1, 9, 0, 0), 4, "Kelner", 0, 1)));
+			Assert::IsTrue(intervals.collides(Shift(DateTime(2020, 6, 1, 11, 0, 0), 4, "Kelner", 0, 1)));
+			Assert::IsFalse(intervals.collides(Shift(DateTime(2020, 6, 1, 12, 0, 0), 4, "Kelner", 0, 2)));
+			intervals.remove(Shift(DateTime(2020, 6, 1, 8, 0, 0), 4, "Kelner", 0, 1));
+			Assert::AreEqual(size_t(1), intervals.size());
+			Assert::IsFalse(intervals.collides(Shift(DateTime(2020, 6, 1, 8, 0, 0), 1, "Kelner")));
+
+			// the manager rejects colliding inserts and edits
+			RestaurantManager manager(nullptr);
+			auto first = manager.insertShift(Shift(DateTime(2020, 6, 1, 8, 0, 0), 4, "Kelner"));
+			auto second = manager.insertShift(Shift(DateTime(2020, 6, 1, 12, 0, 0), 4, "Kelner"));
+			Assert::ExpectException<std::invalid_argument>([&manager] {
+				manager.insertShift(Shift(DateTime(2020, 6, 1, 10, 0, 0), 4, "Kelner"));
+			});
+			second.setStartTime(DateTime(2020, 6, 1, 10, 0, 0));
+			Assert::ExpectException<std::invalid_argument>([&manager, &second] {
+				manager.insertShift(second, true);
+			});
+			// a moved shift frees its old time
+			first.setStartTime(DateTime(2020, 6, 2, 8, 0, 0));
+			manager.insertShift(first, true);
+			manager.insertShift(second, true);
+			Assert::IsFalse(manager.verifyShift(Shift(DateTime(2020, 6, 2, 9, 0, 0), 1, "Kelner")));
+			Assert::IsTrue(manager.deleteShift(first.getId()));
+			Assert::IsTrue(manager.verifyShift(Shift(DateTime(2020, 6, 2, 9, 0, 0), 1, "Kelner")));
+		}
+		TEST_METHOD(ListShiftsByWorker) {
+			checkSerialization(C2S_GetShiftsByWorker());
+			checkSerialization(C2S_GetShiftsByWorker(rand_id(), Date(2020, 6, 1), Date(2020, 6, 30)));
+			S2C_GetShiftsByWorkerReply reply(5125, rand_id(), Date(2020, 6, 1), Date(2020, 6, 30));
+			checkSerialization(reply);
+			reply.getShifts().insert(rand_shift());
+			reply.getShifts().insert(rand_shift());
+			checkSerialization(reply);
+
+			RestaurantManager manager(nullptr);
+			const auto worker = manager.insertWorker(ShiftWorker(L"Jan", L"Kowalski", L"Kelner")).getId();
+			const auto other = manager.insertWorker(ShiftWorker(L"Anna", L"Nowak", L"Kelner")).getId();
+			auto first = manager.insertShift(Shift(DateTime(2020, 6, 3, 8, 0, 0), 8, "Kelner", worker));
+			auto second = manager.insertShift(Shift(DateTime(2020, 6, 1, 8, 0, 0), 8, "Kelner", worker));
+			auto third = manager.insertShift(Shift(DateTime(2020, 7, 1, 8, 0, 0), 8, "Kelner", worker));
+			manager.insertShift(Shift(DateTime(2020, 6, 2, 8, 0, 0), 8, "Kelner", other));
+			auto june = manager.getShiftsByWorker(worker, Date(2020, 6, 1), Date(2020, 6, 30));
+			Assert::IsTrue(june == std::vector<Shift>({ second, first }));
+			Assert::AreEqual(size_t(3), manager.getShiftsByWorker(worker, Date(2020, 1, 1), Date(2020, 12, 31)).size());
+
+			// edits move the shifts in the index
+			first.setStartTime(DateTime(2020, 7, 2, 8, 0, 0));
+			manager.insertShift(first, true);
+			second.setWorkerId(other);
+			manager.insertShift(second, true);
+			Assert::IsTrue(manager.getShiftsByWorker(worker, Date(2020, 6, 1), Date(2020, 6, 30)).empty());
+			Assert::IsTrue(manager.getShiftsByWorker(worker, Date(2020, 7, 1), Date(2020, 7, 31)) ==
+				std::vector<Shift>({ third, first }));
+			Assert::AreEqual(size_t(2), manager.getShiftsByWorker(other, Date(2020, 6, 1), Date(2020, 6, 30)).size());
+			Assert::IsTrue(manager.deleteShift(third.getId()));
+			Assert::AreEqual(size_t(1), manager.getShiftsByWorker(worker, Date(2020, 7, 1), Date(2020, 7, 31)).size());
+
+			CapturingConnection connection;
+			connection.getData().put("Permissions", UserPermissions::View);
+			manager.handleGetShiftsByWorker(&connection, C2S_GetShiftsByWorker(other, Date(2020, 6, 1), Date(2020, 6, 30)), 0);
+			manager.handleGetShiftsByWorker(&connection, C2S_GetShiftsByWorker(other, Date(2020, 6, 30), Date(2020, 6, 1)), 0);
+			Assert::AreEqual(size_t(2), connection.packets.size());
+			BinaryReader listed(connection.packets[0].data(), connection.packets[0].size());
+			auto schedule = get_instance<S2C_GetShiftsByWorkerReply>(listed);
+			Assert::IsTrue(schedule.isSuccess());
+			Assert::AreEqual(other, schedule.getWorkerId());
+			Assert::AreEqual(size_t(2), schedule.getShifts().size());
+			BinaryReader rejected(connection.packets[1].data(), connection.packets[1].size());
+			Assert::IsFalse(get_instance<S2C_GetShiftsByWorkerReply>(rejected).isSuccess());
+
+			// removing a worker only unassigns its own shifts
+			Assert::IsTrue(manager.deleteWorker(other));
+			Assert::IsTrue(manager.getShiftsByWorker(other, Date(2020, 1, 1), Date(2020, 12, 31)).empty());
+			for (const auto& shift : manager.getShiftsByDay(Date(2020, 6, 1)))
+				Assert::AreEqual(identity_t(0), shift.getWorkerId());
+			Assert::AreEqual(worker, manager.getShiftsByDay(Date(2020, 7, 2)).front().getWorkerId());
+
+			// the index is rebuilt with the database
+			BinaryWriter writer;
+			manager.serialize(writer);
+			BinaryReader reader(writer.data(), writer.getPosition());
+			RestaurantManager restored(nullptr);
+			restored.deserialize(reader);
+			Assert::IsTrue(restored.getShiftsByWorker(worker, Date(2020, 7, 1), Date(2020, 7, 31)) ==
+				std::vector<Shift>({ first }));
+		}
+		TEST_METHOD(StoreShiftsDensely) {
+			const DateTime time(2020, 12, 31, 23, 59, 58);
+			Assert::IsTrue(ShiftTable::unpackTime(ShiftTable::packTime(time)) == time);
+			Assert::IsTrue(ShiftTable::packTime(DateTime(2020, 6, 1, 8, 0, 0)) < ShiftTable::packTime(DateTime(2020, 6, 1, 9, 0, 0)));
+			Assert::IsTrue(ShiftTable::unpackDay(ShiftTable::packDay(Date(2020, 12, 31))) == Date(2020, 12, 31));
+			Assert::IsTrue(ShiftTable::packDay(Date(2020, 1, 31)) < ShiftTable::packDay(Date(2020, 2, 1)));
+
+			ShiftTable table;
+			const Shift late(DateTime(2020, 6, 1, 16, 0, 0), 4, "Kelner", 7, 9);
+			const Shift early(DateTime(2020, 6, 1, 8, 0, 0), 8, "Kucharz", 0, 3);
+			const Shift other(DateTime(2020, 6, 2, 8, 0, 0), 8, "Kelner", 7, 5);
+			const auto lateSlot = table.insert(late);
+			const auto earlySlot = table.insert(early);
+			table.insert(other);
+			Assert::AreEqual(size_t(3), table.size());
+			Assert::IsTrue(table.get(lateSlot) == late);
+			Assert::IsTrue(table.getDay(earlySlot) == Date(2020, 6, 1));
+			Assert::IsTrue(table.holds(lateSlot, 9));
+			Assert::IsFalse(table.holds(lateSlot, 3));
+			// days list their shifts ordered by id
+			Assert::IsTrue(table.getDay(Date(2020, 6, 1)) == ShiftTable::Slots({ earlySlot, lateSlot }));
+			Assert::AreEqual(size_t(2), table.getDays().size());
+
+			table.setWorkerId(lateSlot, 0);
+			Assert::AreEqual(identity_t(0), table.get(lateSlot).getWorkerId());
+			table.erase(earlySlot);
+			Assert::IsFalse(table.holds(earlySlot, 3));
+			Assert::AreEqual(size_t(2), table.size());
+			// removed slots are reused
+			Assert::AreEqual(earlySlot, table.insert(Shift(DateTime(2020, 6, 3, 8, 0, 0), 8, "Kelner", 0, 12)));
+			Assert::IsTrue(table.getDay(Date(2020, 6, 1)) == ShiftTable::Slots({ lateSlot }));
+			table.clear();
+			Assert::AreEqual(size_t(0), table.size());
+			Assert::IsTrue(table.getDay(Date(2020, 6, 1)).empty());
+		}
+		TEST_METHOD(ReplayWriteAheadLog) {
+			const std::string path = "ReplayWriteAheadLog.wal";
+			RestaurantManager manager(nullptr);
+			WriteAheadLog log;
+			log.open(path, 0);
+			log.setCommitWindow(std::chrono::microseconds(0));
+			manager.setWriteAheadLog(&log);
+
+			const auto kept = manager.insertWorker(ShiftWorker(L"Jan", L"Kowalski", L"Kelner"));
+			const auto removed = manager.insertWorker(ShiftWorker(L"Anna", L"Nowak", L"Kucharz"));
+			manager.insertWorker(ShiftWorker(L"Jan", L"Kowalski", L"Szef", kept.getId()), true);
+			const auto first = manager.insertShift(Shift(DateTime(2020, 6, 1, 8, 0, 0), 8, "Kelner", kept.getId()));
+			auto moved = manager.insertShift(Shift(DateTime(2020, 6, 1, 8, 0, 0), 8, "Kucharz", removed.getId()));
+			const auto deleted = manager.insertShift(Shift(DateTime(2020, 6, 1, 16, 0, 0), 4, "Kelner"));
+			moved.setStartTime(DateTime(2020, 6, 2, 10, 0, 0));
+			manager.insertShift(moved, true);
+			manager.deleteShift(deleted.getId());
+			manager.deleteWorker(removed.getId());
+			log.commit();
+			Assert::IsTrue(log.getSyncCount() >= 1);
+
+			RestaurantManager restored(nullptr);
+			uint64_t next;
+			Assert::AreEqual(size_t(10), restored.replayWriteAheadLog(path, 0, next));
+			Assert::AreEqual(uint64_t(1), next);
+			Assert::IsTrue(restored.getShifts() == manager.getShifts());
+			Assert::IsTrue(restored.getWorkers() == manager.getWorkers());
+			// new shifts get ids after the replayed ones
+			Assert::IsTrue(restored.insertShift(Shift(DateTime(2020, 6, 3, 8, 0, 0), 8, "Kelner")).getId() > deleted.getId());
+
+			// a record torn by a crash ends its segment, the log goes on in the next one
+			manager.setWriteAheadLog(nullptr);
+			log.close();
+			{
+				std::ofstream file(WriteAheadLog::segmentPath(path, 0), std::ios::binary | std::ios::app);
+				file.write("\x20\0\0\0\x01", 5);
+			}
+			RestaurantManager torn(nullptr);
+			Assert::AreEqual(size_t(10), torn.replayWriteAheadLog(path, 0, next));
+			log.open(path, next);
+			torn.setWriteAheadLog(&log);
+			torn.deleteShift(first.getId());
+			log.close();
+			RestaurantManager reopened(nullptr);
+			Assert::AreEqual(size_t(11), reopened.replayWriteAheadLog(path, 0, next));
+			Assert::AreEqual(uint64_t(2), next);
+			Assert::AreEqual(size_t(1), reopened.getShifts().size());
+
+			// the segments held by a snapshot are removed
+			log.open(path, next);
+			Assert::AreEqual(uint64_t(3), log.rotate());
+			Assert::AreEqual(size_t(3), log.compact(3));
+			log.close();
+			RestaurantManager empty(nullptr);
+			Assert::AreEqual(size_t(0), empty.replayWriteAheadLog(path, 0, next));
+			Assert::AreEqual(uint64_t(0), next);
+			std::remove(WriteAheadLog::segmentPath(path, 3).c_str());
+		}
+		TEST_METHOD(ReplyOnceDurable) {
+			const std::string path = "ReplyOnceDurable.wal";
+			RestaurantManager manager(nullptr);
+			WriteAheadLog log;
+			log.open(path, 0);
+			log.setCommitWindow(std::chrono::milliseconds(200));
+			manager.setWriteAheadLog(&log);
+			CapturingConnection connection;
+			connection.getData().put("Permissions", UserPermissions::Insert);
+			// the handler returns before the change is synced, the log sends the reply once it is
+			manager.handleInsertShift(&connection, C2S_InsertShift(Shift(DateTime(2020, 6, 1, 8, 0, 0), 8, "Kelner"), false), 0);
+			Assert::IsTrue(connection.packets.empty());
+			Assert::AreEqual(size_t(1), manager.getShifts().size());
+			manager.setWriteAheadLog(nullptr);
+			log.close();
+			Assert::AreEqual(size_t(1), connection.packets.size());
+			BinaryReader reader(connection.packets[0].data(), connection.packets[0].size());
+			auto reply = get_instance<S2C_InsertShiftReply>(reader);
+			Assert::IsTrue(reply.getErrorMsg().empty());
+			Assert::IsTrue(reply.getShift().getId() != 0);
+			std::remove(WriteAheadLog::segmentPath(path, 0).c_str());
+
+			// once the log cannot save changes, they are refused before being made
+			FailingLog failing;
+			failing.open(path, 0);
+			manager.setWriteAheadLog(&failing);
+			failing.fail();
+			Assert::IsTrue(failing.hasFailed());
+			manager.handleInsertShift(&connection, C2S_InsertShift(Shift(DateTime(2020, 6, 2, 8, 0, 0), 8, "Kelner"), false), 0);
+			Assert::AreEqual(size_t(2), connection.packets.size());
+			BinaryReader refused(connection.packets[1].data(), connection.packets[1].size());
+			Assert::IsFalse(get_instance<S2C_InsertShiftReply>(refused).getErrorMsg().empty());
+			Assert::AreEqual(size_t(1), manager.getShifts().size());
+			manager.setWriteAheadLog(nullptr);
+			failing.close();
+			std::remove(WriteAheadLog::segmentPath(path, 0).c_str());
+		}
+		TEST_METHOD(SaveSnapshotsOnline) {
+			const std::string path = "SaveSnapshotsOnline.bin";
+			const std::string logPath = "SaveSnapshotsOnline.wal";
+			RestaurantManager manager(nullptr);
+			manager.getAccessTokens()["arbuz"] = UserPermissions::NORMAL_USER;
+			WriteAheadLog log;
+			log.open(logPath, 0);
+			log.setCommitWindow(std::chrono::microseconds(0));
+			manager.setWriteAheadLog(&log);
+			Checkpointer checkpointer(manager, path, &log);
+			for (int i = 0; i < 50; i++)
+				manager.insertShift(Shift(DateTime(2020, 6, 1 + i % 10, i / 10, 0, 0), 1, "Kelner", 0));
+			const auto worker = manager.insertWorker(ShiftWorker(L"Jan", L"Kowalski", L"Kelner"));
+
+			// the image does not change with the manager, and is written the same way as the manager itself
+			const auto image = manager.captureSnapshot();
+			BinaryWriter expected;
+			manager.serialize(expected);
+			manager.deleteShift(1);
+			BinaryWriter written;
+			image->serialize(written);
+			Assert::AreEqual(expected.getPosition(), written.getPosition());
+			Assert::IsTrue(std::equal(expected.data(), expected.data() + expected.getPosition(), written.data()));
+			Assert::AreEqual(expected.getPosition(), image->serializedSize());
+
+			// changes made while the snapshot is saved go to the next segment of the log
+			std::atomic<bool> stop{false};
+			std::thread writer([&] {
+				for (int i = 0; !stop; i++) {
+					manager.deleteShift(manager.insertShift(Shift(DateTime(2020, 7, 1, 8, 0, 0), 1, "Kucharz")).getId());
+					if (i % 16 == 0)
+						manager.insertWorker(ShiftWorker(L"Jan", L"Kowalski", std::to_wstring(i), worker.getId()), true);
+				}
+			});
+			checkpointer.checkpoint();
+			checkpointer.checkpoint();
+			stop = true;
+			writer.join();
+			log.commit();
+			const auto stats = checkpointer.getStats();
+			Assert::AreEqual(uint64_t(2), stats.snapshots);
+			Assert::IsTrue(stats.maxPause >= stats.lastPause);
+			Assert::IsTrue(stats.lastSize > 0);
+
+			// the snapshot and the segments after it give back the same state
+			RestaurantManager restored(nullptr);
+			Checkpointer loader(restored, path);
+			uint64_t segment;
+			Assert::IsTrue(loader.load(segment));
+			Assert::AreEqual(uint64_t(2), segment);
+			uint64_t next;
+			restored.replayWriteAheadLog(logPath, segment, next);
+			Assert::IsTrue(restored.getShifts() == manager.getShifts());
+			Assert::IsTrue(restored.getWorkers() == manager.getWorkers());
+			Assert::IsTrue(restored.getAccessTokens() == manager.getAccessTokens());
+			// the older segments are gone
+			Assert::IsFalse(std::ifstream(WriteAheadLog::segmentPath(logPath, 1)).good());
+
+			manager.setWriteAheadLog(nullptr);
+			log.close();
+			for (auto id = segment; id < next; id++)
+				std::remove(WriteAheadLog::segmentPath(logPath, id).c_str());
+			std::remove(Checkpointer::imagePath(path, 0).c_str());
+			std::remove(Checkpointer::imagePath(path, 1).c_str());
+		}
+		TEST_METHOD(ServeMappedImage) {
+			const std::string path = "ServeMappedImage.bin";
+			{
+				RestaurantManager manager(nullptr);
+				manager.getAccessTokens()["melon"] = UserPermissions::SUPER_USER;
+				const auto kept = manager.insertWorker(ShiftWorker(L"Jan", L"Kowalski", L"Kelner"));
+				const auto removed = manager.insertWorker(ShiftWorker(L"Anna", L"Nowak", L"Kucharz"));
+				for (int i = 0; i < 60; i++) {
+					const std::string job = i % 2 ? u8"Kelner" : u8"Kuchta Żaneta";
+					manager.insertShift(Shift(DateTime(2020, 6, 1 + i % 20, i / 20 * 4, 0, 0), 2, job,
+					                          i % 3 ? kept.getId() : removed.getId()));
+				}
+				Checkpointer saver(manager, path);
+				saver.checkpoint();
+
+				// the days are read from the mapping until they are changed
+				RestaurantManager mapped(nullptr);
+				Checkpointer loader(mapped, path);
+				uint64_t segment;
+				Assert::IsTrue(loader.load(segment));
+				Assert::IsTrue(mapped.getWorkers() == manager.getWorkers());
+				Assert::IsTrue(mapped.getAccessTokens() == manager.getAccessTokens());
+				Assert::IsTrue(mapped.getShifts() == manager.getShifts());
+				Assert::IsTrue(*mapped.getDaySnapshot(Date(2020, 6, 3)) == *manager.getDaySnapshot(Date(2020, 6, 3)));
+				Assert::IsTrue(mapped.getShiftsByWorker(kept.getId(), Date(2020, 6, 1), Date(2020, 6, 10)) ==
+					manager.getShiftsByWorker(kept.getId(), Date(2020, 6, 1), Date(2020, 6, 10)));
+				Assert::IsTrue(mapped.getShifts().size() == 60);
+
+				// changes load the days they touch, with the collisions checked against the mapped shifts
+				Assert::IsFalse(mapped.verifyShift(Shift(DateTime(2020, 6, 2, 1, 0, 0), 2, u8"Kelner")));
+				for (auto* target : { &manager, &mapped }) {
+					auto moved = target->getDaySnapshot(Date(2020, 6, 4))->front();
+					moved.setStartTime(DateTime(2020, 7, 1, 8, 0, 0));
+					target->insertShift(moved, true);
+					target->deleteShift(target->getDaySnapshot(Date(2020, 6, 5))->back().getId());
+					target->insertShift(Shift(DateTime(2020, 6, 6, 20, 0, 0), 1, u8"Kelner", removed.getId()));
+					target->deleteWorker(removed.getId());
+				}
+				Assert::IsTrue(mapped.getShifts() == manager.getShifts());
+				Assert::IsTrue(mapped.getShiftsByWorker(removed.getId(), Date(2020, 1, 1), Date(2021, 1, 1)).empty());
+				Assert::IsTrue(mapped.getShiftsByWorker(kept.getId(), Date(2020, 1, 1), Date(2021, 1, 1)) ==
+					manager.getShiftsByWorker(kept.getId(), Date(2020, 1, 1), Date(2021, 1, 1)));
+				const auto inserted = mapped.insertShift(Shift(DateTime(2020, 6, 7, 21, 0, 0), 1, u8"Kelner"));
+				Assert::IsTrue(inserted.getId() > 61);
+
+				// the next image holds the loaded days and the mapped ones, and is served from in turn
+				loader.checkpoint();
+				Assert::IsTrue(mapped.getShifts().size() == manager.getShifts().size() + 1);
+				mapped.deleteShift(inserted.getId());
+				Assert::IsTrue(mapped.getShifts() == manager.getShifts());
+				RestaurantManager reloaded(nullptr);
+				Checkpointer reloader(reloaded, path);
+				Assert::IsTrue(reloader.load(segment));
+				reloaded.deleteShift(inserted.getId());
+				Assert::IsTrue(reloaded.getShifts() == manager.getShifts());
+				Assert::IsTrue(reloaded.getWorkers() == manager.getWorkers());
+
+				// an image of another layout is not served
+				std::ifstream image(Checkpointer::imagePath(path, 0), std::ios::binary);
+				std::string data((std::istreambuf_iterator<char>(image)), std::istreambuf_iterator<char>());
+				data[4] = static_cast<char>(SnapshotImage::VERSION + 1);
+				std::ofstream bad(path + ".bad", std::ios::binary);
+				bad.write(data.data(), data.size());
+			}
+			Assert::ExpectException<std::runtime_error>([&path] {
+				SnapshotImage::open(path + ".bad");
+			});
+			std::remove((path + ".bad").c_str());
+
+			// a damaged image is skipped for the older checkpoint, the load fails only when none is left
+			const auto corrupt = [](const std::string& file) {
+				std::fstream image(file, std::ios::binary | std::ios::in | std::ios::out);
+				image.seekp(4);
+				image.put(static_cast<char>(SnapshotImage::VERSION + 1));
+			};
+			corrupt(Checkpointer::imagePath(path, 0));
+			{
+				RestaurantManager fallback(nullptr);
+				Checkpointer loader(fallback, path);
+				uint64_t segment;
+				Assert::IsTrue(loader.load(segment));
+				Assert::AreEqual(size_t(60), fallback.getShifts().size());
+			}
+			corrupt(Checkpointer::imagePath(path, 1));
+			Assert::ExpectException<std::runtime_error>([&path] {
+				RestaurantManager damaged(nullptr);
+				uint64_t segment;
+				Checkpointer(damaged, path).load(segment);
+			});
+			std::remove(Checkpointer::imagePath(path, 0).c_str());
+			std::remove(Checkpointer::imagePath(path, 1).c_str());
+		}
+		TEST_METHOD(FlushFramesQueuedDuringFlush) {
+			const int port = 47311;
+			auto* address = p_socket_address_new("127.0.0.1", port);
+			auto* listener = p_socket_new(P_SOCKET_FAMILY_INET, P_SOCKET_TYPE_STREAM, P_SOCKET_PROTOCOL_TCP, nullptr);
+			Assert::IsTrue(p_socket_bind(listener, address, TRUE, nullptr) && p_socket_listen(listener, nullptr));
+			p_socket_address_free(address);
+			RacingConnection connection;
+			connection.connect("127.0.0.1", port);
+			Connection peer(false);
+			peer.connect(p_socket_accept(listener, nullptr));
+			// another thread writes while the reading thread still owns the flush, and leaves its frame to it
+			connection.beforeRelease = [&connection] {
+				std::thread writer([&connection] {
+					connection.writeAsync(Ping(), nullptr);
+				});
+				writer.join();
+				Assert::AreEqual(size_t(1), connection.getQueuedFrames());
+			};
+			connection.replyAsReader(Ping());
+			Assert::AreEqual(size_t(0), connection.getQueuedFrames());
+			for (int i = 0; i < 2; i++)
+				Assert::IsTrue(dynamic_cast<Ping*>(peer.readSync().get()) != nullptr);
+			connection.close();
+			peer.close();
+			p_socket_close(listener, nullptr);
+			p_socket_free(listener);
+		}
+
+		TEST_METHOD(EncodeSharedFrames) {
+			S2C_ClientSync sync;
+			sync.getChangedShifts().insert(rand_shift());
+			sync.getRemovedWorkers().insert(rand_id());
+			for (auto format : { WireFormat::Fixed, WireFormat::Compact }) {
+				const auto frame = Connection::encodeSharedFrame(sync, format);
+				Assert::AreEqual(sizeof(content_len_t) + sync.serializedSize(format), frame->size());
+				BinaryReader header(frame->data(), sizeof(content_len_t));
+				const auto prefix = read_primitive<content_len_t>(header);
+				Assert::AreEqual(format == WireFormat::Compact, (prefix & COMPACT_FRAME_FLAG) != 0);
+				Assert::AreEqual(frame->size() - sizeof(content_len_t), static_cast<size_t>(prefix & ~COMPACT_FRAME_FLAG));
+				const auto decoded = decode_payload(frame->data() + sizeof(content_len_t), frame->size() - sizeof(content_len_t), format, DecodeLimits());
+				Assert::IsTrue(static_cast<const S2C_ClientSync&>(*decoded) == sync);
+			}
+			// connections that cannot share frames encode the payload themselves
+			CapturingConnection connection;
+			connection.writeAsync(sync, SharedFrame(), nullptr);
+			Assert::AreEqual(size_t(1), connection.packets.size());
+		}
 	};
 }
@@ -20,6 +20,7 @@ App::App() {
 	addHandler(&App::onInsertWorker);
 	addHandler(&App::onDeleteWorker);
 	addHandler(&App::onSync);
+	addHandler(&App::onGetChanges);
 }
 
 App::~App() {
@@ -106,11 +107,14 @@ void App::onSync(ConnectionBase* connection, const S2C_ClientSync& payload, size
 	refreshUi();
 }
 
-void App::onConnected(ConnectionBase* connection) {
-	ConnectionObserver::onConnected(connection);
-	try {
-		_client.queryWorkers();
-		if (_window)
-			_client.queryShiftsByDay(_window->getCurrentDate());
-	} catch(std::exception&) {}
+void App::onGetChanges(ConnectionBase* connection, const S2C_GetChangesReply& payload, size_t size) {
+	// the missed changes are merged by the client, unless the server could not tell them
+	if (payload.isSuccess() && !payload.isComplete()) {
+		try {
+			_client.queryWorkers();
+			if (_window)
+				_client.queryShiftsByDay(_window->getCurrentDate());
+		} catch(std::exception&) {}
+	}
+	refreshUi();
 }
@@ -8,6 +8,7 @@
 #include "S2C_GetWorkersReply.h"
 #include "S2C_InsertShiftReply.h"
 #include "S2C_InsertWorkerReply.h"
+#include "S2C_GetChangesReply.h"
 #include "RestaurantClient.h"
 
 const std::string HOST = "127.0.0.1";
@@ -52,7 +53,7 @@ protected:
 	void onInsertWorker(ConnectionBase* connection, const S2C_InsertWorkerReply& payload, size_t size);
 	void onDeleteWorker(ConnectionBase* connection, const S2C_DeleteWorkerReply& payload, size_t size);
 	void onSync(ConnectionBase* connection, const S2C_ClientSync& payload, size_t size);
-	void onConnected(ConnectionBase* connection) override;
+	void onGetChanges(ConnectionBase* connection, const S2C_GetChangesReply& payload, size_t size);
 
 public:
 	/**
@@ -120,12 +120,8 @@ void MainWindow::openShiftEditor(identity_t shiftId) {
 }
 
 void MainWindow::checkJobs() {
-	currentJobs.clear();
 	// collects unique jobs from a given day
-	for (auto ref : _app->getClient().getShifts(_currentDate)) {
-		auto& shift = ref.get();
-		currentJobs.insert(shift.getJobName());
-	}
+	currentJobs = _app->getClient().getJobs(_currentDate);
 }
 
 void MainWindow::resizeGrid(int nRows, int nCols) {
@@ -168,12 +164,12 @@ void MainWindow::drawTable() {
 	}
 	_grid->SetColLabelValue(0, "No data");
 
-	std::map<std::wstring, int> jobToColumn;
+	std::map<job_id_t, int> jobToColumn;
 	{
 		int col = 0;
-		for (auto job : currentJobs) {
-			_grid->SetColLabelValue(col, job);
-			jobToColumn[job] = col++;
+		for (const auto& job : currentJobs) {
+			_grid->SetColLabelValue(col, job.first);
+			jobToColumn[job.second] = col++;
 		}
 	}
 
@@ -190,7 +186,7 @@ void MainWindow::drawTable() {
 		}
 		catch (std::exception&) { }
 
-		int col = jobToColumn[shift.getJobName()];
+		int col = jobToColumn[shift.getJobId()];
 		int row = shift.getStartTime().getHour() - START_HOUR;
 
 		_grid->SetCellValue(row, col, workerName);
@@ -222,6 +218,12 @@ void MainWindow::onCurrDateButtonClicked(wxCommandEvent& evt) {
 	const auto now = wxDateTime::Now();
 	_calendar->SetValue(now);
 	_currentDate = asDateModel(now);
+	try {
+		_app->getClient().viewDay(_currentDate);
+	}
+	catch (std::exception& ex) {
+		showExceptionMessageBox("Connection failure", "Error while connecting to the server", ex, this);
+	}
 	refreshInternal();
 	evt.Skip();
 }
@@ -241,7 +243,7 @@ void MainWindow::onDateChanged(wxDateEvent& evt) {
 	const auto& date = evt.GetDate();
 	_currentDate = asDateModel(date);
 	try {
-		_app->getClient().queryShiftsByDay(_currentDate);
+		_app->getClient().viewDay(_currentDate);
 	}
 	catch (std::exception& ex) {
 		showExceptionMessageBox("Connection failure", "Error while connecting to the server", ex, this);
@@ -272,7 +274,7 @@ void MainWindow::onSizeChanged(wxSizeEvent& evt) {
 void MainWindow::onShown(wxShowEvent& evt) {
 	_app->setMainWindow(this);
 	try {
-		_app->getClient().queryShiftsByDay(_currentDate);
+		_app->getClient().viewDay(_currentDate);
 	}
 	catch (std::exception& ex) {
 		showExceptionMessageBox("Connection failure", "Error while connecting to the server", ex, this, true);
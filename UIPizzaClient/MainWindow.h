@@ -22,7 +22,7 @@ private:
 	Date _currentDate; /**<Keeps current date as Date*/
 	std::map<std::tuple<int, int>, identity_t> _gridShifts; /**<Keeps shifts ID by x and y positions*/
 
-	std::set<std::wstring> currentJobs; /**<Keeps jobs for the current day*/
+	std::map<std::wstring, job_id_t> currentJobs; /**<Keeps jobs for the current day, by name*/
 
 	/**
 	 * UI elements
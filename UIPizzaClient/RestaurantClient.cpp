@@ -4,9 +4,12 @@
 #include "C2S_DeleteShift.h"
 #include "C2S_DeleteWorker.h"
 #include "C2S_GetShiftsByDay.h"
+#include "C2S_GetShiftsByWorker.h"
 #include "C2S_GetWorkers.h"
 #include "C2S_InsertShift.h"
 #include "C2S_InsertWorker.h"
+#include "C2S_SubscribeDays.h"
+#include "C2S_GetChanges.h"
 #include "S2C_DeleteWorkerReply.h"
 
 int RestaurantClient::authorize() {
@@ -33,6 +36,24 @@ int RestaurantClient::queryShiftsByDay(const Date& day) {
 	return writeRequest(request);
 }
 
+int RestaurantClient::queryShiftsByWorker(identity_t workerId, const Date& from, const Date& to) {
+	C2S_GetShiftsByWorker request(workerId, from, to);
+	return writeRequest(request);
+}
+
+int RestaurantClient::subscribeDays(const Date& from, const Date& to) {
+	_subscribed = true;
+	_subscribedFrom = from;
+	_subscribedTo = to;
+	C2S_SubscribeDays request(from, to);
+	return writeRequest(request);
+}
+
+int RestaurantClient::queryChanges() {
+	C2S_GetChanges request(_logId, _version);
+	return writeRequest(request);
+}
+
 int RestaurantClient::queryWorkers() {
 	C2S_GetWorkers request;
 	return writeRequest(request);
@@ -74,6 +95,8 @@ void RestaurantClient::insertShift(const Shift& shift) {
 	}
 	_shifts[shift.getId()] = shift;
 	_shiftsByDay[shift.getStartTime()].insert(shift.getId());
+	if (shift.getWorkerId())
+		_shiftsByWorker[shift.getWorkerId()].insert(shift.getId());
 }
 
 void RestaurantClient::deleteShift(identity_t id) {
@@ -81,20 +104,27 @@ void RestaurantClient::deleteShift(identity_t id) {
 	if (it != _shifts.end()) {
 		const auto& shift = it->second;
 		_shiftsByDay[shift.getStartTime()].erase(shift.getId());
+		auto assigned = _shiftsByWorker.find(shift.getWorkerId());
+		if (assigned != _shiftsByWorker.end()) {
+			assigned->second.erase(shift.getId());
+			if (assigned->second.empty())
+				_shiftsByWorker.erase(assigned);
+		}
 		_shifts.erase(shift.getId());
 	}
 }
 
 void RestaurantClient::deleteWorker(identity_t id) {
-	auto it = _workers.find(id);
-	if (it != _workers.end()) {
-		_workers.erase(it);
-		for (auto& kv : _shifts) {
-			auto& shift = kv.second;
-			if (shift.getWorkerId() == id)
-				shift.setWorkerId(0);
-		}
+	_workers.erase(id);
+	auto it = _shiftsByWorker.find(id);
+	if (it == _shiftsByWorker.end())
+		return;
+	for (auto shiftId : it->second) {
+		auto shift = _shifts.find(shiftId);
+		if (shift != _shifts.end() && shift->second.getWorkerId() == id)
+			shift->second.setWorkerId(0);
 	}
+	_shiftsByWorker.erase(it);
 }
 
 Shift& RestaurantClient::getShift(identity_t id) {
@@ -118,6 +148,37 @@ std::set<std::reference_wrapper<Shift>> RestaurantClient::getShifts(Date day) {
 	return temp;
 }
 
+std::set<std::reference_wrapper<Shift>> RestaurantClient::getShiftsByWorker(identity_t workerId) {
+	std::set<std::reference_wrapper<Shift>> temp;
+	auto it = _shiftsByWorker.find(workerId);
+	if (it == _shiftsByWorker.end()) {
+		return temp;
+	}
+
+	for (auto id : it->second) {
+		temp.insert(getShift(id));
+	}
+	return temp;
+}
+
+std::map<std::wstring, job_id_t> RestaurantClient::getJobs(Date day) {
+	std::map<std::wstring, job_id_t> jobs;
+	auto it = _shiftsByDay.find(day);
+	if (it == _shiftsByDay.end()) {
+		return jobs;
+	}
+
+	// shifts of the same job share the id, so every name is converted only once
+	std::set<job_id_t> ids;
+	for (auto& kv : it->second) {
+		ids.insert(getShift(kv).getJobId());
+	}
+	for (auto id : ids) {
+		jobs[Utf8::toWide(JobCatalog::getInstance().getName(id))] = id;
+	}
+	return jobs;
+}
+
 void RestaurantClient::onAuthorize(ConnectionBase* connection, const S2C_AuthorizeReply& payload, size_t size) {
 	_permissions = payload.getPermissions();
 }
@@ -129,13 +190,34 @@ void RestaurantClient::onDeleteShift(ConnectionBase* connection, const S2C_Delet
 }
 
 void RestaurantClient::onGetShiftsByDay(ConnectionBase* connection, const S2C_GetShiftsReply& payload, size_t size) {
-	auto shifts = payload.getShifts();
-	for (const auto& shift : shifts) {
-		insertShift(shift);
+	// busy days arrive in several parts, each one merged as soon as it is received
+	// shifts that did not change since the last refresh are never decoded into Shift objects
+	for (const auto& view : payload.getShiftsView()) {
+		_receivedShifts.insert(view.getId());
+		auto it = _shifts.find(view.getId());
+		if (it == _shifts.end() || view != it->second)
+			insertShift(view.toShift());
 	}
+	if (payload.isContinued())
+		return;
+	// days not subscribed to miss removals, so cached shifts absent from a complete listing are stale
+	if (payload.isSuccess()) {
+		auto it = _shiftsByDay.find(payload.getDate());
+		if (it != _shiftsByDay.end()) {
+			std::vector<identity_t> stale;
+			for (auto id : it->second) {
+				if (_receivedShifts.find(id) == _receivedShifts.end())
+					stale.push_back(id);
+			}
+			for (auto id : stale)
+				deleteShift(id);
+		}
+	}
+	_receivedShifts.clear();
 }
 
 void RestaurantClient::onGetWorkers(ConnectionBase* connection, const S2C_GetWorkersReply& payload, size_t size) {
+	// large sites arrive in several parts, each one merged as soon as it is received
 	for (auto& kv : payload.getWorkers()) {
 		_workers[kv.first] = kv.second;
 	}
@@ -155,32 +237,70 @@ void RestaurantClient::onInsertWorker(ConnectionBase* connection, const S2C_Inse
 
 void RestaurantClient::onDeleteWorker(ConnectionBase* connection, const S2C_DeleteWorkerReply& payload, size_t size) {
 	if (payload.isSuccess()) {
-		_workers.erase(payload.getId());
-		for (auto& kv : _shifts) {
-			auto& shift = kv.second;
-			if (shift.getWorkerId() == payload.getId())
-				shift.setWorkerId(0);
-		}
+		deleteWorker(payload.getId());
 	}
 }
 
 void RestaurantClient::onSync(ConnectionBase* connection, const S2C_ClientSync& payload, size_t size) {
-	for (auto id : payload.getRemovedShifts()) {
+	applyChanges(payload);
+}
+
+void RestaurantClient::onGetChanges(ConnectionBase* connection, const S2C_GetChangesReply& payload, size_t size) {
+	if (!payload.isSuccess())
+		return;
+	if (payload.isComplete()) {
+		applyChanges(payload.getChanges());
+	}
+	else {
+		// everything is listed again; workers removed in the meantime would be left behind otherwise
+		_workers.clear();
+		_version = 0;
+	}
+	_logId = payload.getLogId();
+	if (_version < payload.getChanges().getVersion())
+		_version = payload.getChanges().getVersion();
+}
+
+void RestaurantClient::onGetShiftsByWorker(ConnectionBase* connection, const S2C_GetShiftsByWorkerReply& payload,
+                                           size_t size) {
+	// long schedules arrive in several parts, each one merged as soon as it is received
+	for (const auto& shift : payload.getShifts()) {
+		insertShift(shift);
+	}
+}
+
+void RestaurantClient::applyChanges(const S2C_ClientSync& changes) {
+	for (auto id : changes.getRemovedShifts()) {
 		deleteShift(id);
 	}
-	for (auto id : payload.getRemovedWorkers()) {
+	for (auto id : changes.getRemovedWorkers()) {
 		deleteWorker(id);
 	}
-	for (const auto& worker : payload.getChangedWorkers()) {
+	for (const auto& worker : changes.getChangedWorkers()) {
 		_workers[worker.getId()] = worker;
 	}
-	for (const auto& shift : payload.getChangedShifts()) {
+	for (const auto& shift : changes.getChangedShifts()) {
 		insertShift(shift);
 	}
+	// syncs sent before a reply may arrive after it
+	if (_version < changes.getVersion())
+		_version = changes.getVersion();
+}
+
+void RestaurantClient::onSubscribeDays(ConnectionBase* connection, const S2C_SubscribeDaysReply& payload,
+                                       size_t size) {
+	// a rejected range leaves the server sending the changes of all days, which is harmless
 }
 
 void RestaurantClient::onConnected(ConnectionBase* connection) {
 	ConnectionObserver::onConnected(connection);
+	// taken before any sync of the new connection can move the version past the missed changes
+	C2S_GetChanges changes(_logId, _version);
 	_connection.setReadingAsync(true);
 	authorize();
+	if (_subscribed) {
+		C2S_SubscribeDays request(_subscribedFrom, _subscribedTo);
+		writeRequest(request);
+	}
+	writeRequest(changes);
 }
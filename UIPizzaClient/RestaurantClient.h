@@ -6,12 +6,15 @@
 #include "ShiftWorker.h"
 #include "S2C_AuthorizeReply.h"
 #include "S2C_DeleteShiftReply.h"
+#include "S2C_GetShiftsByWorkerReply.h"
 #include "S2C_GetShiftsReply.h"
 #include "S2C_GetWorkersReply.h"
 #include "S2C_InsertShiftReply.h"
 #include "S2C_InsertWorkerReply.h"
 #include "S2C_DeleteWorkerReply.h"
 #include "S2C_ClientSync.h"
+#include "S2C_SubscribeDaysReply.h"
+#include "S2C_GetChangesReply.h"
 
 /**
  * Client interface to access resources provided by the remote RestaurantManager
@@ -25,7 +28,18 @@ protected:
 	std::map<identity_t, ShiftWorker> _workers;
 	std::map<identity_t, Shift> _shifts;
 	std::map<Date, std::set<identity_t>> _shiftsByDay;
+	/* worker id -> ids of the cached shifts assigned to the worker */
+	std::map<identity_t, std::set<identity_t>> _shiftsByWorker;
 	UserPermissions _permissions;
+	/* range of days the server sends the changes of, restored on every connection */
+	bool _subscribed = false;
+	Date _subscribedFrom;
+	Date _subscribedTo;
+	/* change log of the server and the last version of it merged, to ask only for the missed changes */
+	uint64_t _logId = 0;
+	uint64_t _version = 0;
+	/* shifts received so far by the reply being streamed */
+	std::set<identity_t> _receivedShifts;
 
 	/**
 	 * Sends a request to the server while ensuring the internal Connection is alive
@@ -78,6 +92,16 @@ public:
 	 */
 	std::set<std::reference_wrapper<Shift>> getShifts(Date day);
 
+	/**
+	 * Gets the local Shift objects assigned to a ShiftWorker
+	 */
+	std::set<std::reference_wrapper<Shift>> getShiftsByWorker(identity_t workerId);
+
+	/**
+	 * Gets the jobs of all local Shift objects by Date, sorted by name
+	 */
+	std::map<std::wstring, job_id_t> getJobs(Date day);
+
 
 protected:
 	/**
@@ -91,6 +115,13 @@ protected:
 	void onInsertWorker(ConnectionBase* connection, const S2C_InsertWorkerReply& payload, size_t size);
 	void onDeleteWorker(ConnectionBase* connection, const S2C_DeleteWorkerReply& payload, size_t size);
 	void onSync(ConnectionBase* connection, const S2C_ClientSync& payload, size_t size);
+	void onSubscribeDays(ConnectionBase* connection, const S2C_SubscribeDaysReply& payload, size_t size);
+	void onGetChanges(ConnectionBase* connection, const S2C_GetChangesReply& payload, size_t size);
+	void onGetShiftsByWorker(ConnectionBase* connection, const S2C_GetShiftsByWorkerReply& payload, size_t size);
+	/**
+	 * Merges changes into the local database
+	 */
+	void applyChanges(const S2C_ClientSync& changes);
 	void onConnected(ConnectionBase* connection) override;
 
 public:
@@ -108,6 +139,9 @@ public:
 		addHandler(&RestaurantClient::onInsertWorker);
 		addHandler(&RestaurantClient::onDeleteWorker);
 		addHandler(&RestaurantClient::onSync);
+		addHandler(&RestaurantClient::onSubscribeDays);
+		addHandler(&RestaurantClient::onGetChanges);
+		addHandler(&RestaurantClient::onGetShiftsByWorker);
 	}
 
 	/**
@@ -216,6 +250,37 @@ public:
 	 * @return unique request id
 	 */
 	int queryShiftsByDay(const Date& day);
+	/**
+	 * Sends a request to receive the changes of Shift objects only in the specified range of days.
+	 * The range is sent again whenever the connection is restored.
+	 * Cached shifts of other days are not kept up to date anymore, so they have to be queried again before use.
+	 * @param from first day of the range
+	 * @param to last day of the range (inclusive)
+	 * @return unique request id
+	 */
+	int subscribeDays(const Date& from, const Date& to);
+	/**
+	 * Subscribes to the changes of the specified Date and lists all its Shift objects
+	 * @return unique request id of the listing
+	 */
+	int viewDay(const Date& day) {
+		subscribeDays(day, day);
+		return queryShiftsByDay(day);
+	}
+	/**
+	 * Sends a request for the changes made since the last version merged.
+	 * The reply is not complete if the server cannot tell them, then everything has to be listed again
+	 * @return unique request id
+	 */
+	int queryChanges();
+	/**
+	 * Sends a request to list the Shift objects assigned to a ShiftWorker in the specified range of days
+	 * @param workerId id of the ShiftWorker
+	 * @param from first day of the range
+	 * @param to last day of the range (inclusive)
+	 * @return unique request id
+	 */
+	int queryShiftsByWorker(identity_t workerId, const Date& from, const Date& to);
 	/**
 	 * Sends a request to list all ShiftWorker objects
 	 * @return unique request id